@@ -0,0 +1,44 @@
+#version 330 core
+// One pass of the bloom mip chain (Jimenez, Next Generation Post Processing
+// in Call of Duty: Advanced Warfare)
+// - downsample: 13 taps from the next larger level, the 4 overlapping 4x4
+//   boxes weigh 0.125 each and the center box 0.5, which keeps the bright
+//   pixels from flickering as they move across the texels
+// - upsample: 3x3 tent from the next smaller level, added onto the level
+//   that is drawn (blending is on)
+out vec4 FragColor;
+
+in vec2 TexCoords;
+
+uniform sampler2D image;
+
+uniform bool upsample;
+
+vec3 tap(vec2 offset, vec2 texel) {
+    return texture(image, TexCoords + offset * texel).rgb;
+}
+
+void main()
+{
+    // Size of a texel of the level that is read
+    vec2 texel = 1.0 / textureSize(image, 0);
+    vec3 result;
+    if (upsample) {
+        result = tap(vec2(0.0, 0.0), texel) * 4.0;
+        result += (tap(vec2(0.0, 1.0), texel) + tap(vec2(-1.0, 0.0), texel) +
+                   tap(vec2(1.0, 0.0), texel) + tap(vec2(0.0, -1.0), texel)) * 2.0;
+        result += tap(vec2(-1.0, 1.0), texel) + tap(vec2(1.0, 1.0), texel) +
+                  tap(vec2(-1.0, -1.0), texel) + tap(vec2(1.0, -1.0), texel);
+        result /= 16.0;
+    } else {
+        vec3 e = tap(vec2(0.0, 0.0), texel);
+        vec3 corners = tap(vec2(-2.0, 2.0), texel) + tap(vec2(2.0, 2.0), texel) +
+                       tap(vec2(-2.0, -2.0), texel) + tap(vec2(2.0, -2.0), texel);
+        vec3 edges = tap(vec2(0.0, 2.0), texel) + tap(vec2(-2.0, 0.0), texel) +
+                     tap(vec2(2.0, 0.0), texel) + tap(vec2(0.0, -2.0), texel);
+        vec3 inner = tap(vec2(-1.0, 1.0), texel) + tap(vec2(1.0, 1.0), texel) +
+                     tap(vec2(-1.0, -1.0), texel) + tap(vec2(1.0, -1.0), texel);
+        result = e * 0.125 + corners * 0.03125 + edges * 0.0625 + inner * 0.125;
+    }
+    FragColor = vec4(result, 1.0);
+}
@@ -0,0 +1,34 @@
+#version 330 core
+// Heatmap of one channel of the march cost target
+// - 0 is dark blue, maxCost (the max of a recent frame) is dark red
+out vec4 FragColor;
+
+in vec2 TexCoords;
+
+uniform sampler2D costTexture;
+// - 0 primary steps, 1 shadow steps, 2 SDF evaluations, 3 all steps
+uniform int channel;
+uniform float maxCost;
+
+// Turbo colormap, polynomial fit
+// - https://gist.github.com/mikhailov-work/0d177465a8151eb6ede1768d51d476c7
+vec3 turbo(float x) {
+    const vec4 kRedVec4 = vec4(0.13572138, 4.61539260, -42.66032258, 132.13108234);
+    const vec4 kGreenVec4 = vec4(0.09140261, 2.19418839, 4.84296658, -14.18503333);
+    const vec4 kBlueVec4 = vec4(0.10667330, 12.64194608, -60.58204836, 110.36276771);
+    const vec2 kRedVec2 = vec2(-152.94239396, 59.28637943);
+    const vec2 kGreenVec2 = vec2(4.27729857, 2.82956604);
+    const vec2 kBlueVec2 = vec2(-89.90310912, 27.34824973);
+    x = clamp(x, 0.0, 1.0);
+    vec4 v4 = vec4(1.0, x, x * x, x * x * x);
+    vec2 v2 = v4.zw * v4.z;
+    return vec3(dot(v4, kRedVec4) + dot(v2, kRedVec2),
+                dot(v4, kGreenVec4) + dot(v2, kGreenVec2),
+                dot(v4, kBlueVec4) + dot(v2, kBlueVec2));
+}
+
+void main()
+{
+    float cost = texture(costTexture, TexCoords)[channel];
+    FragColor = vec4(turbo(cost / max(maxCost, 1.0)), 1.0);
+}
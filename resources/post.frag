@@ -1,14 +1,43 @@
 #version 330 core
-// FXAA
-// source: http://blog.simonrodriguez.fr/articles/2016/07/implementing_fxaa.html
+// Post processing of the frame in a single pass
+// ==== Preprocessor Directives ====
+// Injected after #version by RayMarchRenderer, one compiled permutation per
+// set of the enabled effects:
+// HDR, BLOOM: adds the bloom (BLOOM) and tone maps with the exposure
+// GAMMA: gamma correction (only without HDR and BLOOM)
+// FXAA: anti-aliasing of the result. Every tap of FXAA goes through the
+//       light effects above, so they need no target of their own
+// (none copies the frame)
 out vec4 FragColor;
 
 in vec2 TexCoords;
 
-uniform sampler2D screenTexture;
+uniform sampler2D frame;
+uniform sampler2D bloomBlur;
+// - the bloom is the sum of the levels of its mip chain
+uniform float bloomScale;
+uniform float exposure;
 uniform vec2 inverseScreenSize;
 uniform float multiplier = 1.0;
 
+// Light effects of the frame at uv
+vec3 fetch(vec2 uv) {
+    vec3 color = texture(frame, uv).rgb;
+#ifdef BLOOM
+    color += texture(bloomBlur, uv).rgb * bloomScale;
+#endif
+#if defined(HDR) || defined(BLOOM)
+    color = vec3(1.0) - exp(-color * exposure);
+#elif defined(GAMMA)
+    const float gamma = 2.2;
+    color = pow(color, vec3(1.0 / gamma));
+#endif
+    return color;
+}
+
+#ifdef FXAA
+// FXAA
+// source: http://blog.simonrodriguez.fr/articles/2016/07/implementing_fxaa.html
 float EDGE_THRESHOLD_MIN = 0.0312;
 float EDGE_THRESHOLD_MAX = 0.125;
 float SUBPIXEL_QUALITY = 0.875;
@@ -20,15 +49,15 @@ float rgb2luma(vec3 rgb) {
     return sqrt(dot(rgb, vec3(0.299, 0.587, 0.114)));
 }
 
-void main() {
-    vec3 colorCenter = texture(screenTexture, TexCoords).rgb;
+vec3 applyFXAA() {
+    vec3 colorCenter = fetch(TexCoords);
 
     float lumaCenter = rgb2luma(colorCenter);
 
-    float lumaDown = rgb2luma(textureOffset(screenTexture,TexCoords,ivec2(0,-1)).rgb);
-    float lumaUp = rgb2luma(textureOffset(screenTexture,TexCoords,ivec2(0,1)).rgb);
-    float lumaLeft = rgb2luma(textureOffset(screenTexture,TexCoords,ivec2(-1,0)).rgb);
-    float lumaRight = rgb2luma(textureOffset(screenTexture,TexCoords,ivec2(1,0)).rgb);
+    float lumaDown = rgb2luma(fetch(TexCoords + vec2(0, -1) * inverseScreenSize));
+    float lumaUp = rgb2luma(fetch(TexCoords + vec2(0, 1) * inverseScreenSize));
+    float lumaLeft = rgb2luma(fetch(TexCoords + vec2(-1, 0) * inverseScreenSize));
+    float lumaRight = rgb2luma(fetch(TexCoords + vec2(1, 0) * inverseScreenSize));
 
     float lumaMin = min(lumaCenter,min(min(lumaDown,lumaUp),min(lumaLeft,lumaRight)));
     float lumaMax = max(lumaCenter,max(max(lumaDown,lumaUp),max(lumaLeft,lumaRight)));
@@ -36,14 +65,13 @@ void main() {
     float lumaRange = lumaMax - lumaMin;
     // Check if pixel is part of an edge
     if (lumaRange < max(EDGE_THRESHOLD_MIN, lumaMax * EDGE_THRESHOLD_MAX)) {
-        FragColor = vec4(colorCenter, 1.0);
-        return;
+        return colorCenter;
     }
 
-    float lumaDownLeft = rgb2luma(textureOffset(screenTexture,TexCoords,ivec2(-1,-1)).rgb);
-    float lumaUpRight = rgb2luma(textureOffset(screenTexture,TexCoords,ivec2(1,1)).rgb);
-    float lumaUpLeft = rgb2luma(textureOffset(screenTexture,TexCoords,ivec2(-1,1)).rgb);
-    float lumaDownRight = rgb2luma(textureOffset(screenTexture,TexCoords,ivec2(1,-1)).rgb);
+    float lumaDownLeft = rgb2luma(fetch(TexCoords + vec2(-1, -1) * inverseScreenSize));
+    float lumaUpRight = rgb2luma(fetch(TexCoords + vec2(1, 1) * inverseScreenSize));
+    float lumaUpLeft = rgb2luma(fetch(TexCoords + vec2(-1, 1) * inverseScreenSize));
+    float lumaDownRight = rgb2luma(fetch(TexCoords + vec2(1, -1) * inverseScreenSize));
 
     // Combine the four edges lumas (using intermediary variables for future computations with the same values).
     float lumaDownUp = lumaDown + lumaUp;
@@ -92,8 +120,8 @@ void main() {
     vec2 uv1 = currentUV - offset;
     vec2 uv2 = currentUV + offset;
 
-    float lumaEnd1 = rgb2luma(texture(screenTexture, uv1).rgb);
-    float lumaEnd2 = rgb2luma(texture(screenTexture, uv2).rgb);
+    float lumaEnd1 = rgb2luma(fetch(uv1));
+    float lumaEnd2 = rgb2luma(fetch(uv2));
     lumaEnd1 -= lumaLocalAverage;
     lumaEnd2 -= lumaLocalAverage;
 
@@ -108,12 +136,12 @@ void main() {
     if (!reachedBoth) {
         for (int i = 2; i < ITERATIONS; i++) {
             if (!reached1) {
-                lumaEnd1 = rgb2luma(texture(screenTexture, uv1).rgb);
+                lumaEnd1 = rgb2luma(fetch(uv1));
                 lumaEnd1 = lumaEnd1 - lumaLocalAverage;
             }
 
             if (!reached2) {
-                lumaEnd2 = rgb2luma(texture(screenTexture, uv2).rgb);
+                lumaEnd2 = rgb2luma(fetch(uv2));
                 lumaEnd2 = lumaEnd2 - lumaLocalAverage;
             }
 
@@ -161,6 +189,14 @@ void main() {
         finalUv.x += finalOffset * stepLength * multiplier;
     }
 
-    vec3 finalColor = texture(screenTexture, finalUv).rgb;
-    FragColor = vec4(finalColor, 1.0);
+    return fetch(finalUv);
+}
+#endif
+
+void main() {
+#ifdef FXAA
+    FragColor = vec4(applyFXAA(), 1.0);
+#else
+    FragColor = vec4(fetch(TexCoords), 1.0);
+#endif
 }
@@ -1,22 +1,33 @@
 #version 330 core
 // ==== Preprocessor Directives ====
-
+// Injected after #version by RayMarchRenderer from the globalData of the
+// scene (see SceneShaderFeatures), one compiled permutation per set:
 // == DAY and NIGHT ==
-// #define SKY_BACKGROUND
-// #define NIGHTSKY_BACKGROUND
+// SKY_BACKGROUND, NIGHTSKY_BACKGROUND
 // == MONOTONE ==
-// #define DARK_BACKGROUND
-#define WHITE_BACKGROUND
-
+// DARK_BACKGROUND, WHITE_BACKGROUND
 // ENVIRONMENT
-// #define CLOUD
-// #define TERRAIN
-// #define SEA
-#define PERLIN_BUMP
+// CLOUD, TERRAIN, SEA
+// PERLIN_BUMP
+// == DEFERRED PASSES ==
+// GBUFFER_PASS, SHADOW_PASS, AO_PASS, LIGHTING_PASS (none for the forward
+// pass that does everything at once)
 
 // =============== Out =============
 layout (location = 0) out vec4 fragColor;
 layout (location = 1) out vec4 BrightColor;
+// - depth from the eye of the primary hit (0 if no hit), kept for the
+//   reprojection of the next frame
+layout (location = 2) out float hitDepth;
+// - march cost of the pixel: primary steps, shadow steps, SDF evaluations
+//   and all the steps (primary, secondary and shadow rays)
+layout (location = 3) out vec4 marchCost;
+#ifdef GBUFFER_PASS
+// - the G-buffer pass writes the position and the depth from the eye (0 if
+//   no hit) to location 0 and the normal and the object to location 1
+layout (location = 4) out vec4 gTrap;
+layout (location = 5) out float gCustomId;
+#endif
 // =============== In ==============
 in vec4 nearClip;
 in vec4 farClip;
@@ -28,6 +39,8 @@ const float OUTSIDE = 1.f;
 const int MAX_STEPS = 256;
 const int MAX_STEPS_FRACTALS = 20;
 const int FRACTALS_BAILOUT = 2;
+// - fewest iterations of a fractal, however small its detail on screen
+const int MIN_FRACTAL_ITERATIONS = 4;
 // - threshold for intersection
 const float SURFACE_DIST = 0.001;
 const float PLANCK = 0.01;
@@ -37,6 +50,8 @@ const float SHADOWRAY_OFFSET = 0.007;
 const float TEXTURE_EPS = 0.005;
 // - area light samples
 const int AREA_LIGHT_SAMPLES = 1;
+// - half angle of the cone that shadow rays are jittered in when accumulating
+const float SHADOW_CONE_ANGLE = 0.03;
 // - PI
 const float PI = 3.14159265;
 const float TAU = 6.28318;
@@ -130,11 +145,31 @@ const float BUMP_INTENSITY = 2.0;
 
 int FRAME;
 float SPEED;
+// March cost of the pixel (see marchCost)
+// - iterations of raymarch (primary and secondary rays) and of softshadow
+int MARCH_STEPS = 0;
+int SHADOW_STEPS = 0;
+// - MARCH_STEPS after the primary ray
+int PRIMARY_STEPS = 0;
+// - objects evaluated by sdScene
+int SDF_EVALS = 0;
+// Radius of the pixel cone at the current point of raymarch
+// - 0 outside of raymarch, so normals, shadows and AO evaluate every SDF in
+//   full detail, in the forward and in the deferred passes alike
+float PIXEL_FOOTPRINT = 0.f;
+// True while a march picks its steps, which may use the bound of the SDF
+// cache. Normals, the penumbra and AO need the distance, so sdScene
+// evaluates the cached objects otherwise
+bool USE_SDF_CACHE = false;
+// True while the lighting pass shades the primary hit, whose shadows and AO
+// were computed by the shadow and AO passes
+bool SHADE_FROM_GBUFFER = false;
 const int SPEED_SCALE = 3;
 // ============ Structs ============
 struct RayMarchObject
 {
     // Struct for each shape
+    // - unpacked from the object buffers by getObject
 
     // Type of the shape
     int type;
@@ -212,20 +247,21 @@ struct IntersectionInfo
 struct LightSource
 {
     // Struct for lights in the scene
+    // - unpacked from the light buffer by getLight
 
     // Common
-    int type;
     vec3 lightColor;
+    int type;
 
     vec3 lightDir;
-    vec3 lightPos;
-    vec3 lightFunc;
     float lightAngle;
+    vec3 lightPos;
     float lightPenumbra;
+    vec3 lightFunc;
 
     // Area Light
-    vec3 points[4];
     float intensity;
+    vec3 points[4];
     bool twoSided;
 };
 
@@ -246,20 +282,74 @@ uniform vec4 eyePosition;
 uniform vec2 screenDimensions;
 uniform float initialFar;
 uniform bool isTwoD;
+// - radius of the cone of a pixel per unit of depth
+uniform float pixelRadius;
+// - index of the accumulated sample (0 if not accumulating)
+uniform int sampleIndex;
 
 // Lighting
-// - Phong Constants
-uniform float ka;
-uniform float kd;
-uniform float ks;
-uniform float kt;
-// - Scene Lights
-uniform LightSource lights[10];
-uniform int numLights;
+// - only re-uploaded when the scene changes
+layout(std140) uniform LightBlock
+{
+    // - Scene Lights (in lightData)
+    int numLights;
+    // - Phong Constants
+    float ka;
+    float kd;
+    float ks;
+    float kt;
+};
 
 // Objects
-uniform RayMarchObject objects[30];
+// - packed by RayMarchScene::packObjects, only re-uploaded when the scene
+//   changes. The geometry (all that sdScene reads) and the material live in
+//   separate buffers so that the marching loop only touches 4 texels per
+//   object
+uniform samplerBuffer objectGeometry;
+uniform samplerBuffer objectMaterials;
 uniform int numObjects;
+// - BVH over the object bounds (see bvh.h). 2 texels per node:
+//   (min, left child or first object), (max, number of objects)
+uniform samplerBuffer bvhNodes;
+// - object indices of the leaves, followed by the unbounded objects
+uniform isamplerBuffer bvhObjects;
+uniform int numBVHNodes;
+uniform int numUnboundedObjects;
+uniform int unboundedStart;
+// - the unbounded objects that are not in the SDF cache come first
+uniform int numUncachedObjects;
+
+// SDF cache of the static objects (see sdfcache.h)
+// - grid of cells: (atlas position of the brick or -1, lower bound of the
+//   distance in the cell)
+uniform sampler3D sdfCacheGrid;
+// - bricks of SDF_CACHE_BRICK^3 distance samples, the border samples are
+//   shared with the neighbouring bricks
+uniform sampler3D sdfCacheAtlas;
+uniform bool useSDFCache;
+uniform vec3 sdfCacheMin;
+uniform vec3 sdfCacheDims;
+uniform float sdfCacheCellSize;
+// - max amount by which the interpolated distance exceeds the distance
+uniform float sdfCacheError;
+// - distance within which the objects are evaluated instead
+uniform float sdfCacheRefine;
+
+// Lights
+// - packed by RayMarchRenderer::uploadLights, only re-uploaded when the
+//   scene changes
+uniform samplerBuffer lightData;
+// - clusters of the view frustum (see lightclusters.h): (offset, count) per
+//   cluster, followed by the light indices of every cluster. Re-built when
+//   the view changes
+uniform isamplerBuffer lightClusters;
+uniform bool useLightClusters;
+// - NDC of view space xy at depth 1
+uniform vec2 clusterScale;
+// - slices split the depth exponentially from the near plane
+uniform float clusterNear;
+uniform float clusterLogScale;
+uniform mat4 viewMatrix;
 
 // Textures
 uniform sampler2D objTextures[10];
@@ -270,6 +360,54 @@ uniform sampler2D LTC2;
 uniform sampler2D noise;
 uniform sampler2D bluenoise;
 
+// Depth Prepass
+// - true while drawing the prepass (writes the cone depth instead of color)
+uniform bool depthPrepass;
+// - radius of the cone of a tile per unit of depth
+uniform float coneRadius;
+// - start depths of the tiles, if the prepass ran
+uniform bool usePrepass;
+uniform sampler2D prepassDepth;
+
+// Temporal Reprojection
+// - hit depths of the last frame scattered into this view (0 where nothing
+//   landed, i.e. disoccluded)
+uniform bool useReprojection;
+uniform sampler2D reprojectedDepth;
+
+#if defined(SHADOW_PASS) || defined(AO_PASS) || defined(LIGHTING_PASS)
+// Deferred Shading
+// - G-buffer of the primary rays (see GBUFFER_PASS)
+uniform sampler2D gPositionBuffer;
+uniform sampler2D gNormalBuffer;
+// - pixels per side of a texel of the shadow and AO buffers (1, 2 or 4)
+uniform int lightingScale;
+#endif
+#ifdef SHADOW_PASS
+// - first of the (up to) 4 lights of the cluster of a texel in the layer
+//   being drawn
+uniform int firstSlot;
+#endif
+#ifdef LIGHTING_PASS
+uniform sampler2D gTrapBuffer;
+uniform sampler2D gCustomIdBuffer;
+// - visibility of light k of the cluster of the texel in channel k % 4 of
+//   layer k / 4
+uniform sampler2DArray shadowBuffer;
+uniform sampler2D aoBuffer;
+// - low resolution texels around the pixel and their bilateral weights
+//   (see setUpsampleWeights)
+ivec2 UPSAMPLE_TEXELS[4];
+vec4 UPSAMPLE_WEIGHTS = vec4(1.f, 0.f, 0.f, 0.f);
+// - the weights of the texels in the cluster of the pixel (0 if none is)
+vec4 SHADOW_WEIGHTS = vec4(1.f, 0.f, 0.f, 0.f);
+#endif
+
+// Over-relaxed sphere tracing
+// - factor of the steps of raymarch and softshadow (1 is plain sphere
+//   tracing), from the globalData of the scene
+uniform float relaxation;
+
 // Timer
 uniform float iTime;
 
@@ -286,6 +424,113 @@ uniform float terrainHeight = 0.f;
 uniform float terrainScale;
 
 // ================== Utility =======================
+// Texels per object in objectGeometry and objectMaterials
+const int OBJECT_GEOMETRY_TEXELS = 4;
+const int OBJECT_MATERIAL_TEXELS = 7;
+
+// Brings p to the space of object i
+// - texels 0-2 of the geometry are the rows of the (affine) inverse model
+//   matrix
+vec3 toObjectSpace(int i, vec3 p) {
+    int base = i * OBJECT_GEOMETRY_TEXELS;
+    vec4 pw = vec4(p, 1.f);
+    return vec3(dot(texelFetch(objectGeometry, base), pw),
+                dot(texelFetch(objectGeometry, base + 1), pw),
+                dot(texelFetch(objectGeometry, base + 2), pw));
+}
+
+// Gets the type (x) and the scale factor (y) of object i
+vec4 getObjectShape(int i) {
+    return texelFetch(objectGeometry, i * OBJECT_GEOMETRY_TEXELS + 3);
+}
+
+// Unpacks object i
+RayMarchObject getObject(int i) {
+    RayMarchObject obj;
+    int g = i * OBJECT_GEOMETRY_TEXELS;
+    obj.invModelMatrix = transpose(mat4(texelFetch(objectGeometry, g),
+                                        texelFetch(objectGeometry, g + 1),
+                                        texelFetch(objectGeometry, g + 2),
+                                        vec4(0.f, 0.f, 0.f, 1.f)));
+    vec4 shape = texelFetch(objectGeometry, g + 3);
+    obj.type = int(shape.x);
+    obj.scaleFactor = shape.y;
+
+    int m = i * OBJECT_MATERIAL_TEXELS;
+    vec4 t0 = texelFetch(objectMaterials, m);
+    vec4 t1 = texelFetch(objectMaterials, m + 1);
+    vec4 t2 = texelFetch(objectMaterials, m + 2);
+    vec4 t3 = texelFetch(objectMaterials, m + 3);
+    vec4 t4 = texelFetch(objectMaterials, m + 4);
+    vec4 t5 = texelFetch(objectMaterials, m + 5);
+    vec4 t6 = texelFetch(objectMaterials, m + 6);
+    obj.cAmbient = t0.rgb; obj.shininess = t0.a;
+    obj.cDiffuse = t1.rgb; obj.blend = t1.a;
+    obj.cSpecular = t2.rgb; obj.ior = t2.a;
+    obj.cReflective = t3.rgb; obj.repeatU = t3.a;
+    obj.cTransparent = t4.rgb; obj.repeatV = t4.a;
+    obj.color = t5.rgb; obj.isEmissive = t5.a != 0.f;
+    obj.texLoc = int(t6.x); obj.lightIdx = int(t6.y);
+    return obj;
+}
+
+// Texels per light in lightData, and the clusters (CLUSTER_TILES_X,
+// CLUSTER_TILES_Y and CLUSTER_SLICES in lightclusters.h)
+const int LIGHT_TEXELS = 9;
+const ivec3 CLUSTER_DIMS = ivec3(16, 9, 24);
+
+// Unpacks light i
+LightSource getLight(int i) {
+    LightSource li;
+    int l = i * LIGHT_TEXELS;
+    vec4 t0 = texelFetch(lightData, l);
+    vec4 t1 = texelFetch(lightData, l + 1);
+    vec4 t2 = texelFetch(lightData, l + 2);
+    vec4 t3 = texelFetch(lightData, l + 3);
+    li.lightColor = t0.rgb; li.type = int(t0.a);
+    li.lightDir = t1.xyz; li.lightAngle = t1.w;
+    li.lightPos = t2.xyz; li.lightPenumbra = t2.w;
+    li.lightFunc = t3.xyz; li.intensity = t3.w;
+    if (li.type == AREA) {
+        for (int k = 0; k < 4; k++) {
+            li.points[k] = texelFetch(lightData, l + 4 + k).xyz;
+        }
+        li.twoSided = texelFetch(lightData, l + 4).w != 0.f;
+    }
+    return li;
+}
+
+// True if p is in the bounding sphere of light i (or it is unbounded)
+bool inLightBounds(int i, vec3 p) {
+    vec4 bounds = texelFetch(lightData, i * LIGHT_TEXELS + 8);
+    return bounds.w < 0.f || distance(p, bounds.xyz) <= bounds.w;
+}
+
+// Gets the cluster of the view frustum that p is in
+// - same tiles and slices as LightClusters::build
+// @returns Cluster, -1 if p is behind the camera or off the screen
+int getCluster(vec3 p) {
+    if (!useLightClusters) return -1;
+    vec3 v = (viewMatrix * vec4(p, 1.f)).xyz;
+    float depth = -v.z;
+    if (depth <= 0.f) return -1;
+    vec2 ndc = clusterScale * v.xy / depth;
+    // - slack for the primary rays through the edge of the screen
+    if (any(greaterThan(abs(ndc), vec2(1.001f)))) return -1;
+    ivec2 tile = clamp(ivec2(floor((ndc * 0.5f + 0.5f) * vec2(CLUSTER_DIMS.xy))),
+                       ivec2(0), CLUSTER_DIMS.xy - 1);
+    int slice = depth <= clusterNear ? 0 :
+                min(int(log(depth / clusterNear) * clusterLogScale), CLUSTER_DIMS.z - 1);
+    return (slice * CLUSTER_DIMS.y + tile.y) * CLUSTER_DIMS.x + tile.x;
+}
+
+// Gets the number of lights of cluster c
+// @param offset Set to the position of its first light index in lightClusters
+int getClusterLights(int c, out int offset) {
+    offset = texelFetch(lightClusters, 2 * c).r;
+    return texelFetch(lightClusters, 2 * c + 1).r;
+}
+
 float tri(float x) {
     return abs(fract(x) - 0.5);
 }
@@ -447,16 +692,16 @@ float attenuationFactor(float d, vec3 func) {
 }
 
 // Gets the angular falloff term given light direction
-float angularFalloff(vec3 L, int i) {
-    float cosalpha = dot(-normalize(lights[i].lightDir), L);
-    float inner = lights[i].lightAngle - lights[i].lightPenumbra;
-    if (cosalpha <= cos(lights[i].lightAngle)){
+float angularFalloff(vec3 L, LightSource li) {
+    float cosalpha = dot(-normalize(li.lightDir), L);
+    float inner = li.lightAngle - li.lightPenumbra;
+    if (cosalpha <= cos(li.lightAngle)){
         return 0.f;
     } else if (cosalpha > cos(inner)) {
         return 1.f;
     } else {
         return 1.f -
-                angularFalloffFactor(acos(cosalpha), inner, lights[i].lightAngle);
+                angularFalloffFactor(acos(cosalpha), inner, li.lightAngle);
     }
 }
 
@@ -489,6 +734,13 @@ vec2 random2(vec2 seed) {
     return vec2(hash(seed), hash(seed + vec2(1.0)));
 }
 
+// Random numbers of this pixel for the current accumulated sample
+// @param salt Different per use within the same sample
+vec2 sampleRandom(int salt) {
+    return random2(gl_FragCoord.xy / screenDimensions
+                   + vec2(float(sampleIndex) * 0.7548777, float(salt) * 0.5698403));
+}
+
 // Used in fbm_9
 float noiseT( in vec2 x ) {
     vec2 p = floor(x);
@@ -768,11 +1020,25 @@ float sdMandelBrot(in vec2 p) {
     return sqrt(clamp((150.0/zoom)*d, 0.0, 1.0));
 }
 
+// Iterations of a fractal whose detail shrinks by a factor per iteration
+// - stops at the first iteration whose detail is smaller than the pixel
+//   footprint, plus one
+// @param maxIterations Iterations in full detail
+// @param scale Shrink factor of the detail per iteration
+// @param footprint Pixel footprint in object space (0 for full detail)
+// @returns Number of iterations to evaluate
+int fractalIterations(int maxIterations, float scale, float footprint) {
+    if (footprint <= 0.0) return maxIterations;
+    float n = ceil(log(1.0 / footprint) / log(scale)) + 1.0;
+    return int(clamp(n, float(MIN_FRACTAL_ITERATIONS), float(maxIterations)));
+}
+
 // Mandelbulb Set Signed Distance Field
 // Great ref: https://www.youtube.com/watch?v=6IWXkV82oyY&t=1502s
 // @param p Point in object space
 // @param power (typically 8)
-float sdMandelBulb(vec3 pos, out vec4 resColor) {
+// @param footprint Pixel footprint in object space
+float sdMandelBulb(vec3 pos, out vec4 resColor, float footprint) {
     vec3 w = pos;
     float m = dot(w,w);
     vec4 trap = vec4(abs(w),m);
@@ -782,7 +1048,9 @@ float sdMandelBulb(vec3 pos, out vec4 resColor) {
     if (length(juliaSeed) != 0) {
         c = vec3(juliaSeed, 0);
     }
-    for (int i=0; i < MAX_STEPS_FRACTALS; i++) {
+    // - the detail shrinks by about the power per iteration
+    int iterations = fractalIterations(MAX_STEPS_FRACTALS, max(power, 2.f), footprint);
+    for (int i=0; i < iterations; i++) {
         // derivative
         dz = power * pow(m, (power-1.f)/2.f) * dz + 1.0;
         // z = z^8+c
@@ -804,10 +1072,10 @@ float sdMandelBulb(vec3 pos, out vec4 resColor) {
 
 // Sierpinski Signed Distance Field
 // @param p Point in object space
-// @param power (typically 8)
-float sdSierpinski(vec3 p) {
-    const int Iterations = 14;
+// @param footprint Pixel footprint in object space
+float sdSierpinski(vec3 p, float footprint) {
     const float Scale = 1.85;
+    int Iterations = fractalIterations(14, Scale, footprint);
     const float Offset = 2.0;
     vec3 a1 = vec3(1,1,1);
     vec3 a2 = vec3(-1,-1,1);
@@ -1259,7 +1527,8 @@ float sdCUSTOM(vec3 p, out int customId, out vec4 trap) {
 // Invoke the appropriate SDF function and return the distance
 // @param p Point in object space
 // @param type Type of the object
-float sdMatch(vec3 p, int type, int id, out int customId, out vec4 trapCol)
+float sdMatch(vec3 p, int type, int id, float footprint, out int customId,
+              out vec4 trapCol)
 {
     if (type == CUBE) {
         return sdBox(p, vec3(0.5));
@@ -1282,11 +1551,11 @@ float sdMatch(vec3 p, int type, int id, out int customId, out vec4 trapCol)
     } else if (type == MANDELBROT) {
         return sdMandelBrot(vec2(p));
     } else if (type == MANDELBULB) {
-        return sdMandelBulb(p, trapCol);
+        return sdMandelBulb(p, trapCol, footprint);
     } else if (type == MENGERSPONGE) {
         return sdMengerSponge(p, trapCol);
     } else if (type == SIERPINSKI) {
-        return sdSierpinski(p);
+        return sdSierpinski(p, footprint);
     } else if (type == CUSTOM) {
         return sdCUSTOM(p, customId, trapCol);
     }
@@ -1398,36 +1667,147 @@ vec2 uvMapSphere(vec3 p, float repeatU, float repeatV) {
 }
 
 // ================ Raymarch Algorithm ==================
+// Max depth of the BVH + 1 (BVH_MAX_DEPTH in bvh.h)
+const int BVH_STACK_SIZE = 25;
+// Pixels per side of a prepass tile (DEPTH_PREPASS_TILE in raymarchrenderer.h)
+const int PREPASS_TILE = 8;
+const int PREPASS_STEPS = 64;
+// - kept in front of the prepass depth
+const float PREPASS_MARGIN = 0.01;
+// - fraction of the reprojected depth kept in front of it
+const float REPROJECT_MARGIN = 0.02;
+
+// Distance from p to an axis aligned box (0 inside)
+float boxDistance(vec3 p, vec3 bmin, vec3 bmax) {
+    return length(max(max(bmin - p, p - bmax), 0.f));
+}
+
+// True if a box at distance d can not hold anything closer than minD
+// - boxes around p are always visited so that overlapping objects still
+//   give the deepest distance inside
+bool isCulled(float d, float minD) {
+    return d > 0.f && d >= minD;
+}
+
+// Evaluates the SDF of object i and keeps it if it is the closest so far
+void sdObject(int i, vec3 p, inout SceneMin res) {
+    int customId; vec4 trapCol;
+    SDF_EVALS++;
+    // Conv to Object space
+    vec3 po = toObjectSpace(i, p);
+    // Get the distance to the object
+    vec4 shape = getObjectShape(i);
+    // - the footprint in object space for the fractals
+    float currD = sdMatch(po, int(shape.x), i, PIXEL_FOOTPRINT / shape.y,
+                          customId, trapCol) * shape.y;
+    if (currD < res.minD) {
+        // Update if we found a closer object
+        res.minD = currD; res.minObjIdx = i;
+        res.customId = customId; res.trap = trapCol;
+    }
+}
+
+// Samples per side of a brick (SDF_CACHE_BRICK in sdfcache.h)
+const int SDF_CACHE_BRICK = 8;
+
+// Lower bound of the distance to the objects in the SDF cache
+// - outside the grid, the distance to the grid (the objects are inside it)
+// - in a cell without a brick, the bound of the cell. In a brick, the
+//   interpolated samples minus the interpolation error
+float sdCache(vec3 p) {
+    vec3 q = (p - sdfCacheMin) / sdfCacheCellSize;
+    if (any(lessThan(q, vec3(0.f))) ||
+        any(greaterThanEqual(q, sdfCacheDims))) {
+        return boxDistance(p, sdfCacheMin,
+                           sdfCacheMin + sdfCacheDims * sdfCacheCellSize);
+    }
+    vec4 cell = texelFetch(sdfCacheGrid, ivec3(q), 0);
+    if (cell.x < 0.f) return cell.w;
+    vec3 uvw = cell.xyz + 0.5f + fract(q) * float(SDF_CACHE_BRICK - 1);
+    return texture(sdfCacheAtlas, uvw / vec3(textureSize(sdfCacheAtlas, 0))).r
+           - sdfCacheError;
+}
+
+// Checks if the objects in the SDF cache can be skipped at p
+// - they are if they are farther away than the closest object so far, or far
+//   enough from p that their bound can be the step. The bound is then kept
+//   if it is the closest
+bool skipCachedObjects(vec3 p, inout SceneMin res) {
+    if (!useSDFCache || !USE_SDF_CACHE) return false;
+    float d = sdCache(p);
+    if (d >= res.minD) return true;
+    // - never a hit, those need the objects
+    if (d <= sdfCacheRefine + max(SURFACE_DIST, PIXEL_FOOTPRINT)) return false;
+    res.minD = d; res.minObjIdx = -1;
+    return true;
+}
+
+#ifdef SPECIALIZED_SCENE
+// Union of all the SDFs in the scene, unrolled for the loaded scene
+// (generated by SceneShader::generateSDScene)
+// @SPECIALIZED_SDSCENE@
+#else
 // Union of all the SDFs in the scene
+// - objects without bounds (fractals, custom) and those too large for the
+//   SDF cache are always evaluated. The BVH is walked near child first and a
+//   node is skipped once its box is farther away than the closest object
+//   found so far
+// - while USE_SDF_CACHE is set, the objects in the SDF cache are skipped
+//   away from their surfaces, only the others are evaluated there
 // @param p Current raymarching point for which we wish to
 // find the distance
 // @returns SceneMin struct with closest distance and closest
 // object
 SceneMin sdScene(vec3 p) {
-    float minD = 1000000.f;
-    int minObj = -1; int minCId;
-    int customId;
-    float currD;
-    vec3 po;
-    vec4 trapCol;
-    for (int i = 0; i < numObjects; i++) {
-        // Get current obj
-        RayMarchObject obj = objects[i];
-        // Conv to Object space
-        po = vec3(obj.invModelMatrix * vec4(p, 1.f));
-        // Get the distance to the object
-        currD = sdMatch(po, obj.type, i, customId, trapCol) * obj.scaleFactor;
-        if (currD < minD) {
-            // Update if we found a closer object
-            minD = currD; minObj = i; minCId = customId;
+    SceneMin res;
+    res.minD = 1000000.f; res.minObjIdx = -1;
+    int k = 0;
+    if (useSDFCache && USE_SDF_CACHE) {
+        for (; k < numUncachedObjects; k++) {
+            int i = texelFetch(bvhObjects, unboundedStart + k).x;
+            if (i < numObjects) sdObject(i, p, res);
         }
+        if (skipCachedObjects(p, res)) return res;
+    }
+    for (; k < numUnboundedObjects; k++) {
+        int i = texelFetch(bvhObjects, unboundedStart + k).x;
+        if (i < numObjects) sdObject(i, p, res);
+    }
+    if (numBVHNodes == 0) return res;
+
+    int stack[BVH_STACK_SIZE];
+    int sp = 0;
+    stack[sp++] = 0;
+    while (sp > 0) {
+        int node = stack[--sp];
+        vec4 a = texelFetch(bvhNodes, 2 * node);
+        vec4 b = texelFetch(bvhNodes, 2 * node + 1);
+        // The closest object may have changed since the node was pushed
+        if (isCulled(boxDistance(p, a.xyz, b.xyz), res.minD)) continue;
+        int count = int(b.w);
+        if (count > 0) {
+            // Leaf
+            int first = int(a.w);
+            for (int k = first; k < first + count; k++) {
+                int i = texelFetch(bvhObjects, k).x;
+                if (i < numObjects) sdObject(i, p, res);
+            }
+            continue;
+        }
+        // Interior: push the far child first so that the near one is next
+        int left = int(a.w);
+        float dl = boxDistance(p, texelFetch(bvhNodes, 2 * left).xyz,
+                               texelFetch(bvhNodes, 2 * left + 1).xyz);
+        float dr = boxDistance(p, texelFetch(bvhNodes, 2 * left + 2).xyz,
+                               texelFetch(bvhNodes, 2 * left + 3).xyz);
+        int nearChild = dl <= dr ? left : left + 1;
+        int farChild = dl <= dr ? left + 1 : left;
+        if (!isCulled(max(dl, dr), res.minD)) stack[sp++] = farChild;
+        if (!isCulled(min(dl, dr), res.minD)) stack[sp++] = nearChild;
     }
-    // Populate the struct
-    SceneMin res;
-    res.minD = minD; res.minObjIdx = minObj;
-    res.customId = minCId; res.trap = trapCol;
     return res;
 }
+#endif
 
 // Given intersection point, get the normal
 // - https://iquilezles.org/articles/normalsSDF
@@ -1444,32 +1824,60 @@ vec3 getNormal(in vec3 p) {
 }
 
 // Performs raymarching
+// - over-relaxed sphere tracing (Keinert et al. 2014): the steps are scaled
+//   by the relaxation factor. If the unbounding spheres of two consecutive
+//   points do not overlap, the step may have jumped over a surface, so the
+//   ray goes back to the last point and continues with plain steps
+// - a point is a hit once it is closer to a surface than the radius of the
+//   pixel cone there (or SURFACE_DIST near the origin). Detail below that
+//   size is not visible, so far away rays stop early and the fractals are
+//   evaluated with fewer iterations (see PIXEL_FOOTPRINT)
 // @param ro Ray origin
 // @param rd Ray direction
 // @param end Far plane
 // @param side Determines if we are inside or outside the object
 // - used in refraction
+// @param start Depth known to be free of surfaces (0 if unknown)
 // @returns structs that contains the result of raymarching
-RayMarchRes raymarch(vec3 ro, vec3 rd, float end, float side) {
-  // Start from eye pos
-  float rayDepth = 0.0;
+RayMarchRes raymarch(vec3 ro, vec3 rd, float end, float side, float start) {
+  // Start from eye pos (or where the prepass left off)
+  float rayDepth = start;
   SceneMin closest;
   closest.minD = 1000000;
+  // Relaxation and the last point
+  float omega = relaxation;
+  float prevDepth = start, prevD = 0.f, stepLength = 0.f;
+  float hitDist = SURFACE_DIST;
+  USE_SDF_CACHE = true;
   // Start the march
   for(int i = 0; i < MAX_STEPS; i++) {
+    MARCH_STEPS++;
     // Get the point
     vec3 p = ro + rd * rayDepth;
+    PIXEL_FOOTPRINT = pixelRadius * rayDepth;
+    hitDist = max(SURFACE_DIST, PIXEL_FOOTPRINT);
     // Find the closest object in the scene
     closest = sdScene(p);
-    if (abs(closest.minD) < SURFACE_DIST || rayDepth > end) {
+    if (omega > 1.f && abs(closest.minD) + abs(prevD) < abs(stepLength)) {
+        // Overshot, step back with a plain step
+        omega = 1.f;
+        stepLength = prevD * side;
+        rayDepth = prevDepth + stepLength;
+        continue;
+    }
+    if (abs(closest.minD) < hitDist || rayDepth > end) {
         // If hit or exceed the far plane, break
         break;
     }
     // March the ray
-    rayDepth += closest.minD * side;
+    prevDepth = rayDepth; prevD = closest.minD;
+    stepLength = closest.minD * side * omega;
+    rayDepth += stepLength;
   }
+  PIXEL_FOOTPRINT = 0.f;
+  USE_SDF_CACHE = false;
   RayMarchRes res;
-  if (abs(closest.minD) < SURFACE_DIST) {
+  if (abs(closest.minD) < hitDist) {
       // HIT
       res.intersectObj = closest.minObjIdx;
       // Bruh don't ask me why we need this.
@@ -1483,6 +1891,30 @@ RayMarchRes raymarch(vec3 ro, vec3 rd, float end, float side) {
   return res;
 }
 
+// Marches a cone from the eye around the center ray of a prepass tile
+// - the cone holds the rays of every pixel of the tile. The ball of radius d
+//   around a point on the axis holds the cone up to (t + d) / (1 + k), so the
+//   returned depth is free of surfaces for all of those rays
+// @param eye Apex of the cone
+// @param rd Direction of the axis
+// @param k Radius of the cone per unit of depth
+// @param end Far plane
+// @returns Depth from the eye that every ray of the tile can start from
+float coneMarch(vec3 eye, vec3 rd, float k, float end) {
+    float t = 0.0;
+    USE_SDF_CACHE = true;
+    for (int i = 0; i < PREPASS_STEPS; i++) {
+        float d = sdScene(eye + rd * t).minD;
+        float dt = (d - k * t) / (1.0 + k);
+        // - the cone touches a surface
+        if (dt < SURFACE_DIST) break;
+        t += dt;
+        if (t > end) break;
+    }
+    USE_SDF_CACHE = false;
+    return t;
+}
+
 // ====== MIST ======
 float fogDensity(vec3 p) {
     const vec3 fdir = normalize(vec3(10,0,-7));
@@ -1705,13 +2137,36 @@ RayMarchRes softshadow(vec3 ro, vec3 rd, float mint, float maxt, float k ) {
     float rayDepth = mint;
     RayMarchRes r;
     SceneMin closest;
+    // Over-relaxed like raymarch
+    float omega = relaxation;
+    float prevDepth = mint, prevD = 0.0, stepLength = 0.0;
+    USE_SDF_CACHE = true;
     for(int i=0; i < MAX_STEPS; i++) {
+        SHADOW_STEPS++;
         closest = sdScene(ro + rd*rayDepth);
+        if (omega > 1.0 && abs(closest.minD) + prevD < stepLength) {
+            // Overshot, step back with a plain step
+            omega = 1.0;
+            stepLength = prevD;
+            rayDepth = prevDepth + stepLength;
+            continue;
+        }
         if(abs(closest.minD) < SURFACE_DIST || rayDepth > maxt) break;
-        res = min(res, k * closest.minD/(rayDepth));
+        float penumbra = k * closest.minD/(rayDepth);
+        if (penumbra < res && closest.minObjIdx == -1) {
+            // - the bound of the SDF cache is below the distance, which may
+            //   not darken the penumbra
+            USE_SDF_CACHE = false;
+            penumbra = k * sdScene(ro + rd*rayDepth).minD/(rayDepth);
+            USE_SDF_CACHE = true;
+        }
+        res = min(res, penumbra);
         // March the ray
-        rayDepth += abs(closest.minD);
+        prevDepth = rayDepth; prevD = abs(closest.minD);
+        stepLength = prevD * omega;
+        rayDepth += stepLength;
     }
+    USE_SDF_CACHE = false;
     if (abs(closest.minD) < SURFACE_DIST) {
         // HIT
         r.intersectObj = closest.minObjIdx;
@@ -1720,10 +2175,24 @@ RayMarchRes softshadow(vec3 ro, vec3 rd, float mint, float maxt, float k ) {
     } else {
         // NO HIT
         r.intersectObj = -1;
+        r.d = res;
     }
     return r;
 }
 
+// Jitters a direction inside a cone around it
+// @param d Direction (normalized)
+// @param angle Half angle of the cone
+// @param u Uniform random numbers in [0, 1)
+// @returns Jittered direction
+vec3 jitterDirection(vec3 d, float angle, vec2 u) {
+    vec3 t = normalize(cross(d, abs(d.y) < 0.99 ? vec3(0, 1, 0) : vec3(1, 0, 0)));
+    vec3 b = cross(d, t);
+    float r = tan(angle) * sqrt(u.x);
+    float phi = TAU * u.y;
+    return normalize(d + r * (cos(phi) * t + sin(phi) * b));
+}
+
 // Calculate the ambient occlusion
 // https://iquilezles.org/articles/nvscene2008/rwwtt.pdf
 float calcAO(in vec3 pos, in vec3 nor) {
@@ -1809,7 +2278,7 @@ vec3 getAreaLight(vec3 N, vec3 V, vec3 P, int lightIdx, vec3 cD,
         vec3(t1.z, 0, t1.w)
     );
 
-    LightSource areaLight = lights[lightIdx];
+    LightSource areaLight = getLight(lightIdx);
     // Evaluate LTC shading
     vec3 diffuse = LTC_Evaluate(N, V, P, mat3(1), areaLight.points, areaLight.twoSided);
     vec3 specular = LTC_Evaluate(N, V, P, Minv, areaLight.points, areaLight.twoSided);
@@ -1833,6 +2302,98 @@ void setCustomMat(int customId, out vec3 a, out vec3 d, out vec3 s,
     //    }
 }
 
+// Gets the direction and the distance from p to a light
+// @param li Light (not an area light)
+// @param p Surface point
+// @param far Distance used for directional lights
+// @param L Set to the direction towards the light
+// @param maxT Set to the distance to the light
+void getLightRay(LightSource li, vec3 p, float far, out vec3 L, out float maxT) {
+    if (li.type == DIRECTIONAL) {
+        L = normalize(-li.lightDir);
+        //L = getSunDir();
+        maxT = far;
+    } else {
+        L = normalize(li.lightPos - p);
+        maxT = length(li.lightPos - p);
+    }
+}
+
+// Marches the shadow rays from p to a light
+// - area lights: fraction of the AREA_LIGHT_SAMPLES rays towards random
+//   points on the light that reach it
+// - other lights: 0 if the ray hits an object, else the penumbra of
+//   softshadow (1 without soft shadows)
+// @param N Normal at p
+// @param rd Direction of the ray that hit p
+// @param far Distance used for directional lights
+// @param i Index of the light
+// @returns Visibility in [0, 1] (0 if the surface faces away)
+float calcVisibility(vec3 p, vec3 N, vec3 rd, float far, int i) {
+    LightSource li = getLight(i);
+    vec3 shadowRO = p + N * SURFACE_DIST * 5.f;
+    if (li.type == AREA) {
+        float visible = 0.f;
+        for (int idx = 0; idx < AREA_LIGHT_SAMPLES; idx++) {
+            // Sample a point and cast a shadow ray towards it
+            // - a new point per accumulated sample
+            vec2 uv = sampleIndex > 0 ? sampleRandom(idx) : vec2(rd + idx);
+            vec3 randomP = samplePointOnRectangleAreaLight(li.points[0], li.points[1],
+                                                           li.points[2], li.points[3], uv);
+            vec3 L = normalize(randomP - p);
+            if (dot(N, L) <= 0.005f) continue;
+            RayMarchRes res = softshadow(shadowRO, L, 0, length(randomP - p), 8);
+            // - the ray may hit the geometry of the light itself
+            if (res.intersectObj != -1 && getObject(res.intersectObj).lightIdx != i) continue;
+            visible += 1.f;
+        }
+        return visible / AREA_LIGHT_SAMPLES;
+    }
+    vec3 L; float maxT;
+    getLightRay(li, p, far, L, maxT);
+    if (dot(N, L) <= 0.005f) return 0.f; // pointing away
+    // - jittered per accumulated sample so the penumbra converges
+    if (enableSoftShadow && sampleIndex > 0) {
+        L = jitterDirection(L, SHADOW_CONE_ANGLE, sampleRandom(AREA_LIGHT_SAMPLES + i));
+    }
+    RayMarchRes res = softshadow(shadowRO, L, 0, maxT, 8);
+    if (res.intersectObj != -1) return 0.f; // shadow ray intersect
+    return enableSoftShadow ? res.d : 1.f;
+}
+
+// Gets the visibility of a light from p (see calcVisibility)
+// - read from the shadow pass for the primary hit of the lighting pass, if
+//   a texel around it is in the same cluster
+// @param slot Position of the light in the cluster of p (-1 if none)
+float getVisibility(vec3 p, vec3 N, vec3 rd, float far, int i, int slot) {
+#ifdef LIGHTING_PASS
+    if (SHADE_FROM_GBUFFER && slot >= 0 && SHADOW_WEIGHTS != vec4(0.f)) {
+        float v = 0.f;
+        for (int k = 0; k < 4; k++) {
+            ivec3 texel = ivec3(UPSAMPLE_TEXELS[k], slot / 4);
+            v += SHADOW_WEIGHTS[k] * texelFetch(shadowBuffer, texel, 0)[slot % 4];
+        }
+        return v;
+    }
+#endif
+    return calcVisibility(p, N, rd, far, i);
+}
+
+// Gets the ambient occlusion at p (see calcAO)
+// - read from the AO pass for the primary hit of the lighting pass
+float getAO(vec3 p, vec3 N) {
+#ifdef LIGHTING_PASS
+    if (SHADE_FROM_GBUFFER) {
+        float ao = 0.f;
+        for (int k = 0; k < 4; k++) {
+            ao += UPSAMPLE_WEIGHTS[k] * texelFetch(aoBuffer, UPSAMPLE_TEXELS[k], 0).r;
+        }
+        return ao;
+    }
+#endif
+    return calcAO(p, N);
+}
+
 // Gets Phong Light
 // @param N normal
 // @param intersectObj Id of the intersected object
@@ -1840,7 +2401,7 @@ void setCustomMat(int customId, out vec3 a, out vec3 d, out vec3 s,
 // @param rd Ray direction
 // @returns phong color for that fragment
 vec3 getPhong(vec3 N, int intersectObj, vec3 p, vec3 ro, vec3 rd, float far, bool custom) {
-    vec3 total = vec3(0.f); RayMarchObject obj = objects[intersectObj];
+    vec3 total = vec3(0.f); RayMarchObject obj = getObject(intersectObj);
     // Get material
     vec3 cAmbient = obj.cAmbient,
          cDiffuse = obj.cDiffuse,
@@ -1856,78 +2417,61 @@ vec3 getPhong(vec3 N, int intersectObj, vec3 p, vec3 ro, vec3 rd, float far, boo
     if (custom && intersectObj == 0) {
         cAmbient = getDiffuse(p, N, type, cDiffuse, texLoc, invModel, rU, rV, blend);
     }
-    if (enableAmbientOcculusion) ao = calcAO(p, N);
+    if (enableAmbientOcculusion) ao = getAO(p, N);
     total += cAmbient * ka * ao;
 
     // Loop Lights
-    for (int i = 0; i < numLights; i++) {
-        float fAtt = 1.f; float aFall = 1.f; LightSource li = lights[i];
-        float d = length(p - li.lightPos);
-        vec3 currColor = vec3(0.f); vec3 L; float maxT;
-        if (li.type == POINT) {
-            L = normalize(li.lightPos - p);
-            fAtt = attenuationFactor(d, li.lightFunc);
-            maxT = length(li.lightPos - p);
-        } else if (li.type == DIRECTIONAL) {
-            L = normalize(-li.lightDir);
-            //L = getSunDir();
-            maxT = far;
-        } else if (li.type == SPOT) {
-            L = normalize(li.lightPos - p);
-            fAtt = attenuationFactor(d, li.lightFunc);
-            maxT = length(li.lightPos - p);
-            aFall = angularFalloff(L, i);
+    // - the lights of the cluster of p. Off the screen every light is
+    //   tested against its bounds
+    vec3 V = normalize(-rd);
+    int cluster = getCluster(p), offset = 0;
+    int count = cluster == -1 ? numLights : getClusterLights(cluster, offset);
+    for (int k = 0; k < count; k++) {
+        int i = k;
+        if (cluster != -1) {
+            i = texelFetch(lightClusters, offset + k).r;
+        } else if (!inLightBounds(i, p)) {
+            continue;
         }
+        LightSource li = getLight(i);
+        // Shadow
+        float visibility = getVisibility(p, N, rd, far, i, cluster == -1 ? -1 : k);
+        if (visibility == 0.f) continue;
 
-        vec3 V = normalize(-rd);
         // Area Light Calculation
+        // - the LTC integral covers the whole light, the shadow rays only
+        //   scale it
         if (li.type == AREA) {
-            vec3 areaColor = vec3(0.f);
-            vec3 p1 = li.points[0], p2 = li.points[1], p3 = li.points[2], p4 = li.points[3];
-            for (int idx = 0; idx < AREA_LIGHT_SAMPLES; idx++) {
-                // Sample a point and cast a shadow ray towards it
-                vec3 randomP = samplePointOnRectangleAreaLight(p1,p2,p3,p4,vec2(rd + idx));
-                L = normalize(randomP - p);
-                float NdotL = dot(N, L);
-                if (NdotL <= 0.005f) continue;
-                maxT = length(randomP - p);
-                // Check for shadow
-                RayMarchRes res = softshadow(p + N * SURFACE_DIST * 5.f, L, 0, maxT, 8);
-                if (res.intersectObj != -1) {
-                    // Shadow Ray intersected an object
-                    // We need to check if the intersected object
-                    // is indeed area light or not
-                    if (objects[res.intersectObj].lightIdx != i) continue;
-                }
-                // calculate light contribution
-                areaColor += getAreaLight(N, V, p, i, cDiffuse, cSpecular, type, texLoc, invModel, rU, rV, blend);
-            }
-            currColor += areaColor / AREA_LIGHT_SAMPLES;
-        } else {
-            // Shadow
-            RayMarchRes res = softshadow(p + N * SURFACE_DIST * 5.f, L, 0, maxT, 8);
-            if (res.intersectObj != -1) continue; // shadow ray intersect
-            // Diffuse
-            float NdotL = dot(N, L);
-            if (NdotL <= 0.005f) continue; // pointing away
-            NdotL = clamp(NdotL, 0.f, 1.f);
-            currColor +=  getDiffuse(p, N, type, cDiffuse, texLoc, invModel, rU, rV, blend)
-                    * NdotL
-                    * li.lightColor;
-                   // * getSunColor();
-                    // * getMoonColor(rd);
-            // Specular
-            vec3 R = reflect(-L, N);
-            float RdotV = clamp(dot(R, V), 0.f, 1.f);
-            currColor += getSpecular(RdotV, cSpecular, shininess)
-                    * li.lightColor;
-                    //* getSunColor();
-                    // * getMoonColor(rd);
-            // Add the light source's contribution
-            currColor *= fAtt * aFall;
-            if (enableSoftShadow) currColor *= res.d;
+            total += visibility * getAreaLight(N, V, p, i, cDiffuse, cSpecular, type, texLoc,
+                                               invModel, rU, rV, blend);
+            continue;
+        }
+
+        float fAtt = 1.f; float aFall = 1.f;
+        vec3 currColor = vec3(0.f); vec3 L; float maxT;
+        getLightRay(li, p, far, L, maxT);
+        if (li.type == POINT) {
+            fAtt = attenuationFactor(maxT, li.lightFunc);
+        } else if (li.type == SPOT) {
+            fAtt = attenuationFactor(maxT, li.lightFunc);
+            aFall = angularFalloff(L, li);
         }
-        total += currColor;
+        // Diffuse
+        float NdotL = clamp(dot(N, L), 0.f, 1.f);
+        currColor +=  getDiffuse(p, N, type, cDiffuse, texLoc, invModel, rU, rV, blend)
+                * NdotL
+                * li.lightColor;
+               // * getSunColor();
+                // * getMoonColor(rd);
+        // Specular
+        vec3 R = reflect(-L, N);
+        float RdotV = clamp(dot(R, V), 0.f, 1.f);
+        currColor += getSpecular(RdotV, cSpecular, shininess)
+                * li.lightColor;
+                //* getSunColor();
+                // * getMoonColor(rd);
+        // Add the light source's contribution (and its penumbra)
+        total += currColor * fAtt * aFall * visibility;
     }
     return total;
 }
@@ -2310,32 +2854,42 @@ RenderInfo seaRender(in vec3 ro, in vec3 rd, inout bool hit, in float maxT, in v
 }
 
 // =============================================================
-// Given ray origin and ray direction, performs a raymarching
-// @param ro Ray origin
+// Gets the color of a ray that did not hit anything
 // @param rd Ray direction
-// @param i IntersectionInfo we are populating
-// @param side Determines if we are inside or outside of an object (for refraction)
-RenderInfo render(in vec3 ro, in vec3 rd, out IntersectionInfo i,
-                  in float side, in float maxT, in vec3 bgCol) {
-    RenderInfo ri; i.intersectObj = -1;
-    // Raymarching
-    RayMarchRes res = raymarch(ro, rd, maxT, side);
-    if (res.intersectObj == -1) {
-        // NO HIT
-        ri.fragColor = vec4(bgCol, 1.f);
-        // If no hit but sky box is used, sample
-        if (enableSkyBox) ri.fragColor = vec4(texture(skybox, rd).rgb, 1.f);
-        ri.isAL = false; ri.isEnv = true; ri.d = maxT; return ri;
-    }
-
-    // HIT
-    ri.isEnv = false; ri.d = res.d;
-    vec3 p = ro + rd * res.d; vec3 pn = getNormal(p); vec3 col;
+// @param maxT Far plane
+// @param bgCol Background color
+RenderInfo renderMiss(in vec3 rd, in float maxT, in vec3 bgCol) {
+    RenderInfo ri;
+    ri.fragColor = vec4(bgCol, 1.f);
+    // If no hit but sky box is used, sample
+    if (enableSkyBox) ri.fragColor = vec4(texture(skybox, rd).rgb, 1.f);
+    ri.isAL = false; ri.isEnv = true; ri.d = maxT; return ri;
+}
+
+// Gets the shading normal of a hit
+// @param p Hit point
+vec3 getSurfaceNormal(in vec3 p) {
+    vec3 pn = getNormal(p);
 #ifdef PERLIN_BUMP
     pn = bumpNormal(pn, p, BUMP_SCALE, BUMP_INTENSITY);
 #endif
+    return pn;
+}
 
-    RayMarchObject obj = objects[res.intersectObj];
+// Shades the hit of a ray
+// @param ro Ray origin
+// @param rd Ray direction
+// @param res Result of the march
+// @param p Hit point
+// @param pn Shading normal at p
+// @param i IntersectionInfo we are populating
+// @param maxT Far plane
+RenderInfo shadeHit(in vec3 ro, in vec3 rd, in RayMarchRes res, in vec3 p,
+                    in vec3 pn, out IntersectionInfo i, in float maxT) {
+    RenderInfo ri; i.intersectObj = -1;
+    ri.isEnv = false; ri.d = res.d; vec3 col;
+
+    RayMarchObject obj = getObject(res.intersectObj);
     if (obj.isEmissive) {
         // Area Light
         col = obj.color; ri.fragColor = vec4(col, 1.f); ri.isAL = true; return ri;
@@ -2374,6 +2928,116 @@ RenderInfo render(in vec3 ro, in vec3 rd, out IntersectionInfo i,
     return ri;
 }
 
+// Given ray origin and ray direction, performs a raymarching
+// @param ro Ray origin
+// @param rd Ray direction
+// @param i IntersectionInfo we are populating
+// @param side Determines if we are inside or outside of an object (for refraction)
+// @param start Depth the march starts from (see raymarch)
+RenderInfo render(in vec3 ro, in vec3 rd, out IntersectionInfo i,
+                  in float side, in float maxT, in vec3 bgCol, in float start) {
+    i.intersectObj = -1;
+    // Raymarching
+    RayMarchRes res = raymarch(ro, rd, maxT, side, start);
+    if (res.intersectObj == -1) {
+        // NO HIT
+        return renderMiss(rd, maxT, bgCol);
+    }
+    // HIT
+    vec3 p = ro + rd * res.d;
+    return shadeHit(ro, rd, res, p, getSurfaceNormal(p), i, maxT);
+}
+
+#if defined(SHADOW_PASS) || defined(AO_PASS) || defined(LIGHTING_PASS)
+// Gets the G-buffer pixel that a texel of the shadow and AO buffers is
+// computed for (the center of its lightingScale x lightingScale block)
+ivec2 getLightingPixel(ivec2 texel) {
+    return min(texel * lightingScale + lightingScale / 2,
+               textureSize(gPositionBuffer, 0) - 1);
+}
+#endif
+
+#ifdef LIGHTING_PASS
+// Picks the texels of the shadow and AO buffers for the pixel
+// - full resolution: the texel of the pixel
+// - lower resolution: the 2x2 texels around it, weighted bilinearly and by
+//   how close the depth and the normal of their G-buffer pixel are to those
+//   of the pixel, so shadows and AO do not bleed across silhouettes
+// - the shadows of a texel are those of the lights of its cluster, so only
+//   the texels in the cluster of the pixel are used for them
+// @param depth Depth from the eye of the pixel
+// @param N Normal of the pixel
+// @param cluster Cluster of the pixel (see getCluster)
+void setUpsampleWeights(float depth, vec3 N, int cluster) {
+    ivec2 pixel = ivec2(gl_FragCoord.xy);
+    if (lightingScale == 1) {
+        UPSAMPLE_TEXELS[0] = pixel;
+        UPSAMPLE_WEIGHTS = vec4(1.f, 0.f, 0.f, 0.f);
+        SHADOW_WEIGHTS = cluster == -1 ? vec4(0.f) : UPSAMPLE_WEIGHTS;
+        return;
+    }
+    ivec2 maxTexel = textureSize(aoBuffer, 0) - 1;
+    vec2 pos = gl_FragCoord.xy / float(lightingScale) - 0.5f;
+    ivec2 base = ivec2(floor(pos));
+    vec2 f = pos - vec2(base);
+    float wsum = 0.f, bestDiff = 1e10; int best = 0;
+    vec4 sameCluster = vec4(0.f);
+    for (int k = 0; k < 4; k++) {
+        ivec2 off = ivec2(k % 2, k / 2);
+        ivec2 texel = clamp(base + off, ivec2(0), maxTexel);
+        ivec2 src = getLightingPixel(texel);
+        vec4 position = texelFetch(gPositionBuffer, src, 0);
+        float d = position.w;
+        vec3 n = texelFetch(gNormalBuffer, src, 0).xyz;
+        if (cluster != -1 && d != 0.f && getCluster(position.xyz) == cluster) {
+            sameCluster[k] = 1.f;
+        }
+        vec2 b = mix(1.f - f, f, vec2(off));
+        float diff = d == 0.f ? 1e9 : abs(d - depth) / depth;
+        float w = b.x * b.y * exp(-diff * 50.f) *
+                  pow(max(dot(N, normalize(n)), 0.f), 8.f);
+        UPSAMPLE_TEXELS[k] = texel;
+        UPSAMPLE_WEIGHTS[k] = w;
+        wsum += w;
+        if (diff < bestDiff) { bestDiff = diff; best = k; }
+    }
+    if (wsum > 1e-4) {
+        UPSAMPLE_WEIGHTS /= wsum;
+    } else {
+        // - no texel is on the surface of the pixel, take the closest one
+        UPSAMPLE_WEIGHTS = vec4(0.f);
+        UPSAMPLE_WEIGHTS[best] = 1.f;
+    }
+    SHADOW_WEIGHTS = UPSAMPLE_WEIGHTS * sameCluster;
+    float ssum = dot(SHADOW_WEIGHTS, vec4(1.f));
+    SHADOW_WEIGHTS = ssum > 1e-4 ? SHADOW_WEIGHTS / ssum : vec4(0.f);
+}
+
+// Shades the primary hit stored in the G-buffer
+// - same result as render, without the march
+RenderInfo renderGBuffer(in vec3 ro, in vec3 rd, out IntersectionInfo i,
+                         in float maxT, in vec3 bgCol) {
+    i.intersectObj = -1;
+    ivec2 pixel = ivec2(gl_FragCoord.xy);
+    vec4 position = texelFetch(gPositionBuffer, pixel, 0);
+    if (position.w == 0.f) {
+        // NO HIT
+        return renderMiss(rd, maxT, bgCol);
+    }
+    vec4 normal = texelFetch(gNormalBuffer, pixel, 0);
+    RayMarchRes res;
+    res.intersectObj = int(normal.w); res.d = length(position.xyz - ro);
+    res.trap = texelFetch(gTrapBuffer, pixel, 0);
+    res.customId = int(texelFetch(gCustomIdBuffer, pixel, 0).r);
+    vec3 N = normalize(normal.xyz);
+    setUpsampleWeights(position.w, N, getCluster(position.xyz));
+    SHADE_FROM_GBUFFER = true;
+    RenderInfo ri = shadeHit(ro, rd, res, position.xyz, N, i, maxT);
+    SHADE_FROM_GBUFFER = false;
+    return ri;
+}
+#endif
+
 vec3 render2D(vec2 pos) {
     float scol = sdMandelBrot(twoDFragCoord.xy);
     return pow( vec3(scol), vec3(0.9,1.1,1.4) );
@@ -2426,7 +3090,35 @@ void setScene(inout vec3 ro, inout vec3 rd, inout vec3 bgCol, out float far) {
 #endif
 }
 
-void main() {
+// Gets the depth the primary ray of the pixel can start from
+// @param ro Ray origin (on the near plane)
+float getStartDepth(vec3 ro) {
+    // - primary rays start from the depth of their tile
+    float start = 0.f;
+    if (usePrepass) {
+        float tileDepth = texelFetch(prepassDepth, ivec2(gl_FragCoord.xy) / PREPASS_TILE, 0).r;
+        start = max(tileDepth - length(ro - eyePosition.xyz) - PREPASS_MARGIN, 0.f);
+    }
+    // - or from the surface of the last frame, if it is farther
+    // - the nearest of the 3x3 pixels around it, so a pixel next to one that
+    //   no point landed on (a gap of a magnified surface, or a silhouette)
+    //   does not start behind a surface
+    if (useReprojection) {
+        ivec2 pixel = ivec2(gl_FragCoord.xy);
+        ivec2 maxPixel = textureSize(reprojectedDepth, 0) - 1;
+        float lastDepth = 1e30;
+        for (int y = -1; y <= 1; y++) {
+            for (int x = -1; x <= 1; x++) {
+                ivec2 q = clamp(pixel + ivec2(x, y), ivec2(0), maxPixel);
+                lastDepth = min(lastDepth, texelFetch(reprojectedDepth, q, 0).r);
+            }
+        }
+        start = max(lastDepth * (1.f - REPROJECT_MARGIN) - length(ro - eyePosition.xyz), start);
+    }
+    return start;
+}
+
+void shade() {
     // === 2D Render ===
     if (isTwoD) { fragColor = vec4(render2D(twoDFragCoord.xy), 1.f); return; }
 
@@ -2434,14 +3126,26 @@ void main() {
     vec3 ro, rd, bgCol; float far;
     setScene(ro, rd, bgCol, far);
 
+    // === Depth prepass ===
+    if (depthPrepass) {
+        fragColor = vec4(coneMarch(eyePosition.xyz, rd, coneRadius, far));
+        return;
+    }
+
     vec4 phong, refl = vec4(0.f), refr = vec4(0.f), cres;
     bool cloudHit = false, terrainHit = false, seaHit = false;
     IntersectionInfo info, oi;
     RenderInfo ri, tr, sr;
 
     // === Main render ===
-    ri = render(ro, rd, info, OUTSIDE, far, bgCol);
+#ifdef LIGHTING_PASS
+    ri = renderGBuffer(ro, rd, info, far, bgCol);
+#else
+    ri = render(ro, rd, info, OUTSIDE, far, bgCol, getStartDepth(ro));
+#endif
+    PRIMARY_STEPS = MARCH_STEPS;
     sr.d = ri.d; tr.d = ri.d;
+    hitDepth = ri.isEnv ? 0.f : ri.d + length(ro - eyePosition.xyz);
     // === Sea render ===
 #ifdef SEA
     sr = seaRender(ro, rd, seaHit, ri.d, bgCol);
@@ -2480,7 +3184,7 @@ void main() {
     // =================== Refl && Refr =====================
     oi.intersectObj = info.intersectObj; oi.n = info.n; oi.p = info.p; oi.rd = info.rd;
     // === Secondary Rays ===
-    RayMarchObject obj = objects[info.intersectObj];
+    RayMarchObject obj = getObject(info.intersectObj);
     vec3 cRefl = obj.cReflective, cRefr = obj.cTransparent;
     if (obj.type == CUSTOM) {
         // Change accordingly
@@ -2502,7 +3206,7 @@ void main() {
             // Render the reflected ray
             bool terrainHit = false, cloudHit = false, seaHit = false; vec4 cres;
             RenderInfo res, tr, sr;
-            res = render(shiftedRO, r, info, OUTSIDE, far, bgCol);
+            res = render(shiftedRO, r, info, OUTSIDE, far, bgCol, 0.f);
             tr.d = res.d; sr.d = res.d;
 #ifdef SEA
             sr = seaRender(shiftedRO, r, seaHit, res.d, bgCol);
@@ -2531,14 +3235,15 @@ void main() {
         // gets around this but, like many other things, for the time being this is
         // good enough.
 
-        float ior = objects[oi.intersectObj].ior;
-        vec3 ct = objects[oi.intersectObj].cTransparent;
+        RayMarchObject oobj = getObject(oi.intersectObj);
+        float ior = oobj.ior;
+        vec3 ct = oobj.cTransparent;
 
         // Air -> Medium
         // - air ior is 1.
         vec3 rdIn = refract(oi.rd, oi.n, 1./ior);
         vec3 pEnter = oi.p - oi.n * SURFACE_DIST * 3.f;
-        float dIn = raymarch(pEnter, rdIn, far, INSIDE).d;
+        float dIn = raymarch(pEnter, rdIn, far, INSIDE, 0.f).d;
 
         vec3 pExit = pEnter + rdIn * dIn;
         vec3 nExit = -getNormal(pExit);
@@ -2551,7 +3256,7 @@ void main() {
             vec3 shiftedRO = pExit - nExit * SURFACE_DIST*5.f;
             bool cloudHit = false, terrainHit = false, seaHit = false;
             vec4 cres; vec4 resC; RenderInfo res, tr, sr;
-            res = render(shiftedRO, rdOut, info, OUTSIDE, far, bgCol);
+            res = render(shiftedRO, rdOut, info, OUTSIDE, far, bgCol, 0.f);
             tr.d = res.d; sr.d = res.d;
 #ifdef SEA
             sr = seaRender(shiftedRO, rdOut, seaHit, res.d, bgCol);
@@ -2573,3 +3278,82 @@ void main() {
     setBrightness(vec3(col));
     fragColor = col;
 }
+
+// ====== DEFERRED PASSES ======
+#ifdef GBUFFER_PASS
+// Marches the primary ray and writes its hit to the G-buffer
+void writeGBuffer() {
+    vec3 ro, rd, bgCol; float far;
+    setScene(ro, rd, bgCol, far);
+    // - the depth prepass runs with this shader in deferred mode
+    if (depthPrepass) {
+        fragColor = vec4(coneMarch(eyePosition.xyz, rd, coneRadius, far));
+        return;
+    }
+    RayMarchRes res = raymarch(ro, rd, far, OUTSIDE, getStartDepth(ro));
+    PRIMARY_STEPS = MARCH_STEPS;
+    if (res.intersectObj == -1) {
+        fragColor = vec4(0.f); hitDepth = 0.f;
+        return;
+    }
+    vec3 p = ro + rd * res.d;
+    hitDepth = res.d + length(ro - eyePosition.xyz);
+    fragColor = vec4(p, hitDepth);
+    BrightColor = vec4(getSurfaceNormal(p), res.intersectObj);
+    gTrap = res.trap; gCustomId = float(res.customId);
+}
+#endif
+
+#ifdef SHADOW_PASS
+// Writes the visibility of lights firstSlot to firstSlot + 3 of the cluster
+// of the hit of the G-buffer
+// - one texel per lightingScale x lightingScale pixels
+void writeShadows() {
+    vec3 ro, rd, bgCol; float far;
+    setScene(ro, rd, bgCol, far);
+    fragColor = vec4(1.f);
+    ivec2 pixel = getLightingPixel(ivec2(gl_FragCoord.xy));
+    vec4 position = texelFetch(gPositionBuffer, pixel, 0);
+    vec4 normal = texelFetch(gNormalBuffer, pixel, 0);
+    // - area lights are not shaded
+    if (position.w == 0.f || getObject(int(normal.w)).isEmissive) return;
+    vec3 n = normalize(normal.xyz);
+    int cluster = getCluster(position.xyz), offset;
+    if (cluster == -1) return;
+    int count = getClusterLights(cluster, offset);
+    for (int k = 0; k < 4; k++) {
+        int slot = firstSlot + k;
+        if (slot >= count) break;
+        int i = texelFetch(lightClusters, offset + slot).r;
+        fragColor[k] = calcVisibility(position.xyz, n, rd, far, i);
+    }
+}
+#endif
+
+#ifdef AO_PASS
+// Writes the ambient occlusion of the hit of the G-buffer
+// - one texel per lightingScale x lightingScale pixels
+void writeAO() {
+    fragColor = vec4(1.f);
+    ivec2 pixel = getLightingPixel(ivec2(gl_FragCoord.xy));
+    vec4 position = texelFetch(gPositionBuffer, pixel, 0);
+    if (position.w == 0.f) return;
+    fragColor = vec4(calcAO(position.xyz, normalize(texelFetch(gNormalBuffer, pixel, 0).xyz)));
+}
+#endif
+
+void main() {
+#if defined(GBUFFER_PASS)
+    writeGBuffer();
+#elif defined(SHADOW_PASS)
+    writeShadows();
+#elif defined(AO_PASS)
+    writeAO();
+#else
+    // - forward, or the lighting pass
+    shade();
+#endif
+    // - only bound to a target by the raymarch pass (see setRaymarchOutputs)
+    marchCost = vec4(PRIMARY_STEPS, SHADOW_STEPS, SDF_EVALS,
+                     MARCH_STEPS + SHADOW_STEPS);
+}
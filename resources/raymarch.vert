@@ -5,6 +5,11 @@ layout (location = 0) in vec2 pos;
 uniform mat4 viewMatrix;
 uniform mat4 projMatrix;
 uniform mat4 invProjViewMatrix;
+// Sub-pixel offset of the rays in NDC (0 if not accumulating)
+uniform vec2 pixelJitter;
+// Scale of the viewport in NDC (1 except for the depth prepass, whose tiles
+// cover a little more than the screen)
+uniform vec2 rayScale = vec2(1.f);
 
 out vec4 nearClip;
 out vec4 farClip;
@@ -20,6 +25,7 @@ void main() {
     // (REFERENCE)
     // https://community.khronos.org/t/ray-origin-through-view-and-projection-matrices/72579/4
     // In NDC, all ray intersects at (x, y, -1) and (x, y, 1)    
-    nearClip = invProjViewMatrix * (vec4(gl_Position.xy, -1, 1.0));
-    farClip = invProjViewMatrix * (vec4(gl_Position.xy, +1, 1.0));
+    vec2 ndc = (gl_Position.xy + 1.f) * rayScale - 1.f + pixelJitter;
+    nearClip = invProjViewMatrix * (vec4(ndc, -1, 1.0));
+    farClip = invProjViewMatrix * (vec4(ndc, +1, 1.0));
 }
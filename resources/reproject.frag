@@ -0,0 +1,10 @@
+#version 330 core
+// Writes the depth from the eye of a reprojected surface point
+flat in float depth;
+
+out vec4 FragColor;
+
+void main()
+{
+    FragColor = vec4(depth);
+}
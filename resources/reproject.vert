@@ -0,0 +1,36 @@
+#version 330 core
+// Scatters the hit depth of the last frame into the current view
+// - one point per texel of the last frame, placed on the surface that the
+//   ray of the texel hit. Texels that hit nothing are dropped
+// - where points overlap, the depth test keeps the nearest surface
+uniform sampler2D hitDepth;
+// Camera of the last frame
+uniform mat4 prevInvProjViewMatrix;
+uniform vec3 prevEyePosition;
+// Camera of the current frame
+uniform mat4 projViewMatrix;
+uniform vec3 eyePosition;
+
+flat out float depth;
+
+void main() {
+    ivec2 size = textureSize(hitDepth, 0);
+    ivec2 texel = ivec2(gl_VertexID % size.x, gl_VertexID / size.x);
+    float d = texelFetch(hitDepth, texel, 0).r;
+    depth = 0.0;
+    if (d <= 0.0) {
+        // - outside of the clip volume
+        gl_Position = vec4(2.0, 2.0, 2.0, 1.0);
+        return;
+    }
+
+    // Ray through the texel center in the last frame (see raymarch.vert)
+    vec2 ndc = (vec2(texel) + 0.5) / vec2(size) * 2.0 - 1.0;
+    vec4 nearClip = prevInvProjViewMatrix * vec4(ndc, -1.0, 1.0);
+    vec4 farClip = prevInvProjViewMatrix * vec4(ndc, 1.0, 1.0);
+    vec3 rd = normalize(farClip.xyz / farClip.w - nearClip.xyz / nearClip.w);
+
+    vec3 p = prevEyePosition + rd * d;
+    gl_Position = projViewMatrix * vec4(p, 1.0);
+    depth = length(p - eyePosition);
+}
@@ -0,0 +1,61 @@
+#version 330 core
+// Edge-aware upscale of the render resolution image to the window
+// - a 4x4 texel kernel (Lanczos-like) that is stretched along the local edge
+//   and squeezed across it, so edges stay sharp instead of getting blurred
+//   into stairs like with plain bilinear
+// - the result is clamped to the 2x2 texels around the pixel to avoid ringing
+out vec4 FragColor;
+
+in vec2 TexCoords;
+
+uniform sampler2D image;
+
+float luma(vec3 c) {
+    return dot(c, vec3(0.299, 0.587, 0.114));
+}
+
+vec3 fetch(ivec2 p, ivec2 maxP) {
+    return texelFetch(image, clamp(p, ivec2(0), maxP), 0).rgb;
+}
+
+void main()
+{
+    ivec2 size = textureSize(image, 0);
+    ivec2 maxP = size - 1;
+    // Position in texels relative to the texel centers
+    vec2 pos = TexCoords * vec2(size) - 0.5;
+    ivec2 base = ivec2(floor(pos));
+    vec2 f = pos - vec2(base);
+
+    // Edge of the 2x2 texels around the pixel
+    vec3 c00 = fetch(base, maxP), c10 = fetch(base + ivec2(1, 0), maxP);
+    vec3 c01 = fetch(base + ivec2(0, 1), maxP), c11 = fetch(base + ivec2(1, 1), maxP);
+    float l00 = luma(c00), l10 = luma(c10), l01 = luma(c01), l11 = luma(c11);
+    vec2 grad = vec2(l10 + l11 - l00 - l01, l01 + l11 - l00 - l10);
+    float edge = length(grad);
+    vec2 across = edge > 1e-4 ? grad / edge : vec2(1, 0);
+    vec2 along = vec2(-across.y, across.x);
+    // - 0 in flat areas (round kernel), 1 on strong edges
+    float stretch = clamp(edge * 4.0, 0.0, 1.0);
+    vec2 scale = vec2(1.0 + stretch, 1.0 - 0.5 * stretch);
+
+    vec3 sum = vec3(0.0);
+    float wsum = 0.0;
+    for (int y = -1; y <= 2; y++) {
+        for (int x = -1; x <= 2; x++) {
+            vec2 off = vec2(x, y) - f;
+            vec2 d = vec2(dot(off, across), dot(off, along)) * scale;
+            float d2 = min(dot(d, d), 4.0);
+            // - Lanczos 2 approximation (1 at 0, 0 at a distance of 2)
+            float w = (25.0 / 16.0 * (0.4 * d2 - 1.0) * (0.4 * d2 - 1.0)
+                       - 9.0 / 16.0) * (0.25 * d2 - 1.0) * (0.25 * d2 - 1.0);
+            sum += w * fetch(base + ivec2(x, y), maxP);
+            wsum += w;
+        }
+    }
+    vec3 color = sum / max(wsum, 1e-4);
+
+    vec3 lo = min(min(c00, c10), min(c01, c11));
+    vec3 hi = max(max(c00, c10), max(c01, c11));
+    FragColor = vec4(clamp(color, lo, hi), 1.0);
+}
@@ -0,0 +1,465 @@
+#include "cpu/cpurenderer.h"
+#include "raymarch/raymarchrenderer.h"
+#include "settings.h"
+
+#include <QCommandLineParser>
+#include <QDir>
+#include <QFileInfo>
+#include <QGuiApplication>
+#include <QOffscreenSurface>
+#include <QOpenGLContext>
+#include <QSurfaceFormat>
+#include <algorithm>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+
+// Headless batch renderer. Renders every scene file given on the command line
+// into <output-dir>/<scene name>.png without creating a window, e.g.
+//   raymarch_cli -W 1920 -H 1080 -o output/nightly scenefiles/final/*.json
+// With --cpu the scenes are rendered by the CPU renderer and no GL context is
+// created, so it also runs on machines without a GPU. With --compare-cpu the
+// GPU images are checked against the CPU renderer.
+
+namespace {
+
+/**
+ * @brief Applies the command line render options to the global settings
+ * @param parser Parsed command line
+ * @returns False if any of the options is invalid
+ */
+bool applyOptions(const QCommandLineParser &parser) {
+  bool ok = true;
+  settings.screenWidth = parser.value("width").toInt(&ok);
+  if (!ok || settings.screenWidth <= 0) {
+    std::cerr << "Invalid width." << std::endl;
+    return false;
+  }
+  settings.screenHeight = parser.value("height").toInt(&ok);
+  if (!ok || settings.screenHeight <= 0) {
+    std::cerr << "Invalid height." << std::endl;
+    return false;
+  }
+  settings.nearPlane = parser.value("near").toFloat();
+  settings.farPlane = parser.value("far").toFloat();
+  settings.exposure = parser.value("exposure").toDouble();
+  settings.idxSkyBox = parser.value("skybox").toInt();
+  if (settings.idxSkyBox < 0 || settings.idxSkyBox > 3) {
+    std::cerr << "Invalid sky box (expected 0-3)." << std::endl;
+    return false;
+  }
+
+  // Render Options
+  settings.enableSoftShadow = parser.isSet("soft-shadow");
+  settings.enableReflection = parser.isSet("reflection");
+  settings.enableRefraction = parser.isSet("refraction");
+  settings.enableAmbientOcculusion = parser.isSet("ao");
+  settings.enableFXAA = parser.isSet("fxaa");
+  settings.enableBumpMap = !parser.isSet("no-bump");
+  settings.enableDepthPrepass = !parser.isSet("no-prepass");
+  settings.enableReprojection = !parser.isSet("no-reprojection");
+  settings.enableRelaxation = !parser.isSet("no-relaxation");
+  settings.enableSDFCache = !parser.isSet("no-sdf-cache");
+  settings.enableDeferred = parser.isSet("deferred");
+  settings.sampleBudget = parser.value("samples").toInt(&ok);
+  if (!ok || settings.sampleBudget < 0) {
+    std::cerr << "Invalid number of samples." << std::endl;
+    return false;
+  }
+  settings.enableAccumulation = settings.sampleBudget > 0;
+
+  // Light Effects (mirrors the "Light Effects" combo box)
+  QString lightingRes = parser.value("lighting-res");
+  settings.lightingScale = lightingRes == "half"      ? 2
+                           : lightingRes == "quarter" ? 4
+                                                      : 1;
+  if (lightingRes != "full" && settings.lightingScale == 1) {
+    std::cerr << "Invalid lighting resolution (expected full|half|quarter)."
+              << std::endl;
+    return false;
+  }
+  QString display = parser.value("display");
+  settings.enableGammaCorrection = display == "gamma";
+  settings.enableHDR = display == "hdr";
+  settings.enableBloom = display == "bloom";
+  if (display != "none" && !settings.enableGammaCorrection &&
+      !settings.enableHDR && !settings.enableBloom) {
+    std::cerr << "Invalid display option (expected none|gamma|hdr|bloom)."
+              << std::endl;
+    return false;
+  }
+
+  // The steps are read back from the march cost of the raymarch pass
+  if (parser.isSet("compare-relaxation") && parser.isSet("cpu")) {
+    std::cerr << "--compare-relaxation needs the GPU renderer." << std::endl;
+    return false;
+  }
+  // The CPU renderer has no FXAA and no jittered samples
+  if (parser.isSet("compare-cpu") &&
+      (parser.isSet("cpu") || parser.isSet("compare-relaxation") ||
+       settings.enableFXAA || settings.enableAccumulation)) {
+    std::cerr << "--compare-cpu needs the GPU renderer, without "
+                 "--compare-relaxation, --fxaa or --samples."
+              << std::endl;
+    return false;
+  }
+  int tolerance = parser.value("compare-tolerance").toInt(&ok);
+  if (!ok || tolerance < 0 || tolerance > 255) {
+    std::cerr << "Invalid compare tolerance (expected 0-255)." << std::endl;
+    return false;
+  }
+  return true;
+}
+
+/**
+ * @brief Renders the scene with plain and with over-relaxed sphere tracing
+ * and prints the mean march steps per pixel of both, and how many pixels of
+ * the two images differ
+ * @param renderer Renderer with a current context
+ * @param renderScene Renders settings.sceneFilePath
+ * @returns Image with over-relaxation
+ * - settings.enableRelaxation is restored, so --no-relaxation still holds
+ *   for the following scenes
+ */
+QImage compareRelaxation(RayMarchRenderer &renderer,
+                         const std::function<QImage()> &renderScene) {
+  QImage images[2];
+  double steps[2];
+  bool relaxation = settings.enableRelaxation;
+  renderer.setCostOutput(true);
+  for (int i = 0; i < 2; i++) {
+    settings.enableRelaxation = i == 1;
+    images[i] = renderScene();
+    // - steps of the last frame (the last sample, if accumulating)
+    CostReadback &cost = renderer.getCostReadback();
+    cost.flush();
+    steps[i] = cost.getStats().getMean(CostChannel::COST_ALL_STEPS);
+  }
+  renderer.setCostOutput(false);
+  settings.enableRelaxation = relaxation;
+
+  // - pixels off by more than rounding
+  const int tolerance = 2;
+  int differing = 0;
+  for (int y = 0; y < images[0].height(); y++) {
+    for (int x = 0; x < images[0].width(); x++) {
+      QRgb a = images[0].pixel(x, y), b = images[1].pixel(x, y);
+      int diff = std::max({std::abs(qRed(a) - qRed(b)),
+                           std::abs(qGreen(a) - qGreen(b)),
+                           std::abs(qBlue(a) - qBlue(b))});
+      differing += diff > tolerance;
+    }
+  }
+  float factor = renderer.getScene().getGlobalData().relaxation;
+  std::cout << "Steps per pixel: " << steps[0] << " plain, " << steps[1]
+            << " with relaxation " << factor << " ("
+            << 100. * (steps[1] - steps[0]) / std::max(steps[0], 1.)
+            << "%), " << differing << " pixels differ." << std::endl;
+  return images[1];
+}
+
+/**
+ * @brief Renders the scene on the GPU and on the CPU and prints how much the
+ * two images differ
+ * - the difference of a pixel is that of its most different channel
+ *   (0-255). The images match if at most 1% of the pixels differ by more
+ *   than the tolerance, since a silhouette may fall on the neighbouring
+ *   pixel of the other renderer
+ * - the night sky and the procedural environments (clouds, terrain, sea)
+ *   are not ported to the CPU, scenes with them do not match
+ * @param renderer Renderer with a current context
+ * @param cpu CPU renderer
+ * @param renderScene Renders settings.sceneFilePath
+ * @param tolerance Largest channel difference of a matching pixel
+ * @param matches Set to true if the images match
+ * @returns Image of the GPU
+ */
+QImage compareCPU(RayMarchRenderer &renderer, CPURenderer &cpu,
+                  const std::function<QImage()> &renderScene, int tolerance,
+                  bool &matches) {
+  QImage gpuImage = renderScene();
+  // Same scene and camera as the GPU frame
+  cpu.sceneChanged();
+  cpu.settingsChanged();
+  QImage cpuImage = cpu.render(renderer.getScene());
+  matches = false;
+  if (gpuImage.isNull() || gpuImage.size() != cpuImage.size()) {
+    std::cerr << "The CPU image does not have the size of the GPU image."
+              << std::endl;
+    return gpuImage;
+  }
+
+  int maxDiff = 0, differing = 0;
+  double sumDiff = 0.;
+  for (int y = 0; y < gpuImage.height(); y++) {
+    for (int x = 0; x < gpuImage.width(); x++) {
+      QRgb a = gpuImage.pixel(x, y), b = cpuImage.pixel(x, y);
+      int diff = std::max({std::abs(qRed(a) - qRed(b)),
+                           std::abs(qGreen(a) - qGreen(b)),
+                           std::abs(qBlue(a) - qBlue(b))});
+      maxDiff = std::max(maxDiff, diff);
+      sumDiff += diff;
+      differing += diff > tolerance;
+    }
+  }
+  int numPixels = gpuImage.width() * gpuImage.height();
+  matches = differing <= numPixels / 100;
+  std::cout << "CPU difference: max " << maxDiff << ", mean "
+            << sumDiff / numPixels << ", " << differing
+            << " pixels above " << tolerance << " ("
+            << 100. * differing / numPixels << "%), "
+            << (matches ? "matches." : "DIFFERS.") << std::endl;
+  return gpuImage;
+}
+
+/**
+ * @brief Renders every scene file and saves the results
+ * @param scenes Scene files
+ * @param outDir Directory the images are written to
+ * @param renderScene Renders settings.sceneFilePath
+ * @returns Number of scenes that failed
+ */
+int renderScenes(const QStringList &scenes, const QDir &outDir,
+                 const std::function<QImage()> &renderScene) {
+  int failures = 0;
+  for (const QString &scene : scenes) {
+    QFileInfo info(scene);
+    if (!info.exists()) {
+      std::cerr << "Scene file \"" << scene.toStdString()
+                << "\" does not exist." << std::endl;
+      failures++;
+      continue;
+    }
+    settings.sceneFilePath = info.absoluteFilePath().toStdString();
+
+    QString outPath = outDir.filePath(info.completeBaseName() + ".png");
+    QImage image = renderScene();
+    if (image.isNull() || !image.save(outPath)) {
+      std::cerr << "Failed to save image to " << outPath.toStdString()
+                << std::endl;
+      failures++;
+      continue;
+    }
+    std::cout << "Rendered \"" << scene.toStdString() << "\" to \""
+              << outPath.toStdString() << "\"." << std::endl;
+  }
+  return failures;
+}
+
+/**
+ * @brief Renders the scenes with RayMarchRenderer on an offscreen context
+ * @param timingsPath If not empty, the GPU time of the passes is written to
+ * this CSV file
+ * @param relaxationComparison If true, the march steps with and without
+ * over-relaxation are printed for every scene
+ * @param cpuTolerance If >= 0, every scene is also rendered on the CPU and
+ * must match the GPU image within this tolerance (see compareCPU)
+ * @returns Exit code
+ */
+int renderOnGPU(const QStringList &scenes, const QDir &outDir, float time,
+                const QString &timingsPath, bool relaxationComparison,
+                int cpuTolerance) {
+  // Offscreen GL context (same format as the application window)
+  QSurfaceFormat fmt;
+  fmt.setVersion(4, 1);
+  fmt.setProfile(QSurfaceFormat::CoreProfile);
+  QSurfaceFormat::setDefaultFormat(fmt);
+
+  QOpenGLContext context;
+  context.setFormat(fmt);
+  if (!context.create()) {
+    std::cerr << "Failed to create an OpenGL 4.1 core context." << std::endl;
+    return 1;
+  }
+  QOffscreenSurface surface;
+  surface.setFormat(context.format());
+  surface.create();
+  if (!context.makeCurrent(&surface)) {
+    std::cerr << "Failed to make the OpenGL context current." << std::endl;
+    return 1;
+  }
+
+  RayMarchRenderer renderer;
+  renderer.initialize(settings.screenWidth, settings.screenHeight);
+  renderer.setTime(time);
+
+  auto renderScene = [&renderer]() {
+    renderer.sceneChanged();
+    renderer.resize(settings.screenWidth, settings.screenHeight);
+    renderer.settingsChanged();
+    QImage image = renderer.renderToImage();
+    // - one frame per scene, so wait for its timings
+    renderer.getPassTimer().flush();
+    return image;
+  };
+  CPURenderer cpu;
+  cpu.setTime(time);
+  int mismatches = 0;
+  int failures = renderScenes(scenes, outDir, [&]() {
+    if (cpuTolerance >= 0) {
+      bool matches;
+      QImage image =
+          compareCPU(renderer, cpu, renderScene, cpuTolerance, matches);
+      mismatches += !matches;
+      return image;
+    }
+    return relaxationComparison ? compareRelaxation(renderer, renderScene)
+                                : renderScene();
+  });
+  failures += mismatches;
+
+  if (!timingsPath.isEmpty() &&
+      !renderer.getPassTimer().writeCSV(timingsPath.toStdString())) {
+    failures++;
+  }
+  renderer.finish();
+  context.doneCurrent();
+  return failures ? 1 : 0;
+}
+
+/**
+ * @brief Renders the scenes with CPURenderer
+ * @param numThreads Number of render threads (0 uses all hardware threads)
+ * @param simdLevel Instruction set of the packet kernels
+ * @returns Exit code
+ */
+int renderOnCPU(const QStringList &scenes, const QDir &outDir, float time,
+                int numThreads, SIMDLevel simdLevel) {
+  CPURenderer renderer(numThreads);
+  renderer.setTime(time);
+  renderer.setSIMDLevel(simdLevel);
+  std::cout << "Rendering on the CPU with " << renderer.getNumThreads()
+            << " threads ("
+            << PacketMarcher::getName(renderer.getSIMDLevel()) << ")."
+            << std::endl;
+
+  RayMarchScene scene;
+  int failures = renderScenes(scenes, outDir, [&renderer, &scene]() {
+    // Same steps as RayMarchRenderer::sceneChanged, resize, settingsChanged
+    bool isAreaLightUsed = false;
+    scene.initScene(settings, isAreaLightUsed);
+    renderer.sceneChanged();
+    scene.m_width = settings.screenWidth;
+    scene.m_height = settings.screenHeight;
+    scene.resizeScene(scene.m_width, scene.m_height);
+    scene.updateScene(settings);
+    renderer.settingsChanged();
+    return renderer.render(scene);
+  });
+  return failures ? 1 : 0;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  // Fall back to the offscreen platform when there is no display server
+  if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM") &&
+      qEnvironmentVariableIsEmpty("DISPLAY") &&
+      qEnvironmentVariableIsEmpty("WAYLAND_DISPLAY")) {
+    qputenv("QT_QPA_PLATFORM", "offscreen");
+  }
+
+  QGuiApplication a(argc, argv);
+
+  QCoreApplication::setApplicationName("Raymarching CLI");
+  QCoreApplication::setOrganizationName("PhongTotal");
+  QCoreApplication::setApplicationVersion(QT_VERSION_STR);
+
+  QCommandLineParser parser;
+  parser.setApplicationDescription(
+      "Renders scene files to PNG without opening a window.");
+  parser.addHelpOption();
+  parser.addVersionOption();
+  parser.addPositionalArgument("scenes", "Scene files (*.json) to render.",
+                               "<scene.json...>");
+  parser.addOptions({
+      {{"W", "width"}, "Output width in pixels.", "px", "1024"},
+      {{"H", "height"}, "Output height in pixels.", "px", "768"},
+      {{"o", "output-dir"}, "Directory the images are written to.", "dir",
+       "output"},
+      {"time", "Value of iTime for animated scenes.", "seconds", "0"},
+      {"near", "Near plane.", "distance", "0.1"},
+      {"far", "Far plane.", "distance", "100"},
+      {"soft-shadow", "Enable soft shadows."},
+      {"reflection", "Enable reflection."},
+      {"refraction", "Enable refraction."},
+      {"ao", "Enable ambient occlusion."},
+      {"fxaa", "Enable FXAA."},
+      {"no-bump", "Disable the bump mapping of the scenes."},
+      {"no-prepass", "Disable the depth prepass of the primary rays."},
+      {"no-reprojection",
+       "Disable the temporal reprojection of the primary rays."},
+      {"no-relaxation", "Disable the over-relaxed sphere tracing."},
+      {"no-sdf-cache",
+       "Evaluate the static objects instead of their baked distance."},
+      {"compare-relaxation",
+       "Print the march steps per pixel with and without over-relaxation."},
+      {"compare-cpu",
+       "Also render on the CPU and fail if the images differ (no --fxaa or "
+       "--samples)."},
+      {"compare-tolerance",
+       "Largest channel difference (0-255) of a matching pixel for "
+       "--compare-cpu.",
+       "levels", "8"},
+      {"deferred", "Shade from a G-buffer in separate passes."},
+      {"lighting-res",
+       "Resolution of the shadows and AO: full, half or quarter (below full "
+       "implies --deferred).",
+       "res", "full"},
+      {"samples", "Jittered samples averaged per image (0 renders one frame).",
+       "count", "0"},
+      {"display", "Light effect: none, gamma, hdr or bloom.", "mode", "none"},
+      {"exposure", "Exposure used by HDR and bloom.", "value", "1"},
+      {"skybox", "Sky box: 0 none, 1 beach, 2 night sky, 3 island.", "index",
+       "0"},
+      {"cpu", "Render on the CPU (FXAA is not supported)."},
+      {"threads", "Threads used by --cpu (0 uses all cores).", "count", "0"},
+      {"simd", "Ray packets of --cpu: auto, scalar, sse4 or avx2.", "level",
+       "auto"},
+      {"timings", "Write the GPU time of every pass to a CSV file.", "csv"},
+  });
+  parser.process(a);
+
+  const QStringList scenes = parser.positionalArguments();
+  if (scenes.isEmpty()) {
+    parser.showHelp(1);
+  }
+  if (!applyOptions(parser)) {
+    return 1;
+  }
+  QDir outDir(parser.value("output-dir"));
+  if (!outDir.mkpath(".")) {
+    std::cerr << "Failed to create output directory \""
+              << outDir.path().toStdString() << "\"." << std::endl;
+    return 1;
+  }
+
+  float time = parser.value("time").toFloat();
+  if (parser.isSet("cpu")) {
+    bool ok = true;
+    int numThreads = parser.value("threads").toInt(&ok);
+    if (!ok || numThreads < 0) {
+      std::cerr << "Invalid number of threads." << std::endl;
+      return 1;
+    }
+    QString simd = parser.value("simd");
+    SIMDLevel simdLevel = PacketMarcher::getSupportedLevel();
+    if (simd == "scalar") {
+      simdLevel = SIMDLevel::SIMD_SCALAR;
+    } else if (simd == "sse4") {
+      simdLevel = SIMDLevel::SIMD_SSE4;
+    } else if (simd == "avx2") {
+      simdLevel = SIMDLevel::SIMD_AVX2;
+    } else if (simd != "auto") {
+      std::cerr << "Invalid SIMD option (expected auto|scalar|sse4|avx2)."
+                << std::endl;
+      return 1;
+    }
+    return renderOnCPU(scenes, outDir, time, numThreads, simdLevel);
+  }
+  int cpuTolerance = parser.isSet("compare-cpu")
+                         ? parser.value("compare-tolerance").toInt()
+                         : -1;
+  return renderOnGPU(scenes, outDir, time, parser.value("timings"),
+                     parser.isSet("compare-relaxation"), cpuTolerance);
+}
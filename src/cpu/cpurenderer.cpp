@@ -0,0 +1,1382 @@
+#include "cpurenderer.h"
+#include "cpu/cpusdf.h"
+#include "raymarch/lightclusters.h"
+#include "settings.h"
+#include "utils/ltc_matrix.h"
+#include <algorithm>
+#include <filesystem>
+#include <iostream>
+
+// Constants of resources/raymarch.frag
+static const float INSIDE = -1.f;
+static const float OUTSIDE = 1.f;
+static const int MAX_STEPS = 256;
+static const float SURFACE_DIST = 0.001f;
+static const int AREA_LIGHT_SAMPLES = 1;
+static const float PI = 3.14159265f;
+static const int NUM_REFLECTION = 1;
+static const float TEXTURE_EPS = 0.005f;
+static const float LUT_SIZE = 64.f;
+static const float LUT_SCALE = (LUT_SIZE - 1.f) / LUT_SIZE;
+static const float LUT_BIAS = 0.5f / LUT_SIZE;
+static const glm::vec3 BRIGHT_FILTER(0.2126f, 0.7152f, 0.0722f);
+static const float BUMP_SCALE = 10.f;
+static const float BUMP_INTENSITY = 2.f;
+
+// Constants of the post processing passes
+// - bloom mip chain (same as RayMarchRenderer)
+static const int BLOOM_MIN_HEIGHT = 16;
+static const int BLOOM_MAX_MIPS = 8;
+static const float GAMMA = 2.2f;
+
+// Tile size in pixels
+static const int TILE_SIZE = 32;
+
+// Area light corners in object space (same as RayMarchRenderer)
+static const glm::vec3 AREA_LIGHT_CORNERS[4] = {
+    glm::vec3(-0.5f, 0.5f, 0.f),  // tl
+    glm::vec3(0.5f, 0.5f, 0.f),   // tr
+    glm::vec3(0.5f, -0.5f, 0.f),  // br
+    glm::vec3(-0.5f, -0.5f, 0.f), // bl
+};
+
+// =================== Sky ===================
+
+// - fixed time of day of the sky (timeOfDay in raymarch.frag)
+static const float TIME_OF_DAY = 0.1f;
+static const float SUNRISE_START = 0.2f;
+static const float SUNSET_START = 0.8f;
+
+/**
+ * @brief Gets the sky background of a ray (getSky in raymarch.frag)
+ * @param rd Ray direction
+ */
+static glm::vec3 getSky(const glm::vec3 &rd) {
+  const glm::vec3 sunriseColor(1.f, 0.5f, 0.2f);
+  const glm::vec3 sunsetColor(1.f, 0.8f, 0.5f);
+  float rise = glm::smoothstep(0.f, SUNRISE_START, TIME_OF_DAY);
+  float set = glm::smoothstep(SUNSET_START, 1.f, TIME_OF_DAY);
+  glm::vec3 skyColor =
+      glm::mix(glm::mix(sunriseColor, glm::vec3(0.8f, 0.9f, 1.1f), rise),
+               sunsetColor, set);
+  glm::vec3 sunColor =
+      glm::mix(glm::mix(sunriseColor, glm::vec3(1.f, 1.f, 0.8f), rise),
+               sunsetColor, set);
+  float elevation = glm::mix(0.f, 3.14f, TIME_OF_DAY);
+  glm::vec3 sunDir = glm::normalize(
+      glm::vec3(glm::cos(elevation), glm::sin(elevation), -0.577f));
+  return skyColor * (0.6f + 0.4f * rd.y) +
+         sunColor *
+             glm::pow(glm::clamp(glm::dot(rd, sunDir), 0.f, 1.f), 32.f);
+}
+
+// =================== Texture Sampling ===================
+
+/**
+ * @brief Bilinear filtering with the GL_LINEAR conventions
+ * @param w,h Size of the texture
+ * @param uv Texture coordinates
+ * @param repeat GL_REPEAT if true, GL_CLAMP_TO_EDGE otherwise
+ * @param fetch Returns the texel at (x, y)
+ */
+template <typename Fetch>
+static glm::vec4 sampleBilinear(int w, int h, glm::vec2 uv, bool repeat,
+                                Fetch fetch) {
+  float x = uv.x * w - 0.5f;
+  float y = uv.y * h - 0.5f;
+  int x0 = std::floor(x);
+  int y0 = std::floor(y);
+  float fx = x - x0;
+  float fy = y - y0;
+  auto wrap = [repeat](int i, int n) {
+    if (repeat) {
+      i %= n;
+      return i < 0 ? i + n : i;
+    }
+    return std::clamp(i, 0, n - 1);
+  };
+  int xa = wrap(x0, w), xb = wrap(x0 + 1, w);
+  int ya = wrap(y0, h), yb = wrap(y0 + 1, h);
+  glm::vec4 top = glm::mix(fetch(xa, ya), fetch(xb, ya), fx);
+  glm::vec4 bottom = glm::mix(fetch(xa, yb), fetch(xb, yb), fx);
+  return glm::mix(top, bottom, fy);
+}
+
+/**
+ * @brief Samples a RGBA8 texture (first row is t = 0)
+ */
+static glm::vec4 sampleTexture(const TextureInfo &tex, glm::vec2 uv,
+                               bool repeat) {
+  return sampleBilinear(tex.width, tex.height, uv, repeat, [&](int x, int y) {
+    const RGBA &c = tex.data[y * tex.width + x];
+    return glm::vec4(c.r, c.g, c.b, c.a) / 255.f;
+  });
+}
+
+/**
+ * @brief Samples a level of the bloom mip chain (GL_CLAMP_TO_EDGE)
+ */
+static glm::vec3 sampleMip(const std::vector<glm::vec3> &mip, glm::ivec2 size,
+                           glm::vec2 uv) {
+  return sampleBilinear(size.x, size.y, uv, false, [&](int x, int y) {
+    return glm::vec4(mip[y * size.x + x], 0.f);
+  });
+}
+
+/**
+ * @brief Samples one of the 64x64 LTC tables
+ */
+static glm::vec4 sampleLTC(const float *table, glm::vec2 uv) {
+  return sampleBilinear(64, 64, uv, false, [&](int x, int y) {
+    const float *t = &table[(y * 64 + x) * 4];
+    return glm::vec4(t[0], t[1], t[2], t[3]);
+  });
+}
+
+// ====================== Noise ===========================
+
+static glm::vec3 fade(glm::vec3 t) {
+  return t * t * t * (t * (t * 6.f - 15.f) + 10.f);
+}
+
+static glm::vec4 permute(glm::vec4 x) {
+  return glm::mod(((x * 34.f) + 1.f) * x, 289.f);
+}
+
+static glm::vec4 taylorInvSqrt(glm::vec4 r) {
+  return 1.79284291400159f - 0.85373472095314f * r;
+}
+
+/**
+ * @brief Perlin noise (pnoise in raymarch.frag)
+ */
+static float pnoise(glm::vec3 p) {
+  glm::vec3 Pi0 = glm::floor(p);
+  glm::vec3 Pi1 = Pi0 + glm::vec3(1.f);
+  Pi0 = glm::mod(Pi0, 256.f);
+  Pi1 = glm::mod(Pi1, 256.f);
+  glm::vec3 Pf0 = glm::fract(p);
+  glm::vec3 Pf1 = Pf0 - glm::vec3(1.f);
+  glm::vec4 ix(Pi0.x, Pi1.x, Pi0.x, Pi1.x);
+  glm::vec4 iy(Pi0.y, Pi0.y, Pi1.y, Pi1.y);
+  glm::vec4 iz0(Pi0.z);
+  glm::vec4 iz1(Pi1.z);
+
+  glm::vec4 ixy = permute(permute(ix) + iy);
+  glm::vec4 ixy0 = permute(ixy + iz0);
+  glm::vec4 ixy1 = permute(ixy + iz1);
+
+  glm::vec4 gx0 = ixy0 / 7.f;
+  glm::vec4 gy0 = glm::fract(glm::floor(gx0) / 7.f) - 0.5f;
+  gx0 = glm::fract(gx0);
+  glm::vec4 gz0 = glm::vec4(0.5f) - glm::abs(gx0) - glm::abs(gy0);
+  glm::vec4 sz0 = glm::step(gz0, glm::vec4(0.f));
+  gx0 -= sz0 * (glm::step(glm::vec4(0.f), gx0) - 0.5f);
+  gy0 -= sz0 * (glm::step(glm::vec4(0.f), gy0) - 0.5f);
+
+  glm::vec4 gx1 = ixy1 / 7.f;
+  glm::vec4 gy1 = glm::fract(glm::floor(gx1) / 7.f) - 0.5f;
+  gx1 = glm::fract(gx1);
+  glm::vec4 gz1 = glm::vec4(0.5f) - glm::abs(gx1) - glm::abs(gy1);
+  glm::vec4 sz1 = glm::step(gz1, glm::vec4(0.f));
+  gx1 -= sz1 * (glm::step(glm::vec4(0.f), gx1) - 0.5f);
+  gy1 -= sz1 * (glm::step(glm::vec4(0.f), gy1) - 0.5f);
+
+  glm::vec3 g000(gx0.x, gy0.x, gz0.x);
+  glm::vec3 g100(gx0.y, gy0.y, gz0.y);
+  glm::vec3 g010(gx0.z, gy0.z, gz0.z);
+  glm::vec3 g110(gx0.w, gy0.w, gz0.w);
+  glm::vec3 g001(gx1.x, gy1.x, gz1.x);
+  glm::vec3 g101(gx1.y, gy1.y, gz1.y);
+  glm::vec3 g011(gx1.z, gy1.z, gz1.z);
+  glm::vec3 g111(gx1.w, gy1.w, gz1.w);
+
+  glm::vec4 norm0 = taylorInvSqrt(
+      glm::vec4(glm::dot(g000, g000), glm::dot(g010, g010),
+                glm::dot(g100, g100), glm::dot(g110, g110)));
+  g000 *= norm0.x;
+  g010 *= norm0.y;
+  g100 *= norm0.z;
+  g110 *= norm0.w;
+  glm::vec4 norm1 = taylorInvSqrt(
+      glm::vec4(glm::dot(g001, g001), glm::dot(g011, g011),
+                glm::dot(g101, g101), glm::dot(g111, g111)));
+  g001 *= norm1.x;
+  g011 *= norm1.y;
+  g101 *= norm1.z;
+  g111 *= norm1.w;
+
+  float n000 = glm::dot(g000, Pf0);
+  float n100 = glm::dot(g100, glm::vec3(Pf1.x, Pf0.y, Pf0.z));
+  float n010 = glm::dot(g010, glm::vec3(Pf0.x, Pf1.y, Pf0.z));
+  float n110 = glm::dot(g110, glm::vec3(Pf1.x, Pf1.y, Pf0.z));
+  float n001 = glm::dot(g001, glm::vec3(Pf0.x, Pf0.y, Pf1.z));
+  float n101 = glm::dot(g101, glm::vec3(Pf1.x, Pf0.y, Pf1.z));
+  float n011 = glm::dot(g011, glm::vec3(Pf0.x, Pf1.y, Pf1.z));
+  float n111 = glm::dot(g111, Pf1);
+
+  glm::vec3 fade_xyz = fade(Pf0);
+  glm::vec4 n_z = glm::mix(glm::vec4(n000, n100, n010, n110),
+                           glm::vec4(n001, n101, n011, n111), fade_xyz.z);
+  glm::vec2 n_yz =
+      glm::mix(glm::vec2(n_z.x, n_z.y), glm::vec2(n_z.z, n_z.w), fade_xyz.y);
+  float n_xyz = glm::mix(n_yz.x, n_yz.y, fade_xyz.x);
+  return 2.2f * n_xyz;
+}
+
+/**
+ * @brief Bump mapping with noise (bumpNormal in raymarch.frag)
+ */
+static glm::vec3 bumpNormal(const glm::vec3 &normal, const glm::vec3 &pos,
+                            float scale, float intensity) {
+  float noiseValue = pnoise(pos * scale);
+  glm::vec3 gradient(
+      pnoise(pos * scale + glm::vec3(0.1f, 0.f, 0.f)) - noiseValue,
+      pnoise(pos * scale + glm::vec3(0.f, 0.1f, 0.f)) - noiseValue,
+      pnoise(pos * scale + glm::vec3(0.f, 0.f, 0.1f)) - noiseValue);
+  return glm::normalize(normal + gradient * intensity);
+}
+
+// ====================== UV Mapping ======================
+
+static glm::vec2 uvMapCube(const glm::vec3 &p, float repeatU, float repeatV) {
+  float u, v;
+  glm::vec3 absP = glm::abs(p);
+  float m = glm::max(glm::max(absP.x, absP.y), absP.z);
+  // Determine the major axis
+  if (m == absP.x) {
+    u = p.x < 0 ? p.z + 0.5f : -p.z + 0.5f;
+    v = p.y + 0.5f;
+  } else if (m == absP.y) {
+    u = p.x + 0.5f;
+    v = p.y < 0 ? p.z + 0.5f : -p.z + 0.5f;
+  } else {
+    u = p.z < 0 ? -p.x + 0.5f : p.x + 0.5f;
+    v = p.y + 0.5f;
+  }
+  return glm::vec2(u * repeatU, v * repeatV);
+}
+
+static float uvAroundY(const glm::vec3 &p) {
+  float theta = glm::atan(p.z, p.x);
+  return theta < 0 ? -theta / (2 * PI) : 1 - (theta / (2 * PI));
+}
+
+static glm::vec2 uvMapCone(const glm::vec3 &p, float repeatU, float repeatV) {
+  float u, v;
+  if (glm::abs(p.y + 0.5f) < TEXTURE_EPS) {
+    // intersect at flat base
+    u = p.x + 0.5f;
+    v = p.z + 0.5f;
+  } else {
+    // intersects at the side
+    u = uvAroundY(p);
+    v = p.y + 0.5f;
+  }
+  return glm::vec2(u * repeatU, v * repeatV);
+}
+
+static glm::vec2 uvMapCylinder(const glm::vec3 &p, float repeatU,
+                               float repeatV) {
+  float u, v;
+  if (glm::abs(p.y - 0.5f) < TEXTURE_EPS) {
+    u = p.x + 0.5f;
+    v = -p.z + 0.5f;
+  } else if (glm::abs(p.y + 0.5f) < TEXTURE_EPS) {
+    u = p.x + 0.5f;
+    v = p.z + 0.5f;
+  } else {
+    // at the side
+    u = uvAroundY(p);
+    v = p.y + 0.5f;
+  }
+  return glm::vec2(u * repeatU, v * repeatV);
+}
+
+static glm::vec2 uvMapSphere(const glm::vec3 &p, float repeatU,
+                             float repeatV) {
+  float u = uvAroundY(p);
+  float phi = glm::asin(p.y / 0.5f);
+  float v = phi / PI + 0.5f;
+  if (v == 0.f || v == 1.f) {
+    // Poles (singularity)
+    u = 0.5f;
+  }
+  return glm::vec2(u * repeatU, v * repeatV);
+}
+
+// ====================== Area Lights =====================
+// source: https://learnopengl.com/Guest-Articles/2022/Area-Lights
+
+static glm::vec3 integrateEdgeVec(const glm::vec3 &v1, const glm::vec3 &v2) {
+  float x = glm::dot(v1, v2);
+  float y = glm::abs(x);
+
+  float a = 0.8543985f + (0.4965155f + 0.0145206f * y) * y;
+  float b = 3.4175940f + (4.1616724f + y) * y;
+  float v = a / b;
+
+  float theta_sintheta =
+      (x > 0.f) ? v
+                : 0.5f * glm::inversesqrt(glm::max(1.f - x * x, 1e-7f)) - v;
+  return glm::cross(v1, v2) * theta_sintheta;
+}
+
+static glm::vec3 evaluateLTC(const glm::vec3 &N, const glm::vec3 &V,
+                             const glm::vec3 &P, glm::mat3 Minv,
+                             const glm::vec3 points[4], bool twoSided) {
+  // construct orthonormal basis around N
+  glm::vec3 T1 = glm::normalize(V - N * glm::dot(V, N));
+  glm::vec3 T2 = glm::cross(N, T1);
+
+  // rotate area light in (T1, T2, N) basis
+  Minv = Minv * glm::transpose(glm::mat3(T1, T2, N));
+
+  // transform polygon from LTC back to origin Do (cosine weighted)
+  glm::vec3 L[4];
+  for (int i = 0; i < 4; i++) {
+    L[i] = glm::normalize(Minv * (points[i] - P));
+  }
+
+  // check if the shading point is behind the light
+  glm::vec3 dir = points[0] - P;
+  glm::vec3 lightNormal =
+      glm::cross(points[1] - points[0], points[3] - points[0]);
+  bool behind = glm::dot(dir, lightNormal) < 0.f;
+
+  // integrate
+  glm::vec3 vsum(0.f);
+  for (int i = 0; i < 4; i++) {
+    vsum += integrateEdgeVec(L[i], L[(i + 1) % 4]);
+  }
+
+  // form factor of the polygon in direction vsum
+  float len = glm::length(vsum);
+  float z = vsum.z / len;
+  if (behind) {
+    z = -z;
+  }
+  glm::vec2 uv = glm::vec2(z * 0.5f + 0.5f, len) * LUT_SCALE + LUT_BIAS;
+
+  // Fetch the form factor for horizon clipping
+  float scale = sampleLTC(LTC2, uv).w;
+  float sum = len * scale;
+  if (!behind && !twoSided) {
+    sum = 0.f;
+  }
+  return glm::vec3(sum);
+}
+
+// ======================= Renderer =======================
+
+/**
+ * @brief Constructs the renderer and its render threads
+ * @param numThreads Number of threads, all hardware threads if <= 0
+ */
+CPURenderer::CPURenderer(int numThreads) : m_pool(numThreads) {}
+
+/**
+ * @brief Applies the latest settings
+ * Mirrors RayMarchRenderer::updateUISettings.
+ */
+void CPURenderer::settingsChanged() {
+  m_twoDSpace = settings.twoDSpace;
+  m_exposure = settings.exposure;
+  m_enableGammaCorrection = settings.enableGammaCorrection;
+  m_enableHDR = settings.enableHDR;
+  m_enableBloom = settings.enableBloom;
+  m_enableSoftShadow = settings.enableSoftShadow;
+  m_enableReflection = settings.enableReflection;
+  m_enableRefraction = settings.enableRefraction;
+  m_enableAmbientOcclusion = settings.enableAmbientOcculusion;
+  m_power = settings.power;
+  m_juliaSeed = settings.juliaSeed;
+  m_idxSkyBox = settings.idxSkyBox;
+}
+
+/**
+ * @brief Drops the state that belongs to the previous scene
+ * - the tile timings of another scene would only mislead the scheduler
+ */
+void CPURenderer::sceneChanged() { m_scheduler.reset(); }
+
+/**
+ * @brief Sets the time that is used as iTime
+ * @param time Time in seconds
+ */
+void CPURenderer::setTime(float time) { m_time = time; }
+
+/**
+ * @brief Sets the instruction set used to march the primary rays
+ * - clamped to what this machine supports
+ * @param level SIMD level (SIMD_SCALAR disables packets)
+ */
+void CPURenderer::setSIMDLevel(SIMDLevel level) {
+  m_simdLevel = std::min(level, PacketMarcher::getSupportedLevel());
+}
+
+/**
+ * @brief Gets the instruction set used to march the primary rays
+ * @returns SIMD level
+ */
+SIMDLevel CPURenderer::getSIMDLevel() const { return m_simdLevel; }
+
+/**
+ * @brief Gets the number of render threads
+ * @returns Number of threads
+ */
+int CPURenderer::getNumThreads() const { return m_pool.getNumThreads(); }
+
+/**
+ * @brief Renders the scene
+ * 1. Raymarch every tile on the thread pool (expensive tiles first)
+ * 2. Apply the light effects (Bloom, HDR, Gamma Correction) if enabled
+ * @param scene Initialized scene
+ * @returns Rendered image (top row first)
+ */
+QImage CPURenderer::render(RayMarchScene &scene) {
+  if (!scene.isInitialized() || scene.m_width <= 0 || scene.m_height <= 0) {
+    return QImage();
+  }
+  prepareFrame(scene);
+
+  // Raymarch
+  int tilesX = (m_width + TILE_SIZE - 1) / TILE_SIZE;
+  int tilesY = (m_height + TILE_SIZE - 1) / TILE_SIZE;
+  m_scheduler.run(
+      m_pool, tilesX * tilesY, [this](int tile) { renderTile(tile); },
+      [this](int tile) { probeTile(tile); });
+
+  // Post processing
+  if (m_enableHDR || m_enableGammaCorrection || m_enableBloom) {
+    applyLightEffects();
+  }
+
+  // Convert to 8 bit (GL origin is bottom left)
+  QImage image(m_width, m_height, QImage::Format_RGBA8888);
+  for (int y = 0; y < m_height; y++) {
+    uchar *row = image.scanLine(m_height - 1 - y);
+    for (int x = 0; x < m_width; x++) {
+      glm::vec3 c = glm::clamp(m_color[y * m_width + x], 0.f, 1.f);
+      row[4 * x + 0] = std::lround(c.r * 255.f);
+      row[4 * x + 1] = std::lround(c.g * 255.f);
+      row[4 * x + 2] = std::lround(c.b * 255.f);
+      row[4 * x + 3] = 255;
+    }
+  }
+  return image;
+}
+
+/**
+ * @brief Copies the scene into the flat arrays used while rendering
+ * Mirrors the configure*Uniforms functions of RayMarchRenderer.
+ * @param scene Scene we are rendering
+ */
+void CPURenderer::prepareFrame(RayMarchScene &scene) {
+  m_width = scene.m_width;
+  m_height = scene.m_height;
+  m_color.assign(m_width * m_height, glm::vec3(0.f));
+  m_bright.assign(m_width * m_height, glm::vec3(0.f));
+
+  // Camera
+  Camera &cam = scene.getCamera();
+  m_invProjViewMatrix =
+      glm::inverse(cam.getProjMatrix() * cam.getViewMatrix());
+  m_far = cam.getFarPlane();
+  // - radius of a pixel per unit of depth (pixelRadius in raymarch.frag)
+  m_pixelRadius = 1.f / (cam.getProjMatrix()[1][1] * m_height);
+
+  // Phong constants
+  m_ka = scene.getGlobalData().ka;
+  m_kd = scene.getGlobalData().kd;
+  m_ks = scene.getGlobalData().ks;
+  m_kt = scene.getGlobalData().kt;
+  // Shader features
+  // - the night sky (it samples the noise texture) and the procedural
+  //   environments are not ported, the night sky falls back to black
+  const SceneShaderFeatures &features = scene.getGlobalData().features;
+  m_background = features.background == BackgroundType::BACKGROUND_WHITE
+                     ? glm::vec3(1.f)
+                     : glm::vec3(0.f);
+  m_skyBackground = features.background == BackgroundType::BACKGROUND_SKY;
+  m_perlinBump = features.perlinBump && settings.enableBumpMap;
+
+  // Shapes
+  auto &textures = scene.getShapesTextures();
+  m_objects.clear();
+  for (const RayMarchObj &obj : scene.getShapes()) {
+    const SceneMaterial &mat = obj.m_material;
+    Object o;
+    o.type = obj.m_type;
+    o.invModelMatrix = obj.m_ctmInv;
+    o.scaleFactor =
+        fmin(obj.m_scale[0][0], fmin(obj.m_scale[1][1], obj.m_scale[2][2]));
+    o.shininess = mat.shininess;
+    o.blend = mat.blend;
+    o.ior = mat.ior;
+    o.cAmbient = mat.cAmbient;
+    o.cDiffuse = mat.cDiffuse;
+    o.cSpecular = mat.cSpecular;
+    o.cReflective = mat.cReflective;
+    o.cTransparent = mat.cTransparent;
+    o.texture = nullptr;
+    if (mat.textureMap.isUsed) {
+      auto it = textures.find(mat.textureMap.filename);
+      if (it != textures.end() && !it->second.data.empty()) {
+        o.texture = &it->second;
+      }
+    }
+    o.repeatU = mat.textureMap.repeatU;
+    o.repeatV = mat.textureMap.repeatV;
+    o.isEmissive = obj.m_isEmissive;
+    o.color = obj.m_color;
+    o.lightIdx = obj.m_lightIdx;
+    m_objects.push_back(o);
+  }
+
+  // Packet mode (only if the kernels know every SDF in the scene)
+  m_packetObjects.clear();
+  m_usePackets = m_simdLevel != SIMDLevel::SIMD_SCALAR && !m_twoDSpace;
+  for (const Object &o : m_objects) {
+    int type = static_cast<int>(o.type);
+    if (!PacketMarcher::isSupported(type)) {
+      m_usePackets = false;
+      break;
+    }
+    PacketMarcher::Object po;
+    po.type = type;
+    const float *m = &o.invModelMatrix[0][0];
+    std::copy(m, m + 16, po.invModelMatrix);
+    po.scaleFactor = o.scaleFactor;
+    m_packetObjects.push_back(po);
+  }
+
+  // Lights
+  m_lights.clear();
+  for (const SceneLightData &light : scene.getLights()) {
+    Light l;
+    l.type = light.type;
+    l.lightColor = light.color;
+    l.lightDir = light.dir;
+    l.lightPos = light.pos;
+    l.lightFunc = light.function;
+    l.lightAngle = light.angle;
+    l.lightPenumbra = light.penumbra;
+    l.intensity = light.intensity;
+    l.twoSided = true;
+    if (light.type == LightType::LIGHT_AREA) {
+      for (int i = 0; i < 4; i++) {
+        l.points[i] = light.ctm * glm::vec4(AREA_LIGHT_CORNERS[i], 1.f);
+      }
+    }
+    if (!LightClusters::getBounds(light, l.boundsCenter, l.boundsRadius)) {
+      l.boundsRadius = -1.f;
+    }
+    m_lights.push_back(l);
+  }
+
+  // Sky box
+  if (m_idxSkyBox != m_loadedSkyBox) {
+    loadSkyBox(scene);
+  }
+}
+
+/**
+ * @brief Loads the cube map faces of the selected sky box
+ * Mirrors RayMarchRenderer::initCubeMap.
+ * @param scene Scene we are rendering
+ */
+void CPURenderer::loadSkyBox(RayMarchScene &scene) {
+  m_cubeMap.clear();
+  m_loadedSkyBox = m_idxSkyBox;
+  if (m_idxSkyBox == CUBEMAP::UNUSED) {
+    return;
+  }
+  std::filesystem::path basepath =
+      std::filesystem::path(settings.sceneFilePath).parent_path().parent_path();
+  for (const std::string &face :
+       scene.getCubeMapWithType(static_cast<CUBEMAP>(m_idxSkyBox))) {
+    QImage myImage;
+    QString str((basepath / face).string().data());
+    if (!myImage.load(str)) {
+      std::cout << "Failed to load in image" << std::endl;
+      m_cubeMap.clear();
+      return;
+    }
+    myImage = myImage.convertToFormat(QImage::Format_RGBA8888).mirrored();
+    TextureInfo info{myImage, {}, myImage.width(), myImage.height()};
+    const uchar *bits = myImage.bits();
+    info.data.reserve(info.width * info.height);
+    for (int i = 0; i < info.width * info.height; i++) {
+      info.data.push_back(
+          RGBA{bits[4 * i], bits[4 * i + 1], bits[4 * i + 2], bits[4 * i + 3]});
+    }
+    m_cubeMap.push_back(std::move(info));
+  }
+}
+
+/**
+ * @brief Renders one tile of the image
+ * Rows are marched in packets when packet mode is available, the remaining
+ * pixels of a row one by one.
+ * @param tile Index of the tile (row major, starting at the bottom left)
+ */
+void CPURenderer::renderTile(int tile) {
+  int tilesX = (m_width + TILE_SIZE - 1) / TILE_SIZE;
+  int x0 = (tile % tilesX) * TILE_SIZE;
+  int y0 = (tile / tilesX) * TILE_SIZE;
+  int x1 = std::min(x0 + TILE_SIZE, m_width);
+  int y1 = std::min(y0 + TILE_SIZE, m_height);
+  int width = m_usePackets ? PacketMarcher::getWidth(m_simdLevel) : 1;
+  for (int y = y0; y < y1; y++) {
+    int x = x0;
+    if (width > 1) {
+      for (; x + width <= x1; x += width) {
+        renderPacket(x, y, width);
+      }
+    }
+    for (; x < x1; x++) {
+      int idx = y * m_width + x;
+      m_color[idx] = renderPixel(x, y, m_bright[idx]);
+    }
+  }
+}
+
+/**
+ * @brief Renders the center pixel of a tile and drops the result
+ * - the time it takes estimates the cost of the tile for the scheduler when
+ *   there are no timings of a previous frame (e.g. the only frame of the CLI)
+ * @param tile Index of the tile
+ */
+void CPURenderer::probeTile(int tile) const {
+  int tilesX = (m_width + TILE_SIZE - 1) / TILE_SIZE;
+  int x0 = (tile % tilesX) * TILE_SIZE;
+  int y0 = (tile / tilesX) * TILE_SIZE;
+  int x = (x0 + std::min(x0 + TILE_SIZE, m_width)) / 2;
+  int y = (y0 + std::min(y0 + TILE_SIZE, m_height)) / 2;
+  glm::vec3 bright;
+  renderPixel(x, y, bright);
+}
+
+/**
+ * @brief Renders width consecutive pixels of a row
+ * The primary rays are marched together by the packet kernel and shaded one
+ * by one afterwards.
+ * @param x,y First pixel in GL window coordinates
+ * @param width Number of pixels (lanes of the packet)
+ */
+void CPURenderer::renderPacket(int x, int y, int width) {
+  PacketMarcher::Packet packet;
+  glm::vec3 ro[PacketMarcher::MAX_WIDTH], rd[PacketMarcher::MAX_WIDTH];
+  for (int i = 0; i < width; i++) {
+    getPrimaryRay(x + i, y, ro[i], rd[i]);
+    packet.ox[i] = ro[i].x;
+    packet.oy[i] = ro[i].y;
+    packet.oz[i] = ro[i].z;
+    packet.dx[i] = rd[i].x;
+    packet.dy[i] = rd[i].y;
+    packet.dz[i] = rd[i].z;
+  }
+  PacketMarcher::Hits hits;
+  PacketMarcher::raymarch(m_simdLevel, m_packetObjects.data(),
+                          m_packetObjects.size(), packet, m_far,
+                          m_pixelRadius, hits);
+  for (int i = 0; i < width; i++) {
+    int idx = y * m_width + x + i;
+    RayMarchRes res{hits.intersectObj[i], hits.d[i], glm::vec4(0.f)};
+    m_color[idx] = shadePixel(ro[i], rd[i], res, m_bright[idx]);
+  }
+}
+
+/**
+ * @brief Gets the primary ray through the center of a pixel
+ * @param x,y Pixel in GL window coordinates (bottom left is 0, 0)
+ * @param ro Ray origin (on the near plane)
+ * @param rd Normalized ray direction
+ */
+void CPURenderer::getPrimaryRay(int x, int y, glm::vec3 &ro,
+                                glm::vec3 &rd) const {
+  // Pixel center in NDC
+  glm::vec2 ndc((x + 0.5f) / m_width * 2.f - 1.f,
+                (y + 0.5f) / m_height * 2.f - 1.f);
+  // - In NDC, all rays intersect at (x, y, -1) and (x, y, 1)
+  glm::vec4 nearClip = m_invProjViewMatrix * glm::vec4(ndc, -1.f, 1.f);
+  glm::vec4 farClip = m_invProjViewMatrix * glm::vec4(ndc, 1.f, 1.f);
+  ro = glm::vec3(nearClip) / nearClip.w;
+  rd = glm::normalize(glm::vec3(farClip) / farClip.w - ro);
+}
+
+/**
+ * @brief Renders a single pixel (main in raymarch.frag)
+ * @param x,y Pixel in GL window coordinates (bottom left is 0, 0)
+ * @param bright Bright color used by Bloom (BrightColor)
+ * @returns Color of the pixel (fragColor)
+ */
+glm::vec3 CPURenderer::renderPixel(int x, int y, glm::vec3 &bright) const {
+  // === 2D Render ===
+  if (m_twoDSpace) {
+    bright = glm::vec3(0.f);
+    glm::vec2 ndc((x + 0.5f) / m_width * 2.f - 1.f,
+                  (y + 0.5f) / m_height * 2.f - 1.f);
+    float scol = CPUSDF::sdMandelBrot(ndc, m_time);
+    return glm::pow(glm::vec3(scol), glm::vec3(0.9f, 1.1f, 1.4f));
+  }
+
+  // === set scene ===
+  glm::vec3 ro, rd;
+  getPrimaryRay(x, y, ro, rd);
+  return shadePixel(ro, rd, raymarch(ro, rd, m_far, OUTSIDE), bright);
+}
+
+/**
+ * @brief Shades a pixel given the result of its primary ray
+ * @param ro Primary ray origin
+ * @param rd Primary ray direction
+ * @param primary Result of marching the primary ray
+ * @param bright Bright color used by Bloom (BrightColor)
+ * @returns Color of the pixel (fragColor)
+ */
+glm::vec3 CPURenderer::shadePixel(const glm::vec3 &ro, const glm::vec3 &rd,
+                                  const RayMarchRes &primary,
+                                  glm::vec3 &bright) const {
+  bright = glm::vec3(0.f);
+  const glm::vec3 bgCol = m_skyBackground ? getSky(rd) : m_background;
+  float far = m_far;
+
+  // === Main render ===
+  IntersectionInfo info;
+  RenderInfo ri = shade(ro, rd, primary, info, far, bgCol);
+  if (ri.isEnv) {
+    // NO HIT
+    return ri.color;
+  }
+  glm::vec3 col = ri.color;
+  if (info.intersectObj == -1) {
+    // Area light (emissive) hit
+    if (glm::dot(col, BRIGHT_FILTER) > 1.f) {
+      bright = col;
+    }
+    return col;
+  }
+
+  // =================== Refl && Refr =====================
+  IntersectionInfo oi = info;
+  const Object &obj = m_objects[info.intersectObj];
+  if (m_enableReflection && glm::length(obj.cReflective) != 0.f) {
+    glm::vec3 fil(1.f);
+    // - fil keeps track of the accumulated material reflectivity
+    for (int i = 0; i < NUM_REFLECTION; i++) {
+      // Reflect ray
+      glm::vec3 r = glm::reflect(info.rd, info.n);
+      glm::vec3 shiftedRO = info.p + r * SURFACE_DIST * 3.f;
+      fil *= obj.cReflective;
+      // Render the reflected ray
+      RenderInfo res = render(shiftedRO, r, info, OUTSIDE, far, bgCol);
+      col += m_ks * fil * res.color;
+      if (res.isEnv || info.intersectObj == -1) {
+        break;
+      }
+    }
+  }
+
+  if (m_enableRefraction && glm::length(obj.cTransparent) != 0.f) {
+    // Two hardcoded refractions, same as the shader
+    float ior = obj.ior;
+    glm::vec3 ct = obj.cTransparent;
+
+    // Air -> Medium
+    glm::vec3 rdIn = glm::refract(oi.rd, oi.n, 1.f / ior);
+    glm::vec3 pEnter = oi.p - oi.n * SURFACE_DIST * 3.f;
+    float dIn = raymarch(pEnter, rdIn, far, INSIDE).d;
+
+    glm::vec3 pExit = pEnter + rdIn * dIn;
+    glm::vec3 nExit = -getNormal(pExit);
+
+    glm::vec3 rdOut = glm::refract(rdIn, nExit, ior);
+    if (glm::length(rdOut) != 0.f) {
+      // Not a Total Internal Reflection
+      glm::vec3 shiftedRO = pExit - nExit * SURFACE_DIST * 5.f;
+      RenderInfo res = render(shiftedRO, rdOut, info, OUTSIDE, far, bgCol);
+      col += m_kt * ct * res.color;
+    }
+  }
+
+  if (glm::dot(col, BRIGHT_FILTER) > 1.f) {
+    bright = col;
+  }
+  return col;
+}
+
+/**
+ * @brief Applies Bloom with a mip chain of the bright colors
+ * Mirrors RayMarchRenderer::applyBloom (bloom.frag, 13 tap downsample and
+ * tent upsample with GL_LINEAR and GL_CLAMP_TO_EDGE). The result, scaled
+ * like bloomScale of post.frag, is left in m_bright.
+ */
+void CPURenderer::applyBloom() {
+  std::vector<std::vector<glm::vec3>> mips;
+  std::vector<glm::ivec2> sizes;
+  glm::ivec2 size(m_width, m_height);
+  while ((int)mips.size() < BLOOM_MAX_MIPS) {
+    const std::vector<glm::vec3> &src = mips.empty() ? m_bright : mips.back();
+    glm::ivec2 srcSize = size;
+    glm::vec2 texel = 1.f / glm::vec2(srcSize);
+    size = glm::max(size / 2, 1);
+    std::vector<glm::vec3> mip(size.x * size.y);
+    m_pool.parallelFor(size.y, [&](int y) {
+      for (int x = 0; x < size.x; x++) {
+        glm::vec2 uv = (glm::vec2(x, y) + 0.5f) / glm::vec2(size);
+        auto tap = [&](float dx, float dy) {
+          return sampleMip(src, srcSize, uv + glm::vec2(dx, dy) * texel);
+        };
+        glm::vec3 corners =
+            tap(-2, 2) + tap(2, 2) + tap(-2, -2) + tap(2, -2);
+        glm::vec3 edges = tap(0, 2) + tap(-2, 0) + tap(2, 0) + tap(0, -2);
+        glm::vec3 inner = tap(-1, 1) + tap(1, 1) + tap(-1, -1) + tap(1, -1);
+        mip[y * size.x + x] = tap(0, 0) * 0.125f + corners * 0.03125f +
+                              edges * 0.0625f + inner * 0.125f;
+      }
+    });
+    mips.push_back(std::move(mip));
+    sizes.push_back(size);
+    if (size.y <= BLOOM_MIN_HEIGHT) {
+      break;
+    }
+  }
+  // Add every level onto the next larger one
+  for (int i = mips.size() - 1; i > 0; i--) {
+    const std::vector<glm::vec3> &src = mips[i];
+    std::vector<glm::vec3> &dst = mips[i - 1];
+    glm::ivec2 srcSize = sizes[i], dstSize = sizes[i - 1];
+    glm::vec2 texel = 1.f / glm::vec2(srcSize);
+    m_pool.parallelFor(dstSize.y, [&](int y) {
+      for (int x = 0; x < dstSize.x; x++) {
+        glm::vec2 uv = (glm::vec2(x, y) + 0.5f) / glm::vec2(dstSize);
+        auto tap = [&](float dx, float dy) {
+          return sampleMip(src, srcSize, uv + glm::vec2(dx, dy) * texel);
+        };
+        glm::vec3 tent = tap(0, 0) * 4.f +
+                         (tap(0, 1) + tap(-1, 0) + tap(1, 0) + tap(0, -1)) *
+                             2.f +
+                         tap(-1, 1) + tap(1, 1) + tap(-1, -1) + tap(1, -1);
+        dst[y * dstSize.x + x] += tent / 16.f;
+      }
+    });
+  }
+  // Level 0 at the pixels of the frame
+  float scale = 1.f / mips.size();
+  m_pool.parallelFor(m_height, [&](int y) {
+    for (int x = 0; x < m_width; x++) {
+      glm::vec2 uv = (glm::vec2(x, y) + 0.5f) / glm::vec2(m_width, m_height);
+      m_bright[y * m_width + x] = sampleMip(mips[0], sizes[0], uv) * scale;
+    }
+  });
+}
+
+/**
+ * @brief Applies HDR, Bloom, or Gamma Correction (post.frag)
+ */
+void CPURenderer::applyLightEffects() {
+  if (m_enableBloom) {
+    applyBloom();
+  }
+  m_pool.parallelFor(m_height, [this](int y) {
+    for (int x = 0; x < m_width; x++) {
+      glm::vec3 &c = m_color[y * m_width + x];
+      if (!m_enableHDR && !m_enableBloom) {
+        // 1. Gamma Correction
+        c = glm::pow(glm::max(c, 0.f), glm::vec3(1.f / GAMMA));
+        continue;
+      }
+      if (m_enableBloom) {
+        // 3. Bloom
+        c += m_bright[y * m_width + x];
+      }
+      // 2. / 3. tone mapping
+      c = glm::vec3(1.f) - glm::exp(-c * m_exposure);
+    }
+  });
+}
+
+// ================ Raymarch Algorithm ==================
+
+/**
+ * @brief Invokes the SDF of the given type
+ * @param p Point in object space
+ * @param type Type of the object
+ * @param trap Orbit trap (only written by fractals)
+ * @param footprint Pixel footprint in object space (0 for full detail)
+ */
+float CPURenderer::sdMatch(const glm::vec3 &p, PrimitiveType type,
+                           glm::vec4 &trap, float footprint) const {
+  switch (type) {
+  case PrimitiveType::PRIMITIVE_CUBE:
+    return CPUSDF::sdBox(p, glm::vec3(0.5f));
+  case PrimitiveType::PRIMITIVE_CONE:
+    return CPUSDF::sdCone(p, 0.5f, 0.5f);
+  case PrimitiveType::PRIMITIVE_CYLINDER:
+    return CPUSDF::sdCylinder(p, 0.5f, 0.5f);
+  case PrimitiveType::PRIMITIVE_SPHERE:
+    return CPUSDF::sdSphere(p, 0.5f);
+  case PrimitiveType::PRIMITIVE_OCTAHEDRON:
+    return CPUSDF::sdOctahedron(p, 0.5f);
+  case PrimitiveType::PRIMITIVE_TORUS:
+    return CPUSDF::sdTorus(p, glm::vec2(0.5f, 0.5f / 4));
+  case PrimitiveType::PRIMITIVE_CAPSULE:
+    return CPUSDF::sdCapsule(p, 0.5f, 0.1f);
+  case PrimitiveType::PRIMITIVE_DEATHSTAR:
+    return CPUSDF::sdDeathStar(p, 0.5f, 0.35f, 0.5f);
+  case PrimitiveType::PRIMITIVE_RECTANGLE:
+    return CPUSDF::sdBox(p, glm::vec3(0.5f, 0.5f, 0.f));
+  case PrimitiveType::MANDELBROT:
+    return CPUSDF::sdMandelBrot(glm::vec2(p), m_time);
+  case PrimitiveType::MANDELBULB:
+    return CPUSDF::sdMandelBulb(p, m_power, m_juliaSeed, trap, footprint);
+  case PrimitiveType::MENGERSPONGE:
+    return CPUSDF::sdMengerSponge(p, m_time, trap);
+  case PrimitiveType::SIERPINSKI:
+    return CPUSDF::sdSierpinski(p, footprint);
+  default:
+    // - sdCUSTOM is a per-scene stub in the shader
+    return 1000000.f;
+  }
+}
+
+/**
+ * @brief Union of all the SDFs in the scene
+ * @param p Current raymarching point (world space)
+ * @param footprint Pixel footprint at p (0 for full detail)
+ * @returns SceneMin struct with closest distance and closest object
+ */
+CPURenderer::SceneMin CPURenderer::sdScene(const glm::vec3 &p,
+                                           float footprint) const {
+  SceneMin res{-1, 1000000.f, glm::vec4(0.f)};
+  glm::vec4 trapCol(0.f);
+  for (int i = 0; i < (int)m_objects.size(); i++) {
+    const Object &obj = m_objects[i];
+    // Conv to Object space
+    glm::vec3 po = glm::vec3(obj.invModelMatrix * glm::vec4(p, 1.f));
+    // Get the distance to the object
+    float currD =
+        sdMatch(po, obj.type, trapCol, footprint / obj.scaleFactor) *
+        obj.scaleFactor;
+    if (currD < res.minD) {
+      // Update if we found a closer object
+      res.minD = currD;
+      res.minObjIdx = i;
+      res.trap = trapCol;
+    }
+  }
+  return res;
+}
+
+/**
+ * @brief Given intersection point, get the normal
+ * - https://iquilezles.org/articles/normalsSDF
+ * @param p Intersection point
+ * @returns normalized intersection point normal
+ */
+glm::vec3 CPURenderer::getNormal(const glm::vec3 &p) const {
+  const float h = 0.5773f * 0.0005f;
+  const glm::vec3 xyy(h, -h, -h), yyx(-h, -h, h), yxy(-h, h, -h), xxx(h);
+  return glm::normalize(xyy * sdScene(p + xyy).minD +
+                        yyx * sdScene(p + yyx).minD +
+                        yxy * sdScene(p + yxy).minD +
+                        xxx * sdScene(p + xxx).minD);
+}
+
+/**
+ * @brief Performs raymarching
+ * - a point is a hit once it is closer to a surface than the radius of the
+ *   pixel cone there, and the fractals are evaluated with fewer iterations
+ *   (see PIXEL_FOOTPRINT in raymarch.frag)
+ * @param ro Ray origin
+ * @param rd Ray direction
+ * @param end Far plane
+ * @param side Determines if we are inside or outside the object
+ * @returns Result of raymarching
+ */
+CPURenderer::RayMarchRes CPURenderer::raymarch(const glm::vec3 &ro,
+                                               const glm::vec3 &rd, float end,
+                                               float side) const {
+  float rayDepth = 0.f;
+  SceneMin closest{-1, 1000000.f, glm::vec4(0.f)};
+  float hitDist = SURFACE_DIST;
+  // Start the march
+  for (int i = 0; i < MAX_STEPS; i++) {
+    float footprint = m_pixelRadius * rayDepth;
+    hitDist = glm::max(SURFACE_DIST, footprint);
+    // Find the closest object in the scene
+    closest = sdScene(ro + rd * rayDepth, footprint);
+    if (glm::abs(closest.minD) < hitDist || rayDepth > end) {
+      // If hit or exceed the far plane, break
+      break;
+    }
+    // March the ray
+    rayDepth += closest.minD * side;
+  }
+  if (glm::abs(closest.minD) < hitDist) {
+    // HIT
+    return {closest.minObjIdx, rayDepth - closest.minD, closest.trap};
+  }
+  // NO HIT
+  return {-1, rayDepth, glm::vec4(0.f)};
+}
+
+/**
+ * @brief Computes the shadow scale for soft shadow
+ * - https://iquilezles.org/articles/rmshadows/
+ * @param ro Ray origin
+ * @param rd Ray direction
+ * @param mint Start t
+ * @param maxt End t
+ * @param k How "hard" we want the shadow to be
+ * @returns Result of raymarching, d holds the shadow scale
+ */
+CPURenderer::RayMarchRes CPURenderer::softshadow(const glm::vec3 &ro,
+                                                 const glm::vec3 &rd,
+                                                 float mint, float maxt,
+                                                 float k) const {
+  float res = 1.f;
+  float rayDepth = mint;
+  SceneMin closest{-1, 1000000.f, glm::vec4(0.f)};
+  for (int i = 0; i < MAX_STEPS; i++) {
+    closest = sdScene(ro + rd * rayDepth);
+    if (glm::abs(closest.minD) < SURFACE_DIST || rayDepth > maxt) {
+      break;
+    }
+    res = glm::min(res, k * closest.minD / rayDepth);
+    // March the ray
+    rayDepth += glm::abs(closest.minD);
+  }
+  if (glm::abs(closest.minD) < SURFACE_DIST) {
+    // HIT
+    return {closest.minObjIdx, res, closest.trap};
+  }
+  // NO HIT
+  // - the shader leaves d unset here and the compiler forwards res
+  return {-1, res, glm::vec4(0.f)};
+}
+
+/**
+ * @brief Calculate the ambient occlusion
+ * - https://iquilezles.org/articles/nvscene2008/rwwtt.pdf
+ */
+float CPURenderer::calcAO(const glm::vec3 &pos, const glm::vec3 &nor) const {
+  float occ = 0.f;
+  float sca = 1.f;
+  for (int i = 0; i < 5; i++) {
+    float h = 0.01f + 0.12f * float(i) / 4.f;
+    float d = sdScene(pos + h * nor).minD;
+    occ += (h - d) * sca;
+    sca *= 0.95f;
+    if (occ > 0.35f) {
+      break;
+    }
+  }
+  return glm::clamp(1.f - 3.f * occ, 0.f, 1.f) * (0.5f + 0.5f * nor.y);
+}
+
+/**
+ * @brief Raymarches a ray and shades the hit point (render in raymarch.frag)
+ * @param ro Ray origin
+ * @param rd Ray direction
+ * @param i IntersectionInfo we are populating
+ * @param side Determines if we are inside or outside of an object
+ * @param maxT Far plane
+ * @param bgCol Background color
+ */
+CPURenderer::RenderInfo CPURenderer::render(const glm::vec3 &ro,
+                                            const glm::vec3 &rd,
+                                            IntersectionInfo &i, float side,
+                                            float maxT,
+                                            const glm::vec3 &bgCol) const {
+  // Raymarching
+  return shade(ro, rd, raymarch(ro, rd, maxT, side), i, maxT, bgCol);
+}
+
+/**
+ * @brief Shades the result of a raymarch
+ * @param ro Ray origin
+ * @param rd Ray direction
+ * @param res Result of raymarching the ray
+ * @param i IntersectionInfo we are populating
+ * @param maxT Far plane
+ * @param bgCol Background color
+ */
+CPURenderer::RenderInfo CPURenderer::shade(const glm::vec3 &ro,
+                                           const glm::vec3 &rd,
+                                           const RayMarchRes &res,
+                                           IntersectionInfo &i, float maxT,
+                                           const glm::vec3 &bgCol) const {
+  i.intersectObj = -1;
+  if (res.intersectObj == -1) {
+    // NO HIT
+    glm::vec3 col = bgCol;
+    // If no hit but sky box is used, sample
+    if (!m_cubeMap.empty()) {
+      col = sampleSkyBox(rd);
+    }
+    return {col, maxT, true, false};
+  }
+
+  // HIT
+  glm::vec3 p = ro + rd * res.d;
+  glm::vec3 pn = getNormal(p);
+  if (m_perlinBump) {
+    pn = bumpNormal(pn, p, BUMP_SCALE, BUMP_INTENSITY);
+  }
+
+  const Object &obj = m_objects[res.intersectObj];
+  if (obj.isEmissive) {
+    // Area Light
+    return {obj.color, res.d, false, true};
+  }
+
+  glm::vec3 col;
+  if (obj.type == PrimitiveType::MANDELBULB) {
+    // Orbit Trap to color
+    col = glm::vec3(0.2f);
+    col = glm::mix(col, glm::vec3(0.10f, 0.20f, 0.30f),
+                   glm::clamp(res.trap.y, 0.f, 1.f));
+    col = glm::mix(col, glm::vec3(0.02f, 0.10f, 0.30f),
+                   glm::clamp(res.trap.z * res.trap.z, 0.f, 1.f));
+    col = glm::mix(col, glm::vec3(0.30f, 0.10f, 0.02f),
+                   glm::clamp(glm::pow(res.trap.w, 6.f), 0.f, 1.f));
+    col *= 0.5f;
+    col *= getPhong(pn, res.intersectObj, p, rd, maxT) * 8.f;
+  } else if (obj.type == PrimitiveType::MENGERSPONGE) {
+    // Orbit Trap to color
+    col = 0.5f + 0.5f * glm::cos(glm::vec3(0, 1, 2) + 2.f * res.trap.z);
+    col *= getPhong(pn, res.intersectObj, p, rd, maxT);
+  } else {
+    col = getPhong(pn, res.intersectObj, p, rd, maxT);
+  }
+  // set output variable
+  i.p = p;
+  i.n = pn;
+  i.rd = rd;
+  i.intersectObj = res.intersectObj;
+  return {col, res.d, false, false};
+}
+
+// ================== Phong Total Illumination =================
+
+/**
+ * @brief Gets the diffuse term
+ * @param p Intersection Point in world space
+ * @param obj Intersected object
+ */
+glm::vec3 CPURenderer::getDiffuse(const glm::vec3 &p, const Object &obj) const {
+  if (!obj.texture) {
+    // No texture used
+    return m_kd * obj.cDiffuse;
+  }
+  // Texture used -> find uv
+  glm::vec2 uv;
+  glm::vec3 po = glm::vec3(obj.invModelMatrix * glm::vec4(p, 1.f));
+  switch (obj.type) {
+  case PrimitiveType::PRIMITIVE_CUBE:
+    uv = uvMapCube(po, obj.repeatU, obj.repeatV);
+    break;
+  case PrimitiveType::PRIMITIVE_CONE:
+    uv = uvMapCone(po, obj.repeatU, obj.repeatV);
+    break;
+  case PrimitiveType::PRIMITIVE_CYLINDER:
+    uv = uvMapCylinder(po, obj.repeatU, obj.repeatV);
+    break;
+  case PrimitiveType::PRIMITIVE_SPHERE:
+    uv = uvMapSphere(po, obj.repeatU, obj.repeatV);
+    break;
+  default:
+    // - tri-planar mapping is only defined for custom textures
+    return m_kd * obj.cDiffuse;
+  }
+  glm::vec3 texVal = sampleTexture(*obj.texture, uv, true);
+  // Linear interpolate
+  return (1.f - obj.blend) * m_kd * obj.cDiffuse + obj.blend * texVal;
+}
+
+/**
+ * @brief Gets the contribution of an area light (LTC)
+ */
+glm::vec3 CPURenderer::getAreaLight(const glm::vec3 &N, const glm::vec3 &V,
+                                    const glm::vec3 &P, int lightIdx,
+                                    const Object &obj) const {
+  float dotNV = glm::clamp(glm::dot(N, V), 0.f, 1.f);
+  // use roughness and sqrt(1-cos_theta) to sample M_texture
+  glm::vec2 uv =
+      glm::vec2(0.f, glm::sqrt(1.f - dotNV)) * LUT_SCALE + LUT_BIAS;
+  // get 4 parameters for inverse_M
+  glm::vec4 t1 = sampleLTC(LTC1, uv);
+  // Get 2 parameters for Fresnel calculation
+  glm::vec4 t2 = sampleLTC(LTC2, uv);
+  glm::mat3 Minv(glm::vec3(t1.x, 0, t1.y), glm::vec3(0, 1, 0),
+                 glm::vec3(t1.z, 0, t1.w));
+
+  const Light &areaLight = m_lights[lightIdx];
+  // Evaluate LTC shading
+  glm::vec3 diffuse = evaluateLTC(N, V, P, glm::mat3(1.f), areaLight.points,
+                                  areaLight.twoSided);
+  glm::vec3 specular =
+      evaluateLTC(N, V, P, Minv, areaLight.points, areaLight.twoSided);
+  // GGX BRDF shadowing and Fresnel
+  specular *=
+      obj.cSpecular * t2.x + (areaLight.intensity - obj.cSpecular) * t2.y;
+  return areaLight.lightColor * (specular + getDiffuse(P, obj) * diffuse);
+}
+
+/**
+ * @brief Gets the angular falloff term given light direction
+ */
+float CPURenderer::angularFalloff(const glm::vec3 &L,
+                                  const Light &light) const {
+  float cosalpha = glm::dot(-glm::normalize(light.lightDir), L);
+  float inner = light.lightAngle - light.lightPenumbra;
+  if (cosalpha <= glm::cos(light.lightAngle)) {
+    return 0.f;
+  } else if (cosalpha > glm::cos(inner)) {
+    return 1.f;
+  }
+  float t = (glm::acos(cosalpha) - inner) / (light.lightAngle - inner);
+  return 1.f - (-2 * glm::pow(t, 3.f) + 3 * glm::pow(t, 2.f));
+}
+
+/**
+ * @brief Gets Phong Light
+ * @param N normal
+ * @param intersectObj Id of the intersected object
+ * @param p Intersection point
+ * @param rd Ray direction
+ * @param far Far plane (shadow ray length of directional lights)
+ * @returns phong color
+ */
+glm::vec3 CPURenderer::getPhong(const glm::vec3 &N, int intersectObj,
+                                const glm::vec3 &p, const glm::vec3 &rd,
+                                float far) const {
+  const Object &obj = m_objects[intersectObj];
+  glm::vec3 total(0.f);
+
+  // Ambience
+  float ao = 1.f;
+  if (m_enableAmbientOcclusion) {
+    ao = calcAO(p, N);
+  }
+  total += obj.cAmbient * m_ka * ao;
+
+  glm::vec3 V = glm::normalize(-rd);
+  glm::vec3 shadowRO = p + N * SURFACE_DIST * 5.f;
+  // Loop Lights
+  // - skips the lights that are out of range, like the clusters of the
+  //   shader
+  for (int i = 0; i < (int)m_lights.size(); i++) {
+    const Light &li = m_lights[i];
+    if (li.boundsRadius >= 0.f &&
+        glm::distance(p, li.boundsCenter) > li.boundsRadius) {
+      continue;
+    }
+    float fAtt = 1.f, aFall = 1.f;
+    float d = glm::length(p - li.lightPos);
+    glm::vec3 currColor(0.f), L(0.f);
+    float maxT = far;
+    if (li.type == LightType::LIGHT_POINT) {
+      L = glm::normalize(li.lightPos - p);
+      fAtt = glm::min(1.f / (li.lightFunc[0] + d * li.lightFunc[1] +
+                             d * d * li.lightFunc[2]),
+                      1.f);
+      maxT = d;
+    } else if (li.type == LightType::LIGHT_DIRECTIONAL) {
+      L = glm::normalize(-li.lightDir);
+    } else if (li.type == LightType::LIGHT_SPOT) {
+      L = glm::normalize(li.lightPos - p);
+      fAtt = glm::min(1.f / (li.lightFunc[0] + d * li.lightFunc[1] +
+                             d * d * li.lightFunc[2]),
+                      1.f);
+      maxT = d;
+      aFall = angularFalloff(L, li);
+    }
+
+    if (li.type == LightType::LIGHT_AREA) {
+      // Area Light Calculation
+      glm::vec3 areaColor(0.f);
+      glm::vec3 side1 = li.points[1] - li.points[0];
+      glm::vec3 side2 = li.points[3] - li.points[0];
+      for (int idx = 0; idx < AREA_LIGHT_SAMPLES; idx++) {
+        // Sample a point and cast a shadow ray towards it
+        glm::vec3 randomP = li.points[0] + (rd.x + idx) * side1 +
+                            (rd.y + idx) * side2;
+        L = glm::normalize(randomP - p);
+        if (glm::dot(N, L) <= 0.005f) {
+          continue;
+        }
+        maxT = glm::length(randomP - p);
+        // Check for shadow
+        RayMarchRes res = softshadow(shadowRO, L, 0, maxT, 8);
+        if (res.intersectObj != -1 &&
+            m_objects[res.intersectObj].lightIdx != i) {
+          // Shadow Ray intersected an object that is not this light
+          continue;
+        }
+        // calculate light contribution
+        areaColor += getAreaLight(N, V, p, i, obj);
+      }
+      total += areaColor / float(AREA_LIGHT_SAMPLES);
+      continue;
+    }
+
+    // Shadow
+    RayMarchRes res = softshadow(shadowRO, L, 0, maxT, 8);
+    if (res.intersectObj != -1) {
+      // shadow ray intersect
+      continue;
+    }
+    // Diffuse
+    float NdotL = glm::dot(N, L);
+    if (NdotL <= 0.005f) {
+      // pointing away
+      continue;
+    }
+    NdotL = glm::clamp(NdotL, 0.f, 1.f);
+    currColor += getDiffuse(p, obj) * NdotL * li.lightColor;
+    // Specular
+    glm::vec3 R = glm::reflect(-L, N);
+    float RdotV = glm::clamp(glm::dot(R, V), 0.f, 1.f);
+    float spec = obj.shininess == 0 ? RdotV : glm::pow(RdotV, obj.shininess);
+    currColor += m_ks * spec * obj.cSpecular * li.lightColor;
+    // Add the light source's contribution
+    currColor *= fAtt * aFall;
+    if (m_enableSoftShadow) {
+      currColor *= res.d;
+    }
+    total += currColor;
+  }
+  return total;
+}
+
+/**
+ * @brief Samples the sky box cube map (GL cube map face selection)
+ * @param dir Direction
+ */
+glm::vec3 CPURenderer::sampleSkyBox(const glm::vec3 &dir) const {
+  glm::vec3 a = glm::abs(dir);
+  int face;
+  float sc, tc, ma;
+  if (a.x >= a.y && a.x >= a.z) {
+    face = dir.x > 0 ? 0 : 1;
+    sc = dir.x > 0 ? -dir.z : dir.z;
+    tc = -dir.y;
+    ma = a.x;
+  } else if (a.y >= a.z) {
+    face = dir.y > 0 ? 2 : 3;
+    sc = dir.x;
+    tc = dir.y > 0 ? dir.z : -dir.z;
+    ma = a.y;
+  } else {
+    face = dir.z > 0 ? 4 : 5;
+    sc = dir.z > 0 ? dir.x : -dir.x;
+    tc = -dir.y;
+    ma = a.z;
+  }
+  glm::vec2 uv((sc / ma + 1.f) * 0.5f, (tc / ma + 1.f) * 0.5f);
+  return sampleTexture(m_cubeMap[face], uv, false);
+}
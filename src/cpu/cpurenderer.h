@@ -0,0 +1,229 @@
+#ifndef CPURENDERER_H
+#define CPURENDERER_H
+
+#include "cpu/packetmarcher.h"
+#include "cpu/threadpool.h"
+#include "cpu/tilescheduler.h"
+#include "raymarch/raymarchscene.h"
+#include <QImage>
+#include <glm/glm.hpp>
+
+class CPURenderer {
+  // Multithreaded CPU port of resources/raymarch.frag followed by the light
+  // effects pass (bloom.frag, post.frag). It consumes the same RayMarchScene
+  // as RayMarchRenderer, so it runs on machines without a GPU and doubles as
+  // a reference for the shader.
+  // - the image is split into tiles that are rendered on a thread pool with
+  //   work stealing (see TileScheduler)
+  // - primary rays are marched in SSE4/AVX2 packets when the scene only has
+  //   primitives (see PacketMarcher)
+  // - FXAA is not ported (compare against the GPU path with FXAA off)
+
+public:
+  // PUBLIC METHODS
+
+  // Cstr
+  // - numThreads <= 0 uses all hardware threads
+  explicit CPURenderer(int numThreads = 0);
+
+  // Applies the latest settings
+  void settingsChanged();
+  // Drops per-scene state (tile timings) after a new scene was loaded
+  void sceneChanged();
+  // Sets the time (in seconds) that is used as iTime
+  void setTime(float time);
+  // Renders the scene at scene.m_width x scene.m_height (top row first)
+  QImage render(RayMarchScene &scene);
+
+  // Sets / gets the instruction set used to march the primary rays
+  // - defaults to the best supported one
+  void setSIMDLevel(SIMDLevel level);
+  SIMDLevel getSIMDLevel() const;
+
+  // Gets the number of render threads
+  int getNumThreads() const;
+
+private:
+  // PRIVATE TYPES
+
+  // Mirror of the RayMarchObject uniform struct
+  struct Object {
+    PrimitiveType type;
+    glm::mat4 invModelMatrix;
+    float scaleFactor;
+    // Material
+    float shininess;
+    float blend;
+    float ior;
+    glm::vec3 cAmbient;
+    glm::vec3 cDiffuse;
+    glm::vec3 cSpecular;
+    glm::vec3 cReflective;
+    glm::vec3 cTransparent;
+    // - nullptr if not used
+    const TextureInfo *texture;
+    float repeatU;
+    float repeatV;
+    // Area Light
+    bool isEmissive;
+    glm::vec3 color;
+    int lightIdx;
+  };
+
+  // Mirror of the LightSource uniform struct
+  struct Light {
+    LightType type;
+    glm::vec3 lightColor;
+    glm::vec3 lightDir;
+    glm::vec3 lightPos;
+    glm::vec3 lightFunc;
+    float lightAngle;
+    float lightPenumbra;
+    // Area Light
+    glm::vec3 points[4];
+    float intensity;
+    bool twoSided;
+    // Bounding sphere (radius < 0 if unbounded, see LightClusters::getBounds)
+    glm::vec3 boundsCenter;
+    float boundsRadius;
+  };
+
+  // Result of sdScene
+  struct SceneMin {
+    int minObjIdx;
+    float minD;
+    glm::vec4 trap;
+  };
+
+  // Result of a single raymarch
+  struct RayMarchRes {
+    int intersectObj;
+    float d;
+    glm::vec4 trap;
+  };
+
+  // Intersection information for secondary rays
+  struct IntersectionInfo {
+    glm::vec3 rd;
+    glm::vec3 p;
+    glm::vec3 n;
+    int intersectObj;
+  };
+
+  // Render results
+  struct RenderInfo {
+    glm::vec3 color;
+    float d;
+    bool isEnv;
+    bool isAL;
+  };
+
+  // PRIVATE METHODS
+
+  // Copies the scene into the flat arrays used while rendering
+  void prepareFrame(RayMarchScene &scene);
+  // Loads the cube map faces of the selected sky box
+  void loadSkyBox(RayMarchScene &scene);
+  // Renders one tile of the image
+  void renderTile(int tile);
+  // Renders the center pixel of a tile to estimate its cost
+  void probeTile(int tile) const;
+  // Renders width pixels of a row with one ray packet
+  void renderPacket(int x, int y, int width);
+  // Gets the primary ray of a pixel
+  void getPrimaryRay(int x, int y, glm::vec3 &ro, glm::vec3 &rd) const;
+  // Renders a single pixel (GL window coordinates)
+  glm::vec3 renderPixel(int x, int y, glm::vec3 &bright) const;
+  // Shades a pixel given the result of its primary ray
+  glm::vec3 shadePixel(const glm::vec3 &ro, const glm::vec3 &rd,
+                       const RayMarchRes &primary, glm::vec3 &bright) const;
+
+  // Applies Bloom (mip chain of the bright colors)
+  void applyBloom();
+  // Applies HDR, Bloom or Gamma Correction
+  void applyLightEffects();
+
+  // Raymarching
+  // - footprint is the pixel footprint, 0 outside of raymarch
+  float sdMatch(const glm::vec3 &p, PrimitiveType type, glm::vec4 &trap,
+                float footprint = 0.f) const;
+  SceneMin sdScene(const glm::vec3 &p, float footprint = 0.f) const;
+  glm::vec3 getNormal(const glm::vec3 &p) const;
+  RayMarchRes raymarch(const glm::vec3 &ro, const glm::vec3 &rd, float end,
+                       float side) const;
+  RayMarchRes softshadow(const glm::vec3 &ro, const glm::vec3 &rd, float mint,
+                         float maxt, float k) const;
+  float calcAO(const glm::vec3 &pos, const glm::vec3 &nor) const;
+  RenderInfo render(const glm::vec3 &ro, const glm::vec3 &rd,
+                    IntersectionInfo &i, float side, float maxT,
+                    const glm::vec3 &bgCol) const;
+  RenderInfo shade(const glm::vec3 &ro, const glm::vec3 &rd,
+                   const RayMarchRes &res, IntersectionInfo &i, float maxT,
+                   const glm::vec3 &bgCol) const;
+
+  // Shading
+  glm::vec3 getPhong(const glm::vec3 &N, int intersectObj, const glm::vec3 &p,
+                     const glm::vec3 &rd, float far) const;
+  glm::vec3 getDiffuse(const glm::vec3 &p, const Object &obj) const;
+  glm::vec3 getAreaLight(const glm::vec3 &N, const glm::vec3 &V,
+                         const glm::vec3 &P, int lightIdx,
+                         const Object &obj) const;
+  float angularFalloff(const glm::vec3 &L, const Light &light) const;
+  glm::vec3 sampleSkyBox(const glm::vec3 &dir) const;
+
+private:
+  // PRIVATE DATA
+
+  // Render threads
+  ThreadPool m_pool;
+  // Orders and distributes the tiles over m_pool
+  TileScheduler m_scheduler;
+
+  // Instruction set of the packet kernels
+  SIMDLevel m_simdLevel = PacketMarcher::getSupportedLevel();
+
+  // Time fed to the time dependent SDFs (iTime)
+  float m_time = 0.f;
+
+  // Frame data (read-only while the tiles are rendered)
+  std::vector<Object> m_objects;
+  std::vector<Light> m_lights;
+  std::vector<PacketMarcher::Object> m_packetObjects;
+  bool m_usePackets = false;
+  float m_ka, m_kd, m_ks, m_kt;
+  // - shader features of the scene (see SceneShaderFeatures)
+  glm::vec3 m_background = glm::vec3(1.f);
+  // - true if the background is the sky of the primary ray instead
+  bool m_skyBackground = false;
+  bool m_perlinBump = true;
+  glm::mat4 m_invProjViewMatrix;
+  // - radius of a pixel per unit of depth
+  float m_pixelRadius = 0.f;
+  float m_far;
+  int m_width = 0;
+  int m_height = 0;
+
+  // Frame buffers (GL window coordinates, bottom row first)
+  std::vector<glm::vec3> m_color;
+  std::vector<glm::vec3> m_bright;
+
+  // Sky box faces (+x, -x, +y, -y, +z, -z)
+  std::vector<TextureInfo> m_cubeMap;
+  int m_loadedSkyBox = 0;
+
+  // Options (mirror RayMarchRenderer)
+  bool m_twoDSpace = false;
+  bool m_enableSoftShadow = false;
+  bool m_enableReflection = false;
+  bool m_enableRefraction = false;
+  bool m_enableAmbientOcclusion = false;
+  int m_idxSkyBox = 0;
+  float m_exposure = 1.f;
+  bool m_enableHDR = false;
+  bool m_enableBloom = false;
+  bool m_enableGammaCorrection = false;
+  float m_power = 8.f;
+  glm::vec2 m_juliaSeed = glm::vec2(0.f);
+};
+
+#endif // CPURENDERER_H
@@ -0,0 +1,281 @@
+#include "cpusdf.h"
+
+// - max raymarching steps (MAX_STEPS, MAX_STEPS_FRACTALS in raymarch.frag)
+static const int MAX_STEPS = 256;
+static const int MAX_STEPS_FRACTALS = 20;
+static const float FRACTALS_BAILOUT = 2.f;
+// - fewest iterations of a fractal far away (MIN_FRACTAL_ITERATIONS)
+static const int MIN_FRACTAL_ITERATIONS = 4;
+
+/**
+ * @brief Iterations of a fractal whose detail shrinks by a factor per
+ * iteration (fractalIterations in raymarch.frag)
+ * - stops at the first iteration whose detail is smaller than the pixel
+ *   footprint, plus one
+ * @param maxIterations Iterations in full detail
+ * @param scale Shrink factor of the detail per iteration
+ * @param footprint Pixel footprint in object space (0 for full detail)
+ * @returns Number of iterations to evaluate
+ */
+int CPUSDF::fractalIterations(int maxIterations, float scale,
+                              float footprint) {
+  if (footprint <= 0.f) {
+    return maxIterations;
+  }
+  float n = glm::ceil(glm::log(1.f / footprint) / glm::log(scale)) + 1.f;
+  return int(glm::clamp(n, float(MIN_FRACTAL_ITERATIONS),
+                        float(maxIterations)));
+}
+
+/**
+ * @brief Sphere Signed Distance Field
+ * @param p Point in object space
+ * @param r Radius
+ */
+float CPUSDF::sdSphere(const glm::vec3 &p, float r) {
+  return glm::length(p) - r;
+}
+
+/**
+ * @brief Box Signed Distance Field
+ * @param p Point in object space
+ * @param b half-length dimensions of the box (x,y,z)
+ */
+float CPUSDF::sdBox(const glm::vec3 &p, const glm::vec3 &b) {
+  glm::vec3 q = glm::abs(p) - b;
+  return glm::length(glm::max(q, 0.f)) +
+         glm::min(glm::max(q.x, glm::max(q.y, q.z)), 0.f);
+}
+
+/**
+ * @brief Cone Signed Distance Field
+ * @param p Point in object space
+ * @param r Radius of the base
+ * @param h Half height of the cone
+ */
+float CPUSDF::sdCone(const glm::vec3 &p, float r, float h) {
+  glm::vec2 po(glm::length(glm::vec2(p.x, p.z)) - r, p.y + h);
+  glm::vec2 e(-r, 2.f * h);
+  glm::vec2 q =
+      po - e * glm::clamp(glm::dot(po, e) / glm::dot(e, e), 0.f, 1.f);
+  float d = glm::length(q);
+  if (glm::max(q.x, q.y) > 0.f) {
+    return d;
+  }
+  return -glm::min(d, po.y);
+}
+
+/**
+ * @brief Cylinder Signed Distance Field
+ * @param p Point in object space
+ * @param h Half height of the cylinder
+ * @param r Radius of the base
+ */
+float CPUSDF::sdCylinder(const glm::vec3 &p, float h, float r) {
+  glm::vec2 d =
+      glm::abs(glm::vec2(glm::length(glm::vec2(p.x, p.z)), p.y)) -
+      glm::vec2(r, h);
+  return glm::min(glm::max(d.x, d.y), 0.f) + glm::length(glm::max(d, 0.f));
+}
+
+/**
+ * @brief Octahedron Signed Distance Field
+ * @param p Point in object space
+ * @param s radius s
+ */
+float CPUSDF::sdOctahedron(glm::vec3 p, float s) {
+  p = glm::abs(p);
+  float m = p.x + p.y + p.z - s;
+  glm::vec3 r = 3.f * p - m;
+  glm::vec3 q;
+  if (r.x < 0.f) {
+    q = p;
+  } else if (r.y < 0.f) {
+    q = glm::vec3(p.y, p.z, p.x);
+  } else if (r.z < 0.f) {
+    q = glm::vec3(p.z, p.x, p.y);
+  } else {
+    return m * 0.57735027f;
+  }
+  float k = glm::clamp(0.5f * (q.z - q.y + s), 0.f, s);
+  return glm::length(glm::vec3(q.x, q.y - s + k, q.z - k));
+}
+
+/**
+ * @brief Torus Signed Distance Field
+ * @param p Point in object space
+ * @param t (major radius, minor radius)
+ */
+float CPUSDF::sdTorus(const glm::vec3 &p, const glm::vec2 &t) {
+  glm::vec2 q(glm::length(glm::vec2(p.x, p.z)) - t.x, p.y);
+  return glm::length(q) - t.y;
+}
+
+/**
+ * @brief Capsule Signed Distance Field
+ * @param p Point in object space
+ * @param h half height
+ * @param r corner radius of capsule
+ */
+float CPUSDF::sdCapsule(glm::vec3 p, float h, float r) {
+  p.y -= glm::clamp(p.y, 0.f, h);
+  return glm::length(p) - r;
+}
+
+/**
+ * @brief Deathstar Signed Distance Field
+ * @param p2 Point in object space
+ * @param ra,rb,d radii of the two spheres and the distance between them
+ */
+float CPUSDF::sdDeathStar(const glm::vec3 &p2, float ra, float rb, float d) {
+  glm::vec2 p(p2.x, glm::length(glm::vec2(p2.y, p2.z)));
+
+  float a = (ra * ra - rb * rb + d * d) / (2.f * d);
+  float b = glm::sqrt(glm::max(ra * ra - a * a, 0.f));
+  if (p.x * b - p.y * a > d * glm::max(b - p.y, 0.f)) {
+    return glm::length(p - glm::vec2(a, b));
+  }
+  return glm::max(glm::length(p) - ra,
+                  -(glm::length(p - glm::vec2(d, 0.f)) - rb));
+}
+
+/**
+ * @brief Mandelbrot Set Signed Distance Field
+ * ref: https://www.shadertoy.com/view/Mss3R8
+ * @param p Point in 2D space
+ * @param time iTime
+ */
+float CPUSDF::sdMandelBrot(glm::vec2 p, float time) {
+  float ltime = 0.5f - 0.5f * glm::cos(time * 0.06f);
+  float zoom = glm::pow(0.9f, 50.f * ltime);
+  glm::vec2 c =
+      glm::vec2(-0.745f, 0.186f) - 0.045f * zoom * (1.f - ltime * 0.5f);
+
+  float ld2 = 1.f;
+  float lz2 = glm::dot(p, p);
+  for (int i = 0; i < MAX_STEPS; i++) {
+    ld2 *= 4.f * lz2;
+    p = glm::vec2(p.x * p.x - p.y * p.y, 2.f * p.x * p.y) + c;
+    lz2 = glm::dot(p, p);
+    if (lz2 > 200.f) {
+      break;
+    }
+  }
+  float d = glm::sqrt(lz2 / ld2) * glm::log(lz2);
+  return glm::sqrt(glm::clamp((150.f / zoom) * d, 0.f, 1.f));
+}
+
+/**
+ * @brief Mandelbulb Signed Distance Field
+ * @param pos Point in object space
+ * @param power Power of the fractal (typically 8)
+ * @param juliaSeed Julia seed (unused if zero)
+ * @param resColor Orbit trap
+ * @param footprint Pixel footprint in object space (0 for full detail)
+ */
+float CPUSDF::sdMandelBulb(const glm::vec3 &pos, float power,
+                           const glm::vec2 &juliaSeed, glm::vec4 &resColor,
+                           float footprint) {
+  glm::vec3 w = pos;
+  float m = glm::dot(w, w);
+  glm::vec4 trap(glm::abs(w), m);
+  float dz = 1.f;
+  glm::vec3 c = pos;
+  // If julia seed is used
+  if (glm::length(juliaSeed) != 0.f) {
+    c = glm::vec3(juliaSeed, 0.f);
+  }
+  int iterations =
+      fractalIterations(MAX_STEPS_FRACTALS, glm::max(power, 2.f), footprint);
+  for (int i = 0; i < iterations; i++) {
+    // derivative
+    dz = power * glm::pow(m, (power - 1.f) / 2.f) * dz + 1.f;
+    // z = z^8+c
+    float r = glm::length(w);
+    float b = power * glm::acos(w.y / r);
+    float a = power * glm::atan(w.x, w.z);
+    w = c + glm::pow(r, power) * glm::vec3(glm::sin(b) * glm::sin(a),
+                                           glm::cos(b),
+                                           glm::sin(b) * glm::cos(a));
+
+    trap = glm::min(trap, glm::vec4(glm::abs(w), m));
+
+    m = glm::dot(w, w);
+    if (m > FRACTALS_BAILOUT) {
+      break;
+    }
+  }
+  resColor = glm::vec4(m, trap.y, trap.z, trap.w);
+  // distance estimation (through the Hubbard-Douady potential)
+  return 0.25f * glm::log(m) * glm::sqrt(m) / dz;
+}
+
+/**
+ * @brief Menger Sponge Signed Distance Field
+ * @param p Point in object space
+ * @param time iTime (animates the folding)
+ * @param res Orbit trap
+ */
+float CPUSDF::sdMengerSponge(glm::vec3 p, float time, glm::vec4 &res) {
+  // const mat3 ma in raymarch.frag (column major)
+  const glm::mat3 ma(0.60f, 0.00f, 0.80f, //
+                     0.00f, 1.00f, 0.00f, //
+                     -0.80f, 0.00f, 0.60f);
+  float d = sdBox(p, glm::vec3(1.f));
+  res = glm::vec4(d, 1.f, 0.f, 0.f);
+  float ani = glm::smoothstep(-0.2f, 0.2f, -glm::cos(0.5f * time));
+  float off = 1.5f * glm::sin(0.01f * time);
+  float s = 1.f;
+
+  for (int m = 0; m < 4; m++) {
+    p = glm::mix(p, ma * (p + off), ani);
+    glm::vec3 a = glm::mod(p * s, 2.f) - 1.f;
+    s *= 3.f;
+    glm::vec3 r = glm::abs(1.f - 3.f * glm::abs(a));
+    float da = glm::max(r.x, r.y);
+    float db = glm::max(r.y, r.z);
+    float dc = glm::max(r.z, r.x);
+    float c = (glm::min(da, glm::min(db, dc)) - 1.f) / s;
+    if (c > d) {
+      d = c;
+      res = glm::vec4(d, glm::min(res.y, 0.2f * da * db * dc),
+                      (1.f + float(m)) / 4.f, 0.f);
+    }
+  }
+  return d;
+}
+
+/**
+ * @brief Sierpinski Signed Distance Field
+ * @param p Point in object space
+ * @param footprint Pixel footprint in object space (0 for full detail)
+ */
+float CPUSDF::sdSierpinski(glm::vec3 p, float footprint) {
+  const float scale = 1.85f;
+  const int iterations = fractalIterations(14, scale, footprint);
+  const float offset = 2.f;
+
+  for (int n = 0; n < iterations; n++) {
+    if (p.x + p.y < 0.f) {
+      // fold 1
+      float t = p.x;
+      p.x = -p.y;
+      p.y = -t;
+    }
+    if (p.x + p.z < 0.f) {
+      // fold 2
+      float t = p.x;
+      p.x = -p.z;
+      p.z = -t;
+    }
+    if (p.y + p.z < 0.f) {
+      // fold 3
+      float t = p.z;
+      p.z = -p.y;
+      p.y = -t;
+    }
+    p = p * scale - offset * (scale - 1.f);
+  }
+
+  return glm::length(p) * glm::pow(scale, -float(iterations));
+}
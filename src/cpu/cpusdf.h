@@ -0,0 +1,36 @@
+#ifndef CPUSDF_H
+#define CPUSDF_H
+
+#include <glm/glm.hpp>
+
+class CPUSDF {
+  // Scalar ports of the signed distance fields in resources/raymarch.frag.
+  // Each function mirrors its GLSL counterpart so that the CPU renderer stays
+  // output-compatible with the shader.
+  // - Based on https://iquilezles.org/articles/distfunctions/
+
+public:
+  // Primitives (object space)
+  static float sdSphere(const glm::vec3 &p, float r);
+  static float sdBox(const glm::vec3 &p, const glm::vec3 &b);
+  static float sdCone(const glm::vec3 &p, float r, float h);
+  static float sdCylinder(const glm::vec3 &p, float h, float r);
+  static float sdOctahedron(glm::vec3 p, float s);
+  static float sdTorus(const glm::vec3 &p, const glm::vec2 &t);
+  static float sdCapsule(glm::vec3 p, float h, float r);
+  static float sdDeathStar(const glm::vec3 &p2, float ra, float rb, float d);
+
+  // Fractals (object space)
+  // - footprint is the pixel footprint in object space. The Mandelbulb and
+  //   the Sierpinski tetrahedron stop iterating below it (0 for full detail)
+  static int fractalIterations(int maxIterations, float scale,
+                               float footprint);
+  static float sdMandelBrot(glm::vec2 p, float time);
+  static float sdMandelBulb(const glm::vec3 &pos, float power,
+                            const glm::vec2 &juliaSeed, glm::vec4 &resColor,
+                            float footprint = 0.f);
+  static float sdMengerSponge(glm::vec3 p, float time, glm::vec4 &res);
+  static float sdSierpinski(glm::vec3 p, float footprint = 0.f);
+};
+
+#endif // CPUSDF_H
@@ -0,0 +1,24 @@
+// AVX2 packet kernel (8 lanes). Compiled with -mavx2, see CMakeLists.txt.
+#include "cpu/packetmarcher.h"
+
+#if defined(__AVX2__)
+
+#include "cpu/simd.h"
+#include "cpu/packetkernels.h"
+
+bool PacketMarcher::hasAVX2Kernel() { return true; }
+
+void PacketMarcher::raymarchAVX2(const Object *objects, int numObjects,
+                                 const Packet &packet, float end,
+                                 float pixelRadius, Hits &hits) {
+  raymarchPacket<Float8>(objects, numObjects, packet, end, pixelRadius, hits);
+}
+
+#else
+
+bool PacketMarcher::hasAVX2Kernel() { return false; }
+
+void PacketMarcher::raymarchAVX2(const Object *, int, const Packet &, float,
+                                 float, Hits &) {}
+
+#endif
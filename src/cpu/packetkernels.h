@@ -0,0 +1,220 @@
+#ifndef PACKETKERNELS_H
+#define PACKETKERNELS_H
+
+// Packet versions of the primitive SDFs in resources/raymarch.frag and of the
+// primary raymarch loop, templated on the lane type of simd.h. Included by
+// the per-ISA translation units only.
+// - the arithmetic follows the scalar ports (cpusdf.cpp) operation by
+//   operation, so a packet yields the same hits as marching the rays one by
+//   one
+
+#include "cpu/packetmarcher.h"
+
+namespace {
+
+// Mirrors PrimitiveType (and the constants of raymarch.frag)
+enum PacketType {
+  CUBE = 0,
+  CONE = 1,
+  CYLINDER = 2,
+  SPHERE = 3,
+  OCTAHEDRON = 4,
+  TORUS = 5,
+  CAPSULE = 6,
+  DEATHSTAR = 7,
+  RECTANGLE = 8,
+};
+
+const int MAX_STEPS = 256;
+const float SURFACE_DIST = 0.001f;
+
+template <typename F> struct Vec3 {
+  F x, y, z;
+};
+
+template <typename F> F clamp(F x, F lo, F hi) { return min(max(x, lo), hi); }
+
+template <typename F> F length2(F x, F y) { return sqrt(x * x + y * y); }
+
+template <typename F> F length3(F x, F y, F z) {
+  return sqrt(x * x + y * y + z * z);
+}
+
+template <typename F> F sdSphere(const Vec3<F> &p, float r) {
+  return length3(p.x, p.y, p.z) - F(r);
+}
+
+template <typename F>
+F sdBox(const Vec3<F> &p, float bx, float by, float bz) {
+  F qx = abs(p.x) - F(bx);
+  F qy = abs(p.y) - F(by);
+  F qz = abs(p.z) - F(bz);
+  F zero(0.f);
+  return length3(max(qx, zero), max(qy, zero), max(qz, zero)) +
+         min(max(qx, max(qy, qz)), zero);
+}
+
+template <typename F> F sdCone(const Vec3<F> &p, float r, float h) {
+  F pox = length2(p.x, p.z) - F(r);
+  F poy = p.y + F(h);
+  float ex = -r, ey = 2.f * h;
+  float ee = ex * ex + ey * ey;
+  F t = clamp((pox * F(ex) + poy * F(ey)) / F(ee), F(0.f), F(1.f));
+  F qx = pox - F(ex) * t;
+  F qy = poy - F(ey) * t;
+  F d = length2(qx, qy);
+  return select(max(qx, qy) > F(0.f), d, -min(d, poy));
+}
+
+template <typename F> F sdCylinder(const Vec3<F> &p, float h, float r) {
+  F dx = abs(length2(p.x, p.z)) - F(r);
+  F dy = abs(p.y) - F(h);
+  F zero(0.f);
+  return min(max(dx, dy), zero) + length2(max(dx, zero), max(dy, zero));
+}
+
+template <typename F> F sdOctahedron(const Vec3<F> &p0, float s) {
+  Vec3<F> p{abs(p0.x), abs(p0.y), abs(p0.z)};
+  F m = p.x + p.y + p.z - F(s);
+  F zero(0.f);
+  F rx = F(3.f) * p.x - m;
+  F ry = F(3.f) * p.y - m;
+  F rz = F(3.f) * p.z - m;
+  // - branches of the scalar version as masks
+  F c1 = rx < zero;
+  F c2 = andNot(c1, ry < zero);
+  F c3 = andNot(c1 | c2, rz < zero);
+  F inside = c1 | c2 | c3;
+  // q = p, p.yzx or p.zxy
+  F qx = select(c1, p.x, select(c2, p.y, p.z));
+  F qy = select(c1, p.y, select(c2, p.z, p.x));
+  F qz = select(c1, p.z, select(c2, p.x, p.y));
+  F k = clamp(F(0.5f) * (qz - qy + F(s)), zero, F(s));
+  F d = length3(qx, qy - F(s) + k, qz - k);
+  return select(inside, d, m * F(0.57735027f));
+}
+
+template <typename F> F sdTorus(const Vec3<F> &p, float tx, float ty) {
+  F qx = length2(p.x, p.z) - F(tx);
+  return length2(qx, p.y) - F(ty);
+}
+
+template <typename F> F sdCapsule(const Vec3<F> &p, float h, float r) {
+  F y = p.y - clamp(p.y, F(0.f), F(h));
+  return length3(p.x, y, p.z) - F(r);
+}
+
+template <typename F>
+F sdDeathStar(const Vec3<F> &p2, float ra, float rb, float d) {
+  F px = p2.x;
+  F py = length2(p2.y, p2.z);
+  float a = (ra * ra - rb * rb + d * d) / (2.f * d);
+  F b = sqrt(max(F(ra * ra - a * a), F(0.f)));
+  F cond = px * b - py * F(a) > F(d) * max(b - py, F(0.f));
+  F d1 = length2(px - F(a), py - b);
+  F d2 = max(length2(px, py) - F(ra), -(length2(px - F(d), py) - F(rb)));
+  return select(cond, d1, d2);
+}
+
+/**
+ * @brief Invokes the SDF of the given type (sdMatch in raymarch.frag)
+ * @param p Points in object space
+ * @param type Type of the object (same for every lane)
+ */
+template <typename F> F sdMatch(const Vec3<F> &p, int type) {
+  switch (type) {
+  case CUBE:
+    return sdBox(p, 0.5f, 0.5f, 0.5f);
+  case CONE:
+    return sdCone(p, 0.5f, 0.5f);
+  case CYLINDER:
+    return sdCylinder(p, 0.5f, 0.5f);
+  case SPHERE:
+    return sdSphere(p, 0.5f);
+  case OCTAHEDRON:
+    return sdOctahedron(p, 0.5f);
+  case TORUS:
+    return sdTorus(p, 0.5f, 0.5f / 4);
+  case CAPSULE:
+    return sdCapsule(p, 0.5f, 0.1f);
+  case DEATHSTAR:
+    return sdDeathStar(p, 0.5f, 0.35f, 0.5f);
+  case RECTANGLE:
+    return sdBox(p, 0.5f, 0.5f, 0.f);
+  default:
+    return F(1000000.f);
+  }
+}
+
+/**
+ * @brief Transforms the points to object space (invModelMatrix * vec4(p, 1))
+ * - same summation order as glm's mat4 * vec4
+ */
+template <typename F> Vec3<F> transform(const float *m, const Vec3<F> &p) {
+  return {(F(m[0]) * p.x + F(m[4]) * p.y) + (F(m[8]) * p.z + F(m[12])),
+          (F(m[1]) * p.x + F(m[5]) * p.y) + (F(m[9]) * p.z + F(m[13])),
+          (F(m[2]) * p.x + F(m[6]) * p.y) + (F(m[10]) * p.z + F(m[14]))};
+}
+
+/**
+ * @brief Raymarches a packet of F::WIDTH rays from outside of the objects
+ * @param objects Objects of the scene
+ * @param numObjects Number of objects
+ * @param packet Rays
+ * @param end Far plane
+ * @param pixelRadius Radius of a pixel per unit of depth
+ * @param hits Result per lane
+ */
+template <typename F>
+void raymarchPacket(const PacketMarcher::Object *objects, int numObjects,
+                    const PacketMarcher::Packet &packet, float end,
+                    float pixelRadius, PacketMarcher::Hits &hits) {
+  Vec3<F> ro{F::load(packet.ox), F::load(packet.oy), F::load(packet.oz)};
+  Vec3<F> rd{F::load(packet.dx), F::load(packet.dy), F::load(packet.dz)};
+  F rayDepth(0.f);
+  // Lanes that are still marching
+  F active = F::allTrue();
+  // - object index is kept as float (exact for any realistic scene size)
+  F resObj(-1.f), resD(0.f);
+
+  for (int i = 0; i < MAX_STEPS; i++) {
+    Vec3<F> p{ro.x + rd.x * rayDepth, ro.y + rd.y * rayDepth,
+              ro.z + rd.z * rayDepth};
+    // sdScene
+    F minD(1000000.f), minObj(-1.f);
+    for (int j = 0; j < numObjects; j++) {
+      const PacketMarcher::Object &obj = objects[j];
+      Vec3<F> po = transform(obj.invModelMatrix, p);
+      F currD = sdMatch(po, obj.type) * F(obj.scaleFactor);
+      F closer = currD < minD;
+      minD = select(closer, currD, minD);
+      minObj = select(closer, F(float(j)), minObj);
+    }
+    // Terminate the lanes that hit or exceeded the far plane
+    // - closer than the pixel footprint (or SURFACE_DIST near the origin)
+    F hitDist = max(F(SURFACE_DIST), F(pixelRadius) * rayDepth);
+    F hit = abs(minD) < hitDist;
+    F done = active & (hit | (rayDepth > F(end)));
+    resObj = select(done, select(hit, minObj, F(-1.f)), resObj);
+    resD = select(done, select(hit, rayDepth - minD, rayDepth), resD);
+    active = andNot(done, active);
+    if (!any(active)) {
+      break;
+    }
+    // March the rays that are still active
+    rayDepth = select(active, rayDepth + minD, rayDepth);
+  }
+  // Out of steps -> NO HIT
+  resD = select(active, rayDepth, resD);
+
+  float obj[F::WIDTH];
+  resObj.store(obj);
+  resD.store(hits.d);
+  for (int i = 0; i < F::WIDTH; i++) {
+    hits.intersectObj[i] = int(obj[i]);
+  }
+}
+
+} // namespace
+
+#endif // PACKETKERNELS_H
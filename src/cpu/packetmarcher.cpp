@@ -0,0 +1,120 @@
+#include "packetmarcher.h"
+#include "utils/scenedata.h"
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <immintrin.h>
+#include <intrin.h>
+#endif
+
+// The kernels use the integer values of PrimitiveType
+static_assert(static_cast<int>(PrimitiveType::PRIMITIVE_CUBE) == 0);
+static_assert(static_cast<int>(PrimitiveType::PRIMITIVE_RECTANGLE) == 8);
+
+/**
+ * @brief Checks the CPU for the instruction sets of the kernels
+ * - AVX2 also needs the OS to save the YMM registers
+ * @param avx2 Set to true if AVX2 is usable
+ * @param sse4 Set to true if SSE4.1 is usable
+ */
+static void detectCPU(bool &avx2, bool &sse4) {
+  avx2 = false;
+  sse4 = false;
+#if (defined(__GNUC__) || defined(__clang__)) &&                               \
+    (defined(__x86_64__) || defined(__i386__))
+  __builtin_cpu_init();
+  avx2 = __builtin_cpu_supports("avx2");
+  sse4 = __builtin_cpu_supports("sse4.1");
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+  int info[4];
+  __cpuid(info, 0);
+  int maxLeaf = info[0];
+  __cpuid(info, 1);
+  sse4 = (info[2] & (1 << 19)) != 0;
+  bool osxsave = (info[2] & (1 << 27)) != 0;
+  bool avx = (info[2] & (1 << 28)) != 0;
+  if (maxLeaf >= 7 && osxsave && avx && (_xgetbv(0) & 0x6) == 0x6) {
+    __cpuidex(info, 7, 0);
+    avx2 = (info[1] & (1 << 5)) != 0;
+  }
+#endif
+}
+
+/**
+ * @brief Gets the best instruction set supported by this machine and build
+ * @returns SIMD level
+ */
+SIMDLevel PacketMarcher::getSupportedLevel() {
+  static const SIMDLevel level = []() {
+    bool avx2, sse4;
+    detectCPU(avx2, sse4);
+    if (avx2 && hasAVX2Kernel()) {
+      return SIMDLevel::SIMD_AVX2;
+    }
+    if (sse4 && hasSSE4Kernel()) {
+      return SIMDLevel::SIMD_SSE4;
+    }
+    return SIMDLevel::SIMD_SCALAR;
+  }();
+  return level;
+}
+
+/**
+ * @brief Gets the number of lanes of the level
+ * @param level SIMD level
+ * @returns Number of rays in a packet (1 for scalar)
+ */
+int PacketMarcher::getWidth(SIMDLevel level) {
+  switch (level) {
+  case SIMDLevel::SIMD_AVX2:
+    return 8;
+  case SIMDLevel::SIMD_SSE4:
+    return 4;
+  default:
+    return 1;
+  }
+}
+
+/**
+ * @brief Gets the display name of the level
+ * @param level SIMD level
+ */
+const char *PacketMarcher::getName(SIMDLevel level) {
+  switch (level) {
+  case SIMDLevel::SIMD_AVX2:
+    return "AVX2";
+  case SIMDLevel::SIMD_SSE4:
+    return "SSE4";
+  default:
+    return "scalar";
+  }
+}
+
+/**
+ * @brief Checks if the kernels have an SDF for the primitive type
+ * - fractals and custom SDFs are marched by the scalar path
+ * @param type PrimitiveType as int
+ */
+bool PacketMarcher::isSupported(int type) {
+  return type >= static_cast<int>(PrimitiveType::PRIMITIVE_CUBE) &&
+         type <= static_cast<int>(PrimitiveType::PRIMITIVE_RECTANGLE);
+}
+
+/**
+ * @brief Marches a packet of rays with the kernel of the given level
+ * @param level SIMD_SSE4 (4 rays) or SIMD_AVX2 (8 rays)
+ * @param objects Objects of the scene
+ * @param numObjects Number of objects
+ * @param packet Rays
+ * @param end Far plane
+ * @param pixelRadius Radius of a pixel per unit of depth
+ * @param hits Result per lane
+ */
+void PacketMarcher::raymarch(SIMDLevel level, const Object *objects,
+                             int numObjects, const Packet &packet, float end,
+                             float pixelRadius, Hits &hits) {
+  if (level == SIMDLevel::SIMD_AVX2) {
+    raymarchAVX2(objects, numObjects, packet, end, pixelRadius, hits);
+  } else if (level == SIMDLevel::SIMD_SSE4) {
+    raymarchSSE4(objects, numObjects, packet, end, pixelRadius, hits);
+  }
+}
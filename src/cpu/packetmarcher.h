@@ -0,0 +1,75 @@
+#ifndef PACKETMARCHER_H
+#define PACKETMARCHER_H
+
+// Instruction sets of the packet kernels
+enum class SIMDLevel {
+  SIMD_SCALAR,
+  SIMD_SSE4,
+  SIMD_AVX2,
+};
+
+class PacketMarcher {
+  // Marches 4 (SSE4) or 8 (AVX2) primary rays at once through the primitive
+  // SDFs of the scene. Rays that terminated are masked out while the rest of
+  // the packet keeps marching. The per-ISA kernels live in their own
+  // translation units (packetsse4.cpp, packetavx2.cpp) that are compiled with
+  // the matching target flags, and the kernel is picked at runtime.
+  // - the types here are plain data on purpose: the kernel translation units
+  //   must not include glm/Qt (see simd.h)
+
+public:
+  // Max number of lanes
+  static const int MAX_WIDTH = 8;
+
+  // Object as seen by the kernels (same data as the RayMarchObject uniform)
+  struct Object {
+    // - PrimitiveType
+    int type;
+    // - column major
+    float invModelMatrix[16];
+    float scaleFactor;
+  };
+
+  // Structure of arrays of the rays in a packet
+  struct Packet {
+    float ox[MAX_WIDTH], oy[MAX_WIDTH], oz[MAX_WIDTH];
+    float dx[MAX_WIDTH], dy[MAX_WIDTH], dz[MAX_WIDTH];
+  };
+
+  // Result per lane (same as raymarch in raymarch.frag)
+  struct Hits {
+    // - -1 on miss
+    int intersectObj[MAX_WIDTH];
+    float d[MAX_WIDTH];
+  };
+
+  // Gets the best instruction set supported by this machine and build
+  static SIMDLevel getSupportedLevel();
+  // Gets the number of lanes of the level (1 for scalar)
+  static int getWidth(SIMDLevel level);
+  // Gets the display name of the level
+  static const char *getName(SIMDLevel level);
+  // True if the kernels have an SDF for the primitive type
+  static bool isSupported(int type);
+
+  // Marches getWidth(level) rays
+  // - level must not be SIMD_SCALAR
+  // - pixelRadius is the radius of a pixel per unit of depth, a ray hits
+  //   once it is closer than that to a surface (see raymarch.frag)
+  static void raymarch(SIMDLevel level, const Object *objects, int numObjects,
+                       const Packet &packet, float end, float pixelRadius,
+                       Hits &hits);
+
+private:
+  // Per-ISA kernels (false / no-op if not compiled for this target)
+  static bool hasSSE4Kernel();
+  static void raymarchSSE4(const Object *objects, int numObjects,
+                           const Packet &packet, float end, float pixelRadius,
+                           Hits &hits);
+  static bool hasAVX2Kernel();
+  static void raymarchAVX2(const Object *objects, int numObjects,
+                           const Packet &packet, float end, float pixelRadius,
+                           Hits &hits);
+};
+
+#endif // PACKETMARCHER_H
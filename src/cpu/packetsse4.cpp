@@ -0,0 +1,24 @@
+// SSE4 packet kernel (4 lanes). Compiled with -msse4.1, see CMakeLists.txt.
+#include "cpu/packetmarcher.h"
+
+#if defined(__SSE4_1__) || defined(RAYMARCH_SSE4)
+
+#include "cpu/simd.h"
+#include "cpu/packetkernels.h"
+
+bool PacketMarcher::hasSSE4Kernel() { return true; }
+
+void PacketMarcher::raymarchSSE4(const Object *objects, int numObjects,
+                                 const Packet &packet, float end,
+                                 float pixelRadius, Hits &hits) {
+  raymarchPacket<Float4>(objects, numObjects, packet, end, pixelRadius, hits);
+}
+
+#else
+
+bool PacketMarcher::hasSSE4Kernel() { return false; }
+
+void PacketMarcher::raymarchSSE4(const Object *, int, const Packet &, float,
+                                 float, Hits &) {}
+
+#endif
@@ -0,0 +1,128 @@
+#ifndef SIMD_H
+#define SIMD_H
+
+// Thin wrappers around the SSE4 / AVX2 float registers used by the packet
+// kernels. A type is only defined when the translation unit is compiled for
+// its instruction set, so include this only from the per-ISA kernel files
+// (packetsse4.cpp, packetavx2.cpp).
+// - masks are stored in the same type (all bits set for true lanes)
+// - only intrinsics are used here. Nothing in this file may call glm or any
+//   other inline code that is shared with the baseline translation units.
+
+#include <immintrin.h>
+
+#if defined(__SSE4_1__) || defined(RAYMARCH_SSE4)
+
+struct Float4 {
+  static constexpr int WIDTH = 4;
+  __m128 v;
+
+  Float4() = default;
+  Float4(__m128 x) : v(x) {}
+  Float4(float x) : v(_mm_set1_ps(x)) {}
+
+  static Float4 load(const float *p) { return _mm_loadu_ps(p); }
+  void store(float *p) const { _mm_storeu_ps(p, v); }
+
+  friend Float4 operator+(Float4 a, Float4 b) { return _mm_add_ps(a.v, b.v); }
+  friend Float4 operator-(Float4 a, Float4 b) { return _mm_sub_ps(a.v, b.v); }
+  friend Float4 operator*(Float4 a, Float4 b) { return _mm_mul_ps(a.v, b.v); }
+  friend Float4 operator/(Float4 a, Float4 b) { return _mm_div_ps(a.v, b.v); }
+  friend Float4 operator-(Float4 a) {
+    return _mm_xor_ps(a.v, _mm_set1_ps(-0.f));
+  }
+
+  // Comparisons (masks)
+  friend Float4 operator<(Float4 a, Float4 b) { return _mm_cmplt_ps(a.v, b.v); }
+  friend Float4 operator>(Float4 a, Float4 b) { return _mm_cmpgt_ps(a.v, b.v); }
+
+  // Mask logic
+  friend Float4 operator&(Float4 a, Float4 b) { return _mm_and_ps(a.v, b.v); }
+  friend Float4 operator|(Float4 a, Float4 b) { return _mm_or_ps(a.v, b.v); }
+  // - (!a) & b
+  friend Float4 andNot(Float4 a, Float4 b) { return _mm_andnot_ps(a.v, b.v); }
+  friend bool any(Float4 m) { return _mm_movemask_ps(m.v) != 0; }
+  static Float4 allTrue() { return _mm_castsi128_ps(_mm_set1_epi32(-1)); }
+
+  // m ? a : b (per lane)
+  friend Float4 select(Float4 m, Float4 a, Float4 b) {
+    return _mm_blendv_ps(b.v, a.v, m.v);
+  }
+
+  friend Float4 min(Float4 a, Float4 b) { return _mm_min_ps(a.v, b.v); }
+  friend Float4 max(Float4 a, Float4 b) { return _mm_max_ps(a.v, b.v); }
+  friend Float4 abs(Float4 a) { return _mm_andnot_ps(_mm_set1_ps(-0.f), a.v); }
+  friend Float4 sqrt(Float4 a) { return _mm_sqrt_ps(a.v); }
+};
+
+#endif // SSE4
+
+#if defined(__AVX2__)
+
+struct Float8 {
+  static constexpr int WIDTH = 8;
+  __m256 v;
+
+  Float8() = default;
+  Float8(__m256 x) : v(x) {}
+  Float8(float x) : v(_mm256_set1_ps(x)) {}
+
+  static Float8 load(const float *p) { return _mm256_loadu_ps(p); }
+  void store(float *p) const { _mm256_storeu_ps(p, v); }
+
+  friend Float8 operator+(Float8 a, Float8 b) {
+    return _mm256_add_ps(a.v, b.v);
+  }
+  friend Float8 operator-(Float8 a, Float8 b) {
+    return _mm256_sub_ps(a.v, b.v);
+  }
+  friend Float8 operator*(Float8 a, Float8 b) {
+    return _mm256_mul_ps(a.v, b.v);
+  }
+  friend Float8 operator/(Float8 a, Float8 b) {
+    return _mm256_div_ps(a.v, b.v);
+  }
+  friend Float8 operator-(Float8 a) {
+    return _mm256_xor_ps(a.v, _mm256_set1_ps(-0.f));
+  }
+
+  // Comparisons (masks)
+  friend Float8 operator<(Float8 a, Float8 b) {
+    return _mm256_cmp_ps(a.v, b.v, _CMP_LT_OQ);
+  }
+  friend Float8 operator>(Float8 a, Float8 b) {
+    return _mm256_cmp_ps(a.v, b.v, _CMP_GT_OQ);
+  }
+
+  // Mask logic
+  friend Float8 operator&(Float8 a, Float8 b) {
+    return _mm256_and_ps(a.v, b.v);
+  }
+  friend Float8 operator|(Float8 a, Float8 b) {
+    return _mm256_or_ps(a.v, b.v);
+  }
+  // - (!a) & b
+  friend Float8 andNot(Float8 a, Float8 b) {
+    return _mm256_andnot_ps(a.v, b.v);
+  }
+  friend bool any(Float8 m) { return _mm256_movemask_ps(m.v) != 0; }
+  static Float8 allTrue() {
+    return _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+  }
+
+  // m ? a : b (per lane)
+  friend Float8 select(Float8 m, Float8 a, Float8 b) {
+    return _mm256_blendv_ps(b.v, a.v, m.v);
+  }
+
+  friend Float8 min(Float8 a, Float8 b) { return _mm256_min_ps(a.v, b.v); }
+  friend Float8 max(Float8 a, Float8 b) { return _mm256_max_ps(a.v, b.v); }
+  friend Float8 abs(Float8 a) {
+    return _mm256_andnot_ps(_mm256_set1_ps(-0.f), a.v);
+  }
+  friend Float8 sqrt(Float8 a) { return _mm256_sqrt_ps(a.v); }
+};
+
+#endif // AVX2
+
+#endif // SIMD_H
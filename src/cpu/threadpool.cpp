@@ -0,0 +1,94 @@
+#include "threadpool.h"
+#include <algorithm>
+
+/**
+ * @brief Spawns the worker threads
+ * @param numThreads Number of threads including the caller. Uses the number
+ * of hardware threads if <= 0
+ */
+ThreadPool::ThreadPool(int numThreads) {
+  if (numThreads <= 0) {
+    numThreads = std::max(1u, std::thread::hardware_concurrency());
+  }
+  // The caller is one of the threads
+  for (int i = 0; i < numThreads - 1; i++) {
+    m_workers.emplace_back(&ThreadPool::workerLoop, this);
+  }
+}
+
+/**
+ * @brief Stops and joins the worker threads
+ */
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stop = true;
+  }
+  m_wake.notify_all();
+  for (std::thread &worker : m_workers) {
+    worker.join();
+  }
+}
+
+/**
+ * @brief Runs job(i) for every i in [0, count) on all the threads
+ * Blocks until every index has been processed.
+ * @param count Number of indices
+ * @param job Job to run for each index
+ */
+void ThreadPool::parallelFor(int count, const std::function<void(int)> &job) {
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_job = &job;
+    m_count = count;
+    m_next = 0;
+    m_active = m_workers.size();
+    m_generation++;
+  }
+  m_wake.notify_all();
+  // Help out
+  runJobs();
+  // Wait for the workers to leave the loop
+  std::unique_lock<std::mutex> lock(m_mutex);
+  m_done.wait(lock, [this] { return m_active == 0; });
+  m_job = nullptr;
+}
+
+/**
+ * @brief Gets the number of threads
+ * @returns Number of worker threads plus the caller
+ */
+int ThreadPool::getNumThreads() const { return m_workers.size() + 1; }
+
+/**
+ * @brief Worker loop. Sleeps until a new loop is available
+ */
+void ThreadPool::workerLoop() {
+  unsigned seen = 0;
+  while (true) {
+    {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      m_wake.wait(lock, [&] { return m_stop || m_generation != seen; });
+      if (m_stop) {
+        return;
+      }
+      seen = m_generation;
+    }
+    runJobs();
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_active--;
+    }
+    m_done.notify_one();
+  }
+}
+
+/**
+ * @brief Pulls indices of the current loop until it is exhausted
+ */
+void ThreadPool::runJobs() {
+  int i;
+  while ((i = m_next.fetch_add(1)) < m_count) {
+    (*m_job)(i);
+  }
+}
@@ -0,0 +1,56 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class ThreadPool {
+  // Fixed set of worker threads that run one parallel loop at a time.
+  // Workers are created once and sleep between loops, so a frame does not pay
+  // thread creation cost. The calling thread takes part in every loop.
+
+public:
+  // Cstr
+  // - numThreads (including the caller) <= 0 uses the hardware threads
+  explicit ThreadPool(int numThreads = 0);
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool &) = delete;
+  ThreadPool &operator=(const ThreadPool &) = delete;
+
+  // Runs job(i) for every i in [0, count) and blocks until all are done
+  void parallelFor(int count, const std::function<void(int)> &job);
+
+  // Gets the number of threads (including the caller)
+  int getNumThreads() const;
+
+private:
+  // Worker loop
+  void workerLoop();
+  // Pulls indices of the current loop until it is exhausted
+  void runJobs();
+
+  std::vector<std::thread> m_workers;
+
+  std::mutex m_mutex;
+  // - signals workers that a new loop (or shutdown) is available
+  std::condition_variable m_wake;
+  // - signals the caller that all workers finished the loop
+  std::condition_variable m_done;
+
+  // Current loop
+  const std::function<void(int)> *m_job = nullptr;
+  int m_count = 0;
+  std::atomic<int> m_next = 0;
+  // - incremented for every loop so that workers run each loop once
+  unsigned m_generation = 0;
+  // - number of workers still inside the current loop
+  int m_active = 0;
+  bool m_stop = false;
+};
+
+#endif // THREADPOOL_H
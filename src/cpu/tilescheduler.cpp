@@ -0,0 +1,128 @@
+#include "tilescheduler.h"
+#include <algorithm>
+#include <chrono>
+#include <numeric>
+
+/**
+ * @brief Runs job(tile) for every tile in [0, numTiles)
+ * 1. Sort the tiles by their cost in the previous frame (descending). Without
+ *    timings, the cost of a tile is the time that probe(tile) takes
+ * 2. Deal them round-robin into one deque per thread, so every deque is
+ *    sorted and holds a similar amount of work
+ * 3. Every thread drains its own deque and then steals from the others
+ * Blocks until all the tiles are done.
+ * @param pool Threads to run on
+ * @param numTiles Number of tiles
+ * @param job Renders one tile
+ * @param probe Cheap estimate of a tile (may be empty)
+ */
+void TileScheduler::run(ThreadPool &pool, int numTiles,
+                        const std::function<void(int)> &job,
+                        const std::function<void(int)> &probe) {
+  auto time = [](const std::function<void(int)> &f, int tile) {
+    auto start = std::chrono::steady_clock::now();
+    f(tile);
+    std::chrono::duration<float> elapsed =
+        std::chrono::steady_clock::now() - start;
+    return elapsed.count();
+  };
+  if ((int)m_costs.size() != numTiles) {
+    // No usable timings
+    m_costs.assign(numTiles, 0.f);
+    if (probe) {
+      pool.parallelFor(numTiles,
+                       [&](int tile) { m_costs[tile] = time(probe, tile); });
+    }
+  }
+  std::vector<int> order(numTiles);
+  std::iota(order.begin(), order.end(), 0);
+  // - stable so that equal costs keep the scanline order
+  std::stable_sort(order.begin(), order.end(),
+                   [this](int a, int b) { return m_costs[a] > m_costs[b]; });
+
+  int numThreads = pool.getNumThreads();
+  std::vector<TileDeque> queues(numThreads);
+  for (int i = 0; i < numTiles; i++) {
+    queues[i % numThreads].tiles.push_back(order[i]);
+  }
+  m_queues = &queues;
+  m_steals = 0;
+
+  // Time every tile for the next frame
+  std::function<void(int)> timedJob = [&](int tile) {
+    m_costs[tile] = time(job, tile);
+  };
+  // - one job per deque. A thread that finishes early may run another
+  //   deque's job, which then only finds tiles left to steal
+  pool.parallelFor(numThreads, [&](int self) { runQueue(self, timedJob); });
+  m_queues = nullptr;
+}
+
+/**
+ * @brief Forgets the tile timings
+ */
+void TileScheduler::reset() { m_costs.clear(); }
+
+/**
+ * @brief Gets the time each tile took in the last frame
+ * @returns Seconds per tile (indexed by tile)
+ */
+const std::vector<float> &TileScheduler::getTileCosts() const {
+  return m_costs;
+}
+
+/**
+ * @brief Gets the number of stolen tiles in the last frame
+ */
+int TileScheduler::getNumSteals() const { return m_steals; }
+
+/**
+ * @brief Drains queue "self" and then steals until every queue is empty
+ * @param self Index of the queue owned by this job
+ * @param job Renders one tile
+ */
+void TileScheduler::runQueue(int self, const std::function<void(int)> &job) {
+  int tile;
+  while (popTile(self, tile)) {
+    job(tile);
+  }
+  while (stealTile(self, tile)) {
+    job(tile);
+  }
+}
+
+/**
+ * @brief Takes the most expensive tile left in a queue
+ * @param idx Queue index
+ * @param tile Set to the tile index
+ * @returns False if the queue is empty
+ */
+bool TileScheduler::popTile(int idx, int &tile) {
+  TileDeque &queue = (*m_queues)[idx];
+  std::lock_guard<std::mutex> lock(queue.mutex);
+  if (queue.tiles.empty()) {
+    return false;
+  }
+  tile = queue.tiles.front();
+  queue.tiles.pop_front();
+  return true;
+}
+
+/**
+ * @brief Steals a tile from the other queues
+ * The victim keeps working on its tiles in order, so the thief takes the
+ * most expensive one that is left to shorten the tail of the frame.
+ * @param self Queue of the thief
+ * @param tile Set to the tile index
+ * @returns False if every queue is empty
+ */
+bool TileScheduler::stealTile(int self, int &tile) {
+  int numQueues = m_queues->size();
+  for (int i = 1; i < numQueues; i++) {
+    if (popTile((self + i) % numQueues, tile)) {
+      m_steals++;
+      return true;
+    }
+  }
+  return false;
+}
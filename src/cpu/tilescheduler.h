@@ -0,0 +1,56 @@
+#ifndef TILESCHEDULER_H
+#define TILESCHEDULER_H
+
+#include "cpu/threadpool.h"
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+class TileScheduler {
+  // Distributes the tiles of a frame over per-thread deques and lets idle
+  // threads steal from the others. Tiles are ordered by the time they took in
+  // the previous frame (most expensive first), so the fractal tiles start
+  // right away and the cheap background tiles fill the gaps at the end.
+  // - the first frame (or a frame with a different tile count) has no
+  //   timings. Its tiles are ordered by the time of a probe per tile (e.g.
+  //   one ray), or kept in the plain order without a probe
+
+public:
+  // Runs job(tile) for every tile on the pool and records the tile timings
+  // - probe(tile) estimates the cost of a tile when there are no timings
+  void run(ThreadPool &pool, int numTiles,
+           const std::function<void(int)> &job,
+           const std::function<void(int)> &probe = nullptr);
+
+  // Forgets the timings (e.g. when a new scene is loaded)
+  void reset();
+
+  // Gets the time (in seconds) each tile took in the last frame
+  const std::vector<float> &getTileCosts() const;
+  // Gets the number of tiles that were stolen in the last frame
+  int getNumSteals() const;
+
+private:
+  // Deque of tile indices owned by one thread
+  struct TileDeque {
+    std::mutex mutex;
+    std::deque<int> tiles;
+  };
+
+  // Runs the tiles of queue "self" and steals once it is empty
+  void runQueue(int self, const std::function<void(int)> &job);
+  // Takes the next tile from queue "idx"
+  bool popTile(int idx, int &tile);
+  // Takes a tile from the other queues
+  bool stealTile(int self, int &tile);
+
+  // Queues of the frame being rendered
+  std::vector<TileDeque> *m_queues = nullptr;
+  // Seconds per tile (last frame)
+  std::vector<float> m_costs;
+  std::atomic<int> m_steals = 0;
+};
+
+#endif // TILESCHEDULER_H
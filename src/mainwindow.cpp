@@ -64,6 +64,13 @@ void MainWindow::initialize() {
   th_label->setText("Terrain Height");
   QLabel *ts_label = new QLabel();
   ts_label->setText("Terrain Scale");
+  QLabel *samples_label = new QLabel();
+  samples_label->setText("Sample Budget");
+  QLabel *target_label = new QLabel();
+  target_label->setText("Target Frame (ms)");
+  QLabel *perf_label = new QLabel();
+  perf_label->setText("Performance");
+  perf_label->setFont(font);
 
   softShadow = new QCheckBox();
   softShadow->setText(QStringLiteral("Soft Shadow"));
@@ -81,10 +88,52 @@ void MainWindow::initialize() {
   ambientOcculusion->setText(QStringLiteral("Ambient Occulusion"));
   ambientOcculusion->setChecked(false);
 
+  bumpMap = new QCheckBox();
+  bumpMap->setText(QStringLiteral("Bump Map"));
+  bumpMap->setChecked(true);
+
+  accumulation = new QCheckBox();
+  accumulation->setText(QStringLiteral("Accumulate When Idle"));
+  accumulation->setChecked(true);
+
   fxaa = new QCheckBox();
   fxaa->setText(QStringLiteral("FXAA"));
   fxaa->setChecked(false);
 
+  frameTimings = new QCheckBox();
+  frameTimings->setText(QStringLiteral("Frame Timings"));
+  frameTimings->setChecked(false);
+
+  dynamicResolution = new QCheckBox();
+  dynamicResolution->setText(QStringLiteral("Dynamic Resolution"));
+  dynamicResolution->setChecked(false);
+
+  depthPrepass = new QCheckBox();
+  depthPrepass->setText(QStringLiteral("Depth Prepass"));
+  depthPrepass->setChecked(true);
+
+  reprojection = new QCheckBox();
+  reprojection->setText(QStringLiteral("Temporal Reprojection"));
+  reprojection->setChecked(true);
+
+  relaxation = new QCheckBox();
+  relaxation->setText(QStringLiteral("Over-Relaxation"));
+  relaxation->setChecked(true);
+
+  sdfCache = new QCheckBox();
+  sdfCache->setText(QStringLiteral("SDF Cache"));
+  sdfCache->setChecked(true);
+
+  deferred = new QCheckBox();
+  deferred->setText(QStringLiteral("Deferred Shading"));
+  deferred->setChecked(false);
+
+  lightingResOption = new QComboBox();
+  lightingResOption->addItem("Shadow / AO: Full Res");
+  lightingResOption->addItem("Shadow / AO: Half Res");
+  lightingResOption->addItem("Shadow / AO: Quarter Res");
+  lightingResOption->setCurrentIndex(0);
+
   skyboxOption = new QComboBox();
   skyboxOption->addItem("None");
   skyboxOption->addItem("Beach");
@@ -97,6 +146,11 @@ void MainWindow::initialize() {
   lightOption->addItem("Gamma Correct");
   lightOption->addItem("HDR");
   lightOption->addItem("Bloom");
+  // - same order as CostChannel
+  lightOption->addItem("Heatmap: Primary Steps");
+  lightOption->addItem("Heatmap: Shadow Steps");
+  lightOption->addItem("Heatmap: SDF Evaluations");
+  lightOption->addItem("Heatmap: All Steps");
   lightOption->setCurrentIndex(0);
 
   fractalOption = new QComboBox();
@@ -114,6 +168,9 @@ void MainWindow::initialize() {
   saveImage = new QPushButton();
   saveImage->setText(QStringLiteral("Save image"));
 
+  saveTimings = new QPushButton();
+  saveTimings->setText(QStringLiteral("Save Timings"));
+
   juliaSeed = new QPushButton();
   juliaSeed->setText(QStringLiteral("Generate Julia Seed"));
 
@@ -159,6 +216,18 @@ void MainWindow::initialize() {
   terrainS->setSingleStep(0.25);
   terrainS->setValue(2.75);
 
+  sampleBudgetBox = new QSpinBox();
+  sampleBudgetBox->setMinimum(1);
+  sampleBudgetBox->setMaximum(4096);
+  sampleBudgetBox->setSingleStep(16);
+  sampleBudgetBox->setValue(64);
+
+  targetFrameTimeBox = new QDoubleSpinBox();
+  targetFrameTimeBox->setMinimum(4.f);
+  targetFrameTimeBox->setMaximum(100.f);
+  targetFrameTimeBox->setSingleStep(1.f);
+  targetFrameTimeBox->setValue(16.6f);
+
   QGroupBox *nearLayout = new QGroupBox(); // horizonal near slider alignment
   QHBoxLayout *lnear = new QHBoxLayout();
   QGroupBox *farLayout = new QGroupBox(); // horizonal far slider alignment
@@ -168,6 +237,8 @@ void MainWindow::initialize() {
   QHBoxLayout *octLayout = new QHBoxLayout();
   QHBoxLayout *terrainHL = new QHBoxLayout();
   QHBoxLayout *terrainSL = new QHBoxLayout();
+  QHBoxLayout *samplesLayout = new QHBoxLayout();
+  QHBoxLayout *targetLayout = new QHBoxLayout();
 
   // Adds the slider and number box to the parameter layouts
   lnear->addWidget(near_label);
@@ -193,6 +264,12 @@ void MainWindow::initialize() {
   terrainSL->addWidget(ts_label);
   terrainSL->addWidget(terrainS);
 
+  samplesLayout->addWidget(samples_label);
+  samplesLayout->addWidget(sampleBudgetBox);
+
+  targetLayout->addWidget(target_label);
+  targetLayout->addWidget(targetFrameTimeBox);
+
   vLayout->addWidget(uploadFile);
   vLayout->addWidget(saveImage);
   vLayout->addWidget(camera_label);
@@ -203,6 +280,9 @@ void MainWindow::initialize() {
   vLayout->addWidget(reflection);
   vLayout->addWidget(refraction);
   vLayout->addWidget(ambientOcculusion);
+  vLayout->addWidget(bumpMap);
+  vLayout->addWidget(accumulation);
+  vLayout->addLayout(samplesLayout);
   vLayout->addWidget(skybox_label);
   vLayout->addWidget(skyboxOption);
   vLayout->addWidget(postproc_option_label);
@@ -218,6 +298,17 @@ void MainWindow::initialize() {
   vLayout->addLayout(terrainHL);
   vLayout->addLayout(terrainSL);
   vLayout->addLayout(octLayout);
+  vLayout->addWidget(perf_label);
+  vLayout->addWidget(frameTimings);
+  vLayout->addWidget(dynamicResolution);
+  vLayout->addLayout(targetLayout);
+  vLayout->addWidget(depthPrepass);
+  vLayout->addWidget(reprojection);
+  vLayout->addWidget(relaxation);
+  vLayout->addWidget(sdfCache);
+  vLayout->addWidget(deferred);
+  vLayout->addWidget(lightingResOption);
+  vLayout->addWidget(saveTimings);
 
   connectUIElements();
 
@@ -237,12 +328,25 @@ void MainWindow::finish() {
 void MainWindow::connectUIElements() {
   connectUploadFile();
   connectSaveImage();
+  connectFrameTimings();
+  connectDynamicResolution();
+  connectTargetFrameTime();
+  connectDepthPrepass();
+  connectReprojection();
+  connectRelaxation();
+  connectSDFCache();
+  connectDeferred();
+  connectLightingRes();
+  connectSaveTimings();
   connectNear();
   connectFar();
   connectSoftShadow();
   connectReflection();
   connectRefraction();
   connectAmbientOcculusion();
+  connectBumpMap();
+  connectAccumulation();
+  connectSampleBudget();
   connectFXAA();
   connectSkyBox();
   connectDispOption();
@@ -263,6 +367,55 @@ void MainWindow::connectSaveImage() {
   connect(saveImage, &QPushButton::clicked, this, &MainWindow::onSaveImage);
 }
 
+void MainWindow::connectFrameTimings() {
+  connect(frameTimings, &QCheckBox::clicked, this,
+          &MainWindow::onFrameTimings);
+}
+
+void MainWindow::connectDynamicResolution() {
+  connect(dynamicResolution, &QCheckBox::clicked, this,
+          &MainWindow::onDynamicResolution);
+}
+
+void MainWindow::connectDepthPrepass() {
+  connect(depthPrepass, &QCheckBox::clicked, this,
+          &MainWindow::onDepthPrepass);
+}
+
+void MainWindow::connectReprojection() {
+  connect(reprojection, &QCheckBox::clicked, this,
+          &MainWindow::onReprojection);
+}
+
+void MainWindow::connectRelaxation() {
+  connect(relaxation, &QCheckBox::clicked, this, &MainWindow::onRelaxation);
+}
+
+void MainWindow::connectSDFCache() {
+  connect(sdfCache, &QCheckBox::clicked, this, &MainWindow::onSDFCache);
+}
+
+void MainWindow::connectDeferred() {
+  connect(deferred, &QCheckBox::clicked, this, &MainWindow::onDeferred);
+}
+
+void MainWindow::connectLightingRes() {
+  connect(lightingResOption, &QComboBox::currentIndexChanged, this,
+          &MainWindow::onLightingRes);
+}
+
+void MainWindow::connectTargetFrameTime() {
+  connect(targetFrameTimeBox,
+          static_cast<void (QDoubleSpinBox::*)(double)>(
+              &QDoubleSpinBox::valueChanged),
+          this, &MainWindow::onTargetFrameTime);
+}
+
+void MainWindow::connectSaveTimings() {
+  connect(saveTimings, &QPushButton::clicked, this,
+          &MainWindow::onSaveTimings);
+}
+
 void MainWindow::connectJuliaSeed() {
   connect(juliaSeed, &QPushButton::clicked, this, &MainWindow::onJuliaSeed);
 }
@@ -298,6 +451,21 @@ void MainWindow::connectAmbientOcculusion() {
           &MainWindow::onAmbientOcculusion);
 }
 
+void MainWindow::connectBumpMap() {
+  connect(bumpMap, &QCheckBox::clicked, this, &MainWindow::onBumpMap);
+}
+
+void MainWindow::connectAccumulation() {
+  connect(accumulation, &QCheckBox::clicked, this,
+          &MainWindow::onAccumulation);
+}
+
+void MainWindow::connectSampleBudget() {
+  connect(sampleBudgetBox,
+          static_cast<void (QSpinBox::*)(int)>(&QSpinBox::valueChanged), this,
+          &MainWindow::onSampleBudget);
+}
+
 void MainWindow::connectFXAA() {
   connect(fxaa, &QCheckBox::clicked, this, &MainWindow::onFXAA);
 }
@@ -401,6 +569,65 @@ void MainWindow::onSaveImage() {
   realtime->saveViewportImage(filePath.toStdString());
 }
 
+void MainWindow::onFrameTimings() {
+  settings.showFrameTimings = !settings.showFrameTimings;
+  realtime->settingsChanged();
+}
+
+void MainWindow::onDynamicResolution() {
+  settings.enableDynamicResolution = !settings.enableDynamicResolution;
+  realtime->settingsChanged();
+}
+
+void MainWindow::onDepthPrepass() {
+  settings.enableDepthPrepass = !settings.enableDepthPrepass;
+  realtime->settingsChanged();
+}
+
+void MainWindow::onReprojection() {
+  settings.enableReprojection = !settings.enableReprojection;
+  realtime->settingsChanged();
+}
+
+void MainWindow::onRelaxation() {
+  settings.enableRelaxation = !settings.enableRelaxation;
+  realtime->settingsChanged();
+}
+
+void MainWindow::onSDFCache() {
+  settings.enableSDFCache = !settings.enableSDFCache;
+  realtime->settingsChanged();
+}
+
+void MainWindow::onDeferred() {
+  settings.enableDeferred = !settings.enableDeferred;
+  realtime->settingsChanged();
+}
+
+void MainWindow::onLightingRes(int idx) {
+  // - full, half or quarter
+  settings.lightingScale = 1 << idx;
+  realtime->settingsChanged();
+}
+
+void MainWindow::onTargetFrameTime(double newValue) {
+  settings.targetFrameTime = newValue;
+  realtime->settingsChanged();
+}
+
+void MainWindow::onSaveTimings() {
+  QString filePath = QFileDialog::getSaveFileName(
+      this, tr("Save Timings"),
+      QDir::currentPath().append(QDir::separator()).append("timings.csv"),
+      tr("CSV Files (*.csv)"));
+  if (filePath.isEmpty()) {
+    return;
+  }
+  std::cout << "Saving frame timings to: \"" << filePath.toStdString()
+            << "\"." << std::endl;
+  realtime->saveFrameTimings(filePath.toStdString());
+}
+
 void MainWindow::onValChangeNearBox(double newValue) {
   // nearBox->setValue(newValue);
   settings.nearPlane = nearBox->value();
@@ -433,6 +660,21 @@ void MainWindow::onAmbientOcculusion() {
   realtime->settingsChanged();
 }
 
+void MainWindow::onBumpMap() {
+  settings.enableBumpMap = !settings.enableBumpMap;
+  realtime->settingsChanged();
+}
+
+void MainWindow::onAccumulation() {
+  settings.enableAccumulation = !settings.enableAccumulation;
+  realtime->settingsChanged();
+}
+
+void MainWindow::onSampleBudget(int newValue) {
+  settings.sampleBudget = newValue;
+  realtime->settingsChanged();
+}
+
 void MainWindow::onFXAA() {
   settings.enableFXAA = !settings.enableFXAA;
   realtime->settingsChanged();
@@ -478,6 +720,7 @@ void MainWindow::onDispOption(int idx) {
   settings.enableGammaCorrection = false;
   settings.enableHDR = false;
   settings.enableBloom = false;
+  settings.costHeatmap = 0;
   switch (idx) {
   case 0:
     break;
@@ -490,6 +733,9 @@ void MainWindow::onDispOption(int idx) {
   case 3:
     settings.enableBloom = true;
     break;
+  default:
+    settings.costHeatmap = idx - 3;
+    break;
   }
   realtime->settingsChanged();
 }
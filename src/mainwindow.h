@@ -25,12 +25,25 @@ private:
   void connectReflection();
   void connectRefraction();
   void connectAmbientOcculusion();
+  void connectBumpMap();
+  void connectAccumulation();
+  void connectSampleBudget();
   void connectFXAA();
   void connectSkyBox();
   void connectFractal();
   void connectDispOption();
   void connectUploadFile();
   void connectSaveImage();
+  void connectFrameTimings();
+  void connectDynamicResolution();
+  void connectDepthPrepass();
+  void connectReprojection();
+  void connectRelaxation();
+  void connectSDFCache();
+  void connectDeferred();
+  void connectLightingRes();
+  void connectTargetFrameTime();
+  void connectSaveTimings();
   void connectEpsilon();
   void connectPower();
   void connectJuliaSeed();
@@ -43,6 +56,7 @@ private:
 
   QPushButton *uploadFile;
   QPushButton *saveImage;
+  QPushButton *saveTimings;
   QDoubleSpinBox *nearBox;
   QDoubleSpinBox *farBox;
   QDoubleSpinBox *epsilonBox;
@@ -51,12 +65,24 @@ private:
   QDoubleSpinBox *octaveBox;
   QDoubleSpinBox *terrainH;
   QDoubleSpinBox *terrainS;
+  QSpinBox *sampleBudgetBox;
+  QDoubleSpinBox *targetFrameTimeBox;
 
   QCheckBox *softShadow;
   QCheckBox *reflection;
   QCheckBox *refraction;
   QCheckBox *ambientOcculusion;
+  QCheckBox *bumpMap;
+  QCheckBox *accumulation;
   QCheckBox *fxaa;
+  QCheckBox *frameTimings;
+  QCheckBox *dynamicResolution;
+  QCheckBox *depthPrepass;
+  QCheckBox *reprojection;
+  QCheckBox *relaxation;
+  QCheckBox *sdfCache;
+  QCheckBox *deferred;
+  QComboBox *lightingResOption;
   QComboBox *skyboxOption;
   QComboBox *lightOption;
   QComboBox *fractalOption;
@@ -64,12 +90,25 @@ private:
 private slots:
   void onUploadFile();
   void onSaveImage();
+  void onFrameTimings();
+  void onDynamicResolution();
+  void onDepthPrepass();
+  void onReprojection();
+  void onRelaxation();
+  void onSDFCache();
+  void onDeferred();
+  void onLightingRes(int idx);
+  void onTargetFrameTime(double newValue);
+  void onSaveTimings();
   void onValChangeNearBox(double newValue);
   void onValChangeFarBox(double newValue);
   void onSoftShadow();
   void onReflection();
   void onRefraction();
   void onAmbientOcculusion();
+  void onBumpMap();
+  void onAccumulation();
+  void onSampleBudget(int newValue);
   void onFXAA();
   void onSkyBox(int idx);
   void onDispOption(int idx);
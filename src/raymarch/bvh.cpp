@@ -0,0 +1,290 @@
+#include "bvh.h"
+#include <algorithm>
+#include <cfloat>
+
+/**
+ * @brief Half of the surface area of a box
+ */
+static float halfArea(const glm::vec3 &min, const glm::vec3 &max) {
+  glm::vec3 e = glm::max(max - min, glm::vec3(0.f));
+  return e.x * e.y + e.y * e.z + e.z * e.x;
+}
+
+/**
+ * @brief Gets the object space bounds of a primitive (see sdMatch in
+ * raymarch.frag)
+ * @param type Type of the primitive
+ * @param min Set to the min corner
+ * @param max Set to the max corner
+ * @returns False for fractals and custom SDFs, which have no bounds
+ */
+bool BVH::getLocalBounds(PrimitiveType type, glm::vec3 &min, glm::vec3 &max) {
+  switch (type) {
+  case PrimitiveType::PRIMITIVE_CUBE:
+  case PrimitiveType::PRIMITIVE_CONE:
+  case PrimitiveType::PRIMITIVE_CYLINDER:
+  case PrimitiveType::PRIMITIVE_SPHERE:
+  case PrimitiveType::PRIMITIVE_OCTAHEDRON:
+  case PrimitiveType::PRIMITIVE_DEATHSTAR:
+    min = glm::vec3(-0.5f);
+    max = glm::vec3(0.5f);
+    return true;
+  case PrimitiveType::PRIMITIVE_TORUS:
+    // - major radius 0.5, minor radius 0.125
+    min = glm::vec3(-0.625f, -0.125f, -0.625f);
+    max = glm::vec3(0.625f, 0.125f, 0.625f);
+    return true;
+  case PrimitiveType::PRIMITIVE_CAPSULE:
+    // - segment from y = 0 to y = 0.5, radius 0.1
+    min = glm::vec3(-0.1f, -0.1f, -0.1f);
+    max = glm::vec3(0.1f, 0.6f, 0.1f);
+    return true;
+  case PrimitiveType::PRIMITIVE_RECTANGLE:
+    min = glm::vec3(-0.5f, -0.5f, 0.f);
+    max = glm::vec3(0.5f, 0.5f, 0.f);
+    return true;
+  default:
+    return false;
+  }
+}
+
+/**
+ * @brief Gets the world space bounds of an object
+ * - the box around the 8 transformed corners of the object space bounds. It
+ *   contains the surface, so the distance to it never overestimates the
+ *   distance to the object
+ * @param obj Object
+ * @param min Set to the min corner
+ * @param max Set to the max corner
+ * @returns False if the object has no bounds
+ */
+bool BVH::getWorldBounds(const RayMarchObj &obj, glm::vec3 &min,
+                         glm::vec3 &max) {
+  glm::vec3 lmin, lmax;
+  if (!getLocalBounds(obj.m_type, lmin, lmax)) {
+    return false;
+  }
+  min = glm::vec3(FLT_MAX);
+  max = glm::vec3(-FLT_MAX);
+  for (int i = 0; i < 8; i++) {
+    glm::vec3 corner((i & 1) ? lmax.x : lmin.x, (i & 2) ? lmax.y : lmin.y,
+                     (i & 4) ? lmax.z : lmin.z);
+    glm::vec3 p = glm::vec3(obj.m_ctm * glm::vec4(corner, 1.f));
+    min = glm::min(min, p);
+    max = glm::max(max, p);
+  }
+  return true;
+}
+
+/**
+ * @brief Builds the tree over the objects
+ * @param objects Objects of the scene
+ * @param keepOut Objects listed with the unbounded ones even if they have
+ * bounds (none if empty)
+ */
+void BVH::build(const std::vector<RayMarchObj> &objects,
+                const std::vector<bool> &keepOut) {
+  clear();
+  std::vector<int> unbounded;
+  for (int i = 0; i < (int)objects.size(); i++) {
+    Item item;
+    if ((!keepOut.empty() && keepOut[i]) ||
+        !getWorldBounds(objects[i], item.min, item.max)) {
+      unbounded.push_back(i);
+      continue;
+    }
+    item.centroid = 0.5f * (item.min + item.max);
+    item.object = i;
+    m_items.push_back(item);
+  }
+
+  if (!m_items.empty()) {
+    m_nodes.reserve(2 * m_items.size());
+    m_nodes.push_back(BVHNode{glm::vec3(0.f), 0, glm::vec3(0.f),
+                              (int)m_items.size()});
+    subdivide(0, 1);
+  }
+
+  // Leaf order, then the objects without bounds
+  for (const Item &item : m_items) {
+    m_objectIndices.push_back(item.object);
+  }
+  m_objectIndices.insert(m_objectIndices.end(), unbounded.begin(),
+                         unbounded.end());
+  m_numUnbounded = unbounded.size();
+  m_items.clear();
+}
+
+/**
+ * @brief Removes every node
+ */
+void BVH::clear() {
+  m_nodes.clear();
+  m_objectIndices.clear();
+  m_items.clear();
+  m_numUnbounded = 0;
+  m_depth = 0;
+}
+
+/**
+ * @brief Fits the node to its items and splits it in two
+ * - a node is split if the SAH cost of the split is lower than testing every
+ *   item, or if it has more than BVH_MAX_LEAF_SIZE items
+ * @param nodeIdx Index of the node (a leaf over its items)
+ * @param depth Depth of the node (root is 1)
+ */
+void BVH::subdivide(int nodeIdx, int depth) {
+  m_depth = std::max(m_depth, depth);
+  int first = m_nodes[nodeIdx].leftOrFirst;
+  int count = m_nodes[nodeIdx].count;
+  glm::vec3 min(FLT_MAX), max(-FLT_MAX);
+  for (int i = first; i < first + count; i++) {
+    min = glm::min(min, m_items[i].min);
+    max = glm::max(max, m_items[i].max);
+  }
+  m_nodes[nodeIdx].min = min;
+  m_nodes[nodeIdx].max = max;
+  if (count <= 1 || depth >= BVH_MAX_DEPTH) {
+    return;
+  }
+
+  int axis;
+  float pos;
+  float splitCost = findSplit(m_nodes[nodeIdx], axis, pos);
+  float leafCost = count * halfArea(min, max);
+  if (splitCost >= leafCost && count <= BVH_MAX_LEAF_SIZE) {
+    return;
+  }
+
+  // Partition the items
+  auto begin = m_items.begin() + first;
+  auto end = begin + count;
+  auto mid = end;
+  if (splitCost != FLT_MAX) {
+    mid = std::partition(begin, end, [axis, pos](const Item &item) {
+      return item.centroid[axis] < pos;
+    });
+  }
+  if (mid == begin || mid == end) {
+    // Centroids on top of each other -> split in the middle of the list
+    mid = begin + count / 2;
+  }
+  int leftCount = mid - begin;
+
+  // Children are next to each other
+  int left = m_nodes.size();
+  m_nodes.push_back(BVHNode{glm::vec3(0.f), first, glm::vec3(0.f), leftCount});
+  m_nodes.push_back(BVHNode{glm::vec3(0.f), first + leftCount, glm::vec3(0.f),
+                            count - leftCount});
+  m_nodes[nodeIdx].leftOrFirst = left;
+  m_nodes[nodeIdx].count = 0;
+  subdivide(left, depth + 1);
+  subdivide(left + 1, depth + 1);
+}
+
+/**
+ * @brief Bins the centroids along every axis and evaluates the SAH cost of
+ * the planes between the bins
+ * @param node Node to split
+ * @param axis Set to the axis of the best plane
+ * @param pos Set to the position of the best plane
+ * @returns Cost of the best plane
+ */
+float BVH::findSplit(const BVHNode &node, int &axis, float &pos) const {
+  float bestCost = FLT_MAX;
+  int first = node.leftOrFirst;
+  int count = node.count;
+  for (int a = 0; a < 3; a++) {
+    float cmin = FLT_MAX, cmax = -FLT_MAX;
+    for (int i = first; i < first + count; i++) {
+      cmin = std::min(cmin, m_items[i].centroid[a]);
+      cmax = std::max(cmax, m_items[i].centroid[a]);
+    }
+    if (cmin == cmax) {
+      continue;
+    }
+
+    // Fill the bins
+    struct Bin {
+      glm::vec3 min = glm::vec3(FLT_MAX), max = glm::vec3(-FLT_MAX);
+      int count = 0;
+    } bins[BVH_NUM_BINS];
+    float scale = BVH_NUM_BINS / (cmax - cmin);
+    for (int i = first; i < first + count; i++) {
+      const Item &item = m_items[i];
+      int b = std::min(BVH_NUM_BINS - 1,
+                       (int)((item.centroid[a] - cmin) * scale));
+      bins[b].min = glm::min(bins[b].min, item.min);
+      bins[b].max = glm::max(bins[b].max, item.max);
+      bins[b].count++;
+    }
+
+    // Sweep from both sides
+    float leftArea[BVH_NUM_BINS - 1], rightArea[BVH_NUM_BINS - 1];
+    int leftCount[BVH_NUM_BINS - 1], rightCount[BVH_NUM_BINS - 1];
+    glm::vec3 lmin(FLT_MAX), lmax(-FLT_MAX), rmin(FLT_MAX), rmax(-FLT_MAX);
+    int lsum = 0, rsum = 0;
+    for (int i = 0; i < BVH_NUM_BINS - 1; i++) {
+      lsum += bins[i].count;
+      leftCount[i] = lsum;
+      lmin = glm::min(lmin, bins[i].min);
+      lmax = glm::max(lmax, bins[i].max);
+      leftArea[i] = halfArea(lmin, lmax);
+      int j = BVH_NUM_BINS - 1 - i;
+      rsum += bins[j].count;
+      rightCount[j - 1] = rsum;
+      rmin = glm::min(rmin, bins[j].min);
+      rmax = glm::max(rmax, bins[j].max);
+      rightArea[j - 1] = halfArea(rmin, rmax);
+    }
+    for (int i = 0; i < BVH_NUM_BINS - 1; i++) {
+      if (leftCount[i] == 0 || rightCount[i] == 0) {
+        continue;
+      }
+      float cost = leftCount[i] * leftArea[i] + rightCount[i] * rightArea[i];
+      if (cost < bestCost) {
+        bestCost = cost;
+        axis = a;
+        pos = cmin + (i + 1) / scale;
+      }
+    }
+  }
+  return bestCost;
+}
+
+/**
+ * @brief Packs the nodes for the node texture buffer of raymarch.frag
+ * @param texels BVH_NODE_TEXELS texels per node
+ */
+void BVH::packNodes(std::vector<glm::vec4> &texels) const {
+  texels.clear();
+  texels.reserve(m_nodes.size() * BVH_NODE_TEXELS);
+  for (const BVHNode &node : m_nodes) {
+    texels.emplace_back(node.min, node.leftOrFirst);
+    texels.emplace_back(node.max, node.count);
+  }
+}
+
+/**
+ * @brief Gets the nodes of the tree
+ * @returns Nodes, root first
+ */
+const std::vector<BVHNode> &BVH::getNodes() const { return m_nodes; }
+
+/**
+ * @brief Gets the objects in leaf order followed by the unbounded objects
+ * @returns Indices into the shapes of the scene
+ */
+const std::vector<int> &BVH::getObjectIndices() const {
+  return m_objectIndices;
+}
+
+/**
+ * @brief Gets the number of objects without bounds
+ */
+int BVH::getNumUnbounded() const { return m_numUnbounded; }
+
+/**
+ * @brief Gets the depth of the tree (0 if empty)
+ */
+int BVH::getDepth() const { return m_depth; }
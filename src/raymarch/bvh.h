@@ -0,0 +1,83 @@
+#ifndef BVH_H
+#define BVH_H
+
+#include "raymarch/raymarchobj.h"
+#include <glm/glm.hpp>
+#include <vector>
+
+// Max number of objects in a leaf when a split does not pay off
+#define BVH_MAX_LEAF_SIZE 4
+// Max depth of the tree (the shader keeps a stack of BVH_MAX_DEPTH + 1)
+#define BVH_MAX_DEPTH 24
+// Number of SAH bins per axis
+#define BVH_NUM_BINS 12
+// Texels (RGBA32F) per node in the node texture buffer
+#define BVH_NODE_TEXELS 2
+
+// Node of the flattened tree
+// - interior: count == 0, children are leftOrFirst and leftOrFirst + 1
+// - leaf: objects are getObjectIndices()[leftOrFirst, leftOrFirst + count)
+struct BVHNode {
+  glm::vec3 min;
+  int leftOrFirst;
+  glm::vec3 max;
+  int count;
+};
+
+class BVH {
+  // Bounding volume hierarchy over the world space bounds of the objects,
+  // built with binned SAH. sdScene walks it front to back and skips every
+  // node that is farther away than the closest object found so far.
+  // - fractals and custom SDFs have no bounds. They are kept out of the tree
+  //   and listed after the bounded objects in getObjectIndices(), as are
+  //   the objects that build is told to keep out
+
+public:
+  // Builds the tree over the objects
+  void build(const std::vector<RayMarchObj> &objects,
+             const std::vector<bool> &keepOut = {});
+  // Removes every node
+  void clear();
+
+  // Gets the object space bounds of a primitive
+  // - returns false if the type is not bounded
+  static bool getLocalBounds(PrimitiveType type, glm::vec3 &min,
+                             glm::vec3 &max);
+  // Gets the world space bounds of an object
+  static bool getWorldBounds(const RayMarchObj &obj, glm::vec3 &min,
+                             glm::vec3 &max);
+
+  // Packs the nodes into BVH_NODE_TEXELS texels each
+  // - (min, leftOrFirst), (max, count)
+  void packNodes(std::vector<glm::vec4> &texels) const;
+
+  // Gets the nodes (root first, empty if no object is bounded)
+  const std::vector<BVHNode> &getNodes() const;
+  // Gets the object indices of the leaves followed by the unbounded objects
+  const std::vector<int> &getObjectIndices() const;
+  // Gets the number of unbounded objects (at the end of getObjectIndices())
+  int getNumUnbounded() const;
+  // Gets the depth of the tree
+  int getDepth() const;
+
+private:
+  // Object being sorted into the tree
+  struct Item {
+    glm::vec3 min, max, centroid;
+    int object;
+  };
+
+  // Fits the bounds of the node to its items and splits it, if it pays off
+  void subdivide(int nodeIdx, int depth);
+  // Finds the cheapest SAH split of the items of the node
+  // - returns the cost (FLT_MAX if the centroids do not spread)
+  float findSplit(const BVHNode &node, int &axis, float &pos) const;
+
+  std::vector<BVHNode> m_nodes;
+  std::vector<int> m_objectIndices;
+  std::vector<Item> m_items;
+  int m_numUnbounded = 0;
+  int m_depth = 0;
+};
+
+#endif // BVH_H
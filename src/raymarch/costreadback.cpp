@@ -0,0 +1,142 @@
+#include "costreadback.h"
+#include <algorithm>
+
+/**
+ * @brief Gets the mean per pixel of the channel
+ * @param channel Channel
+ * @returns Mean (0 if no frame was read back)
+ */
+double CostStats::getMean(CostChannel channel) const {
+  return pixels > 0 ? total[static_cast<int>(channel)] / pixels : 0.;
+}
+
+/**
+ * @brief Gets the max over the pixels of the channel
+ * @param channel Channel
+ */
+float CostStats::getMax(CostChannel channel) const {
+  return max[static_cast<int>(channel)];
+}
+
+/**
+ * @brief Creates two pixel buffers of width x height RGBA32F texels
+ * @param width Width of the cost target
+ * @param height Height of the cost target
+ */
+void CostReadback::initialize(int width, int height) {
+  m_width = width;
+  m_height = height;
+  glGenBuffers(2, m_pbos);
+  for (int i = 0; i < 2; i++) {
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, m_pbos[i]);
+    glBufferData(GL_PIXEL_PACK_BUFFER,
+                 (GLsizeiptr)width * height * 4 * sizeof(GLfloat), nullptr,
+                 GL_STREAM_READ);
+    m_pending[i] = false;
+  }
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+  m_buffer = 0;
+  m_initialized = true;
+}
+
+/**
+ * @brief Destroys the pixel buffers
+ * - the stats of the last frame are kept
+ */
+void CostReadback::finish() {
+  if (!m_initialized) {
+    return;
+  }
+  glDeleteBuffers(2, m_pbos);
+  m_initialized = false;
+}
+
+/**
+ * @brief Starts copying the cost target into the next pixel buffer
+ * - the copy of the last frame was issued a frame ago and is reduced now,
+ *   before the next frame reuses its buffer
+ * @param fbo FBO with the cost target attached
+ * @param attachment Color attachment of the cost target
+ */
+void CostReadback::read(GLuint fbo, GLenum attachment) {
+  if (!m_initialized) {
+    return;
+  }
+  m_buffer = 1 - m_buffer;
+  glBindFramebuffer(GL_READ_FRAMEBUFFER, fbo);
+  glReadBuffer(attachment);
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, m_pbos[m_buffer]);
+  // - into the buffer, so this returns without waiting for the pass
+  glReadPixels(0, 0, m_width, m_height, GL_RGBA, GL_FLOAT, nullptr);
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+  glReadBuffer(GL_COLOR_ATTACHMENT0);
+  glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+  m_pending[m_buffer] = true;
+  collect(1 - m_buffer);
+}
+
+/**
+ * @brief Reduces the copy of the latest frame, blocking until it is done
+ * - used by the headless renderer that only draws a few frames
+ */
+void CostReadback::flush() {
+  if (!m_initialized) {
+    return;
+  }
+  collect(m_buffer);
+}
+
+/**
+ * @brief Maps the pixel buffer and sums up every channel
+ * @param buffer Buffer to reduce (skipped if no copy is pending)
+ */
+void CostReadback::collect(int buffer) {
+  if (!m_pending[buffer]) {
+    return;
+  }
+  m_pending[buffer] = false;
+  int count = m_width * m_height;
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, m_pbos[buffer]);
+  const GLfloat *texels = static_cast<const GLfloat *>(
+      glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0,
+                       (GLsizeiptr)count * 4 * sizeof(GLfloat),
+                       GL_MAP_READ_BIT));
+  if (texels != nullptr) {
+    CostStats stats;
+    stats.pixels = count;
+    for (int i = 0; i < count; i++) {
+      for (int c = 0; c < NUM_COST_CHANNELS; c++) {
+        float v = texels[4 * i + c];
+        stats.total[c] += v;
+        stats.max[c] = std::max(stats.max[c], v);
+      }
+    }
+    m_stats = stats;
+    glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+  }
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+}
+
+/**
+ * @brief Gets the cost of the latest frame that was reduced
+ * @returns Stats (pixels is 0 until a frame was read back)
+ */
+const CostStats &CostReadback::getStats() const { return m_stats; }
+
+/**
+ * @brief Gets the display name of the channel
+ * @param channel Channel
+ */
+const char *CostReadback::getName(CostChannel channel) {
+  switch (channel) {
+  case CostChannel::COST_PRIMARY_STEPS:
+    return "primary steps";
+  case CostChannel::COST_SHADOW_STEPS:
+    return "shadow steps";
+  case CostChannel::COST_SDF_EVALS:
+    return "sdf evals";
+  case CostChannel::COST_ALL_STEPS:
+    return "all steps";
+  }
+  return "unknown";
+}
@@ -0,0 +1,76 @@
+#ifndef COSTREADBACK_H
+#define COSTREADBACK_H
+
+// Defined before including GLEW to suppress deprecation messages on macOS
+#ifdef __APPLE__
+#define GL_SILENCE_DEPRECATION
+#endif
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+// Channels of the march cost target (marchCost in raymarch.frag)
+enum class CostChannel {
+  COST_PRIMARY_STEPS,
+  COST_SHADOW_STEPS,
+  COST_SDF_EVALS,
+  COST_ALL_STEPS,
+};
+
+#define NUM_COST_CHANNELS 4
+
+// March cost of one frame, per channel
+struct CostStats {
+  // - pixels that were read back (0 until a frame was read back)
+  int pixels = 0;
+  // - sum and max over the pixels
+  glm::dvec4 total = glm::dvec4(0.);
+  glm::vec4 max = glm::vec4(0.f);
+
+  // Gets the mean per pixel of the channel
+  double getMean(CostChannel channel) const;
+  // Gets the max of the channel
+  float getMax(CostChannel channel) const;
+};
+
+class CostReadback {
+  // Reads the march cost target of a frame back to the CPU. The pixels are
+  // copied into one of two pixel buffer objects, which is only mapped when
+  // the next frame is read (a frame later), so the copy never stalls the
+  // pipeline.
+  // - the buffers have the size of the render resolution and are re-created
+  //   with the render targets
+
+public:
+  // Creates the pixel buffers for a width x height target
+  void initialize(int width, int height);
+  // Destroys the pixel buffers
+  void finish();
+
+  // Starts copying the color attachment of the FBO and reduces the copy of
+  // the last frame
+  void read(GLuint fbo, GLenum attachment);
+  // Waits for the copy of the latest frame (offline rendering only)
+  void flush();
+
+  // Gets the cost of the latest frame that was reduced
+  const CostStats &getStats() const;
+  // Gets the display name of the channel
+  static const char *getName(CostChannel channel);
+
+private:
+  // Maps the pixel buffer and reduces it into m_stats
+  void collect(int buffer);
+
+  bool m_initialized = false;
+  int m_width = 0;
+  int m_height = 0;
+  // Pixel buffers (RGBA32F) used on alternating frames
+  GLuint m_pbos[2];
+  // - true if a copy was issued into the buffer and not reduced yet
+  bool m_pending[2] = {};
+  // Buffer of the latest copy
+  int m_buffer = 0;
+  CostStats m_stats;
+};
+
+#endif // COSTREADBACK_H
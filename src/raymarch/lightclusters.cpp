@@ -0,0 +1,234 @@
+#include "lightclusters.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+/**
+ * @brief Gets the distance at which the attenuation of a light drops below
+ * LIGHT_CUTOFF (see attenuationFactor in raymarch.frag)
+ * - the brightest channel is min(1 / (c + l d + q d^2), 1) * color, so the
+ *   light is out of range once c + l d + q d^2 > color / LIGHT_CUTOFF
+ * @param light Point or spot light
+ * @returns Range (FLT_MAX if the light does not fall off)
+ */
+float LightClusters::getRange(const SceneLightData &light) {
+  float brightest = glm::max(light.color.r, glm::max(light.color.g,
+                                                     light.color.b));
+  const glm::vec3 &f = light.function;
+  float k = brightest / LIGHT_CUTOFF - f[0];
+  if (k <= 0.f) {
+    // - never brighter than the cutoff
+    return 0.f;
+  }
+  if (f[2] > 0.f) {
+    return (-f[1] + std::sqrt(f[1] * f[1] + 4.f * f[2] * k)) / (2.f * f[2]);
+  }
+  if (f[1] > 0.f) {
+    return k / f[1];
+  }
+  return FLT_MAX;
+}
+
+/**
+ * @brief Gets the bounding sphere of a light
+ * - point light: the sphere of its range
+ * - spot light: the sphere around its cone, cut off at the range (Wronski,
+ *   Cull that cone!). A wide cone is bounded by the circle of its base, a
+ *   narrow one by the sphere through its apex and its base
+ * @param light Light of the scene
+ * @param center Set to the center of the sphere
+ * @param radius Set to the radius of the sphere
+ * @returns False for directional and area lights, and lights that do not
+ * fall off
+ */
+bool LightClusters::getBounds(const SceneLightData &light, glm::vec3 &center,
+                              float &radius) {
+  if (light.type != LightType::LIGHT_POINT &&
+      light.type != LightType::LIGHT_SPOT) {
+    return false;
+  }
+  float range = getRange(light);
+  if (range == FLT_MAX) {
+    return false;
+  }
+  center = glm::vec3(light.pos);
+  radius = range;
+  if (light.type == LightType::LIGHT_SPOT && light.angle < M_PI / 2.f) {
+    glm::vec3 dir = glm::normalize(glm::vec3(light.dir));
+    float cosAngle = std::cos(light.angle);
+    if (light.angle > M_PI / 4.f) {
+      center += dir * range * cosAngle;
+      radius = range * std::sin(light.angle);
+    } else {
+      radius = range / (2.f * cosAngle);
+      center += dir * radius;
+    }
+  }
+  return true;
+}
+
+/**
+ * @brief Sets the lights and computes their bounds
+ * @param lights Lights of the scene
+ * @param numLights Number of lights that are uploaded (the first ones)
+ */
+void LightClusters::setLights(const std::vector<SceneLightData> &lights,
+                              int numLights) {
+  m_bounds.clear();
+  for (int i = 0; i < numLights; i++) {
+    Bounds b;
+    if (!getBounds(lights[i], b.center, b.radius)) {
+      b.radius = -1.f;
+    }
+    m_bounds.push_back(b);
+  }
+}
+
+/**
+ * @brief Gets the slice of a view space depth (see getCluster in
+ * raymarch.frag)
+ * @param depth Distance from the eye along the view direction
+ * @returns Slice (0 up to the near plane, the last one beyond the far plane)
+ */
+int LightClusters::getSlice(float depth) const {
+  if (depth <= m_near) {
+    return 0;
+  }
+  int slice = static_cast<int>(std::log(depth / m_near) * m_logScale);
+  return std::min(slice, CLUSTER_SLICES - 1);
+}
+
+/**
+ * @brief Adds a light to a cluster, unless it is full
+ */
+void LightClusters::add(int cluster, int light) {
+  int &count = m_counts[cluster];
+  if (count == MAX_CLUSTER_LIGHTS) {
+    m_numDropped++;
+    return;
+  }
+  m_lights[cluster * MAX_CLUSTER_LIGHTS + count] = light;
+  count++;
+}
+
+/**
+ * @brief Bins the lights into the clusters of a view
+ * - the tiles of a light are those of the screen space box around its
+ *   sphere. The projection of x / depth peaks at a corner of the view space
+ *   box of the sphere, so the corners give a conservative box
+ * - a sphere that reaches the near plane covers every tile of its slices
+ * @param view View matrix of the camera
+ * @param proj Projection matrix of the camera (symmetric perspective)
+ * @param near Near plane
+ * @param far Far plane
+ */
+void LightClusters::build(const glm::mat4 &view, const glm::mat4 &proj,
+                          float near, float far) {
+  // - NDC of the view space point (1, 1, -1), i.e. at depth 1
+  glm::vec4 clip = proj * glm::vec4(1.f, 1.f, -1.f, 1.f);
+  m_scale = glm::vec2(clip) / clip.w;
+  m_near = near;
+  m_logScale = CLUSTER_SLICES / std::log(far / near);
+  m_lights.assign(NUM_CLUSTERS * MAX_CLUSTER_LIGHTS, 0);
+  m_counts.assign(NUM_CLUSTERS, 0);
+  m_numDropped = 0;
+
+  // Unbounded lights reach every cluster
+  for (int i = 0; i < (int)m_bounds.size(); i++) {
+    if (m_bounds[i].radius < 0.f) {
+      for (int c = 0; c < NUM_CLUSTERS; c++) {
+        add(c, i);
+      }
+    }
+  }
+
+  // Bounded lights
+  auto toTile = [](float ndc, int tiles) {
+    int tile = static_cast<int>(std::floor((ndc * 0.5f + 0.5f) * tiles));
+    return std::clamp(tile, 0, tiles - 1);
+  };
+  for (int i = 0; i < (int)m_bounds.size(); i++) {
+    const Bounds &b = m_bounds[i];
+    if (b.radius <= 0.f) {
+      continue;
+    }
+    glm::vec3 c = glm::vec3(view * glm::vec4(b.center, 1.f));
+    float minDepth = -c.z - b.radius;
+    float maxDepth = -c.z + b.radius;
+    if (maxDepth <= 0.f) {
+      // - behind the camera
+      continue;
+    }
+    int minTile[2] = {0, 0};
+    int maxTile[2] = {CLUSTER_TILES_X - 1, CLUSTER_TILES_Y - 1};
+    if (minDepth > near) {
+      const int tiles[2] = {CLUSTER_TILES_X, CLUSTER_TILES_Y};
+      bool visible = true;
+      for (int axis = 0; axis < 2; axis++) {
+        float lo = FLT_MAX, hi = -FLT_MAX;
+        for (float x : {c[axis] - b.radius, c[axis] + b.radius}) {
+          for (float depth : {minDepth, maxDepth}) {
+            float ndc = m_scale[axis] * x / depth;
+            lo = std::min(lo, ndc);
+            hi = std::max(hi, ndc);
+          }
+        }
+        if (hi < -1.f || lo > 1.f) {
+          visible = false;
+          break;
+        }
+        minTile[axis] = toTile(lo, tiles[axis]);
+        maxTile[axis] = toTile(hi, tiles[axis]);
+      }
+      if (!visible) {
+        continue;
+      }
+    }
+    int minSlice = getSlice(minDepth), maxSlice = getSlice(maxDepth);
+    for (int z = minSlice; z <= maxSlice; z++) {
+      for (int y = minTile[1]; y <= maxTile[1]; y++) {
+        for (int x = minTile[0]; x <= maxTile[0]; x++) {
+          add((z * CLUSTER_TILES_Y + y) * CLUSTER_TILES_X + x, i);
+        }
+      }
+    }
+  }
+  m_maxLights = *std::max_element(m_counts.begin(), m_counts.end());
+}
+
+/**
+ * @brief Packs the clusters and their light indices into one buffer
+ * @param data Set to 2 ints per cluster (offset, count) followed by the
+ * light indices of every cluster
+ */
+void LightClusters::packClusters(std::vector<int> &data) const {
+  data.clear();
+  data.resize(2 * NUM_CLUSTERS);
+  for (int c = 0; c < NUM_CLUSTERS; c++) {
+    data[2 * c] = data.size();
+    data[2 * c + 1] = m_counts[c];
+    const int *lights = &m_lights[c * MAX_CLUSTER_LIGHTS];
+    data.insert(data.end(), lights, lights + m_counts[c]);
+  }
+}
+
+/**
+ * @brief Gets the scale from view space xy over the depth to NDC
+ */
+glm::vec2 LightClusters::getScale() const { return m_scale; }
+
+/**
+ * @brief Gets the factor of the log of depth / near that gives the slice
+ */
+float LightClusters::getLogScale() const { return m_logScale; }
+
+/**
+ * @brief Gets the max number of lights of a cluster in the last build
+ */
+int LightClusters::getMaxLights() const { return m_maxLights; }
+
+/**
+ * @brief Gets the number of lights left out of full clusters in the last
+ * build
+ */
+int LightClusters::getNumDropped() const { return m_numDropped; }
@@ -0,0 +1,87 @@
+#ifndef LIGHTCLUSTERS_H
+#define LIGHTCLUSTERS_H
+
+#include "utils/scenedata.h"
+#include <glm/glm.hpp>
+#include <vector>
+
+// Clusters of the view frustum: screen tiles times depth slices
+#define CLUSTER_TILES_X 16
+#define CLUSTER_TILES_Y 9
+#define CLUSTER_SLICES 24
+#define NUM_CLUSTERS (CLUSTER_TILES_X * CLUSTER_TILES_Y * CLUSTER_SLICES)
+// Max number of lights of a cluster
+// - the deferred shadow pass keeps the visibility of each (4 per layer)
+#define MAX_CLUSTER_LIGHTS 32
+// Contribution below which a light is out of range (one step of an 8 bit
+// color)
+#define LIGHT_CUTOFF (1.f / 256.f)
+// Texels (RGBA32F) per light in the light texture buffer
+#define LIGHT_TEXELS 9
+
+class LightClusters {
+  // Assigns the lights to the clusters of the view frustum, so that the
+  // shader only loops over the lights that reach the cluster of a point.
+  // - point and spot lights are bounded by a sphere: the distance at which
+  //   their attenuation drops below LIGHT_CUTOFF, and the cone of a spot
+  //   light. Directional and area lights reach everything and are in every
+  //   cluster
+  // - the slices split the depth exponentially between the near and the far
+  //   plane. The first slice starts at the eye and the last one has no end,
+  //   so every point in front of the camera inside the screen has a cluster
+  // - a cluster keeps at most MAX_CLUSTER_LIGHTS lights, in the order of the
+  //   scene, unbounded lights first
+
+public:
+  // Sets the lights and computes their bounds
+  void setLights(const std::vector<SceneLightData> &lights, int numLights);
+  // Bins the lights into the clusters of a view
+  void build(const glm::mat4 &view, const glm::mat4 &proj, float near,
+             float far);
+
+  // Packs the clusters and their light indices into one buffer
+  // - (offset, count) per cluster, then the indices. offset is the position
+  //   of the first index in the buffer
+  void packClusters(std::vector<int> &data) const;
+
+  // Gets the bounding sphere of a light
+  // - returns false if the light is not bounded
+  static bool getBounds(const SceneLightData &light, glm::vec3 &center,
+                        float &radius);
+  // Gets the distance at which the attenuation of a light drops below
+  // LIGHT_CUTOFF (infinite if it does not fall off)
+  static float getRange(const SceneLightData &light);
+
+  // Gets the scale from view space xy over the depth to NDC
+  glm::vec2 getScale() const;
+  // Gets the factor of the log of depth / near that gives the slice
+  float getLogScale() const;
+  // Gets the max number of lights of a cluster in the last build
+  int getMaxLights() const;
+  // Gets the number of lights left out of full clusters in the last build
+  int getNumDropped() const;
+
+private:
+  // Bounds of a light (radius < 0 if unbounded)
+  struct Bounds {
+    glm::vec3 center;
+    float radius;
+  };
+
+  // Gets the slice of a view space depth
+  int getSlice(float depth) const;
+  // Adds a light to a cluster, unless it is full
+  void add(int cluster, int light);
+
+  std::vector<Bounds> m_bounds;
+  // - MAX_CLUSTER_LIGHTS slots per cluster
+  std::vector<int> m_lights;
+  std::vector<int> m_counts;
+  glm::vec2 m_scale = glm::vec2(1.f);
+  float m_near = 0.1f;
+  float m_logScale = 1.f;
+  int m_maxLights = 0;
+  int m_numDropped = 0;
+};
+
+#endif // LIGHTCLUSTERS_H
@@ -0,0 +1,238 @@
+#include "passtimer.h"
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+/**
+ * @brief Creates two query objects per pass
+ */
+void PassTimer::initialize() {
+  glGenQueries(2 * NUM_RENDER_PASSES, &m_queries[0][0]);
+  m_initialized = true;
+  m_buffer = 0;
+  reset();
+}
+
+/**
+ * @brief Destroys the query objects
+ */
+void PassTimer::finish() {
+  if (!m_initialized) {
+    return;
+  }
+  glDeleteQueries(2 * NUM_RENDER_PASSES, &m_queries[0][0]);
+  m_initialized = false;
+}
+
+/**
+ * @brief Starts a new frame
+ * - the queries of this frame were last issued two frames ago. Their results
+ *   are read now (if ready) before they get overwritten
+ * - the sum of the results is the time of that frame. It is only kept if
+ *   every pass of the frame was ready, a frame with a missing pass would
+ *   look cheaper than it was
+ */
+void PassTimer::beginFrame() {
+  m_hasNewFrameTime = false;
+  if (!m_initialized) {
+    return;
+  }
+  m_buffer = 1 - m_buffer;
+  double frameTime = 0.;
+  bool collected = false, complete = true;
+  for (int pass = 0; pass < NUM_RENDER_PASSES; pass++) {
+    if (!m_pending[m_buffer][pass]) {
+      continue;
+    }
+    if (collect(m_buffer, pass, false)) {
+      frameTime += m_samples[pass].back();
+      collected = true;
+    } else {
+      complete = false;
+    }
+  }
+  if (collected && complete) {
+    m_lastFrameTime = frameTime;
+    m_hasNewFrameTime = true;
+  }
+}
+
+/**
+ * @brief Starts timing the pass
+ * @param pass Pass that is about to be issued
+ */
+void PassTimer::begin(RenderPass pass) {
+  if (!m_initialized) {
+    return;
+  }
+  glBeginQuery(GL_TIME_ELAPSED, m_queries[m_buffer][static_cast<int>(pass)]);
+}
+
+/**
+ * @brief Stops timing the pass
+ * @param pass Pass that was issued since begin(pass)
+ */
+void PassTimer::end(RenderPass pass) {
+  if (!m_initialized) {
+    return;
+  }
+  glEndQuery(GL_TIME_ELAPSED);
+  m_pending[m_buffer][static_cast<int>(pass)] = true;
+}
+
+/**
+ * @brief Blocks until the results of both buffers are read back
+ * - used by the headless renderer that only draws a few frames
+ */
+void PassTimer::flush() {
+  if (!m_initialized) {
+    return;
+  }
+  // Older buffer first so the samples stay in frame order
+  for (int i = 1; i <= 2; i++) {
+    int buffer = (m_buffer + i) % 2;
+    for (int pass = 0; pass < NUM_RENDER_PASSES; pass++) {
+      collect(buffer, pass, true);
+    }
+  }
+}
+
+/**
+ * @brief Drops every sample
+ */
+void PassTimer::reset() {
+  for (int pass = 0; pass < NUM_RENDER_PASSES; pass++) {
+    m_samples[pass].clear();
+  }
+  m_lastFrameTime = 0.;
+  m_hasNewFrameTime = false;
+}
+
+/**
+ * @brief Checks if the last beginFrame read back every pass of a frame
+ * - getLastFrameTime is the time of an older frame otherwise
+ */
+bool PassTimer::hasNewFrameTime() const { return m_hasNewFrameTime; }
+
+/**
+ * @brief Reads the result of a query if it is pending
+ * @param buffer Buffer of the query
+ * @param pass Pass of the query
+ * @param wait If false, the sample is dropped when the result is not ready
+ * @returns True if the sample was added
+ */
+bool PassTimer::collect(int buffer, int pass, bool wait) {
+  if (!m_pending[buffer][pass]) {
+    return false;
+  }
+  m_pending[buffer][pass] = false;
+  GLuint query = m_queries[buffer][pass];
+  if (!wait) {
+    GLint available = GL_FALSE;
+    glGetQueryObjectiv(query, GL_QUERY_RESULT_AVAILABLE, &available);
+    if (available == GL_FALSE) {
+      return false;
+    }
+  }
+  GLuint64 elapsed = 0;
+  glGetQueryObjectui64v(query, GL_QUERY_RESULT, &elapsed);
+  std::deque<double> &samples = m_samples[pass];
+  samples.push_back(elapsed * 1e-6);
+  if (samples.size() > PASS_TIMER_WINDOW) {
+    samples.pop_front();
+  }
+  return true;
+}
+
+/**
+ * @brief Computes the average and the percentiles of the pass
+ * - percentiles use the nearest rank
+ * @param pass Pass
+ * @returns Statistics in ms (all 0 if the pass did not run)
+ */
+PassStats PassTimer::getStats(RenderPass pass) const {
+  const std::deque<double> &samples = m_samples[static_cast<int>(pass)];
+  PassStats stats;
+  stats.samples = samples.size();
+  if (samples.empty()) {
+    return stats;
+  }
+  std::vector<double> sorted(samples.begin(), samples.end());
+  std::sort(sorted.begin(), sorted.end());
+  double sum = 0.;
+  for (double s : sorted) {
+    sum += s;
+  }
+  auto percentile = [&sorted](double p) {
+    int rank = std::ceil(p * sorted.size()) - 1;
+    return sorted[std::clamp(rank, 0, (int)sorted.size() - 1)];
+  };
+  stats.avg = sum / sorted.size();
+  stats.p50 = percentile(0.5);
+  stats.p95 = percentile(0.95);
+  stats.p99 = percentile(0.99);
+  return stats;
+}
+
+/**
+ * @brief Gets the GPU time of the latest frame that was read back
+ * @returns Sum of the passes of that frame in ms (0 if none yet)
+ */
+double PassTimer::getLastFrameTime() const { return m_lastFrameTime; }
+
+/**
+ * @brief Gets the display name of the pass
+ * @param pass Pass
+ */
+const char *PassTimer::getName(RenderPass pass) {
+  switch (pass) {
+  case RenderPass::PASS_REPROJECT:
+    return "reproject";
+  case RenderPass::PASS_PREPASS:
+    return "prepass";
+  case RenderPass::PASS_RAYMARCH:
+    return "raymarch";
+  case RenderPass::PASS_GBUFFER:
+    return "gbuffer";
+  case RenderPass::PASS_SHADOWS:
+    return "shadows";
+  case RenderPass::PASS_AO:
+    return "ao";
+  case RenderPass::PASS_LIGHTING:
+    return "lighting";
+  case RenderPass::PASS_ACCUMULATE:
+    return "accumulate";
+  case RenderPass::PASS_BLOOM:
+    return "bloom";
+  case RenderPass::PASS_POST:
+    return "post";
+  case RenderPass::PASS_UPSCALE:
+    return "upscale";
+  case RenderPass::PASS_FXAA:
+    return "fxaa";
+  }
+  return "unknown";
+}
+
+/**
+ * @brief Writes one row per pass: pass,samples,avg_ms,p50_ms,p95_ms,p99_ms
+ * @param filePath Path of the CSV file
+ * @returns True on success
+ */
+bool PassTimer::writeCSV(const std::string &filePath) const {
+  std::ofstream file(filePath);
+  if (!file.is_open()) {
+    std::cerr << "Error: Could not open \"" << filePath << "\"" << std::endl;
+    return false;
+  }
+  file << "pass,samples,avg_ms,p50_ms,p95_ms,p99_ms\n";
+  for (int i = 0; i < NUM_RENDER_PASSES; i++) {
+    RenderPass pass = static_cast<RenderPass>(i);
+    PassStats stats = getStats(pass);
+    file << getName(pass) << "," << stats.samples << "," << stats.avg << ","
+         << stats.p50 << "," << stats.p95 << "," << stats.p99 << "\n";
+  }
+  return file.good();
+}
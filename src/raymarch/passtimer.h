@@ -0,0 +1,101 @@
+#ifndef PASSTIMER_H
+#define PASSTIMER_H
+
+// Defined before including GLEW to suppress deprecation messages on macOS
+#ifdef __APPLE__
+#define GL_SILENCE_DEPRECATION
+#endif
+#include <GL/glew.h>
+
+#include <deque>
+#include <string>
+
+// Passes of the RayMarchRenderer pipeline that are timed
+enum class RenderPass {
+  PASS_REPROJECT,
+  PASS_PREPASS,
+  PASS_RAYMARCH,
+  // - deferred shading (instead of PASS_RAYMARCH)
+  PASS_GBUFFER,
+  PASS_SHADOWS,
+  PASS_AO,
+  PASS_LIGHTING,
+  PASS_ACCUMULATE,
+  PASS_BLOOM,
+  // - light effects and FXAA in one pass (FXAA has its own pass after the
+  //   upscale)
+  PASS_POST,
+  PASS_UPSCALE,
+  PASS_FXAA,
+};
+
+#define NUM_RENDER_PASSES 12
+#define PASS_TIMER_WINDOW 240
+
+// GPU time of a pass over the last PASS_TIMER_WINDOW frames (in ms)
+struct PassStats {
+  int samples = 0;
+  double avg = 0.;
+  double p50 = 0.;
+  double p95 = 0.;
+  double p99 = 0.;
+};
+
+class PassTimer {
+  // Measures the GPU time of every pass with GL_TIME_ELAPSED queries. Each
+  // pass has two query objects that are used on alternating frames, and the
+  // result of a query is only read back right before the query is reused (two
+  // frames later), so reading the timings never stalls the pipeline.
+  // - a result that is still not available by then is dropped
+  // - queries of GL_TIME_ELAPSED cannot nest, so the passes must not overlap
+
+public:
+  // Creates the query objects
+  void initialize();
+  // Destroys the query objects
+  void finish();
+
+  // Starts a new frame and collects the results that are ready
+  void beginFrame();
+  // Starts / stops timing the pass
+  void begin(RenderPass pass);
+  void end(RenderPass pass);
+  // Waits for every pending result (offline rendering only)
+  void flush();
+  // Drops every sample
+  void reset();
+
+  // Gets the rolling statistics of the pass
+  PassStats getStats(RenderPass pass) const;
+  // Gets the GPU time of every pass of the latest frame that was read back
+  // - in ms, 0 until a frame was read back
+  double getLastFrameTime() const;
+  // Checks if the last beginFrame read back every pass of a frame
+  bool hasNewFrameTime() const;
+  // Gets the display name of the pass
+  static const char *getName(RenderPass pass);
+  // Writes the statistics of every pass as CSV
+  bool writeCSV(const std::string &filePath) const;
+
+private:
+  // Reads the result of the query of the pass in the given buffer
+  // - wait: block until the result is available
+  // - returns true if a sample was added
+  bool collect(int buffer, int pass, bool wait);
+
+  bool m_initialized = false;
+  // Query objects [buffer][pass]
+  GLuint m_queries[2][NUM_RENDER_PASSES];
+  // - true if the query was issued and its result not read yet
+  bool m_pending[2][NUM_RENDER_PASSES] = {};
+  // Buffer used by the current frame
+  int m_buffer = 0;
+  // GPU time of the last frames in ms, oldest first
+  std::deque<double> m_samples[NUM_RENDER_PASSES];
+  // GPU time of the latest frame whose passes were all read back in ms
+  double m_lastFrameTime = 0.;
+  // - true if beginFrame read back a frame
+  bool m_hasNewFrameTime = false;
+};
+
+#endif // PASSTIMER_H
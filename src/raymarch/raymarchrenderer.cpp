@@ -0,0 +1,2584 @@
+#include "raymarchrenderer.h"
+#include "raymarch/sceneshader.h"
+#include "settings.h"
+#include "utils/ltc_matrix.h"
+#include "utils/shaderloader.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <filesystem>
+#include <iostream>
+
+// ======================== UTILITY FUNCTIONS ========================
+
+/**
+ * @brief Gets the location of a uniform
+ * - looked up once per shader program and cached afterwards
+ * @param shader Shader program
+ * @param var Name of the uniform
+ * @returns Location (-1 if the uniform is not active)
+ */
+GLint RayMarchRenderer::getUniformLocation(GLuint shader, const char *var) {
+  std::unordered_map<std::string, GLint> &locations =
+      m_uniformLocations[shader];
+  auto it = locations.find(var);
+  if (it != locations.end()) {
+    return it->second;
+  }
+  GLint loc = glGetUniformLocation(shader, var);
+  locations.emplace(var, loc);
+  return loc;
+}
+
+void RayMarchRenderer::setIntUniform(GLuint shader, const char *var,
+                                     int val) {
+  GLint loc = getUniformLocation(shader, var);
+  glUniform1i(loc, val);
+}
+
+void RayMarchRenderer::setFloatUniform(GLuint shader, const char *var,
+                                       float val) {
+  GLint loc = getUniformLocation(shader, var);
+  glUniform1f(loc, val);
+}
+
+void RayMarchRenderer::setMat4Uniform(GLuint shader, const char *var,
+                                      const glm::mat4 &mat) {
+  GLint loc = getUniformLocation(shader, var);
+  glUniformMatrix4fv(loc, 1, GL_FALSE, &mat[0][0]);
+}
+
+void RayMarchRenderer::setVec2Uniform(GLuint shader, const char *var,
+                                      const glm::vec2 &v) {
+  GLint loc = getUniformLocation(shader, var);
+  glUniform2fv(loc, 1, &v[0]);
+}
+
+void RayMarchRenderer::setVec3Uniform(GLuint shader, const char *var,
+                                      const glm::vec3 &v) {
+  GLint loc = getUniformLocation(shader, var);
+  glUniform3fv(loc, 1, &v[0]);
+}
+
+void RayMarchRenderer::setVec4Uniform(GLuint shader, const char *var,
+                                      const glm::vec4 &v) {
+  GLint loc = getUniformLocation(shader, var);
+  glUniform4fv(loc, 1, &v[0]);
+}
+
+// ===================================================================
+
+/**
+ * @brief Initializes GL and every resource used by the pipeline
+ * @param width Width of the render targets in pixels
+ * @param height Height of the render targets in pixels
+ */
+void RayMarchRenderer::initialize(int width, int height) {
+  glewExperimental = GL_TRUE;
+  GLenum err = glewInit();
+  if (err != GLEW_OK) {
+    std::cerr << "Error while initializing GL: " << glewGetErrorString(err)
+              << std::endl;
+  }
+  std::cout << "Initialized GL: Version " << glewGetString(GLEW_VERSION)
+            << std::endl;
+
+  glEnable(GL_DEPTH_TEST);
+  glEnable(GL_CULL_FACE);
+  // Set dimensions
+  scene.m_width = width;
+  scene.m_height = height;
+  m_renderWidth = width;
+  m_renderHeight = height;
+  glViewport(0, 0, scene.m_width, scene.m_height);
+
+  // =========== SETUP =============
+
+  // Load the shaders
+  // - the raymarch sources are kept to build the scene specialized variants
+  m_rayMarchVertCode =
+      ShaderLoader::readShaderFile(":/resources/raymarch.vert");
+  m_rayMarchFragCode =
+      ShaderLoader::readShaderFile(":/resources/raymarch.frag");
+  // - permutation of the default features until a scene is loaded
+  selectRayMarchShader();
+  // - let the driver compile the variants in the background
+  if (GLEW_KHR_parallel_shader_compile) {
+    glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+  } else if (GLEW_ARB_parallel_shader_compile) {
+    glMaxShaderCompilerThreadsARB(0xFFFFFFFF);
+  }
+  // - the post processing permutations are built on first use
+  m_postFragCode = ShaderLoader::readShaderFile(":/resources/post.frag");
+  m_debugShader = ShaderLoader::createShaderProgram(
+      ":/resources/fullscreen.vert", ":/resources/color.frag");
+  m_bloomShader = ShaderLoader::createShaderProgram(
+      ":/resources/fullscreen.vert", ":/resources/bloom.frag");
+  m_upscaleShader = ShaderLoader::createShaderProgram(
+      ":/resources/fullscreen.vert", ":/resources/upscale.frag");
+  m_reprojectShader = ShaderLoader::createShaderProgram(
+      ":/resources/reproject.vert", ":/resources/reproject.frag");
+  m_heatmapShader = ShaderLoader::createShaderProgram(
+      ":/resources/fullscreen.vert", ":/resources/heatmap.frag");
+
+  // Initialize the image plane through which we march rays
+  initImagePlane();
+  // Initialize the full screen quad
+  initFullScreenQuad();
+  // - the reprojection points are generated from gl_VertexID
+  glGenVertexArrays(1, &m_pointsVAO);
+  // Initialize any defaults
+  initDefaults();
+  // Initialize the custom FBO
+  initCustomFBO();
+  // Area Light Textures
+  loadMTexture();
+  loadLTUTexture();
+  // Initialize Custom Textures
+  initCustomTextures();
+  // Initialize the object and light buffers
+  initSceneBuffers();
+  // Initialize the shader
+  initShader();
+  // Create the GPU timer queries
+  m_passTimer.initialize();
+}
+
+/**
+ * @brief Terminating function. Destroys every GL resource
+ */
+void RayMarchRenderer::finish() {
+  // Destroy Shapes Textuers
+  destroyShapesTextures();
+
+  // Destroy Image Plane
+  glDeleteVertexArrays(1, &m_imagePlaneVAO);
+  glDeleteBuffers(1, &m_imagePlaneVBO);
+
+  // Destroy Full Screen Quad
+  glDeleteVertexArrays(1, &m_fullscreenVAO);
+  glDeleteBuffers(1, &m_fullscreenVBO);
+  glDeleteVertexArrays(1, &m_pointsVAO);
+
+  // Destroy Area Light Textures
+  glDeleteTextures(1, &m_mTexture);
+  glDeleteTextures(1, &m_ltuTexture);
+
+  // Destroy Defaults
+  glDeleteTextures(1, &m_defaultShapeTexture);
+  glDeleteTextures(1, &m_cubeMapTexture);
+  glDeleteTextures(1, &m_nullCubeMapTexture);
+  glDeleteTextures(1, &m_noiseTexture);
+  glDeleteTextures(1, &m_blueNoiseTexture);
+
+  // Destroy FBO
+  destroyCustomFBO();
+
+  // Destroy Object and Light Buffers
+  glDeleteTextures(1, &m_objectGeometryTexture);
+  glDeleteTextures(1, &m_objectMaterialTexture);
+  glDeleteBuffers(1, &m_objectGeometryBuffer);
+  glDeleteBuffers(1, &m_objectMaterialBuffer);
+  glDeleteTextures(1, &m_bvhNodeTexture);
+  glDeleteTextures(1, &m_bvhObjectTexture);
+  glDeleteBuffers(1, &m_bvhNodeBuffer);
+  glDeleteBuffers(1, &m_bvhObjectBuffer);
+  glDeleteTextures(1, &m_lightDataTexture);
+  glDeleteTextures(1, &m_lightClusterTexture);
+  glDeleteBuffers(1, &m_lightDataBuffer);
+  glDeleteBuffers(1, &m_lightClusterBuffer);
+  glDeleteBuffers(1, &m_lightUBO);
+  glDeleteTextures(1, &m_sdfCacheGridTexture);
+  glDeleteTextures(1, &m_sdfCacheAtlasTexture);
+
+  // Destroy Shaders
+  for (const auto &[defines, shader] : m_rayMarchPermutations) {
+    glDeleteProgram(shader);
+  }
+  m_rayMarchPermutations.clear();
+  m_shaderDefines.clear();
+  m_rayMarchShader = 0;
+  for (const auto &[hash, shader] : m_sceneShaders) {
+    glDeleteProgram(shader);
+  }
+  m_sceneShaders.clear();
+  if (m_pendingSceneShader != 0) {
+    ShaderLoader::deleteShaderProgram(m_pendingSceneShader);
+    m_pendingSceneShader = 0;
+  }
+  for (const auto &[defines, shader] : m_postShaders) {
+    glDeleteProgram(shader);
+  }
+  m_postShaders.clear();
+  glDeleteProgram(m_debugShader);
+  glDeleteProgram(m_bloomShader);
+  glDeleteProgram(m_upscaleShader);
+  glDeleteProgram(m_reprojectShader);
+  glDeleteProgram(m_heatmapShader);
+  m_uniformLocations.clear();
+
+  // Destroy Timer Queries
+  m_passTimer.finish();
+}
+
+/**
+ * @brief Draws the scene
+ */
+void RayMarchRenderer::render() {
+  if (!scene.isInitialized()) {
+    return;
+  }
+  // Perform Raymarch and render the scene
+  rayMarch();
+}
+
+/**
+ * @brief Resizes the scene and re-creates the render targets
+ * @param width New width in pixels
+ * @param height New height in pixels
+ */
+void RayMarchRenderer::resize(int width, int height) {
+  glViewport(0, 0, width, height);
+  scene.m_width = width;
+  scene.m_height = height;
+  // Destroy and re-Init FBO at the current render scale
+  // - also before a scene is loaded, so the targets always match the output
+  destroyCustomFBO();
+  m_renderWidth = std::max(1, (int)std::lround(width * m_renderScale));
+  m_renderHeight = std::max(1, (int)std::lround(height * m_renderScale));
+  initCustomFBO();
+  if (!scene.isInitialized()) {
+    return;
+  }
+  // Resize the scene and update the camera
+  scene.resizeScene(scene.m_width, scene.m_height);
+}
+
+/**
+ * @brief Loads the scene file given by settings.sceneFilePath
+ */
+void RayMarchRenderer::sceneChanged() {
+  // Upload the new objects and lights on the next frame
+  m_objectsDirty = true;
+  m_lightsDirty = true;
+  m_sdfCacheDirty = true;
+  resetAccumulation();
+  // - the surfaces of the last frame are gone
+  m_hitDepthValid = false;
+  // Generic shader until the variant of the new scene is ready
+  m_activeRayMarchShader = m_rayMarchShader;
+  if (scene.isInitialized()) {
+    // Destroy previous shapes textures
+    destroyShapesTextures();
+    m_isAreaLightUsed = false;
+  }
+  if (settings.reset) {
+    scene.resetScene();
+    settings.reset = false;
+    return;
+  }
+  // Initialize the Raymarch scene
+  scene.initScene(settings, m_isAreaLightUsed);
+  // Initialize the textures
+  initShapesTextures();
+  // Compile the features of the scene and specialize it
+  selectRayMarchShader();
+  m_activeRayMarchShader = m_rayMarchShader;
+  requestSceneShader();
+  // Clear the seed
+  m_juliaSeed = glm::vec2(0.f);
+  // Update the dim
+  m_twoDSpace = settings.twoDSpace;
+}
+
+/**
+ * @brief Applies the latest settings to the scene and the render options
+ */
+void RayMarchRenderer::settingsChanged() {
+  if (!scene.isInitialized()) {
+    return;
+  }
+  // Update the camera
+  scene.updateScene(settings);
+  // Update the options
+  updateUISettings();
+  // Samples of the previous settings no longer apply
+  resetAccumulation();
+}
+
+/**
+ * @brief Renders the current frame into an offscreen target of the current
+ * size and reads it back
+ * - with accumulation enabled, the frame is the mean of the sample budget
+ * @returns Rendered frame (top row first)
+ */
+QImage RayMarchRenderer::renderToImage() {
+  int width = scene.m_width;
+  int height = scene.m_height;
+
+  // Offscreen target
+  GLuint fbo, texture, rbo;
+  glGenTextures(1, &texture);
+  glBindTexture(GL_TEXTURE_2D, texture);
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA,
+               GL_UNSIGNED_BYTE, nullptr);
+  glBindTexture(GL_TEXTURE_2D, 0);
+  glGenRenderbuffers(1, &rbo);
+  glBindRenderbuffer(GL_RENDERBUFFER, rbo);
+  glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+  glBindRenderbuffer(GL_RENDERBUFFER, 0);
+  glGenFramebuffers(1, &fbo);
+  glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+  glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D,
+                         texture, 0);
+  glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT,
+                            GL_RENDERBUFFER, rbo);
+
+  QImage image;
+  if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+    std::cerr << "Error: Offscreen framebuffer is not complete!" << std::endl;
+  } else {
+    // Render into the offscreen target
+    GLuint prevOutput = m_defaultFBO;
+    m_defaultFBO = fbo;
+    // - there is no next frame, so bake the SDF cache before it
+    updateSDFCache(true);
+    render();
+    // - there is no next frame, so draw every sample of the budget now
+    while (scene.isInitialized() && m_enableAccumulation &&
+           !isTimeDependent() && m_sampleCount < m_sampleBudget) {
+      render();
+    }
+    m_defaultFBO = prevOutput;
+
+    // Read back
+    image = QImage(width, height, QImage::Format_RGBA8888);
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, image.bits());
+    // GL origin is bottom left
+    image = image.mirrored();
+  }
+
+  // Clean up
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+  glDeleteTextures(1, &texture);
+  glDeleteRenderbuffers(1, &rbo);
+  glDeleteFramebuffers(1, &fbo);
+  return image;
+}
+
+/**
+ * @brief Checks if the frame changes on its own
+ * - a specialized shader that is still being built is swapped in by a frame,
+ *   and so is an SDF cache that is still being baked
+ * - the accumulation adds a sample per frame until the sample budget
+ * @returns True if the frame must be redrawn even when nothing changed
+ */
+bool RayMarchRenderer::needsRedraw() {
+  if (!scene.isInitialized()) {
+    return false;
+  }
+  if (m_pendingSceneShader != 0 || m_sdfCacheBake.valid() ||
+      isTimeDependent()) {
+    return true;
+  }
+  return m_enableAccumulation && m_sampleCount < m_sampleBudget;
+}
+
+/**
+ * @brief Gets the number of samples in the accumulation buffer
+ */
+int RayMarchRenderer::getSampleCount() { return m_sampleCount; }
+
+/**
+ * @brief Gets the scale of the render resolution relative to the output
+ */
+float RayMarchRenderer::getRenderScale() { return m_renderScale; }
+
+/**
+ * @brief Checks if the frame depends on iTime
+ * - iTime drives the procedural environments, the night sky, the 2D
+ *   Mandelbrot zoom and the animated SDFs (sdCUSTOM is assumed animated)
+ */
+bool RayMarchRenderer::isTimeDependent() {
+  if (m_twoDSpace) {
+    return true;
+  }
+  for (const std::string &define : m_shaderDefines) {
+    if (define == "CLOUD" || define == "SEA" ||
+        define == "NIGHTSKY_BACKGROUND") {
+      return true;
+    }
+  }
+  for (const RayMarchObj &obj : scene.getShapes()) {
+    if (obj.m_type == PrimitiveType::MANDELBROT ||
+        obj.m_type == PrimitiveType::MENGERSPONGE ||
+        obj.m_type == PrimitiveType::CUSTOM) {
+      return true;
+    }
+  }
+  return false;
+}
+
+/**
+ * @brief Sets the FBO that the last pass of the pipeline writes to
+ * @param fbo Output FBO
+ */
+void RayMarchRenderer::setOutputFBO(GLuint fbo) { m_defaultFBO = fbo; }
+
+/**
+ * @brief Sets the time that is fed to iTime
+ * @param time Time in seconds
+ */
+void RayMarchRenderer::setTime(float time) { m_time = time; }
+
+/**
+ * @brief Makes the raymarch pass write the march cost of every pixel next to
+ * its color, and read it back every frame (see getCostReadback)
+ * @param enabled True to write the cost
+ */
+void RayMarchRenderer::setCostOutput(bool enabled) { m_costOutput = enabled; }
+
+/**
+ * @brief Gets the scene
+ * @returns RayMarchScene rendered by this renderer
+ */
+RayMarchScene &RayMarchRenderer::getScene() { return scene; }
+
+/**
+ * @brief Gets the GPU timings of the passes
+ * @returns Pass timer
+ */
+PassTimer &RayMarchRenderer::getPassTimer() { return m_passTimer; }
+
+/**
+ * @brief Gets the march cost of the frames
+ * @returns Readback of the cost target (empty unless the cost is written)
+ */
+CostReadback &RayMarchRenderer::getCostReadback() { return m_costReadback; }
+
+/**
+ * @brief Performs Raymarching using our raymarch shader
+ * - Set the shader
+ * - Set the output FBO
+ *   - If FXAA enabled, offline render first
+ *   - Else just render to the wnd
+ * - Set the uniforms
+ * - Draws the Blank Screen
+ * - Once the view stops changing, every frame adds a jittered sample to the
+ *   accumulation buffer and the post processing reads the running mean
+ * - The cost heatmap replaces the image and every pass after the raymarch
+ *   pass
+ */
+void RayMarchRenderer::rayMarch() {
+  m_passTimer.beginFrame();
+  // Pick the render resolution before anything is drawn into the targets
+  updateRenderScale();
+  bool lightEffects = m_enableHDR || m_enableGammaCorrection || m_enableBloom;
+  bool upscale = isUpscaling();
+  bool heatmap = m_costHeatmap > 0;
+  bool cost = m_costOutput || heatmap;
+  m_sampleIndex = nextAccumulationSample();
+  // - the hit depth of the last frame only holds in a static scene
+  // - a jittered sample is not reprojected, nor is its hit depth kept. It is
+  //   along the jittered ray, and a sample that missed a thin edge would
+  //   make every later one start behind it
+  bool reproject = m_enableReprojection && !m_twoDSpace &&
+                   !isTimeDependent() && m_sampleIndex <= 0;
+  // - a converged buffer is only presented again
+  if (m_sampleIndex >= 0) {
+    // Scatter the surfaces of the last frame into this view
+    bool reprojected = reproject && m_hitDepthValid;
+    if (reprojected) {
+      m_passTimer.begin(RenderPass::PASS_REPROJECT);
+      reprojectHitDepth();
+      m_passTimer.end(RenderPass::PASS_REPROJECT);
+    }
+
+    // Deferred shading splits the raymarch pass into the G-buffer, shadow,
+    // AO and lighting passes
+    // - shadows and AO below the render resolution need those passes
+    bool deferred =
+        (m_enableDeferred || m_lightingScale > 1) && canDefer();
+    // Set ray march shader (the G-buffer pass, or the forward shader
+    // specialized for the scene, if ready)
+    GLuint shader =
+        deferred ? getPassShader("GBUFFER_PASS") : m_activeRayMarchShader;
+    glUseProgram(shader);
+    // Set Uniforms
+    configureRayMarchUniforms(shader);
+
+    // Start depth of the primary rays
+    bool prepass = m_enableDepthPrepass && !m_twoDSpace;
+    if (prepass) {
+      m_passTimer.begin(RenderPass::PASS_PREPASS);
+      renderDepthPrepass(shader);
+      m_passTimer.end(RenderPass::PASS_PREPASS);
+    }
+
+    RenderPass pass =
+        deferred ? RenderPass::PASS_GBUFFER : RenderPass::PASS_RAYMARCH;
+    m_passTimer.begin(pass);
+    // Set FBO
+    // - if FXAA, HDR, Bloom, gamma correction, accumulation, upscaling,
+    //   reprojection or the march cost enabled, render offline first
+    bool offscreen = m_enableFXAA || lightEffects || m_sampleIndex > 0 ||
+                     upscale || reproject || cost;
+    // - the primary hits of the deferred passes go to the G-buffer and are
+    //   shaded below
+    GLuint fbo = deferred ? m_gbufferFBO : getFrameFBO();
+    if (deferred || reproject || cost) {
+      setRaymarchOutputs(fbo, reproject, cost);
+    }
+    if (deferred || offscreen) {
+      setFBO(fbo);
+    } else {
+      // Else go straight to application window
+      setFBO(m_defaultFBO);
+    }
+    setIntUniform(shader, "usePrepass", prepass);
+    glActiveTexture(GL_TEXTURE0 + PREPASS_TEX_UNIT_OFF);
+    glBindTexture(GL_TEXTURE_2D, m_prepassTexture);
+    setIntUniform(shader, "useReprojection", reprojected);
+    glActiveTexture(GL_TEXTURE0 + REPROJECTION_TEX_UNIT_OFF);
+    glBindTexture(GL_TEXTURE_2D, m_reprojectTexture);
+
+    // Draw
+    glBindVertexArray(m_imagePlaneVAO);
+    glDrawArrays(GL_TRIANGLES, 0, 6);
+    // Un-set
+    glBindVertexArray(0);
+    glUseProgram(0);
+    m_passTimer.end(pass);
+
+    // Copy the march cost while it is attached
+    if (cost) {
+      m_costReadback.read(fbo, GL_COLOR_ATTACHMENT3);
+    }
+    if (deferred || reproject || cost) {
+      setRaymarchOutputs(fbo, false, false);
+    }
+    if (deferred) {
+      renderDeferredPasses(offscreen);
+    }
+    // Keep the hit depth and its camera for the next frame
+    if (reproject) {
+      Camera &cam = scene.getCamera();
+      m_hitDepthInvProjView =
+          glm::inverse(cam.getProjMatrix() * cam.getViewMatrix());
+      m_hitDepthEye = glm::vec3(cam.getCameraPosition());
+    }
+    // - the jittered samples leave the hit depth of the first frame
+    if (m_sampleIndex == 0) {
+      m_hitDepthValid = reproject;
+    }
+  }
+
+  // Add the sample to the running mean
+  if (m_sampleIndex > 0) {
+    m_passTimer.begin(RenderPass::PASS_ACCUMULATE);
+    accumulateSample();
+    m_passTimer.end(RenderPass::PASS_ACCUMULATE);
+  }
+  bool accumulated = m_sampleIndex != 0;
+
+  // The heatmap is the whole frame
+  if (heatmap) {
+    drawCostHeatmap();
+    pollSceneShader();
+    return;
+  }
+
+  // Blur the bright colors, which the post pass adds
+  if (lightEffects && m_enableBloom) {
+    m_passTimer.begin(RenderPass::PASS_BLOOM);
+    applyBloom();
+    m_passTimer.end(RenderPass::PASS_BLOOM);
+  }
+
+  // Apply HDR, Bloom, gamma correction and FXAA, if enabled
+  GLuint frame = accumulated    ? m_accumTexture
+                 : lightEffects ? m_hdrTexture
+                                : m_customFBOColorTexture;
+  if (upscale) {
+    // - below the output resolution the light effects are applied at the
+    //   render resolution and FXAA at the output size, after the upscale
+    if (lightEffects || accumulated) {
+      m_passTimer.begin(RenderPass::PASS_POST);
+      applyPost(frame, m_customFBO, lightEffects, false);
+      m_passTimer.end(RenderPass::PASS_POST);
+    }
+    m_passTimer.begin(RenderPass::PASS_UPSCALE);
+    applyUpscale();
+    m_passTimer.end(RenderPass::PASS_UPSCALE);
+    if (m_enableFXAA) {
+      m_passTimer.begin(RenderPass::PASS_FXAA);
+      applyPost(m_upscaleTexture, m_defaultFBO, false, true);
+      m_passTimer.end(RenderPass::PASS_FXAA);
+    }
+  } else if (lightEffects || accumulated || m_enableFXAA || reproject ||
+             cost) {
+    // - straight from the frame to the output FBO. It was only rendered
+    //   offline for the hit depth or the march cost if nothing is enabled
+    m_passTimer.begin(RenderPass::PASS_POST);
+    applyPost(frame, m_defaultFBO, lightEffects, m_enableFXAA);
+    m_passTimer.end(RenderPass::PASS_POST);
+  }
+
+  // Swap in the specialized shader for the next frame
+  pollSceneShader();
+}
+
+/**
+ * @brief Cone marches the depth from which the primary rays of each
+ * DEPTH_PREPASS_TILE x DEPTH_PREPASS_TILE tile can start
+ * - one fragment per tile. The viewport of the prepass is scaled in NDC so
+ *   that the ray of a fragment goes through the center of its tile
+ * - the cone around that ray holds every pixel of the tile plus one pixel of
+ *   slack for the jitter of the accumulation. Pixels off the center of the
+ *   screen cover a smaller angle, so the center is the widest case
+ * @param shader Raymarch shader with the uniforms of the frame set
+ */
+void RayMarchRenderer::renderDepthPrepass(GLuint shader) {
+  glBindFramebuffer(GL_FRAMEBUFFER, m_prepassFBO);
+  glViewport(0, 0, m_prepassWidth, m_prepassHeight);
+  glm::vec2 rayScale =
+      glm::vec2(m_prepassWidth, m_prepassHeight) * float(DEPTH_PREPASS_TILE) /
+      glm::vec2(m_renderWidth, m_renderHeight);
+  // - [1][1] is 1 / tan(fov / 2), so a pixel spans this much per unit depth
+  float pixelSize =
+      2.f / (scene.getCamera().getProjMatrix()[1][1] * m_renderHeight);
+  float tileRadius = (DEPTH_PREPASS_TILE / 2.f + 1.f) * std::sqrt(2.f);
+  setIntUniform(shader, "depthPrepass", true);
+  setVec2Uniform(shader, "rayScale", rayScale);
+  setFloatUniform(shader, "coneRadius", tileRadius * pixelSize);
+  glBindVertexArray(m_imagePlaneVAO);
+  glDrawArrays(GL_TRIANGLES, 0, 6);
+  glBindVertexArray(0);
+  setIntUniform(shader, "depthPrepass", false);
+  setVec2Uniform(shader, "rayScale", glm::vec2(1.f));
+}
+
+/**
+ * @brief Scatters the hit depth of the last frame into the current view
+ * - every texel that hit a surface becomes a point on that surface, which is
+ *   projected with the current camera. The nearest point that lands on a
+ *   pixel gives its depth
+ * - pixels that no point lands on were disoccluded (or showed the sky) and
+ *   keep 0. getStartDepth in raymarch.frag takes the min over the 3x3
+ *   pixels around a pixel, so the rays next to them start at the eye too.
+ *   That also covers the gaps between the points of a magnified surface,
+ *   where points of the surface behind it may land
+ */
+void RayMarchRenderer::reprojectHitDepth() {
+  Camera &cam = scene.getCamera();
+  glBindFramebuffer(GL_FRAMEBUFFER, m_reprojectFBO);
+  glViewport(0, 0, m_renderWidth, m_renderHeight);
+  glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+  glUseProgram(m_reprojectShader);
+  setMat4Uniform(m_reprojectShader, "prevInvProjViewMatrix",
+                 m_hitDepthInvProjView);
+  setVec3Uniform(m_reprojectShader, "prevEyePosition", m_hitDepthEye);
+  setMat4Uniform(m_reprojectShader, "projViewMatrix",
+                 cam.getProjMatrix() * cam.getViewMatrix());
+  setVec3Uniform(m_reprojectShader, "eyePosition",
+                 glm::vec3(cam.getCameraPosition()));
+  glActiveTexture(GL_TEXTURE0 + HIT_DEPTH_TEX_UNIT_OFF);
+  glBindTexture(GL_TEXTURE_2D, m_hitDepthTexture);
+  glBindVertexArray(m_pointsVAO);
+  glDrawArrays(GL_POINTS, 0, m_renderWidth * m_renderHeight);
+  glBindVertexArray(0);
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+  glUseProgram(0);
+}
+
+/**
+ * @brief Turns the hit depth and the march cost on (or off) as the third and
+ * fourth outputs of a frame FBO or the G-buffer
+ * - both stay attached (see initCustomFBO), only the draw buffers change.
+ *   They are turned off again after the pass, so the later passes that draw
+ *   into the FBO leave them as they are
+ * - the G-buffer always draws its trap and custom id targets as well
+ * @param fbo Custom FBO, HDR FBO or G-buffer
+ * @param hitDepth True to draw the hit depth
+ * @param cost True to draw the march cost
+ */
+void RayMarchRenderer::setRaymarchOutputs(GLuint fbo, bool hitDepth,
+                                          bool cost) {
+  glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+  GLuint attachments[6] = {GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1,
+                           GL_NONE,              GL_NONE,
+                           GL_COLOR_ATTACHMENT4, GL_COLOR_ATTACHMENT5};
+  if (hitDepth) {
+    attachments[2] = GL_COLOR_ATTACHMENT2;
+  }
+  if (cost) {
+    attachments[3] = GL_COLOR_ATTACHMENT3;
+  }
+  if (fbo == m_gbufferFBO) {
+    glDrawBuffers(6, attachments);
+  } else {
+    glDrawBuffers(cost ? 4 : hitDepth ? 3 : 2, attachments);
+  }
+}
+
+/**
+ * @brief Checks if the scene can be shaded from the G-buffer
+ * - the environments (cloud, terrain, sea) are marched along with the
+ *   objects and 2D scenes have no surfaces, so both stay forward
+ * @returns True if deferred shading can be used
+ */
+bool RayMarchRenderer::canDefer() {
+  const SceneShaderFeatures &features = scene.getGlobalData().features;
+  return !m_twoDSpace && !features.cloud && !features.terrain &&
+         !features.sea;
+}
+
+/**
+ * @brief Runs the passes of the deferred shading after the G-buffer pass
+ * - shadows: the visibility of 4 lights per layer of the shadow texture, one
+ *   draw per layer
+ * - AO: only if enabled
+ * - both are drawn at the render resolution divided by m_lightingScale
+ * - lighting: shades the G-buffer with both (upsampled with a bilateral
+ *   filter) into the same target as the forward raymarch pass. Reflection
+ *   and refraction rays are still marched there
+ * @param offscreen True if the lighting pass draws into the custom FBO
+ */
+void RayMarchRenderer::renderDeferredPasses(bool offscreen) {
+  // G-buffer, read by every pass
+  glActiveTexture(GL_TEXTURE0 + GBUFFER_POSITION_TEX_UNIT_OFF);
+  glBindTexture(GL_TEXTURE_2D, m_gPositionTexture);
+  glActiveTexture(GL_TEXTURE0 + GBUFFER_NORMAL_TEX_UNIT_OFF);
+  glBindTexture(GL_TEXTURE_2D, m_gNormalTexture);
+  glActiveTexture(GL_TEXTURE0 + GBUFFER_TRAP_TEX_UNIT_OFF);
+  glBindTexture(GL_TEXTURE_2D, m_gTrapTexture);
+  glActiveTexture(GL_TEXTURE0 + GBUFFER_CUSTOM_ID_TEX_UNIT_OFF);
+  glBindTexture(GL_TEXTURE_2D, m_gCustomIdTexture);
+  glBindVertexArray(m_imagePlaneVAO);
+
+  // Shadows
+  // - the layers hold the lights of the cluster of a texel, so the fullest
+  //   cluster decides how many are drawn
+  int numSlots = m_lightClusters.getMaxLights();
+  if (numSlots > 0) {
+    m_passTimer.begin(RenderPass::PASS_SHADOWS);
+    GLuint shader = getPassShader("SHADOW_PASS");
+    glUseProgram(shader);
+    configureRayMarchUniforms(shader);
+    glBindFramebuffer(GL_FRAMEBUFFER, m_shadowFBO);
+    glViewport(0, 0, m_lightingWidth, m_lightingHeight);
+    for (int first = 0; first < numSlots; first += 4) {
+      glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                                m_shadowTexture, 0, first / 4);
+      setIntUniform(shader, "firstSlot", first);
+      glDrawArrays(GL_TRIANGLES, 0, 6);
+    }
+    m_passTimer.end(RenderPass::PASS_SHADOWS);
+  }
+
+  // Ambient Occlusion
+  if (m_enableAmbientOcclusion) {
+    m_passTimer.begin(RenderPass::PASS_AO);
+    GLuint shader = getPassShader("AO_PASS");
+    glUseProgram(shader);
+    configureRayMarchUniforms(shader);
+    glBindFramebuffer(GL_FRAMEBUFFER, m_aoFBO);
+    glViewport(0, 0, m_lightingWidth, m_lightingHeight);
+    glDrawArrays(GL_TRIANGLES, 0, 6);
+    m_passTimer.end(RenderPass::PASS_AO);
+  }
+
+  // Lighting
+  m_passTimer.begin(RenderPass::PASS_LIGHTING);
+  GLuint shader = getPassShader("LIGHTING_PASS");
+  glUseProgram(shader);
+  configureRayMarchUniforms(shader);
+  setFBO(offscreen ? getFrameFBO() : m_defaultFBO);
+  glActiveTexture(GL_TEXTURE0 + SHADOW_TEX_UNIT_OFF);
+  glBindTexture(GL_TEXTURE_2D_ARRAY, m_shadowTexture);
+  glActiveTexture(GL_TEXTURE0 + AO_TEX_UNIT_OFF);
+  glBindTexture(GL_TEXTURE_2D, m_aoTexture);
+  glDrawArrays(GL_TRIANGLES, 0, 6);
+  m_passTimer.end(RenderPass::PASS_LIGHTING);
+
+  glBindVertexArray(0);
+  glUseProgram(0);
+}
+
+/**
+ * @brief Draws the channel of the march cost picked by the display option
+ * - straight to the output FBO, so FXAA and the upscale are skipped
+ * - scaled by the max of the latest frame that was read back
+ */
+void RayMarchRenderer::drawCostHeatmap() {
+  CostChannel channel = static_cast<CostChannel>(m_costHeatmap - 1);
+  glUseProgram(m_heatmapShader);
+  setFBO(m_defaultFBO);
+  setIntUniform(m_heatmapShader, "channel", static_cast<int>(channel));
+  setFloatUniform(m_heatmapShader, "maxCost",
+                  m_costReadback.getStats().getMax(channel));
+  drawToQuadWithTex(m_costTexture);
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+  glUseProgram(0);
+}
+
+/**
+ * @brief Picks the sample of the progressive accumulation for this frame
+ * - the first frame of a view is drawn as usual, so moving the camera costs
+ *   nothing extra. The following frames are jittered samples 1, 2, ... up to
+ *   the sample budget, after which the buffer is only presented
+ * - a camera change is detected here. Scene, settings and size changes reset
+ *   the buffer explicitly
+ * @returns Sample index (0 for a regular frame, -1 if converged)
+ */
+int RayMarchRenderer::nextAccumulationSample() {
+  Camera &cam = scene.getCamera();
+  glm::mat4 projView = cam.getProjMatrix() * cam.getViewMatrix();
+  if (projView != m_accumProjView) {
+    m_accumProjView = projView;
+    resetAccumulation();
+  }
+  if (!m_enableAccumulation || isTimeDependent()) {
+    // - samples of different times cannot be averaged
+    resetAccumulation();
+    return 0;
+  }
+  if (!m_accumPrimed) {
+    m_accumPrimed = true;
+    return 0;
+  }
+  if (m_sampleCount >= m_sampleBudget) {
+    return -1;
+  }
+  return ++m_sampleCount;
+}
+
+/**
+ * @brief Blends the sample in the HDR texture into the accumulation buffer
+ * - with weight 1 / n the buffer holds the mean of the n samples
+ */
+void RayMarchRenderer::accumulateSample() {
+  glBindFramebuffer(GL_FRAMEBUFFER, m_accumFBO);
+  glViewport(0, 0, m_renderWidth, m_renderHeight);
+  glUseProgram(m_debugShader);
+  glEnable(GL_BLEND);
+  glBlendColor(0.f, 0.f, 0.f, 1.f / m_sampleIndex);
+  glBlendFunc(GL_CONSTANT_ALPHA, GL_ONE_MINUS_CONSTANT_ALPHA);
+  drawToQuadWithTex(m_hdrTexture);
+  glDisable(GL_BLEND);
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+  glUseProgram(0);
+}
+
+/**
+ * @brief Drops the accumulated samples
+ * - the next frame is drawn as usual and starts a new accumulation
+ */
+void RayMarchRenderer::resetAccumulation() {
+  m_sampleCount = 0;
+  m_accumPrimed = false;
+}
+
+/**
+ * @brief Starts building the raymarch shader specialized for the scene
+ * - variants are cached by the hash of their source, so reloading a scene
+ *   reuses its shader
+ * - the generic shader is used until the variant is ready
+ */
+void RayMarchRenderer::requestSceneShader() {
+  const std::vector<RayMarchObj> &objects = scene.getShapes();
+  if (!SceneShader::canSpecialize(objects)) {
+    return;
+  }
+  std::string code = SceneShader::specialize(
+      m_rayMarchFragCode, SceneShader::generateSDScene(objects));
+  if (code.empty()) {
+    return;
+  }
+  std::vector<std::string> defines = m_shaderDefines;
+  defines.push_back("SPECIALIZED_SCENE");
+  code = ShaderLoader::injectDefines(code, defines);
+  size_t hash = std::hash<std::string>{}(code);
+  auto it = m_sceneShaders.find(hash);
+  if (it != m_sceneShaders.end()) {
+    // - 0 if the variant failed to build before
+    if (it->second != 0) {
+      m_activeRayMarchShader = it->second;
+    }
+    return;
+  }
+  if (m_pendingSceneShader != 0) {
+    if (m_pendingSceneHash == hash) {
+      return;
+    }
+    // Drop the variant of the previous scene
+    ShaderLoader::deleteShaderProgram(m_pendingSceneShader);
+  }
+  m_pendingSceneShader =
+      ShaderLoader::beginShaderProgram(m_rayMarchVertCode, code);
+  m_pendingSceneHash = hash;
+}
+
+/**
+ * @brief Switches to the specialized raymarch shader once it is built
+ * - without parallel shader compile this waits for the driver, but only
+ *   after the first frame of the scene was drawn with the generic shader
+ */
+void RayMarchRenderer::pollSceneShader() {
+  if (m_pendingSceneShader == 0 ||
+      !ShaderLoader::isShaderProgramReady(m_pendingSceneShader)) {
+    return;
+  }
+  GLuint shader = m_pendingSceneShader;
+  m_pendingSceneShader = 0;
+  try {
+    ShaderLoader::finishShaderProgram(shader);
+  } catch (const std::runtime_error &e) {
+    std::cerr << "Error: Specialized raymarch shader failed to build, using "
+                 "the generic one\n"
+              << e.what() << std::endl;
+    m_sceneShaders[m_pendingSceneHash] = 0;
+    return;
+  }
+  initRayMarchShader(shader);
+  m_sceneShaders[m_pendingSceneHash] = shader;
+  m_activeRayMarchShader = shader;
+}
+
+/**
+ * @brief Applies Bloom with a mip chain of the bright colors
+ * - downsamples the bright colors into every level of the chain, each from
+ *   the level before it, then upsamples from the smallest level back to
+ *   level 0, adding every level onto the next larger one
+ * - level 0 ends up with the sum of every level, which the light effects
+ *   pass scales by 1 / m_bloomMipCount
+ * - every pass reads a target 4x (downsample) or 1/4 (upsample) the size of
+ *   the one it writes, so the chain costs less than two passes at the
+ *   render resolution
+ */
+void RayMarchRenderer::applyBloom() {
+  glUseProgram(m_bloomShader);
+  // Downsample
+  setIntUniform(m_bloomShader, "upsample", false);
+  GLuint src = m_bloomBrightnessTexture;
+  for (int i = 0; i < m_bloomMipCount; i++) {
+    glBindFramebuffer(GL_FRAMEBUFFER, m_bloomFBO[i]);
+    glViewport(0, 0, m_bloomMipSizes[i].x, m_bloomMipSizes[i].y);
+    drawToQuadWithTex(src);
+    src = m_bloomMips[i];
+  }
+  // Upsample
+  setIntUniform(m_bloomShader, "upsample", true);
+  glEnable(GL_BLEND);
+  glBlendFunc(GL_ONE, GL_ONE);
+  for (int i = m_bloomMipCount - 1; i > 0; i--) {
+    glBindFramebuffer(GL_FRAMEBUFFER, m_bloomFBO[i - 1]);
+    glViewport(0, 0, m_bloomMipSizes[i - 1].x, m_bloomMipSizes[i - 1].y);
+    drawToQuadWithTex(m_bloomMips[i]);
+  }
+  glDisable(GL_BLEND);
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+  glUseProgram(0);
+}
+
+/**
+ * @brief Applies the light effects and FXAA to the frame in a single pass
+ * - every tap of FXAA goes through the light effects, so the frame is read
+ *   once and no effect needs a target of its own
+ * @param frame HDR texture, accumulation buffer, color texture of the custom
+ * FBO or upscale texture
+ * @param fbo Output FBO, or the custom FBO if the upscale follows
+ * @param lightEffects True to apply HDR, Bloom and gamma correction
+ * @param fxaa True to apply FXAA
+ */
+void RayMarchRenderer::applyPost(GLuint frame, GLuint fbo, bool lightEffects,
+                                 bool fxaa) {
+  GLuint shader = getPostShader(lightEffects, fxaa);
+  glUseProgram(shader);
+  // - every pixel is drawn, so the target is not cleared
+  glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+  if (fbo == m_defaultFBO) {
+    glViewport(0, 0, scene.m_width, scene.m_height);
+  } else {
+    glViewport(0, 0, m_renderWidth, m_renderHeight);
+  }
+  // Set Uniforms
+  configurePostUniforms(shader);
+  drawToQuadWithTex(frame);
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+  glUseProgram(0);
+}
+
+/**
+ * @brief Gets the post processing permutation of the enabled effects
+ * - built on first use and cached by its defines
+ * @param lightEffects True to apply HDR, Bloom and gamma correction
+ * @param fxaa True to apply FXAA
+ * @returns Post processing shader
+ */
+GLuint RayMarchRenderer::getPostShader(bool lightEffects, bool fxaa) {
+  std::vector<std::string> defines;
+  if (lightEffects && m_enableHDR) {
+    defines.push_back("HDR");
+  }
+  if (lightEffects && m_enableBloom) {
+    defines.push_back("BLOOM");
+  }
+  if (lightEffects && !m_enableHDR && !m_enableBloom) {
+    defines.push_back("GAMMA");
+  }
+  if (fxaa) {
+    defines.push_back("FXAA");
+  }
+  std::string key;
+  for (const std::string &define : defines) {
+    key += define + ";";
+  }
+  auto it = m_postShaders.find(key);
+  if (it == m_postShaders.end()) {
+    GLuint shader = ShaderLoader::createShaderProgramFromSource(
+        ShaderLoader::readShaderFile(":/resources/fullscreen.vert"),
+        ShaderLoader::injectDefines(m_postFragCode, defines));
+    glUseProgram(shader);
+    setIntUniform(shader, "frame", 0);
+    setIntUniform(shader, "bloomBlur", 1);
+    glUseProgram(0);
+    it = m_postShaders.emplace(key, shader).first;
+  }
+  return it->second;
+}
+
+/**
+ * @brief Upscales the color texture of the custom FBO to the output size
+ * - into the upscale texture if FXAA follows
+ */
+void RayMarchRenderer::applyUpscale() {
+  glUseProgram(m_upscaleShader);
+  if (m_enableFXAA) {
+    glBindFramebuffer(GL_FRAMEBUFFER, m_upscaleFBO);
+    glViewport(0, 0, scene.m_width, scene.m_height);
+  } else {
+    setFBO(m_defaultFBO);
+  }
+  drawToQuadWithTex(m_customFBOColorTexture);
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+  glUseProgram(0);
+}
+
+/**
+ * @brief Adjusts the render scale so that a frame takes the target GPU time
+ * - the GPU time scales with the number of pixels, i.e. with the square of
+ *   the scale
+ * - the scale moves in steps of RENDER_SCALE_STEP, and only after the frame
+ *   time was off by more than RENDER_SCALE_SLACK for RENDER_SCALE_FRAMES
+ *   frames in a row, so the targets are not re-created every frame
+ * - the scale is held while samples are accumulated
+ * - frames whose passes were not all read back are skipped, their time is
+ *   that of an older frame
+ */
+void RayMarchRenderer::updateRenderScale() {
+  if (!m_enableDynamicResolution) {
+    m_scaleFrames = 0;
+    setRenderScale(1.f);
+    return;
+  }
+  if (!m_passTimer.hasNewFrameTime()) {
+    return;
+  }
+  double frameTime = m_passTimer.getLastFrameTime();
+  if (m_sampleCount > 0 || frameTime <= 0.) {
+    m_scaleFrames = 0;
+    return;
+  }
+  float scale = m_renderScale;
+  float desired = m_renderScale * std::sqrt(m_targetFrameTime / frameTime);
+  desired = std::floor(desired / RENDER_SCALE_STEP) * RENDER_SCALE_STEP;
+  desired = std::clamp(desired, MIN_RENDER_SCALE, 1.f);
+  if (frameTime > m_targetFrameTime * (1.f + RENDER_SCALE_SLACK)) {
+    // - too slow
+    scale = std::min(desired, m_renderScale - RENDER_SCALE_STEP);
+  } else if (frameTime < m_targetFrameTime * (1.f - RENDER_SCALE_SLACK)) {
+    // - headroom
+    scale = std::max(desired, m_renderScale);
+  }
+  scale = std::clamp(scale, MIN_RENDER_SCALE, 1.f);
+  if (scale == m_renderScale) {
+    m_scaleFrames = 0;
+    return;
+  }
+  if (++m_scaleFrames < RENDER_SCALE_FRAMES) {
+    return;
+  }
+  m_scaleFrames = 0;
+  setRenderScale(scale);
+}
+
+/**
+ * @brief Sets the render scale
+ * - the render targets are only re-created if the render resolution changed
+ * @param scale Scale of the render resolution relative to the output size
+ */
+void RayMarchRenderer::setRenderScale(float scale) {
+  m_renderScale = scale;
+  int width = std::max(1, (int)std::lround(scene.m_width * scale));
+  int height = std::max(1, (int)std::lround(scene.m_height * scale));
+  if (width == m_renderWidth && height == m_renderHeight) {
+    return;
+  }
+  destroyCustomFBO();
+  m_renderWidth = width;
+  m_renderHeight = height;
+  initCustomFBO();
+}
+
+/**
+ * @brief Checks if the render resolution differs from the output size
+ */
+bool RayMarchRenderer::isUpscaling() {
+  return m_renderWidth != scene.m_width || m_renderHeight != scene.m_height;
+}
+
+/**
+ * @brief Given tex, draw to a full screen quad
+ * @param texture we want to sample from
+ */
+void RayMarchRenderer::drawToQuadWithTex(GLuint tex) {
+  // Bind full screen quad vao
+  glBindVertexArray(m_fullscreenVAO);
+  // Activate 0
+  glActiveTexture(GL_TEXTURE0);
+  glBindTexture(GL_TEXTURE_2D, tex);
+  // Draw
+  glDrawArrays(GL_TRIANGLES, 0, 6);
+  glBindTexture(GL_TEXTURE_2D, 0);
+  glBindVertexArray(0);
+}
+
+/**
+ * @brief Sets destination FBO
+ * - every offline target is at the render resolution
+ * @param fbo FBO that we wish to render to
+ */
+void RayMarchRenderer::setFBO(GLuint fbo) {
+  glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+  if (fbo == m_defaultFBO) {
+    glViewport(0, 0, scene.m_width, scene.m_height);
+  } else {
+    glViewport(0, 0, m_renderWidth, m_renderHeight);
+  }
+  glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+}
+
+/**
+ * @brief Gets the FBO that the raymarch pass draws the frame into offline
+ * - the HDR FBO keeps the colors that the light effects and the
+ *   accumulation need unclamped, the custom FBO draws 8 bit colors
+ * - both are complete from initCustomFBO on, so no texture is attached per
+ *   frame
+ * @returns HDR FBO or custom FBO
+ */
+GLuint RayMarchRenderer::getFrameFBO() {
+  if (m_enableHDR || m_enableGammaCorrection || m_enableBloom ||
+      m_sampleIndex > 0) {
+    return m_hdrFBO;
+  }
+  return m_customFBO;
+}
+
+/**
+ * @brief Initializes the [-1,1] blank screen vao/vbo pairing to be used for
+ * raymarching
+ */
+void RayMarchRenderer::initImagePlane() {
+  // Four corners of Image Plane
+  std::vector<GLfloat> verts = {
+      -1.f, 1.f,  // top left
+      -1.f, -1.f, // bottom left
+      1.f,  -1.f, // bottom right
+      1.f,  1.f,  // top right
+      -1.f, 1.f,  // top left
+      1.f,  -1.f, // bottom right
+  };
+
+  // VBO
+  glGenBuffers(1, &m_imagePlaneVBO);
+  glBindBuffer(GL_ARRAY_BUFFER, m_imagePlaneVBO);
+  glBufferData(GL_ARRAY_BUFFER, verts.size() * sizeof(GLfloat), verts.data(),
+               GL_STATIC_DRAW);
+
+  // VAO
+  glGenVertexArrays(1, &m_imagePlaneVAO);
+  glBindVertexArray(m_imagePlaneVAO);
+  glEnableVertexAttribArray(0);
+  glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(GLfloat), nullptr);
+
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+  glBindVertexArray(0);
+}
+
+/**
+ * @brief Initializes full screen quad to be used to apply post processing
+ * effects
+ */
+void RayMarchRenderer::initFullScreenQuad() {
+  // Construct a Fullscreen Quads (projector screen)
+  std::vector<GLfloat> fullscreen_quad_data = {
+      -1.f, 1.f,  0.0f, // top left
+      0.f,  1.f,        // tl uv
+      -1.f, -1.f, 0.0f, // bottom left
+      0.f,  0.f,        // bl uv
+      1.f,  -1.f, 0.0f, // bottom right
+      1.f,  0.f,        // br uv
+      1.f,  1.f,  0.0f, // top right
+      1.f,  1.f,        // tr uv
+      -1.f, 1.f,  0.0f, // top left
+      0.f,  1.f,        // tl uv
+      1.f,  -1.f, 0.0f, // bottom right
+      1.f,  0.f,        // br uv
+  };
+
+  // Generate and bind a VBO and VAO for a fullscreen quad
+
+  // - VBO
+  glGenBuffers(1, &m_fullscreenVBO);
+  glBindBuffer(GL_ARRAY_BUFFER, m_fullscreenVBO);
+  glBufferData(GL_ARRAY_BUFFER, fullscreen_quad_data.size() * sizeof(GLfloat),
+               fullscreen_quad_data.data(), GL_STATIC_DRAW);
+  // - VAO
+  glGenVertexArrays(1, &m_fullscreenVAO);
+  glBindVertexArray(m_fullscreenVAO);
+  // pos
+  glEnableVertexAttribArray(0);
+  glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(GLfloat), nullptr);
+  // uv
+  glEnableVertexAttribArray(1);
+  glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(GLfloat),
+                        reinterpret_cast<void *>(3 * sizeof(GLfloat)));
+
+  // unbind the fullscreen quad's VBO and VAO
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+  glBindVertexArray(0);
+}
+
+/**
+ * @brief Creates the material texture object for each shape
+ * Invoke once when the scene is first loaded
+ */
+void RayMarchRenderer::initShapesTextures() {
+  std::unordered_map<std::string, GLuint> texMap;
+  // Set the texture IDs for the shapes that use them
+  for (RayMarchObj &rts : scene.getShapes()) {
+    if (!rts.m_material.textureMap.isUsed) {
+      continue;
+    }
+    std::string texName = rts.m_material.textureMap.filename;
+    if (texMap.find(texName) == texMap.end()) {
+      // not found yet -> generate
+      glGenTextures(1, &rts.m_texture);
+      texMap[texName] = rts.m_texture;
+    } else {
+      // found a texture id -> reuse
+      rts.m_texture = texMap[texName];
+    }
+  }
+
+  // For destruction later
+  m_TextureMap = texMap;
+
+  // For each texture, initialize
+  std::map<std::string, TextureInfo> sceneTexs = scene.getShapesTextures();
+  int cnt = 0;
+  for (auto const &[name, id] : texMap) {
+    TextureInfo texInfo = sceneTexs[name];
+    glActiveTexture(GL_TEXTURE0 + cnt);
+    glBindTexture(GL_TEXTURE_2D, id);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, texInfo.width, texInfo.height, 0,
+                 GL_RGBA, GL_UNSIGNED_BYTE, texInfo.image.bits());
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    cnt++;
+  }
+}
+
+/**
+ * @brief Initializes textures to be used in our custom scene
+ */
+void RayMarchRenderer::initCustomTextures() {
+  std::filesystem::path basepath = std::filesystem::current_path();
+  std::vector<std::string> seaScene{
+      "scenefiles/texture_store/stone.png",
+      "scenefiles/texture_store/stripe.png",
+  };
+  std::vector<std::string> corridorScene{
+      "scenefiles/texture_store/ctile.png",
+  };
+  for (int i = 0; i < corridorScene.size(); i++) {
+    glGenTextures(1, &m_customTextures[i]);
+    glActiveTexture(GL_TEXTURE0 + CUSTOM_TEX_UNIT_OFF + i);
+    glBindTexture(GL_TEXTURE_2D, m_customTextures[i]);
+    QImage myImage;
+    std::filesystem::path fileRelativePath(corridorScene[i]);
+    QString str((basepath / fileRelativePath).string().data());
+    if (!myImage.load(str)) {
+      std::cout << "Failed to load in image:" << str.toStdString() << std::endl;
+      return;
+    }
+    myImage = myImage.convertToFormat(QImage::Format_RGBA8888).mirrored();
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, myImage.width(), myImage.height(),
+                 0, GL_RGBA, GL_UNSIGNED_BYTE, myImage.bits());
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glActiveTexture(0);
+  }
+}
+
+/**
+ * @brief Initializes default variables
+ */
+void RayMarchRenderer::initDefaults() {
+  // Default material texture
+  // - for shapes that don't have textures associated with them
+  //    - if we don't do this GLSL complains
+  glActiveTexture(GL_TEXTURE0);
+  glGenTextures(1, &m_defaultShapeTexture);
+  glBindTexture(GL_TEXTURE_2D, m_defaultShapeTexture);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE,
+               std::vector<GLfloat>{0, 0}.data());
+  glBindTexture(GL_TEXTURE_2D, 0);
+
+  // NULL CUBE MAP TEXTURE
+  glActiveTexture(GL_TEXTURE0 + SKYBOX_TEX_UNIT_OFF);
+  glGenTextures(1, &m_nullCubeMapTexture);
+  glBindTexture(GL_TEXTURE_CUBE_MAP, m_nullCubeMapTexture);
+  for (int i = 0; i < 6; i++) {
+    glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGBA, 1, 1, 0,
+                 GL_RGBA, GL_UNSIGNED_BYTE, std::vector<GLfloat>{0, 0}.data());
+  }
+  glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+
+  // Noise Texture
+  glGenTextures(1, &m_noiseTexture);
+  glBindTexture(GL_TEXTURE_2D, m_noiseTexture);
+  std::filesystem::path basepath = std::filesystem::current_path();
+  QImage myImage;
+  std::filesystem::path fileRelativePath(
+      "scenefiles/texture_store/noise_texture_1.png");
+  QString str((basepath / fileRelativePath).string().data());
+  if (!myImage.load(str)) {
+    std::cout << "Failed to load in image" << std::endl;
+    return;
+  }
+  myImage = myImage.convertToFormat(QImage::Format_RGBA8888).mirrored();
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, myImage.width(), myImage.height(), 0,
+               GL_RGBA, GL_UNSIGNED_BYTE, myImage.bits());
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glBindTexture(GL_TEXTURE_2D, 0);
+
+  // Blue Noise Texture
+  glGenTextures(1, &m_blueNoiseTexture);
+  glBindTexture(GL_TEXTURE_2D, m_blueNoiseTexture);
+  QImage myImage2;
+  std::filesystem::path fileRelativePath2(
+      "scenefiles/texture_store/blue_noise_texture.png");
+  QString str2((basepath / fileRelativePath2).string().data());
+  std::cout << (basepath / fileRelativePath2).string() << std::endl;
+  if (!myImage2.load(str2)) {
+    std::cout << "Failed to load in image" << std::endl;
+    return;
+  }
+  myImage2 = myImage2.convertToFormat(QImage::Format_RGBA8888).mirrored();
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, myImage2.width(), myImage2.height(),
+               0, GL_RGBA, GL_UNSIGNED_BYTE, myImage2.bits());
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+/**
+ * @brief Initializes the shader with constant uniforms
+ */
+void RayMarchRenderer::initShader() {
+  // Raymarch shader
+  // - the constant uniforms of each permutation are set on creation
+  // Bind the object textures to default
+  for (int i = 0; i < MAX_NUM_TEXTURES; i++) {
+    glActiveTexture(GL_TEXTURE0 + i);
+    glBindTexture(GL_TEXTURE_2D, m_defaultShapeTexture);
+  }
+  // Bind the custom scene textures
+  for (int i = 0; i < MAX_NUM_CUSTOM_TEXTURES; i++) {
+    glActiveTexture(GL_TEXTURE0 + CUSTOM_TEX_UNIT_OFF + i);
+    glBindTexture(GL_TEXTURE_2D, m_customTextures[i]);
+  }
+  // Bind the area light textures
+  glActiveTexture(GL_TEXTURE0 + LTC1_TEX_UNIT_OFF);
+  glBindTexture(GL_TEXTURE_2D, m_mTexture);
+  glActiveTexture(GL_TEXTURE0 + LTC2_TEX_UNIT_OFF);
+  glBindTexture(GL_TEXTURE_2D, m_ltuTexture);
+
+  // Debugging Shader
+  glUseProgram(m_debugShader);
+  setIntUniform(m_debugShader, "debugTexture", 0);
+  glUseProgram(0);
+
+  // Bloom Shader
+  glUseProgram(m_bloomShader);
+  setIntUniform(m_bloomShader, "image", 0);
+  glUseProgram(0);
+
+  // Upscale Shader
+  glUseProgram(m_upscaleShader);
+  setIntUniform(m_upscaleShader, "image", 0);
+  glUseProgram(0);
+
+  // Reprojection Shader
+  glUseProgram(m_reprojectShader);
+  setIntUniform(m_reprojectShader, "hitDepth", HIT_DEPTH_TEX_UNIT_OFF);
+  glUseProgram(0);
+
+  // Cost Heatmap Shader
+  glUseProgram(m_heatmapShader);
+  setIntUniform(m_heatmapShader, "costTexture", 0);
+  glUseProgram(0);
+}
+
+/**
+ * @brief Gets the defines of the raymarch shader
+ * - the globalData of the scene picks the background and the environments,
+ *   bump mapping can also be turned off in the settings
+ * @returns Defines in a fixed order
+ */
+std::vector<std::string> RayMarchRenderer::getShaderDefines() {
+  const SceneShaderFeatures &features = scene.getGlobalData().features;
+  std::vector<std::string> defines;
+  switch (features.background) {
+  case BackgroundType::BACKGROUND_WHITE:
+    defines.push_back("WHITE_BACKGROUND");
+    break;
+  case BackgroundType::BACKGROUND_DARK:
+    defines.push_back("DARK_BACKGROUND");
+    break;
+  case BackgroundType::BACKGROUND_SKY:
+    defines.push_back("SKY_BACKGROUND");
+    break;
+  case BackgroundType::BACKGROUND_NIGHTSKY:
+    defines.push_back("NIGHTSKY_BACKGROUND");
+    break;
+  }
+  if (features.perlinBump && m_enableBumpMap) {
+    defines.push_back("PERLIN_BUMP");
+  }
+  if (features.cloud) {
+    defines.push_back("CLOUD");
+  }
+  if (features.terrain) {
+    defines.push_back("TERRAIN");
+  }
+  if (features.sea) {
+    defines.push_back("SEA");
+  }
+  return defines;
+}
+
+/**
+ * @brief Switches to the raymarch shader permutation of getShaderDefines
+ * - permutations are compiled on first use and kept until finish (the binary
+ *   cache makes the first use cheap on later launches)
+ * - the specialized shader of the scene is reset to the generic permutation
+ * @returns True if the permutation changed
+ */
+bool RayMarchRenderer::selectRayMarchShader() {
+  std::vector<std::string> defines = getShaderDefines();
+  if (m_rayMarchShader != 0 && defines == m_shaderDefines) {
+    return false;
+  }
+  std::string key;
+  for (const std::string &define : defines) {
+    key += define + ";";
+  }
+  auto it = m_rayMarchPermutations.find(key);
+  if (it == m_rayMarchPermutations.end()) {
+    GLuint shader = ShaderLoader::createShaderProgramFromSource(
+        m_rayMarchVertCode,
+        ShaderLoader::injectDefines(m_rayMarchFragCode, defines));
+    initRayMarchShader(shader);
+    it = m_rayMarchPermutations.emplace(key, shader).first;
+  }
+  m_shaderDefines = defines;
+  m_rayMarchShader = it->second;
+  m_activeRayMarchShader = m_rayMarchShader;
+  return true;
+}
+
+/**
+ * @brief Gets the permutation of the current defines plus the define of a
+ * deferred pass
+ * - compiled on first use and kept with the other permutations. The passes
+ *   do not use the specialized shader of the scene
+ * @param pass GBUFFER_PASS, SHADOW_PASS, AO_PASS or LIGHTING_PASS
+ * @returns Shader program of the pass
+ */
+GLuint RayMarchRenderer::getPassShader(const char *pass) {
+  std::vector<std::string> defines = m_shaderDefines;
+  defines.push_back(pass);
+  std::string key;
+  for (const std::string &define : defines) {
+    key += define + ";";
+  }
+  auto it = m_rayMarchPermutations.find(key);
+  if (it == m_rayMarchPermutations.end()) {
+    GLuint shader = ShaderLoader::createShaderProgramFromSource(
+        m_rayMarchVertCode,
+        ShaderLoader::injectDefines(m_rayMarchFragCode, defines));
+    initRayMarchShader(shader);
+    it = m_rayMarchPermutations.emplace(key, shader).first;
+  }
+  return it->second;
+}
+
+/**
+ * @brief Sets the texture units and the block binding of a raymarch shader
+ * @param shader Generic or scene specialized raymarch shader
+ */
+void RayMarchRenderer::initRayMarchShader(GLuint shader) {
+  glUseProgram(shader);
+  // Set the textures to use correct slots
+  GLuint texsLoc = glGetUniformLocation(shader, "objTextures");
+  for (int i = 0; i < MAX_NUM_TEXTURES; i++) {
+    glUniform1i(texsLoc + i, i);
+  }
+  // Set custom scene textures
+  GLuint cusTexsLoc = glGetUniformLocation(shader, "customTextures");
+  for (int i = 0; i < MAX_NUM_CUSTOM_TEXTURES; i++) {
+    glUniform1i(cusTexsLoc + i, CUSTOM_TEX_UNIT_OFF + i);
+  }
+  // Set the skybox tex unit to the next available
+  setIntUniform(shader, "skybox", SKYBOX_TEX_UNIT_OFF);
+  // Set the M and LTU texture units for area lights
+  setIntUniform(shader, "LTC1", LTC1_TEX_UNIT_OFF);
+  setIntUniform(shader, "LTC2", LTC2_TEX_UNIT_OFF);
+  // Set the noise texture unit for procedual stuff
+  setIntUniform(shader, "noise", NOISE_TEX_UNIT_OFF);
+  // Set the blue noise texture unit for volumetric rendering
+  setIntUniform(shader, "bluenoise", BLUE_NOISE_TEX_UNIT_OFF);
+  // Set the object buffer units
+  setIntUniform(shader, "objectGeometry", OBJECT_GEOMETRY_TEX_UNIT_OFF);
+  setIntUniform(shader, "objectMaterials", OBJECT_MATERIALS_TEX_UNIT_OFF);
+  setIntUniform(shader, "bvhNodes", BVH_NODES_TEX_UNIT_OFF);
+  setIntUniform(shader, "bvhObjects", BVH_OBJECTS_TEX_UNIT_OFF);
+  setIntUniform(shader, "lightData", LIGHT_DATA_TEX_UNIT_OFF);
+  setIntUniform(shader, "lightClusters", LIGHT_CLUSTERS_TEX_UNIT_OFF);
+  setIntUniform(shader, "sdfCacheGrid", SDF_CACHE_GRID_TEX_UNIT_OFF);
+  setIntUniform(shader, "sdfCacheAtlas", SDF_CACHE_ATLAS_TEX_UNIT_OFF);
+  setIntUniform(shader, "prepassDepth", PREPASS_TEX_UNIT_OFF);
+  setIntUniform(shader, "reprojectedDepth", REPROJECTION_TEX_UNIT_OFF);
+  // Set the G-buffer and the shadow and AO units of the deferred passes
+  setIntUniform(shader, "gPositionBuffer", GBUFFER_POSITION_TEX_UNIT_OFF);
+  setIntUniform(shader, "gNormalBuffer", GBUFFER_NORMAL_TEX_UNIT_OFF);
+  setIntUniform(shader, "gTrapBuffer", GBUFFER_TRAP_TEX_UNIT_OFF);
+  setIntUniform(shader, "gCustomIdBuffer", GBUFFER_CUSTOM_ID_TEX_UNIT_OFF);
+  setIntUniform(shader, "shadowBuffer", SHADOW_TEX_UNIT_OFF);
+  setIntUniform(shader, "aoBuffer", AO_TEX_UNIT_OFF);
+  // Bind the light block to its binding point
+  glUniformBlockBinding(shader, glGetUniformBlockIndex(shader, "LightBlock"),
+                        LIGHT_BLOCK_BINDING);
+  glUseProgram(0);
+}
+
+/**
+ * @brief Initializes the custom FBO for offline rendering
+ */
+void RayMarchRenderer::initCustomFBO() {
+  // ColorBuffer
+  glGenTextures(1, &m_customFBOColorTexture);
+  glBindTexture(GL_TEXTURE_2D, m_customFBOColorTexture);
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, m_renderWidth, m_renderHeight, 0,
+               GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glBindTexture(GL_TEXTURE_2D, 0);
+
+  // HDR ColorBuffer
+  glGenTextures(1, &m_hdrTexture);
+  glBindTexture(GL_TEXTURE_2D, m_hdrTexture);
+  // - note the RGBA16F internal format
+  // - this will prevent from frag shader clamping color val to [0, 1] range
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, m_renderWidth, m_renderHeight, 0,
+               GL_RGBA, GL_FLOAT, nullptr);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glBindTexture(GL_TEXTURE_2D, 0);
+
+  // Bloom BrightColorBuffer
+  glGenTextures(1, &m_bloomBrightnessTexture);
+  glBindTexture(GL_TEXTURE_2D, m_bloomBrightnessTexture);
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, m_renderWidth, m_renderHeight, 0,
+               GL_RGBA, GL_FLOAT, nullptr);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  glBindTexture(GL_TEXTURE_2D, 0);
+
+  // RenderBuffer
+  glGenRenderbuffers(1, &m_customFBORenderBuffer);
+  glBindRenderbuffer(GL_RENDERBUFFER, m_customFBORenderBuffer);
+  glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, m_renderWidth,
+                        m_renderHeight);
+  glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+  // FBO
+  glGenFramebuffers(1, &m_customFBO);
+  glBindFramebuffer(GL_FRAMEBUFFER, m_customFBO);
+  // - set normal color buffer as default 0
+  glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D,
+                         m_customFBOColorTexture, 0);
+  // - set brightness as default 1
+  glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D,
+                         m_bloomBrightnessTexture, 0);
+  GLuint attachments[2] = {GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1};
+  glDrawBuffers(2, attachments);
+  glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT,
+                            GL_RENDERBUFFER, m_customFBORenderBuffer);
+  if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+    std::cout << "Custom Buffer Incomplete" << std::endl;
+  }
+
+  // HDR FBO
+  // - same targets as the custom FBO with the HDR color buffer as 0, so
+  //   that neither is re-attached per frame (see getFrameFBO)
+  glGenFramebuffers(1, &m_hdrFBO);
+  glBindFramebuffer(GL_FRAMEBUFFER, m_hdrFBO);
+  glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D,
+                         m_hdrTexture, 0);
+  glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D,
+                         m_bloomBrightnessTexture, 0);
+  glDrawBuffers(2, attachments);
+  glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT,
+                            GL_RENDERBUFFER, m_customFBORenderBuffer);
+  if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+    std::cout << "HDR Buffer Incomplete" << std::endl;
+  }
+
+  // =================== Bloom ========================
+  // - mip chain from 1/2 of the render resolution down to BLOOM_MIN_HEIGHT
+  glGenFramebuffers(BLOOM_MAX_MIPS, m_bloomFBO);
+  glGenTextures(BLOOM_MAX_MIPS, m_bloomMips);
+  glm::ivec2 mipSize(m_renderWidth, m_renderHeight);
+  m_bloomMipCount = 0;
+  while (m_bloomMipCount < BLOOM_MAX_MIPS) {
+    int i = m_bloomMipCount++;
+    mipSize = glm::max(mipSize / 2, 1);
+    m_bloomMipSizes[i] = mipSize;
+    glBindFramebuffer(GL_FRAMEBUFFER, m_bloomFBO[i]);
+    glBindTexture(GL_TEXTURE_2D, m_bloomMips[i]);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, mipSize.x, mipSize.y, 0,
+                 GL_RGBA, GL_FLOAT, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D,
+                           m_bloomMips[i], 0);
+    if (mipSize.y <= BLOOM_MIN_HEIGHT) {
+      break;
+    }
+  }
+  glBindTexture(GL_TEXTURE_2D, 0);
+
+  // =================== Accumulation ==================
+  // - RGBA32F so that the mean of many samples does not lose precision
+  glGenTextures(1, &m_accumTexture);
+  glBindTexture(GL_TEXTURE_2D, m_accumTexture);
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, m_renderWidth, m_renderHeight, 0,
+               GL_RGBA, GL_FLOAT, nullptr);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glBindTexture(GL_TEXTURE_2D, 0);
+  glGenFramebuffers(1, &m_accumFBO);
+  glBindFramebuffer(GL_FRAMEBUFFER, m_accumFBO);
+  glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D,
+                         m_accumTexture, 0);
+  if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+    std::cout << "Accumulation Buffer Incomplete" << std::endl;
+  }
+  // - the new buffer holds no samples
+  resetAccumulation();
+
+  // =================== Depth Prepass =================
+  // - one texel per tile, rounded up
+  m_prepassWidth =
+      (m_renderWidth + DEPTH_PREPASS_TILE - 1) / DEPTH_PREPASS_TILE;
+  m_prepassHeight =
+      (m_renderHeight + DEPTH_PREPASS_TILE - 1) / DEPTH_PREPASS_TILE;
+  glGenTextures(1, &m_prepassTexture);
+  glBindTexture(GL_TEXTURE_2D, m_prepassTexture);
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, m_prepassWidth, m_prepassHeight, 0,
+               GL_RED, GL_FLOAT, nullptr);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+  glBindTexture(GL_TEXTURE_2D, 0);
+  glGenFramebuffers(1, &m_prepassFBO);
+  glBindFramebuffer(GL_FRAMEBUFFER, m_prepassFBO);
+  glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D,
+                         m_prepassTexture, 0);
+
+  // =================== Temporal Reprojection =========
+  // - hit depth written by the raymarch pass (see setRaymarchOutputs)
+  glGenTextures(1, &m_hitDepthTexture);
+  glBindTexture(GL_TEXTURE_2D, m_hitDepthTexture);
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, m_renderWidth, m_renderHeight, 0,
+               GL_RED, GL_FLOAT, nullptr);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+  // - hit depth of the last frame in the current view. The depth buffer
+  //   keeps the nearest of the points that land on a pixel
+  glGenTextures(1, &m_reprojectTexture);
+  glBindTexture(GL_TEXTURE_2D, m_reprojectTexture);
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, m_renderWidth, m_renderHeight, 0,
+               GL_RED, GL_FLOAT, nullptr);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+  glBindTexture(GL_TEXTURE_2D, 0);
+  glGenRenderbuffers(1, &m_reprojectRenderBuffer);
+  glBindRenderbuffer(GL_RENDERBUFFER, m_reprojectRenderBuffer);
+  glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, m_renderWidth,
+                        m_renderHeight);
+  glBindRenderbuffer(GL_RENDERBUFFER, 0);
+  glGenFramebuffers(1, &m_reprojectFBO);
+  glBindFramebuffer(GL_FRAMEBUFFER, m_reprojectFBO);
+  glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D,
+                         m_reprojectTexture, 0);
+  glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT,
+                            GL_RENDERBUFFER, m_reprojectRenderBuffer);
+  if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+    std::cout << "Reprojection Buffer Incomplete" << std::endl;
+  }
+  // - the new texture holds no frame
+  m_hitDepthValid = false;
+
+  // =================== March Cost ====================
+  // - written by the raymarch pass (see setRaymarchOutputs), RGBA32F so that
+  //   the counts are exact
+  glGenTextures(1, &m_costTexture);
+  glBindTexture(GL_TEXTURE_2D, m_costTexture);
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, m_renderWidth, m_renderHeight, 0,
+               GL_RGBA, GL_FLOAT, nullptr);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+  glBindTexture(GL_TEXTURE_2D, 0);
+  m_costReadback.initialize(m_renderWidth, m_renderHeight);
+
+  // =================== Deferred Shading ==============
+  // - G-buffer
+  auto initTarget = [this](GLuint &tex, GLint format, GLenum channels) {
+    glGenTextures(1, &tex);
+    glBindTexture(GL_TEXTURE_2D, tex);
+    glTexImage2D(GL_TEXTURE_2D, 0, format, m_renderWidth, m_renderHeight, 0,
+                 channels, GL_FLOAT, nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glBindTexture(GL_TEXTURE_2D, 0);
+  };
+  // - RGBA32F positions, so the shadow and AO rays start on the surface
+  initTarget(m_gPositionTexture, GL_RGBA32F, GL_RGBA);
+  initTarget(m_gNormalTexture, GL_RGBA16F, GL_RGBA);
+  initTarget(m_gTrapTexture, GL_RGBA16F, GL_RGBA);
+  initTarget(m_gCustomIdTexture, GL_R16F, GL_RED);
+  glGenFramebuffers(1, &m_gbufferFBO);
+  glBindFramebuffer(GL_FRAMEBUFFER, m_gbufferFBO);
+  glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D,
+                         m_gPositionTexture, 0);
+  glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D,
+                         m_gNormalTexture, 0);
+  glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT4, GL_TEXTURE_2D,
+                         m_gTrapTexture, 0);
+  glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT5, GL_TEXTURE_2D,
+                         m_gCustomIdTexture, 0);
+  if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+    std::cout << "G-Buffer Incomplete" << std::endl;
+  }
+  // - the hit depth and the march cost are the third and fourth outputs of
+  //   every FBO the raymarch pass draws into, drawn only when enabled (see
+  //   setRaymarchOutputs)
+  for (GLuint fbo : {m_customFBO, m_hdrFBO, m_gbufferFBO}) {
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT2,
+                           GL_TEXTURE_2D, m_hitDepthTexture, 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT3,
+                           GL_TEXTURE_2D, m_costTexture, 0);
+  }
+  // - shadows and AO
+  initLightingTargets();
+
+  // =================== Upscale =======================
+  // - the only target at the output size
+  glGenTextures(1, &m_upscaleTexture);
+  glBindTexture(GL_TEXTURE_2D, m_upscaleTexture);
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, scene.m_width, scene.m_height, 0,
+               GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glBindTexture(GL_TEXTURE_2D, 0);
+  glGenFramebuffers(1, &m_upscaleFBO);
+  glBindFramebuffer(GL_FRAMEBUFFER, m_upscaleFBO);
+  glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D,
+                         m_upscaleTexture, 0);
+  glBindFramebuffer(GL_FRAMEBUFFER, m_defaultFBO);
+}
+
+/**
+ * @brief Initializes the shadow and AO targets of the deferred passes
+ * - one texel per m_lightingScale x m_lightingScale pixels of the render
+ *   resolution, re-created when either changes
+ */
+void RayMarchRenderer::initLightingTargets() {
+  m_lightingWidth = (m_renderWidth + m_lightingScale - 1) / m_lightingScale;
+  m_lightingHeight = (m_renderHeight + m_lightingScale - 1) / m_lightingScale;
+  // - visibility of 4 lights of the cluster per layer, the layer is attached
+  //   per draw. 8 bits hold a visibility in [0, 1] and keep the
+  //   SHADOW_LAYERS layers small
+  glGenTextures(1, &m_shadowTexture);
+  glBindTexture(GL_TEXTURE_2D_ARRAY, m_shadowTexture);
+  glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA8, m_lightingWidth,
+               m_lightingHeight, SHADOW_LAYERS, 0, GL_RGBA, GL_UNSIGNED_BYTE,
+               nullptr);
+  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+  glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+  glGenFramebuffers(1, &m_shadowFBO);
+  // - ambient occlusion
+  glGenTextures(1, &m_aoTexture);
+  glBindTexture(GL_TEXTURE_2D, m_aoTexture);
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_R16F, m_lightingWidth, m_lightingHeight,
+               0, GL_RED, GL_FLOAT, nullptr);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+  glBindTexture(GL_TEXTURE_2D, 0);
+  glGenFramebuffers(1, &m_aoFBO);
+  glBindFramebuffer(GL_FRAMEBUFFER, m_aoFBO);
+  glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D,
+                         m_aoTexture, 0);
+  glBindFramebuffer(GL_FRAMEBUFFER, m_defaultFBO);
+}
+
+/**
+ * @brief Sets the cube map texture
+ */
+void RayMarchRenderer::initCubeMap(CUBEMAP type) {
+  if (type == CUBEMAP::UNUSED)
+    return;
+  std::filesystem::path basepath =
+      std::filesystem::path(settings.sceneFilePath).parent_path().parent_path();
+  // Get the image paths
+  std::vector<std::string> faces = scene.getCubeMapWithType(type);
+  glGenTextures(1, &m_cubeMapTexture);
+  glBindTexture(GL_TEXTURE_CUBE_MAP, m_cubeMapTexture);
+  int width, height;
+  for (int i = 0; i < faces.size(); i++) {
+    // Load up each face
+    QImage myImage;
+    std::filesystem::path fileRelativePath(faces[i]);
+    QString str((basepath / fileRelativePath).string().data());
+    if (!myImage.load(str)) {
+      std::cout << "Failed to load in image" << std::endl;
+      return;
+    }
+
+    myImage = myImage.convertToFormat(QImage::Format_RGBA8888).mirrored();
+
+    width = myImage.width();
+    height = myImage.height();
+    glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGBA, width, height,
+                 0, GL_RGBA, GL_UNSIGNED_BYTE, myImage.bits());
+  }
+  glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+  glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+}
+
+/**
+ * @brief Creates the texture buffers of the objects and allocates the uniform
+ * buffer of the light block
+ */
+void RayMarchRenderer::initSceneBuffers() {
+  // Objects
+  // - the buffers are (re-)allocated by uploadObjects
+  glGenBuffers(1, &m_objectGeometryBuffer);
+  glGenBuffers(1, &m_objectMaterialBuffer);
+  glGenTextures(1, &m_objectGeometryTexture);
+  glBindTexture(GL_TEXTURE_BUFFER, m_objectGeometryTexture);
+  glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, m_objectGeometryBuffer);
+  glGenTextures(1, &m_objectMaterialTexture);
+  glBindTexture(GL_TEXTURE_BUFFER, m_objectMaterialTexture);
+  glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, m_objectMaterialBuffer);
+  // BVH
+  glGenBuffers(1, &m_bvhNodeBuffer);
+  glGenBuffers(1, &m_bvhObjectBuffer);
+  glGenTextures(1, &m_bvhNodeTexture);
+  glBindTexture(GL_TEXTURE_BUFFER, m_bvhNodeTexture);
+  glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, m_bvhNodeBuffer);
+  glGenTextures(1, &m_bvhObjectTexture);
+  glBindTexture(GL_TEXTURE_BUFFER, m_bvhObjectTexture);
+  glTexBuffer(GL_TEXTURE_BUFFER, GL_R32I, m_bvhObjectBuffer);
+  // Lights
+  // - re-allocated by uploadLights and uploadLightClusters
+  glGenBuffers(1, &m_lightDataBuffer);
+  glGenBuffers(1, &m_lightClusterBuffer);
+  glGenTextures(1, &m_lightDataTexture);
+  glBindTexture(GL_TEXTURE_BUFFER, m_lightDataTexture);
+  glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, m_lightDataBuffer);
+  glGenTextures(1, &m_lightClusterTexture);
+  glBindTexture(GL_TEXTURE_BUFFER, m_lightClusterTexture);
+  glTexBuffer(GL_TEXTURE_BUFFER, GL_R32I, m_lightClusterBuffer);
+  glBindTexture(GL_TEXTURE_BUFFER, 0);
+  glGenBuffers(1, &m_lightUBO);
+  glBindBuffer(GL_UNIFORM_BUFFER, m_lightUBO);
+  glBufferData(GL_UNIFORM_BUFFER, sizeof(LightBlock), nullptr,
+               GL_DYNAMIC_DRAW);
+  glBindBuffer(GL_UNIFORM_BUFFER, 0);
+  // SDF cache
+  // - allocated by uploadSDFCache. The grid is fetched per cell, the bricks
+  //   are interpolated
+  glGenTextures(1, &m_sdfCacheGridTexture);
+  glBindTexture(GL_TEXTURE_3D, m_sdfCacheGridTexture);
+  glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+  glGenTextures(1, &m_sdfCacheAtlasTexture);
+  glBindTexture(GL_TEXTURE_3D, m_sdfCacheAtlasTexture);
+  glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+  glBindTexture(GL_TEXTURE_3D, 0);
+  m_objectsDirty = true;
+  m_lightsDirty = true;
+  m_sdfCacheDirty = true;
+}
+
+/**
+ * @brief Sets the uniforms that are related to camera/eye
+ * @param shader Shader program we are using
+ */
+void RayMarchRenderer::configureCameraUniforms(GLuint shader) {
+  // Get all the stuff we want to use in our shader program
+  glm::mat4 viewMatrix = scene.getCamera().getViewMatrix();
+  glm::mat4 projMatrix = scene.getCamera().getProjMatrix();
+  glm::vec4 camPosition = scene.getCamera().getCameraPosition();
+  glm::mat4 invProjViewMatrix = glm::inverse(projMatrix * viewMatrix);
+  float near = scene.getCamera().getNearPlane();
+  float far = scene.getCamera().getFarPlane();
+  // Near & Far
+  setFloatUniform(shader, "near", near);
+  setFloatUniform(shader, "initialFar", far);
+  // View Matrix
+  setMat4Uniform(shader, "viewMatrix", viewMatrix);
+  // Projection Matrix
+  setMat4Uniform(shader, "projMatrix", projMatrix);
+  // Camera Position
+  setVec4Uniform(shader, "eyePosition", camPosition);
+  // Inv Proj View
+  setMat4Uniform(shader, "invProjViewMatrix", invProjViewMatrix);
+  // Radius of a pixel per unit of depth ([1][1] is 1 / tan(fov / 2))
+  setFloatUniform(shader, "pixelRadius",
+                  1.f / (projMatrix[1][1] * m_renderHeight));
+}
+
+/**
+ * @brief Sets the uniforms of the accumulated sample
+ * - the rays are offset inside the pixel along the Halton (2, 3) sequence
+ * @param shader Shader program we are using
+ */
+void RayMarchRenderer::configureAccumulationUniforms(GLuint shader) {
+  glm::vec2 jitter(0.f);
+  if (m_sampleIndex > 0) {
+    auto halton = [](int i, int base) {
+      float f = 1.f, r = 0.f;
+      for (; i > 0; i /= base) {
+        f /= base;
+        r += f * (i % base);
+      }
+      return r;
+    };
+    // - [-0.5, 0.5) pixels to NDC
+    jitter = glm::vec2(halton(m_sampleIndex, 2) - 0.5f,
+                       halton(m_sampleIndex, 3) - 0.5f) *
+             2.f / glm::vec2(m_renderWidth, m_renderHeight);
+  }
+  setIntUniform(shader, "sampleIndex", m_sampleIndex);
+  setVec2Uniform(shader, "pixelJitter", jitter);
+}
+
+/**
+ * @brief Sets the uniforms that are related to current screen
+ * @param shader Shader program we are using
+ */
+void RayMarchRenderer::configureScreenUniforms(GLuint shader) {
+  glm::vec2 screenD{
+      m_renderWidth,
+      m_renderHeight,
+  };
+  // Screen Space
+  setIntUniform(shader, "isTwoD", m_twoDSpace);
+  // Screen Dimensions
+  setVec2Uniform(shader, "screenDimensions", screenD);
+  // ITime
+  setFloatUniform(shader, "iTime", m_time);
+  // Sky Box
+  glActiveTexture(GL_TEXTURE0 + SKYBOX_TEX_UNIT_OFF);
+  if (m_idxSkyBox) {
+    glBindTexture(GL_TEXTURE_CUBE_MAP, m_cubeMapTexture);
+  } else {
+    glBindTexture(GL_TEXTURE_CUBE_MAP, m_nullCubeMapTexture);
+  }
+  // Noise
+  glActiveTexture(GL_TEXTURE0 + NOISE_TEX_UNIT_OFF);
+  glBindTexture(GL_TEXTURE_2D, m_noiseTexture);
+  // Blue Noise
+  glActiveTexture(GL_TEXTURE0 + BLUE_NOISE_TEX_UNIT_OFF);
+  glBindTexture(GL_TEXTURE_2D, m_blueNoiseTexture);
+}
+
+/**
+ * @brief Sets the uniforms for all the scene lights
+ * - the lights are only re-uploaded when the scene changed, the clusters
+ *   when the view changed as well
+ * @param shader Shader program we are using
+ */
+void RayMarchRenderer::configureLightsUniforms(GLuint shader) {
+  Camera &cam = scene.getCamera();
+  glm::mat4 projView = cam.getProjMatrix() * cam.getViewMatrix();
+  if (m_lightsDirty) {
+    uploadLights();
+    m_lightsDirty = false;
+    m_clusterProjView = glm::mat4(0.f);
+  }
+  if (projView != m_clusterProjView) {
+    m_clusterProjView = projView;
+    uploadLightClusters();
+  }
+  glBindBufferBase(GL_UNIFORM_BUFFER, LIGHT_BLOCK_BINDING, m_lightUBO);
+  glActiveTexture(GL_TEXTURE0 + LIGHT_DATA_TEX_UNIT_OFF);
+  glBindTexture(GL_TEXTURE_BUFFER, m_lightDataTexture);
+  glActiveTexture(GL_TEXTURE0 + LIGHT_CLUSTERS_TEX_UNIT_OFF);
+  glBindTexture(GL_TEXTURE_BUFFER, m_lightClusterTexture);
+  // - a 2D scene has no frustum to cluster
+  setIntUniform(shader, "useLightClusters", !m_twoDSpace);
+  setVec2Uniform(shader, "clusterScale", m_lightClusters.getScale());
+  setFloatUniform(shader, "clusterNear", cam.getNearPlane());
+  setFloatUniform(shader, "clusterLogScale", m_lightClusters.getLogScale());
+
+  glActiveTexture(GL_TEXTURE0 + LTC1_TEX_UNIT_OFF);
+  glBindTexture(GL_TEXTURE_2D, m_mTexture);
+  glActiveTexture(GL_TEXTURE0 + LTC2_TEX_UNIT_OFF);
+  glBindTexture(GL_TEXTURE_2D, m_ltuTexture);
+}
+
+/**
+ * @brief Packs the scene lights into the light buffer and the phong
+ * constants into the light block and uploads them
+ * - LIGHT_TEXELS texels per light: (color, type), (direction, angle),
+ *   (position, penumbra), (attenuation, intensity), the 4 corners of an area
+ *   light with twoSided in the first, and the bounding sphere (radius -1 if
+ *   unbounded, see LightClusters::getBounds)
+ */
+void RayMarchRenderer::uploadLights() {
+  const std::vector<SceneLightData> &lights = scene.getLights();
+  // Texture buffers are limited to GL_MAX_TEXTURE_BUFFER_SIZE texels
+  GLint maxTexels;
+  glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &maxTexels);
+  int numLights = std::min<int>(lights.size(), maxTexels / LIGHT_TEXELS);
+  if (numLights < (int)lights.size()) {
+    std::cerr << "Warning: Scene has " << lights.size()
+              << " lights, only the first " << numLights << " are rendered"
+              << std::endl;
+  }
+  std::vector<glm::vec4> texels;
+  texels.reserve(numLights * LIGHT_TEXELS);
+  for (int i = 0; i < numLights; i++) {
+    const SceneLightData &light = lights[i];
+    float type = static_cast<std::underlying_type_t<LightType>>(light.type);
+    texels.emplace_back(glm::vec3(light.color), type);
+    texels.emplace_back(glm::vec3(light.dir), light.angle);
+    texels.emplace_back(glm::vec3(light.pos), light.penumbra);
+    texels.emplace_back(light.function, light.intensity);
+    // Area Light
+    // - rectangle corners, which are two sided
+    for (int k = 0; k < 4; k++) {
+      glm::vec4 corner(0.f);
+      if (light.type == LightType::LIGHT_AREA) {
+        corner = glm::mat4(light.ctm) * glm::vec4(corners[k], 1.f);
+      }
+      texels.emplace_back(glm::vec3(corner), k == 0 ? 1.f : 0.f);
+    }
+    glm::vec3 center(0.f);
+    float radius;
+    if (!LightClusters::getBounds(light, center, radius)) {
+      radius = -1.f;
+    }
+    texels.emplace_back(center, radius);
+  }
+  m_lightClusters.setLights(lights, numLights);
+  m_clusterOverflowWarned = false;
+  // - never allocate an empty buffer
+  texels.resize(std::max<size_t>(texels.size(), 1));
+  glBindBuffer(GL_TEXTURE_BUFFER, m_lightDataBuffer);
+  glBufferData(GL_TEXTURE_BUFFER, texels.size() * sizeof(glm::vec4),
+               texels.data(), GL_STATIC_DRAW);
+  glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+  LightBlock block = {};
+  // Number of lights
+  block.numLights = numLights;
+  // Phong constants
+  block.ka = scene.getGlobalData().ka;
+  block.kd = scene.getGlobalData().kd;
+  block.ks = scene.getGlobalData().ks;
+  block.kt = scene.getGlobalData().kt;
+
+  glBindBuffer(GL_UNIFORM_BUFFER, m_lightUBO);
+  glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(LightBlock), &block);
+  glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+/**
+ * @brief Bins the lights into the clusters of the current view and uploads
+ * them
+ * - the lights that do not fit into a full cluster are left out, which is
+ *   reported once per scene
+ */
+void RayMarchRenderer::uploadLightClusters() {
+  Camera &cam = scene.getCamera();
+  m_lightClusters.build(cam.getViewMatrix(), cam.getProjMatrix(),
+                        cam.getNearPlane(), cam.getFarPlane());
+  if (m_lightClusters.getNumDropped() > 0 && !m_clusterOverflowWarned) {
+    std::cerr << "Warning: More than " << MAX_CLUSTER_LIGHTS
+              << " lights reach a cluster, the rest are not rendered there"
+              << std::endl;
+    m_clusterOverflowWarned = true;
+  }
+  std::vector<GLint> data;
+  m_lightClusters.packClusters(data);
+  glBindBuffer(GL_TEXTURE_BUFFER, m_lightClusterBuffer);
+  glBufferData(GL_TEXTURE_BUFFER, data.size() * sizeof(GLint), data.data(),
+               GL_DYNAMIC_DRAW);
+  glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+/**
+ * @brief Sets the uniforms of every frame of a raymarch shader
+ * @param shader Forward raymarch shader or the shader of a deferred pass
+ */
+void RayMarchRenderer::configureRayMarchUniforms(GLuint shader) {
+  configureScreenUniforms(shader);
+  configureCameraUniforms(shader);
+  configureAccumulationUniforms(shader);
+  configureShapesUniforms(shader);
+  configureLightsUniforms(shader);
+  configureSettingsUniforms(shader);
+}
+
+/**
+ * @brief Sets all the uniforms for all the rendering options that are available
+ * @param shader Shader program we are using
+ */
+void RayMarchRenderer::configureSettingsUniforms(GLuint shader) {
+  // Soft Shadow
+  setIntUniform(shader, "enableSoftShadow", m_enableSoftShadow);
+  // Reflection
+  setIntUniform(shader, "enableReflection", m_enableReflection);
+  // Refraction
+  setIntUniform(shader, "enableRefraction", m_enableRefraction);
+  // Ambient Occulusion
+  setIntUniform(shader, "enableAmbientOcculusion", m_enableAmbientOcclusion);
+  // Sky Box
+  setIntUniform(shader, "enableSkyBox", m_idxSkyBox);
+  // Terrain
+  setFloatUniform(shader, "terrainHeight", m_terrainH);
+  setFloatUniform(shader, "terrainScale", m_terrainS);
+  // Number of Octaves
+  setIntUniform(shader, "numOctaves", m_numOctaves);
+  // Over-relaxation
+  setFloatUniform(shader, "relaxation",
+                  m_enableRelaxation ? scene.getGlobalData().relaxation
+                                     : 1.f);
+  // Resolution of the shadows and AO (deferred passes only)
+  setIntUniform(shader, "lightingScale", m_lightingScale);
+}
+
+/**
+ * @brief Sets all the uniforms for all the shapes in our scene
+ * - the object buffers are only re-uploaded when the scene changed
+ * - the SDF cache is baked in the background after the scene or the
+ *   Mandelbulb changed, the frames until it is done evaluate every object
+ * @param shader Shader program we are using
+ */
+void RayMarchRenderer::configureShapesUniforms(GLuint shader) {
+  if (m_objectsDirty) {
+    uploadObjects();
+    uploadBVH();
+    m_objectsDirty = false;
+  }
+  updateSDFCache(false);
+  // Object buffers
+  glActiveTexture(GL_TEXTURE0 + OBJECT_GEOMETRY_TEX_UNIT_OFF);
+  glBindTexture(GL_TEXTURE_BUFFER, m_objectGeometryTexture);
+  glActiveTexture(GL_TEXTURE0 + OBJECT_MATERIALS_TEX_UNIT_OFF);
+  glBindTexture(GL_TEXTURE_BUFFER, m_objectMaterialTexture);
+  // BVH
+  glActiveTexture(GL_TEXTURE0 + BVH_NODES_TEX_UNIT_OFF);
+  glBindTexture(GL_TEXTURE_BUFFER, m_bvhNodeTexture);
+  glActiveTexture(GL_TEXTURE0 + BVH_OBJECTS_TEX_UNIT_OFF);
+  glBindTexture(GL_TEXTURE_BUFFER, m_bvhObjectTexture);
+  // SDF cache
+  glActiveTexture(GL_TEXTURE0 + SDF_CACHE_GRID_TEX_UNIT_OFF);
+  glBindTexture(GL_TEXTURE_3D, m_sdfCacheGridTexture);
+  glActiveTexture(GL_TEXTURE0 + SDF_CACHE_ATLAS_TEX_UNIT_OFF);
+  glBindTexture(GL_TEXTURE_3D, m_sdfCacheAtlasTexture);
+  // Material textures
+  for (const auto &[unit, texture] : m_objectTextureUnits) {
+    glActiveTexture(GL_TEXTURE0 + unit);
+    glBindTexture(GL_TEXTURE_2D, texture);
+  }
+  glActiveTexture(GL_TEXTURE0);
+  setIntUniform(shader, "numObjects", m_numObjects);
+  setIntUniform(shader, "numBVHNodes", m_numBVHNodes);
+  setIntUniform(shader, "numUnboundedObjects", m_numUnboundedObjects);
+  setIntUniform(shader, "unboundedStart", m_unboundedStart);
+  setIntUniform(shader, "numUncachedObjects", m_numUncachedObjects);
+  bool useSDFCache = m_enableSDFCache && m_sdfCacheValid && !m_twoDSpace;
+  setIntUniform(shader, "useSDFCache", useSDFCache);
+  // - m_sdfCache belongs to the bake while it runs (m_sdfCacheValid is false)
+  if (useSDFCache) {
+    setVec3Uniform(shader, "sdfCacheMin", m_sdfCache.getMin());
+    setVec3Uniform(shader, "sdfCacheDims",
+                   glm::vec3(m_sdfCache.getGridDims()));
+    setFloatUniform(shader, "sdfCacheCellSize", m_sdfCache.getCellSize());
+    setFloatUniform(shader, "sdfCacheError", m_sdfCache.getError());
+    setFloatUniform(shader, "sdfCacheRefine",
+                    SDF_CACHE_REFINE * m_sdfCache.getVoxelSize());
+  }
+  setFloatUniform(shader, "power", m_power);
+  setVec2Uniform(shader, "juliaSeed", m_juliaSeed);
+}
+
+/**
+ * @brief Packs the shapes into the object buffers and uploads them
+ * - also assigns a texture unit to the first MAX_NUM_TEXTURES material
+ *   textures
+ */
+void RayMarchRenderer::uploadObjects() {
+  std::map<std::string, int> texMap;
+  m_objectTextureUnits.clear();
+  for (const RayMarchObj &obj : scene.getShapes()) {
+    if (obj.m_texture == -1) {
+      continue;
+    }
+    std::string texName = obj.m_material.textureMap.filename;
+    int texCnt = m_objectTextureUnits.size();
+    if (texMap.find(texName) == texMap.end() && texCnt != MAX_NUM_TEXTURES) {
+      // If texture not bound yet and we have not reached the limit
+      // "texName" is bound to unit 0 + "texCnt"
+      m_objectTextureUnits.emplace_back(texCnt, obj.m_texture);
+      texMap[texName] = texCnt;
+    }
+  }
+
+  std::vector<glm::vec4> geometry, materials;
+  scene.packObjects(texMap, geometry, materials);
+  m_numObjects = scene.getShapes().size();
+
+  // Texture buffers are limited to GL_MAX_TEXTURE_BUFFER_SIZE texels
+  GLint maxTexels;
+  glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &maxTexels);
+  int maxObjects = maxTexels / OBJECT_MATERIAL_TEXELS;
+  if (m_numObjects > maxObjects) {
+    std::cerr << "Warning: Scene has " << m_numObjects
+              << " objects, only the first " << maxObjects << " are rendered"
+              << std::endl;
+    m_numObjects = maxObjects;
+    geometry.resize(m_numObjects * OBJECT_GEOMETRY_TEXELS);
+    materials.resize(m_numObjects * OBJECT_MATERIAL_TEXELS);
+  }
+  // - never allocate an empty buffer
+  geometry.resize(std::max<size_t>(geometry.size(), 1));
+  materials.resize(std::max<size_t>(materials.size(), 1));
+
+  glBindBuffer(GL_TEXTURE_BUFFER, m_objectGeometryBuffer);
+  glBufferData(GL_TEXTURE_BUFFER, geometry.size() * sizeof(glm::vec4),
+               geometry.data(), GL_STATIC_DRAW);
+  glBindBuffer(GL_TEXTURE_BUFFER, m_objectMaterialBuffer);
+  glBufferData(GL_TEXTURE_BUFFER, materials.size() * sizeof(glm::vec4),
+               materials.data(), GL_STATIC_DRAW);
+  glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+/**
+ * @brief Uploads the nodes and the object indices of the BVH
+ * - the unbounded objects that are not in the SDF cache go first, so that
+ *   sdScene can evaluate them before it looks up the cache. The objects
+ *   too large for the cache are among them (see RayMarchScene::initScene)
+ */
+void RayMarchRenderer::uploadBVH() {
+  const BVH &bvh = scene.getBVH();
+  std::vector<glm::vec4> nodes;
+  bvh.packNodes(nodes);
+  std::vector<GLint> objects(bvh.getObjectIndices().begin(),
+                             bvh.getObjectIndices().end());
+  m_numBVHNodes = bvh.getNodes().size();
+  m_numUnboundedObjects = bvh.getNumUnbounded();
+  m_unboundedStart = objects.size() - m_numUnboundedObjects;
+  std::vector<bool> cached = SDFCache::getCachedObjects(scene.getShapes());
+  auto uncached = std::stable_partition(objects.begin() + m_unboundedStart,
+                                        objects.end(),
+                                        [&](GLint i) { return !cached[i]; });
+  m_numUncachedObjects = uncached - (objects.begin() + m_unboundedStart);
+  // - never allocate an empty buffer
+  nodes.resize(std::max<size_t>(nodes.size(), 1));
+  objects.resize(std::max<size_t>(objects.size(), 1));
+
+  glBindBuffer(GL_TEXTURE_BUFFER, m_bvhNodeBuffer);
+  glBufferData(GL_TEXTURE_BUFFER, nodes.size() * sizeof(glm::vec4),
+               nodes.data(), GL_STATIC_DRAW);
+  glBindBuffer(GL_TEXTURE_BUFFER, m_bvhObjectBuffer);
+  glBufferData(GL_TEXTURE_BUFFER, objects.size() * sizeof(GLint),
+               objects.data(), GL_STATIC_DRAW);
+  glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+/**
+ * @brief Bakes the SDF cache on another thread and uploads it once it is
+ * done
+ * - the bake gets a copy of the objects, the shader evaluates every object
+ *   until it is uploaded
+ * - a bake is not interrupted. If the scene changed while it ran, its
+ *   result is dropped and the next bake starts
+ * @param wait Blocks until the cache of the scene is uploaded
+ */
+void RayMarchRenderer::updateSDFCache(bool wait) {
+  auto finishBake = [&]() {
+    bool baked = m_sdfCacheBake.get();
+    if (baked && !m_sdfCacheDirty) {
+      uploadSDFCache();
+      m_sdfCacheValid = true;
+    }
+  };
+  if (m_sdfCacheBake.valid() &&
+      (wait || m_sdfCacheBake.wait_for(std::chrono::seconds(0)) ==
+                   std::future_status::ready)) {
+    finishBake();
+  }
+  if (m_sdfCacheBake.valid() || !m_sdfCacheDirty || !m_enableSDFCache ||
+      m_twoDSpace) {
+    return;
+  }
+  m_sdfCacheDirty = false;
+  m_sdfCacheValid = false;
+  m_sdfCacheBake = std::async(
+      std::launch::async, [this, objects = scene.getShapes(), power = m_power,
+                           juliaSeed = m_juliaSeed]() {
+        return m_sdfCache.bake(objects, power, juliaSeed);
+      });
+  if (wait) {
+    finishBake();
+  }
+}
+
+/**
+ * @brief Uploads the grid and the bricks of the last bake
+ */
+void RayMarchRenderer::uploadSDFCache() {
+  glm::ivec3 gridDims = m_sdfCache.getGridDims();
+  glm::ivec3 atlasDims = m_sdfCache.getAtlasDims();
+  glBindTexture(GL_TEXTURE_3D, m_sdfCacheGridTexture);
+  glTexImage3D(GL_TEXTURE_3D, 0, GL_RGBA32F, gridDims.x, gridDims.y,
+               gridDims.z, 0, GL_RGBA, GL_FLOAT, m_sdfCache.getGrid().data());
+  glBindTexture(GL_TEXTURE_3D, m_sdfCacheAtlasTexture);
+  glTexImage3D(GL_TEXTURE_3D, 0, GL_R16F, atlasDims.x, atlasDims.y,
+               atlasDims.z, 0, GL_RED, GL_FLOAT, m_sdfCache.getAtlas().data());
+  glBindTexture(GL_TEXTURE_3D, 0);
+}
+
+/**
+ * @brief Initializes post processing uniforms
+ * - the permutation without the effect ignores its uniforms
+ */
+void RayMarchRenderer::configurePostUniforms(GLuint shader) {
+  // Exposure
+  setFloatUniform(shader, "exposure", m_exposure);
+  // - level 0 of the mip chain holds the sum of every level
+  setFloatUniform(shader, "bloomScale", 1.f / m_bloomMipCount);
+  glActiveTexture(GL_TEXTURE1);
+  glBindTexture(GL_TEXTURE_2D, m_bloomMips[0]);
+  // Inverse Screen Dimensions
+  // - FXAA runs at the output size
+  float inverseWidth = 1.0 / scene.m_width;
+  float inverseHeight = 1.0 / scene.m_height;
+  setVec2Uniform(shader, "inverseScreenSize",
+                 glm::vec2(inverseWidth, inverseHeight));
+}
+
+/**
+ * @brief Destroyes all generated shape material texture
+ */
+void RayMarchRenderer::destroyShapesTextures() {
+  for (auto &[name, id] : m_TextureMap) {
+    glDeleteTextures(1, &id);
+  }
+  m_TextureMap.clear();
+}
+
+/**
+ * @brief Clean up any rss allocated for our custom FBO
+ */
+void RayMarchRenderer::destroyCustomFBO() {
+  glDeleteTextures(1, &m_hdrTexture);
+  glDeleteTextures(1, &m_bloomBrightnessTexture);
+  glDeleteTextures(1, &m_customFBOColorTexture);
+  glDeleteTextures(BLOOM_MAX_MIPS, m_bloomMips);
+  glDeleteRenderbuffers(1, &m_customFBORenderBuffer);
+  glDeleteFramebuffers(1, &m_customFBO);
+  glDeleteFramebuffers(1, &m_hdrFBO);
+  glDeleteFramebuffers(BLOOM_MAX_MIPS, m_bloomFBO);
+  glDeleteTextures(1, &m_accumTexture);
+  glDeleteFramebuffers(1, &m_accumFBO);
+  glDeleteTextures(1, &m_upscaleTexture);
+  glDeleteFramebuffers(1, &m_upscaleFBO);
+  glDeleteTextures(1, &m_prepassTexture);
+  glDeleteFramebuffers(1, &m_prepassFBO);
+  glDeleteTextures(1, &m_hitDepthTexture);
+  glDeleteTextures(1, &m_reprojectTexture);
+  glDeleteRenderbuffers(1, &m_reprojectRenderBuffer);
+  glDeleteFramebuffers(1, &m_reprojectFBO);
+  glDeleteTextures(1, &m_costTexture);
+  m_costReadback.finish();
+  glDeleteTextures(1, &m_gPositionTexture);
+  glDeleteTextures(1, &m_gNormalTexture);
+  glDeleteTextures(1, &m_gTrapTexture);
+  glDeleteTextures(1, &m_gCustomIdTexture);
+  glDeleteFramebuffers(1, &m_gbufferFBO);
+  destroyLightingTargets();
+}
+
+/**
+ * @brief Clean up the shadow and AO targets
+ */
+void RayMarchRenderer::destroyLightingTargets() {
+  glDeleteTextures(1, &m_shadowTexture);
+  glDeleteFramebuffers(1, &m_shadowFBO);
+  glDeleteTextures(1, &m_aoTexture);
+  glDeleteFramebuffers(1, &m_aoFBO);
+}
+
+/**
+ * @brief Update the settings
+ */
+void RayMarchRenderer::updateUISettings() {
+  // Update the options
+  m_exposure = settings.exposure;
+  m_enableGammaCorrection = settings.enableGammaCorrection;
+  m_enableHDR = settings.enableHDR;
+  m_enableBloom = settings.enableBloom;
+  m_enableSoftShadow = settings.enableSoftShadow;
+  m_enableReflection = settings.enableReflection;
+  m_enableRefraction = settings.enableRefraction;
+  m_enableAmbientOcclusion = settings.enableAmbientOcculusion;
+  if (m_enableBumpMap != settings.enableBumpMap) {
+    // Switch the permutation and re-specialize the scene for it
+    m_enableBumpMap = settings.enableBumpMap;
+    if (selectRayMarchShader()) {
+      requestSceneShader();
+    }
+  }
+  if (m_power != settings.power || m_juliaSeed != settings.juliaSeed) {
+    // - the Mandelbulb is in the SDF cache
+    m_sdfCacheDirty = true;
+    // - and its surfaces of the last frame are gone
+    m_hitDepthValid = false;
+  }
+  m_power = settings.power;
+  m_enableFXAA = settings.enableFXAA;
+  m_enableDepthPrepass = settings.enableDepthPrepass;
+  m_enableReprojection = settings.enableReprojection;
+  m_enableRelaxation = settings.enableRelaxation;
+  m_enableSDFCache = settings.enableSDFCache;
+  m_enableDeferred = settings.enableDeferred;
+  if (m_lightingScale != settings.lightingScale) {
+    m_lightingScale = settings.lightingScale;
+    destroyLightingTargets();
+    initLightingTargets();
+  }
+  m_costHeatmap = settings.costHeatmap;
+  // - the heatmap shows the cost of a single frame
+  m_enableAccumulation = settings.enableAccumulation && m_costHeatmap == 0;
+  m_sampleBudget = settings.sampleBudget;
+  m_enableDynamicResolution = settings.enableDynamicResolution;
+  m_targetFrameTime = settings.targetFrameTime;
+  m_juliaSeed = settings.juliaSeed;
+  m_terrainH = settings.terrainH;
+  m_terrainS = settings.terrainS;
+  m_numOctaves = settings.numOctaves;
+  if (m_idxSkyBox != settings.idxSkyBox) {
+    // If new sky box is selected
+    if (m_idxSkyBox) {
+      // If a cube map was already loaded
+      glDeleteTextures(1, &m_cubeMapTexture);
+    }
+    // Create the new cube map for selected skybox
+    initCubeMap(static_cast<CUBEMAP>(settings.idxSkyBox));
+  }
+  m_idxSkyBox = settings.idxSkyBox;
+}
+
+// =============== AREA Lights ==============
+// Most of this is lowk black magic
+// source: https://learnopengl.com/Guest-Articles/2022/Area-Lights
+
+/**
+ * @brief Load M Texture
+ */
+void RayMarchRenderer::loadMTexture() {
+  glGenTextures(1, &m_mTexture);
+  glBindTexture(GL_TEXTURE_2D, m_mTexture);
+
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 64, 64, 0, GL_RGBA, GL_FLOAT, LTC1);
+
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+  glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+/**
+ * @brief Load LTU Texture
+ */
+void RayMarchRenderer::loadLTUTexture() {
+  glGenTextures(1, &m_ltuTexture);
+  glBindTexture(GL_TEXTURE_2D, m_ltuTexture);
+
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 64, 64, 0, GL_RGBA, GL_FLOAT, LTC2);
+
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+  glBindTexture(GL_TEXTURE_2D, 0);
+}
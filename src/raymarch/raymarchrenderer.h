@@ -0,0 +1,555 @@
+#ifndef RAYMARCHRENDERER_H
+#define RAYMARCHRENDERER_H
+
+// Defined before including GLEW to suppress deprecation messages on macOS
+#ifdef __APPLE__
+#define GL_SILENCE_DEPRECATION
+#endif
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include "raymarch/costreadback.h"
+#include "raymarch/lightclusters.h"
+#include "raymarch/passtimer.h"
+#include "raymarch/raymarchscene.h"
+#include "raymarch/sceneblocks.h"
+#include "raymarch/sdfcache.h"
+#include <QImage>
+#include <future>
+#include <unordered_map>
+
+#define MAX_NUM_TEXTURES 10
+#define MAX_NUM_CUSTOM_TEXTURES 3
+#define SKYBOX_TEX_UNIT_OFF 10
+#define LTC1_TEX_UNIT_OFF 11
+#define LTC2_TEX_UNIT_OFF 12
+#define NOISE_TEX_UNIT_OFF 13
+#define BLUE_NOISE_TEX_UNIT_OFF 14
+#define CUSTOM_TEX_UNIT_OFF 15
+#define OBJECT_GEOMETRY_TEX_UNIT_OFF 18
+#define OBJECT_MATERIALS_TEX_UNIT_OFF 19
+#define BVH_NODES_TEX_UNIT_OFF 20
+#define BVH_OBJECTS_TEX_UNIT_OFF 21
+#define PREPASS_TEX_UNIT_OFF 22
+#define REPROJECTION_TEX_UNIT_OFF 23
+#define HIT_DEPTH_TEX_UNIT_OFF 24
+#define GBUFFER_POSITION_TEX_UNIT_OFF 25
+#define GBUFFER_NORMAL_TEX_UNIT_OFF 26
+#define GBUFFER_TRAP_TEX_UNIT_OFF 27
+#define GBUFFER_CUSTOM_ID_TEX_UNIT_OFF 28
+#define SHADOW_TEX_UNIT_OFF 29
+#define AO_TEX_UNIT_OFF 30
+#define LIGHT_DATA_TEX_UNIT_OFF 31
+#define LIGHT_CLUSTERS_TEX_UNIT_OFF 32
+#define SDF_CACHE_GRID_TEX_UNIT_OFF 33
+#define SDF_CACHE_ATLAS_TEX_UNIT_OFF 34
+// Bloom mip chain
+// - levels are 1/2, 1/4, ... of the render resolution down to the first that
+//   is at most this tall, so the bloom covers the same part of the screen at
+//   any resolution
+#define BLOOM_MIN_HEIGHT 16
+#define BLOOM_MAX_MIPS 8
+
+// Pixels per side of a depth prepass tile (PREPASS_TILE in raymarch.frag)
+#define DEPTH_PREPASS_TILE 8
+
+// Layers of the deferred shadow texture (4 lights of the cluster of a pixel
+// per RGBA layer)
+#define SHADOW_LAYERS (MAX_CLUSTER_LIGHTS / 4)
+
+// Dynamic resolution
+// - smallest scale of the render resolution and the step between scales
+#define MIN_RENDER_SCALE 0.25f
+#define RENDER_SCALE_STEP 0.125f
+// - frame times within this fraction of the target keep the scale
+#define RENDER_SCALE_SLACK 0.1f
+// - frames the scale must be off before the render targets are re-created
+#define RENDER_SCALE_FRAMES 15
+
+class RayMarchRenderer {
+  // Owns every GL resource of the raymarch pipeline (shaders, textures, FBOs)
+  // and renders a RayMarchScene into an output FBO. It does not depend on a
+  // window, so both the Realtime widget and the headless CLI drive it. A GL
+  // context must be current whenever any of the methods below are called.
+
+public:
+  // PUBLIC METHODS
+
+  // Initializes GL, the shaders and the render targets for width x height
+  void initialize(int width, int height);
+  // Destroys all the GL resources
+  void finish();
+  // Renders the current frame into the output FBO
+  void render();
+  // Resizes the scene and the render targets
+  void resize(int width, int height);
+  // Loads the scene file given by settings.sceneFilePath
+  void sceneChanged();
+  // Applies the latest settings
+  void settingsChanged();
+  // Renders the current frame offline and reads it back
+  QImage renderToImage();
+  // True if the next frame can differ from the last one without any change
+  // to the scene, the camera or the settings
+  bool needsRedraw();
+  // Gets the number of samples in the accumulation buffer
+  int getSampleCount();
+  // Gets the scale of the render resolution relative to the output
+  float getRenderScale();
+
+  // Sets the FBO that the last pass writes to
+  void setOutputFBO(GLuint fbo);
+  // Sets the time (in seconds) that is fed to iTime
+  void setTime(float time);
+  // Writes the march cost of every pixel and reads it back every frame
+  // - always on while the cost heatmap is shown
+  void setCostOutput(bool enabled);
+  // Gets the scene
+  RayMarchScene &getScene();
+  // Gets the GPU timings of the passes
+  PassTimer &getPassTimer();
+  // Gets the march cost of the latest frame that was read back
+  CostReadback &getCostReadback();
+
+private:
+  // PRIVATE DATA
+
+  // RayMarch scene
+  RayMarchScene scene;
+
+  // Time fed to iTime
+  float m_time = 0.f;
+  // True if the raymarch pass writes the march cost (see setCostOutput)
+  bool m_costOutput = false;
+
+  // GPU time of every pass
+  PassTimer m_passTimer;
+  // March cost of the frames
+  CostReadback m_costReadback;
+
+  // Shader
+  // - raymarch shader (permutation of the scene)
+  GLuint m_rayMarchShader = 0;
+  // - debug shader
+  GLuint m_debugShader;
+  // - Bloom (mip chain down / upsample shader)
+  GLuint m_bloomShader;
+  // - edge-aware upscale shader
+  GLuint m_upscaleShader;
+  // - scatters the hit depth of the last frame into the current view
+  GLuint m_reprojectShader;
+  // - heatmap of the march cost
+  GLuint m_heatmapShader;
+
+  // Raymarch shader permutations by their defines (see getShaderDefines)
+  std::unordered_map<std::string, GLuint> m_rayMarchPermutations;
+  // - defines of m_rayMarchShader
+  std::vector<std::string> m_shaderDefines;
+
+  // Post processing shader permutations by their defines (see
+  // getPostShader)
+  std::unordered_map<std::string, GLuint> m_postShaders;
+  // - source they are built from
+  std::string m_postFragCode;
+
+  // Scene specialized raymarch shaders (see SceneShader)
+  // - sources of the raymarch shader that the variants are built from
+  std::string m_rayMarchVertCode;
+  std::string m_rayMarchFragCode;
+  // - variants by hash of their source (0 if the variant failed to build)
+  std::unordered_map<size_t, GLuint> m_sceneShaders;
+  // - variant being compiled (0 if none) and its hash
+  GLuint m_pendingSceneShader = 0;
+  size_t m_pendingSceneHash = 0;
+  // - shader of the raymarch pass (generic until the variant is ready)
+  GLuint m_activeRayMarchShader = 0;
+
+  // Textures
+  // - default material texture
+  GLuint m_defaultShapeTexture;
+  // - map from file name to texture object
+  std::unordered_map<std::string, GLuint> m_TextureMap;
+  // - hdr texture
+  GLuint m_hdrTexture;
+  // - Bloom
+  GLuint m_bloomBrightnessTexture;
+  // - cube map texture
+  GLuint m_cubeMapTexture;
+  // - null cube map texture
+  GLuint m_nullCubeMapTexture;
+  // - noise texture
+  GLuint m_noiseTexture;
+  // - blue noise texture
+  GLuint m_blueNoiseTexture;
+  // - custom textures
+  GLuint m_customTextures[3];
+  // - material textures bound for the objects (texture unit, texture)
+  std::vector<std::pair<int, GLuint>> m_objectTextureUnits;
+
+  // Object Buffers (texture buffers packed by RayMarchScene::packObjects)
+  GLuint m_objectGeometryBuffer;
+  GLuint m_objectGeometryTexture;
+  GLuint m_objectMaterialBuffer;
+  GLuint m_objectMaterialTexture;
+  // - number of objects in the buffers
+  int m_numObjects = 0;
+  // BVH Buffers (flattened RayMarchScene::getBVH)
+  GLuint m_bvhNodeBuffer;
+  GLuint m_bvhNodeTexture;
+  GLuint m_bvhObjectBuffer;
+  GLuint m_bvhObjectTexture;
+  int m_numBVHNodes = 0;
+  // - objects without bounds, listed after the leaves in the object buffer
+  int m_numUnboundedObjects = 0;
+  int m_unboundedStart = 0;
+  // - unbounded objects that are not in the SDF cache, listed first
+  int m_numUncachedObjects = 0;
+
+  // SDF Cache (SDFCache of the static objects)
+  // - grid of the cells (RGBA32F) and atlas of the bricks (R16F)
+  GLuint m_sdfCacheGridTexture;
+  GLuint m_sdfCacheAtlasTexture;
+  SDFCache m_sdfCache;
+  // - bake running on another thread (invalid if none), true if it cached
+  //   anything. Declared after m_sdfCache, so it is waited for first
+  std::future<bool> m_sdfCacheBake;
+  // - true if the grid and the bricks of the scene are uploaded
+  bool m_sdfCacheValid = false;
+
+  // Light Buffers
+  // - LIGHT_TEXELS texels per light (see uploadLights)
+  GLuint m_lightDataBuffer;
+  GLuint m_lightDataTexture;
+  // - clusters of the view frustum and their light indices
+  //   (LightClusters::packClusters)
+  GLuint m_lightClusterBuffer;
+  GLuint m_lightClusterTexture;
+  LightClusters m_lightClusters;
+  // - view and projection the clusters were built for
+  glm::mat4 m_clusterProjView = glm::mat4(0.f);
+  // - the lights of a cluster were dropped since the scene was loaded
+  bool m_clusterOverflowWarned = false;
+
+  // Uniform Buffers
+  // - number of lights and the phong constants (LightBlock)
+  GLuint m_lightUBO;
+  // - true if the scene changed since the last upload
+  bool m_objectsDirty = true;
+  bool m_lightsDirty = true;
+  bool m_sdfCacheDirty = true;
+
+  // Uniform locations per shader program, resolved on first use
+  std::unordered_map<GLuint, std::unordered_map<std::string, GLint>>
+      m_uniformLocations;
+
+  // FBO
+  // - output FBO (application window or offscreen target)
+  GLuint m_defaultFBO = 4;
+  // - custom FBO (color texture) and HDR FBO (hdr texture), both with the
+  //   bloom, hit depth and march cost attached (see getFrameFBO)
+  GLuint m_customFBO;
+  GLuint m_hdrFBO;
+  GLuint m_customFBOColorTexture;
+  GLuint m_customFBORenderBuffer;
+  // - Bloom
+  // - mip chain, level 0 holds the bloom once applyBloom is done
+  GLuint m_bloomFBO[BLOOM_MAX_MIPS];
+  GLuint m_bloomMips[BLOOM_MAX_MIPS];
+  glm::ivec2 m_bloomMipSizes[BLOOM_MAX_MIPS];
+  int m_bloomMipCount = 0;
+
+  // - depth prepass (one texel per tile, R32F depth from the eye)
+  GLuint m_prepassFBO;
+  GLuint m_prepassTexture;
+  int m_prepassWidth = 0;
+  int m_prepassHeight = 0;
+  // - hit depth of the primary rays (R32F depth from the eye, 0 if no hit),
+  //   attached to the custom FBO during the raymarch pass only
+  GLuint m_hitDepthTexture;
+  // - hit depth of the last frame reprojected into the current view
+  GLuint m_reprojectFBO;
+  GLuint m_reprojectTexture;
+  GLuint m_reprojectRenderBuffer;
+  // - march cost of the pixels (RGBA32F, see CostChannel), attached to the
+  //   custom FBO during the raymarch pass only
+  GLuint m_costTexture;
+  // - upscaled image at the output size (read by FXAA)
+  GLuint m_upscaleFBO;
+  GLuint m_upscaleTexture;
+
+  // Deferred Shading
+  // - G-buffer of the primary rays: position and depth from the eye (0 if no
+  //   hit), normal and object, trap and custom id
+  GLuint m_gbufferFBO;
+  GLuint m_gPositionTexture;
+  GLuint m_gNormalTexture;
+  GLuint m_gTrapTexture;
+  GLuint m_gCustomIdTexture;
+  // - visibility of every light (light i is channel i % 4 of layer i / 4)
+  GLuint m_shadowFBO;
+  GLuint m_shadowTexture;
+  // - ambient occlusion
+  GLuint m_aoFBO;
+  GLuint m_aoTexture;
+  // - size of the shadow and AO targets (the render resolution divided by
+  //   m_lightingScale, rounded up)
+  int m_lightingWidth = 0;
+  int m_lightingHeight = 0;
+
+  // Render Resolution
+  // - every target of initCustomFBO has this size, the output FBO has the
+  //   size of the scene
+  int m_renderWidth = 0;
+  int m_renderHeight = 0;
+  float m_renderScale = 1.f;
+  // - frames the frame time asked for another scale in a row
+  int m_scaleFrames = 0;
+
+  // Progressive Accumulation
+  // - running mean of the jittered samples (RGBA32F)
+  GLuint m_accumFBO;
+  GLuint m_accumTexture;
+  // - samples in the accumulation buffer
+  int m_sampleCount = 0;
+  // - true once the unjittered frame of the current view was drawn
+  bool m_accumPrimed = false;
+  // - sample drawn by the current frame (0 if not accumulating)
+  int m_sampleIndex = 0;
+  // - camera of the accumulated samples
+  glm::mat4 m_accumProjView = glm::mat4(0.f);
+
+  // Temporal Reprojection
+  // - VAO without attributes for the points of the reprojection pass
+  GLuint m_pointsVAO;
+  // - true if the hit depth texture holds the last frame
+  bool m_hitDepthValid = false;
+  // - camera of the hit depth
+  glm::mat4 m_hitDepthInvProjView = glm::mat4(1.f);
+  glm::vec3 m_hitDepthEye = glm::vec3(0.f);
+
+  // Image Plane through which we march rays
+  GLuint m_imagePlaneVAO;
+  GLuint m_imagePlaneVBO;
+
+  // Full Screen Quad for post processing
+  GLuint m_fullscreenVAO;
+  GLuint m_fullscreenVBO;
+
+  // Area Light
+  // source: https://learnopengl.com/Guest-Articles/2022/Area-Lights
+  bool m_isAreaLightUsed = false;
+  GLuint m_mTexture;
+  GLuint m_ltuTexture;
+  void loadMTexture();
+  void loadLTUTexture();
+  const std::vector<glm::vec3> corners = {
+      glm::vec3(-0.5f, 0.5f, 0.f),  // tl
+      glm::vec3(0.5f, 0.5f, 0.f),   // tr
+      glm::vec3(0.5f, -0.5f, 0.f),  // br
+      glm::vec3(-0.5f, -0.5f, 0.f), // bl
+  };
+
+  // Toggelable Options
+
+  // Others
+  bool m_twoDSpace = false;
+
+  // Render Effects
+  // - soft shadow
+  bool m_enableSoftShadow = false;
+  // - reflection
+  bool m_enableReflection = false;
+  // - refraction
+  bool m_enableRefraction = false;
+  // - ambient occulusion
+  bool m_enableAmbientOcclusion = false;
+  // - bump mapping (if the scene uses it)
+  bool m_enableBumpMap = true;
+  // - cone marched depth prepass
+  bool m_enableDepthPrepass = true;
+  // - primary rays start from the reprojected depth of the last frame
+  bool m_enableReprojection = true;
+  // - over-relaxed sphere tracing (factor from the globalData of the scene)
+  bool m_enableRelaxation = true;
+  // - steps by the baked distance to the static objects away from them
+  bool m_enableSDFCache = true;
+  // - deferred shading (G-buffer, shadow, AO and lighting passes)
+  bool m_enableDeferred = false;
+  // - pixels per side of a texel of the shadows and AO (1, 2 or 4), anything
+  //   above 1 needs the deferred passes
+  int m_lightingScale = 1;
+  // - sky box
+  int m_idxSkyBox = 0;
+  // - progressive accumulation and its sample budget
+  bool m_enableAccumulation = true;
+  int m_sampleBudget = 64;
+  // - dynamic resolution and its target GPU time per frame (ms)
+  bool m_enableDynamicResolution = false;
+  float m_targetFrameTime = 16.6f;
+  // Post Processing Effects
+  // - FXAA
+  bool m_enableFXAA = false;
+
+  // Lighting Effects
+  // - exposure
+  float m_exposure = 1.f;
+  // - HDR
+  bool m_enableHDR = false;
+  // - Bloom
+  bool m_enableBloom = false;
+  // - gamma correction
+  bool m_enableGammaCorrection = false;
+  // - heatmap of a channel of the march cost instead of the image (0 if off,
+  //   else the CostChannel + 1)
+  int m_costHeatmap = 0;
+
+  // Fractals
+  // - power of fractals
+  float m_power = 8.f;
+  // - julia seed (real and imaginary components)
+  glm::vec2 m_juliaSeed = glm::vec2(0.f);
+
+  // Procedural
+  float m_terrainH = 10.;
+  float m_terrainS = 2.75;
+  int m_numOctaves = 8.;
+
+  // PRIVATE METHODS
+
+  // Performs raymarching using our raymarch shader
+  void rayMarch();
+  // Cone marches the start depth of every tile
+  // - the uniforms of the raymarch pass must be set
+  void renderDepthPrepass(GLuint shader);
+  // Scatters the hit depth of the last frame into the current view
+  void reprojectHitDepth();
+  // Turns the hit depth and the march cost on (or off) as the third and
+  // fourth outputs of a frame FBO or the G-buffer
+  void setRaymarchOutputs(GLuint fbo, bool hitDepth, bool cost);
+  // Gets the FBO that the raymarch pass draws the frame into offscreen
+  GLuint getFrameFBO();
+  // True if the scene can be shaded from the G-buffer
+  bool canDefer();
+  // Runs the shadow, AO and lighting passes on the G-buffer
+  void renderDeferredPasses(bool offscreen);
+  // Draws the heatmap of the march cost to the output FBO
+  void drawCostHeatmap();
+  // Upscales the render resolution image to the output size
+  void applyUpscale();
+  // Applies the light effects and FXAA to the frame texture in one pass
+  void applyPost(GLuint frame, GLuint fbo, bool lightEffects, bool fxaa);
+  // Gets the post processing permutation of the enabled effects
+  GLuint getPostShader(bool lightEffects, bool fxaa);
+  // Applies Bloom Post processing
+  void applyBloom();
+  // Draws to the fullsreen quad with given tex
+  void drawToQuadWithTex(GLuint tex);
+
+  // Gets the sample of the accumulation that the frame draws
+  // - 0 draws the frame as usual, -1 if the buffer already converged
+  int nextAccumulationSample();
+  // Blends the sample in the HDR texture into the accumulation buffer
+  void accumulateSample();
+  // Drops the accumulated samples
+  void resetAccumulation();
+  // True if the frame depends on iTime
+  bool isTimeDependent();
+
+  // Adjusts the render scale to the GPU time of the last frames
+  void updateRenderScale();
+  // Sets the render scale and re-creates the render targets if the render
+  // resolution changed
+  void setRenderScale(float scale);
+  // True if the render resolution is not the output size
+  bool isUpscaling();
+
+  // Initializes the shaders with constant uniforms
+  void initShader();
+  // Sets the constant uniforms of a generic or specialized raymarch shader
+  void initRayMarchShader(GLuint shader);
+  // Gets the defines of the raymarch shader for the scene and the settings
+  std::vector<std::string> getShaderDefines();
+  // Switches to the raymarch shader permutation of getShaderDefines
+  // - returns true if the permutation changed
+  bool selectRayMarchShader();
+  // Gets the permutation of the current defines for a deferred pass
+  GLuint getPassShader(const char *pass);
+  // Starts building the raymarch shader specialized for the scene
+  void requestSceneShader();
+  // Switches to the specialized raymarch shader once it is built
+  void pollSceneShader();
+  // Initializes all the default variables used in shader
+  void initDefaults();
+  // Initializes [-1,1] blank canvas to be used for raymarching
+  void initImagePlane();
+  // Initializes full screen quad
+  void initFullScreenQuad();
+  // Initializes each and every material texture used in the scene
+  void initShapesTextures();
+  // Initializes textures for custom scene
+  void initCustomTextures();
+  // Initializes our custom FBO for offline rendering
+  void initCustomFBO();
+  // Initializes the shadow and AO targets of the deferred passes
+  void initLightingTargets();
+  // Initializes our cube map
+  void initCubeMap(CUBEMAP type);
+  // Initializes the object texture buffers and the light uniform buffer
+  void initSceneBuffers();
+
+  // Sets the output FBO
+  void setFBO(GLuint fbo);
+
+  // Update settings
+  void updateUISettings();
+
+  // Sets the uniforms for our screen-related stuff
+  void configureScreenUniforms(GLuint shader);
+  // Sets the uniforms of every frame of a raymarch shader (all of the below)
+  void configureRayMarchUniforms(GLuint shader);
+  // Sets the uniforms for camera-related stuff
+  void configureCameraUniforms(GLuint shader);
+  // Sets the uniforms for each shape in the scene
+  void configureShapesUniforms(GLuint shader);
+  // Sets the jitter of the accumulated sample
+  void configureAccumulationUniforms(GLuint shader);
+  // Sets the uniforms for each light in the scene
+  void configureLightsUniforms(GLuint shader);
+  // Packs the shapes into the object buffers and uploads them
+  void uploadObjects();
+  // Flattens the BVH of the scene and uploads it
+  void uploadBVH();
+  // Packs the lights into the light buffer and the light block and uploads
+  // them
+  void uploadLights();
+  // Bins the lights into the clusters of the current view and uploads them
+  void uploadLightClusters();
+  // Starts baking the SDF cache on another thread and uploads it once it is
+  // done
+  // - wait blocks until the bake is done
+  void updateSDFCache(bool wait);
+  // Uploads the grid and the bricks of the last bake
+  void uploadSDFCache();
+  // Sets the uniforms for all the rendering options
+  void configureSettingsUniforms(GLuint shader);
+  // Sets the uniforms of the post processing (light effects and FXAA)
+  void configurePostUniforms(GLuint shader);
+
+  // Destroies shapes textures
+  void destroyShapesTextures();
+  // Destroy custom FBO
+  void destroyCustomFBO();
+  // Destroys the shadow and AO targets
+  void destroyLightingTargets();
+
+  // Utility
+  GLint getUniformLocation(GLuint shader, const char *var);
+  void setIntUniform(GLuint shader, const char *, int val);
+  void setFloatUniform(GLuint shader, const char *, float val);
+  void setMat4Uniform(GLuint shader, const char *, const glm::mat4 &);
+  void setVec2Uniform(GLuint shader, const char *, const glm::vec2 &);
+  void setVec3Uniform(GLuint shader, const char *, const glm::vec3 &);
+  void setVec4Uniform(GLuint shader, const char *, const glm::vec4 &);
+};
+
+#endif // RAYMARCHRENDERER_H
@@ -1,4 +1,5 @@
 #include "raymarchscene.h"
+#include "raymarch/sdfcache.h"
 #include "utils/sceneparser.h"
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
@@ -11,6 +12,61 @@
  */
 std::vector<RayMarchObj> &RayMarchScene::getShapes() { return m_shapes; }
 
+/**
+ * @brief Packs the shapes into the layout of the object texture buffers
+ * - the geometry of an object (all that sdScene needs) is 4 texels, i.e. one
+ *   64 byte cache line, and is kept apart from the material
+ * @param textureUnits Texture unit of every bound texture file
+ * @param geometry OBJECT_GEOMETRY_TEXELS texels per shape
+ * @param materials OBJECT_MATERIAL_TEXELS texels per shape
+ */
+void RayMarchScene::packObjects(const std::map<std::string, int> &textureUnits,
+                                std::vector<glm::vec4> &geometry,
+                                std::vector<glm::vec4> &materials) const {
+  geometry.clear();
+  materials.clear();
+  geometry.reserve(m_shapes.size() * OBJECT_GEOMETRY_TEXELS);
+  materials.reserve(m_shapes.size() * OBJECT_MATERIAL_TEXELS);
+  for (const RayMarchObj &obj : m_shapes) {
+    // Geometry
+    // - the CTM is affine, so the last row of the inverse is (0, 0, 0, 1)
+    glm::mat4 rows = glm::transpose(obj.m_ctmInv);
+    geometry.push_back(rows[0]);
+    geometry.push_back(rows[1]);
+    geometry.push_back(rows[2]);
+    // - need the scale factor to undo the side-effect of non-rigid tranform
+    float scaleF =
+        fmin(obj.m_scale[0][0], fmin(obj.m_scale[1][1], obj.m_scale[2][2]));
+    geometry.emplace_back(
+        static_cast<std::underlying_type_t<PrimitiveType>>(obj.m_type), scaleF,
+        0.f, 0.f);
+
+    // Material
+    const SceneMaterial &mat = obj.m_material;
+    int texLoc = -1;
+    if (obj.m_texture != -1) {
+      auto it = textureUnits.find(mat.textureMap.filename);
+      if (it != textureUnits.end()) {
+        texLoc = it->second;
+      }
+    }
+    materials.emplace_back(glm::vec3(mat.cAmbient), mat.shininess);
+    materials.emplace_back(glm::vec3(mat.cDiffuse), mat.blend);
+    materials.emplace_back(glm::vec3(mat.cSpecular), mat.ior);
+    materials.emplace_back(glm::vec3(mat.cReflective), mat.textureMap.repeatU);
+    materials.emplace_back(glm::vec3(mat.cTransparent),
+                           mat.textureMap.repeatV);
+    materials.emplace_back(glm::vec3(obj.m_color), obj.m_isEmissive);
+    materials.emplace_back(texLoc, obj.m_lightIdx, 0.f, 0.f);
+  }
+}
+
+/**
+ * @brief Gets the BVH over the shapes
+ * @returns BVH built when the scene was loaded
+ */
+const BVH &RayMarchScene::getBVH() const { return m_bvh; }
+
 /**
  * @brief Gets the shapes texture data of the scene
  * @returns map from texture file name to data
@@ -120,17 +176,23 @@ void RayMarchScene::initScene(Settings &from, bool &isAreaLightUsed) {
   // - Lights
   m_lights = rd.lights;
   isAreaLightUsed = rd.isAreaLightUsed;
-  if (!rd.isAreaLightUsed) {
-    return;
-  }
-  // We need to render area lights too
-  for (int i = 0; i < rd.lights.size(); i++) {
-    SceneLightData &lightData = rd.lights[i];
-    if (lightData.type != LightType::LIGHT_AREA)
-      continue;
-    m_shapes.emplace_back(m_shapes.size(), PrimitiveType::PRIMITIVE_RECTANGLE,
-                          lightData.ctm, lightData.color, i);
+  if (rd.isAreaLightUsed) {
+    // We need to render area lights too
+    for (int i = 0; i < rd.lights.size(); i++) {
+      SceneLightData &lightData = rd.lights[i];
+      if (lightData.type != LightType::LIGHT_AREA)
+        continue;
+      m_shapes.emplace_back(m_shapes.size(),
+                            PrimitiveType::PRIMITIVE_RECTANGLE, lightData.ctm,
+                            lightData.color, i);
+    }
   }
+  // - BVH over every shape (including the area lights)
+  // - the shapes that are not in the SDF cache are evaluated at every point
+  //   while the cache is used, so they are kept out of the tree
+  std::vector<bool> keepOut = SDFCache::getCachedObjects(m_shapes);
+  keepOut.flip();
+  m_bvh.build(m_shapes, keepOut);
 }
 
 /**
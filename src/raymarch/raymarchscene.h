@@ -2,12 +2,22 @@
 #define RAYMARCHSCENE_H
 
 #include "camera/camera.h"
+#include "raymarch/bvh.h"
 #include "raymarch/raymarchobj.h"
 #include "settings.h"
 #include "utils/sceneparser.h"
 #include <map>
 #include <string>
 #include <tuple>
+#include <vector>
+
+// Texels (RGBA32F) per object in the object texture buffers
+// - geometry: rows of the inverse model matrix, (type, scale factor, 0, 0)
+// - material: (cAmbient, shininess), (cDiffuse, blend), (cSpecular, ior),
+//   (cReflective, repeatU), (cTransparent, repeatV), (color, isEmissive),
+//   (texLoc, lightIdx, 0, 0)
+#define OBJECT_GEOMETRY_TEXELS 4
+#define OBJECT_MATERIAL_TEXELS 7
 
 struct RayMarchScene {
   // Struct that contains everything in the scene
@@ -36,6 +46,16 @@ public:
   // Gets Shapes
   std::vector<RayMarchObj> &getShapes();
 
+  // Packs the shapes for the object texture buffers of raymarch.frag
+  // - textureUnits maps a texture file to its texture unit. Textures that are
+  //   not in the map are not sampled
+  void packObjects(const std::map<std::string, int> &textureUnits,
+                   std::vector<glm::vec4> &geometry,
+                   std::vector<glm::vec4> &materials) const;
+
+  // Gets the BVH over the shapes
+  const BVH &getBVH() const;
+
   // Gets Shapes Textures
   std::map<std::string, TextureInfo> &getShapesTextures();
 
@@ -76,6 +96,8 @@ private:
 
   // Shapes
   std::vector<RayMarchObj> m_shapes;
+  // - BVH over the world space bounds of the shapes
+  BVH m_bvh;
 
   // Shapes Textures
   std::map<std::string, TextureInfo> m_textures;
@@ -0,0 +1,29 @@
+#ifndef SCENEBLOCKS_H
+#define SCENEBLOCKS_H
+
+#include <glm/glm.hpp>
+
+// Binding point of the uniform block in raymarch.frag
+#define LIGHT_BLOCK_BINDING 0
+
+// CPU side of the std140 uniform blocks in raymarch.frag. The member order
+// matches the GLSL structs exactly, so a block can be uploaded with a single
+// glBufferSubData.
+// - the size of a block is rounded up to 16 bytes
+// - objects and lights are not limited by a block size and live in texture
+//   buffers (see RayMarchScene::packObjects and
+//   RayMarchRenderer::uploadLights)
+
+// LightBlock
+struct LightBlock {
+  int numLights;
+  float ka;
+  float kd;
+  float ks;
+  float kt;
+  int pad[3];
+};
+
+static_assert(sizeof(LightBlock) == 32, "LightBlock is not std140");
+
+#endif // SCENEBLOCKS_H
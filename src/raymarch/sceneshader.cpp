@@ -0,0 +1,149 @@
+#include "sceneshader.h"
+#include "raymarch/sdfcache.h"
+#include <cmath>
+#include <iomanip>
+#include <sstream>
+
+/**
+ * @brief Checks if sdScene should be specialized for the objects
+ * @param objects Objects of the scene
+ * @returns True if the scene is small enough to unroll
+ */
+bool SceneShader::canSpecialize(const std::vector<RayMarchObj> &objects) {
+  return !objects.empty() && objects.size() <= SCENE_SHADER_MAX_OBJECTS;
+}
+
+/**
+ * @brief Generates an sdScene that evaluates every object
+ * - same result as the generic sdScene, object i is still object i
+ * - the objects that are not in the SDF cache go first, the cached ones are
+ *   skipped away from their surfaces while a march picks its steps
+ *   (skipCachedObjects in raymarch.frag checks USE_SDF_CACHE)
+ * @param objects Objects of the scene
+ * @returns GLSL source of the function
+ */
+std::string
+SceneShader::generateSDScene(const std::vector<RayMarchObj> &objects) {
+  std::vector<int> uncached, cached;
+  std::vector<bool> isCached = SDFCache::getCachedObjects(objects);
+  for (int i = 0; i < (int)objects.size(); i++) {
+    (isCached[i] ? cached : uncached).push_back(i);
+  }
+  std::ostringstream code;
+  code << "SceneMin sdScene(vec3 p) {\n"
+       << "    SceneMin res;\n"
+       << "    res.minD = 1000000.f; res.minObjIdx = -1;\n"
+       << "    int customId; vec4 trapCol;\n"
+       << "    vec3 po; float currD, fp;\n";
+  auto addObjects = [&](const std::vector<int> &indices) {
+    if (indices.empty()) {
+      return;
+    }
+    // - every object is evaluated (see marchCost in raymarch.frag)
+    code << "    SDF_EVALS += " << indices.size() << ";\n";
+    for (int i : indices) {
+      const RayMarchObj &obj = objects[i];
+      // World -> object space (the last row of the inverse CTM is 0, 0, 0, 1)
+      code << "    // " << i << "\n    po = mat4x3(";
+      for (int c = 0; c < 4; c++) {
+        for (int r = 0; r < 3; r++) {
+          code << toLiteral(obj.m_ctmInv[c][r])
+               << (c == 3 && r == 2 ? "" : ", ");
+        }
+      }
+      code << ") * vec4(p, 1.f);\n";
+      // - same scale factor as RayMarchScene::packObjects
+      float scaleF =
+          fmin(obj.m_scale[0][0], fmin(obj.m_scale[1][1], obj.m_scale[2][2]));
+      if (obj.m_type == PrimitiveType::MANDELBULB ||
+          obj.m_type == PrimitiveType::SIERPINSKI) {
+        // - pixel footprint in object space
+        code << "    fp = PIXEL_FOOTPRINT / " << toLiteral(scaleF) << ";\n";
+      }
+      code << "    currD = " << getSDFCall(obj.m_type) << " * "
+           << toLiteral(scaleF) << ";\n"
+           << "    if (currD < res.minD) {\n"
+           << "        res.minD = currD; res.minObjIdx = " << i << ";\n"
+           << "        res.customId = customId; res.trap = trapCol;\n"
+           << "    }\n";
+    }
+  };
+  addObjects(uncached);
+  if (!cached.empty()) {
+    code << "    if (skipCachedObjects(p, res)) return res;\n";
+  }
+  addObjects(cached);
+  code << "    return res;\n}\n";
+  return code.str();
+}
+
+/**
+ * @brief Builds the specialized variant of raymarch.frag
+ * @param fragmentCode Source of raymarch.frag
+ * @param sdScene Source generated by generateSDScene
+ * @returns Source of the variant (empty if the marker is missing)
+ */
+std::string SceneShader::specialize(const std::string &fragmentCode,
+                                    const std::string &sdScene) {
+  size_t marker = fragmentCode.find(SCENE_SHADER_MARKER);
+  if (marker == std::string::npos) {
+    return "";
+  }
+  std::string code = fragmentCode;
+  code.replace(marker, std::string(SCENE_SHADER_MARKER).size(), sdScene);
+  return code;
+}
+
+/**
+ * @brief Gets the SDF call of a primitive (see sdMatch in raymarch.frag)
+ * @param type Type of the primitive
+ * @returns GLSL expression on the object space point "po"
+ */
+std::string SceneShader::getSDFCall(PrimitiveType type) {
+  switch (type) {
+  case PrimitiveType::PRIMITIVE_CUBE:
+    return "sdBox(po, vec3(0.5))";
+  case PrimitiveType::PRIMITIVE_CONE:
+    return "sdCone(po, 0.5, 0.5)";
+  case PrimitiveType::PRIMITIVE_CYLINDER:
+    return "sdCylinder(po, 0.5, 0.5)";
+  case PrimitiveType::PRIMITIVE_SPHERE:
+    return "sdSphere(po, 0.5)";
+  case PrimitiveType::PRIMITIVE_OCTAHEDRON:
+    return "sdOctahedron(po, 0.5)";
+  case PrimitiveType::PRIMITIVE_TORUS:
+    return "sdTorus(po, vec2(0.5, 0.125))";
+  case PrimitiveType::PRIMITIVE_CAPSULE:
+    return "sdCapsule(po, 0.5, 0.1)";
+  case PrimitiveType::PRIMITIVE_DEATHSTAR:
+    return "sdDeathStar(po, 0.5, 0.35, 0.5)";
+  case PrimitiveType::PRIMITIVE_RECTANGLE:
+    return "sdBox(po, vec3(0.5, 0.5, 0))";
+  case PrimitiveType::MANDELBROT:
+    return "sdMandelBrot(vec2(po))";
+  case PrimitiveType::MANDELBULB:
+    return "sdMandelBulb(po, trapCol, fp)";
+  case PrimitiveType::MENGERSPONGE:
+    return "sdMengerSponge(po, trapCol)";
+  case PrimitiveType::SIERPINSKI:
+    return "sdSierpinski(po, fp)";
+  case PrimitiveType::CUSTOM:
+    return "sdCUSTOM(po, customId, trapCol)";
+  }
+  return "1000000.f";
+}
+
+/**
+ * @brief Formats a float as a GLSL literal without losing precision
+ * @param v Value
+ * @returns Literal with a decimal point or an exponent
+ */
+std::string SceneShader::toLiteral(float v) {
+  std::ostringstream s;
+  s << std::setprecision(9) << v;
+  std::string literal = s.str();
+  if (literal.find_first_of(".e") == std::string::npos) {
+    literal += ".0";
+  }
+  return literal;
+}
@@ -0,0 +1,44 @@
+#ifndef SCENESHADER_H
+#define SCENESHADER_H
+
+#include "raymarch/raymarchobj.h"
+#include <string>
+#include <vector>
+
+// Max number of objects for which sdScene is unrolled. Larger scenes keep the
+// generic BVH walk, which scales better than a long list of SDF calls and
+// does not blow up the compile time.
+#define SCENE_SHADER_MAX_OBJECTS 64
+
+// Line of raymarch.frag that is replaced by the generated sdScene
+#define SCENE_SHADER_MARKER "// @SPECIALIZED_SDSCENE@"
+
+class SceneShader {
+  // Generates a variant of raymarch.frag whose sdScene is specialized for a
+  // scene. Every object becomes a direct call to its SDF with the inverse CTM
+  // and the scale factor baked in as constants, so the compiler can inline and
+  // constant fold what the generic shader reads from the object buffers and
+  // dispatches through sdMatch.
+  // - materials are still read from the object buffers (same object indices)
+
+public:
+  // True if sdScene should be specialized for the objects
+  static bool canSpecialize(const std::vector<RayMarchObj> &objects);
+  // Generates the GLSL of the specialized sdScene
+  static std::string generateSDScene(const std::vector<RayMarchObj> &objects);
+  // Builds the variant of the fragment shader source
+  // - replaces SCENE_SHADER_MARKER with sdScene. The variant must be compiled
+  //   with SPECIALIZED_SCENE defined
+  // - returns an empty string if the source has no marker
+  static std::string specialize(const std::string &fragmentCode,
+                                const std::string &sdScene);
+
+private:
+  // Gets the SDF call of a primitive on the object space point "po"
+  // - fractals also take the pixel footprint "fp" in object space
+  static std::string getSDFCall(PrimitiveType type);
+  // Formats a float as a GLSL literal
+  static std::string toLiteral(float v);
+};
+
+#endif // SCENESHADER_H
@@ -0,0 +1,370 @@
+#include "sdfcache.h"
+#include "cpu/cpusdf.h"
+#include "raymarch/bvh.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <numeric>
+
+/**
+ * @brief Distance between two axis aligned boxes (0 if they overlap)
+ */
+static float boxDistance(const glm::vec3 &aMin, const glm::vec3 &aMax,
+                         const glm::vec3 &bMin, const glm::vec3 &bMax) {
+  return glm::length(glm::max(glm::max(aMin - bMax, bMin - aMax), 0.f));
+}
+
+/**
+ * @brief Checks if objects of a type can be cached
+ * - the Mandelbrot and the Menger sponge are animated by iTime and sdCUSTOM
+ *   has no CPU port
+ * @param type Type of the object
+ */
+bool SDFCache::isCacheable(PrimitiveType type) {
+  return type != PrimitiveType::MANDELBROT &&
+         type != PrimitiveType::MENGERSPONGE &&
+         type != PrimitiveType::CUSTOM;
+}
+
+/**
+ * @brief Gets the size of an object
+ * - the longest side of the world space bounds of its unit cube, the same
+ *   for every type, so it does not depend on the Mandelbulb power
+ * @param obj Object
+ */
+static float getSize(const RayMarchObj &obj) {
+  glm::vec3 min(FLT_MAX), max(-FLT_MAX);
+  for (int i = 0; i < 8; i++) {
+    glm::vec3 corner((i & 1) ? 0.5f : -0.5f, (i & 2) ? 0.5f : -0.5f,
+                     (i & 4) ? 0.5f : -0.5f);
+    glm::vec3 p = glm::vec3(obj.m_ctm * glm::vec4(corner, 1.f));
+    min = glm::min(min, p);
+    max = glm::max(max, p);
+  }
+  glm::vec3 extent = max - min;
+  return std::max(extent.x, std::max(extent.y, extent.z));
+}
+
+/**
+ * @brief Gets the objects that are cached
+ * - objects of a cacheable type, unless they are more than
+ *   SDF_CACHE_MAX_SIZE times larger than the median of those. The grid
+ *   covers every cached object, so one large object would make every cell
+ *   and brick coarse
+ * - the shader evaluates the objects that are not cached at every point
+ *   (see uploadBVH in RayMarchRenderer and SceneShader::generateSDScene)
+ * @param objects Objects of the scene
+ * @returns True for the objects that are cached
+ */
+std::vector<bool>
+SDFCache::getCachedObjects(const std::vector<RayMarchObj> &objects) {
+  std::vector<bool> cached(objects.size(), false);
+  std::vector<float> sizes;
+  for (const RayMarchObj &obj : objects) {
+    if (isCacheable(obj.m_type)) {
+      sizes.push_back(getSize(obj));
+    }
+  }
+  if (sizes.empty()) {
+    return cached;
+  }
+  std::nth_element(sizes.begin(), sizes.begin() + sizes.size() / 2,
+                   sizes.end());
+  float maxSize = SDF_CACHE_MAX_SIZE * sizes[sizes.size() / 2];
+  for (int i = 0; i < (int)objects.size(); i++) {
+    cached[i] =
+        isCacheable(objects[i].m_type) && getSize(objects[i]) <= maxSize;
+  }
+  return cached;
+}
+
+/**
+ * @brief Gets the object space bounds of the surface of a cacheable object
+ * - the Mandelbulb escapes beyond max(|c|, 2^(1 / (power - 1))), which has
+ *   no bound below power 2
+ * - the Sierpinski tetrahedron lies in the hull of the fixed points of its
+ *   folds, (2, 2, 2) and its reflections
+ * @param type Type of the object
+ * @param min Set to the min corner
+ * @param max Set to the max corner
+ * @returns False if the surface has no bounds
+ */
+bool SDFCache::getLocalBounds(PrimitiveType type, glm::vec3 &min,
+                              glm::vec3 &max) const {
+  if (type == PrimitiveType::MANDELBULB) {
+    if (m_power < 2.f) {
+      return false;
+    }
+    float radius = std::max(glm::length(m_juliaSeed),
+                            std::pow(2.f, 1.f / (m_power - 1.f)));
+    min = glm::vec3(-radius);
+    max = glm::vec3(radius);
+    return true;
+  }
+  if (type == PrimitiveType::SIERPINSKI) {
+    min = glm::vec3(-2.f);
+    max = glm::vec3(2.f);
+    return true;
+  }
+  return BVH::getLocalBounds(type, min, max);
+}
+
+/**
+ * @brief Distance to an object (see sdMatch in raymarch.frag)
+ * @param obj Cached object
+ * @param p Point in world space
+ */
+float SDFCache::sdObject(const Object &obj, const glm::vec3 &p) const {
+  glm::vec3 po = glm::vec3(obj.invModelMatrix * glm::vec4(p, 1.f));
+  glm::vec4 trap;
+  float d;
+  switch (obj.type) {
+  case PrimitiveType::PRIMITIVE_CUBE:
+    d = CPUSDF::sdBox(po, glm::vec3(0.5f));
+    break;
+  case PrimitiveType::PRIMITIVE_CONE:
+    d = CPUSDF::sdCone(po, 0.5f, 0.5f);
+    break;
+  case PrimitiveType::PRIMITIVE_CYLINDER:
+    d = CPUSDF::sdCylinder(po, 0.5f, 0.5f);
+    break;
+  case PrimitiveType::PRIMITIVE_SPHERE:
+    d = CPUSDF::sdSphere(po, 0.5f);
+    break;
+  case PrimitiveType::PRIMITIVE_OCTAHEDRON:
+    d = CPUSDF::sdOctahedron(po, 0.5f);
+    break;
+  case PrimitiveType::PRIMITIVE_TORUS:
+    d = CPUSDF::sdTorus(po, glm::vec2(0.5f, 0.5f / 4));
+    break;
+  case PrimitiveType::PRIMITIVE_CAPSULE:
+    d = CPUSDF::sdCapsule(po, 0.5f, 0.1f);
+    break;
+  case PrimitiveType::PRIMITIVE_DEATHSTAR:
+    d = CPUSDF::sdDeathStar(po, 0.5f, 0.35f, 0.5f);
+    break;
+  case PrimitiveType::PRIMITIVE_RECTANGLE:
+    d = CPUSDF::sdBox(po, glm::vec3(0.5f, 0.5f, 0.f));
+    break;
+  case PrimitiveType::MANDELBULB:
+    d = CPUSDF::sdMandelBulb(po, m_power, m_juliaSeed, trap);
+    break;
+  case PrimitiveType::SIERPINSKI:
+    d = CPUSDF::sdSierpinski(po);
+    break;
+  default:
+    return FLT_MAX;
+  }
+  return d * obj.scaleFactor;
+}
+
+/**
+ * @brief Distance to the closest of some objects
+ * - an object is skipped once its bounds are farther away than the closest
+ *   object found so far, as in the BVH walk of sdScene in raymarch.frag.
+ *   Bounds around p are never skipped, inside overlapping objects the
+ *   deepest one is the closest
+ * @param p Point in world space
+ * @param candidates Indices of the objects
+ * @param maxD Distance returned if no object is closer
+ */
+float SDFCache::sdScene(const glm::vec3 &p, const std::vector<int> &candidates,
+                        float maxD) const {
+  float d = maxD;
+  for (int i : candidates) {
+    const Object &obj = m_objects[i];
+    float boxD = boxDistance(p, p, obj.min, obj.max);
+    if (boxD > 0.f && boxD >= d) {
+      continue;
+    }
+    d = std::min(d, sdObject(obj, p));
+  }
+  return d;
+}
+
+/**
+ * @brief Bakes the cached objects into the grid and the bricks
+ * - the grid covers the bounds of the objects with a margin of a cell. The
+ *   distance at the center of a cell minus half of its diagonal bounds the
+ *   distance inside it
+ * - a cell gets a brick if a surface may be within a cell of it and it is
+ *   not entirely inside an object
+ * @param objects Objects of the scene
+ * @param power Power of the Mandelbulb
+ * @param juliaSeed Julia seed of the Mandelbulb (0 if unused)
+ * @returns False if no object is cached, or one of them has no bounds
+ */
+bool SDFCache::bake(const std::vector<RayMarchObj> &objects, float power,
+                    const glm::vec2 &juliaSeed) {
+  m_power = power;
+  m_juliaSeed = juliaSeed;
+  m_objects.clear();
+  m_grid.clear();
+  m_atlas.clear();
+  m_gridDims = m_atlasDims = glm::ivec3(0);
+  m_numBricks = 0;
+
+  // Objects and their bounds
+  glm::vec3 sceneMin(FLT_MAX), sceneMax(-FLT_MAX);
+  std::vector<bool> cached = getCachedObjects(objects);
+  for (int i = 0; i < (int)objects.size(); i++) {
+    if (!cached[i]) {
+      continue;
+    }
+    const RayMarchObj &obj = objects[i];
+    glm::vec3 lmin, lmax;
+    if (!getLocalBounds(obj.m_type, lmin, lmax)) {
+      m_objects.clear();
+      return false;
+    }
+    // - same scale factor as RayMarchScene::packObjects
+    float scaleF = std::min(obj.m_scale[0][0],
+                            std::min(obj.m_scale[1][1], obj.m_scale[2][2]));
+    Object o{obj.m_type, obj.m_ctmInv, scaleF, glm::vec3(FLT_MAX),
+             glm::vec3(-FLT_MAX)};
+    for (int i = 0; i < 8; i++) {
+      glm::vec3 corner((i & 1) ? lmax.x : lmin.x, (i & 2) ? lmax.y : lmin.y,
+                       (i & 4) ? lmax.z : lmin.z);
+      glm::vec3 p = glm::vec3(obj.m_ctm * glm::vec4(corner, 1.f));
+      o.min = glm::min(o.min, p);
+      o.max = glm::max(o.max, p);
+    }
+    sceneMin = glm::min(sceneMin, o.min);
+    sceneMax = glm::max(sceneMax, o.max);
+    m_objects.push_back(o);
+  }
+  if (m_objects.empty()) {
+    return false;
+  }
+  std::vector<int> all(m_objects.size());
+  std::iota(all.begin(), all.end(), 0);
+
+  // Grid
+  glm::vec3 extent = sceneMax - sceneMin;
+  m_cellSize = std::max(extent.x, std::max(extent.y, extent.z)) /
+               SDF_CACHE_GRID;
+  if (m_cellSize <= 0.f) {
+    m_objects.clear();
+    return false;
+  }
+  m_gridDims = glm::min(glm::ivec3(glm::ceil(extent / m_cellSize)),
+                        glm::ivec3(SDF_CACHE_GRID)) +
+               2;
+  m_min = sceneMin - m_cellSize;
+  int numCells = m_gridDims.x * m_gridDims.y * m_gridDims.z;
+  auto getCell = [&](int i) {
+    return glm::ivec3(i % m_gridDims.x, (i / m_gridDims.x) % m_gridDims.y,
+                      i / (m_gridDims.x * m_gridDims.y));
+  };
+  std::vector<float> centers(numCells);
+  m_pool.parallelFor(numCells, [&](int i) {
+    glm::vec3 center = m_min + (glm::vec3(getCell(i)) + 0.5f) * m_cellSize;
+    centers[i] = sdScene(center, all, FLT_MAX);
+  });
+
+  // Cells that get a brick
+  float halfDiagonal = 0.5f * std::sqrt(3.f) * m_cellSize;
+  m_grid.assign(numCells, glm::vec4(-1.f, -1.f, -1.f, 0.f));
+  std::vector<int> brickCells;
+  for (int i = 0; i < numCells; i++) {
+    m_grid[i].w = centers[i] - halfDiagonal;
+    if (m_grid[i].w <= m_cellSize && centers[i] > -halfDiagonal) {
+      brickCells.push_back(i);
+    }
+  }
+
+  // Atlas
+  // - about as many bricks along each side, never empty
+  m_numBricks = brickCells.size();
+  int side = std::max(1, (int)std::ceil(std::cbrt((float)m_numBricks)));
+  glm::ivec3 bricks(side, side,
+                    std::max(1, (m_numBricks + side * side - 1) /
+                                    (side * side)));
+  m_atlasDims = bricks * SDF_CACHE_BRICK;
+  m_atlas.assign(m_atlasDims.x * m_atlasDims.y * m_atlasDims.z, 0.f);
+  float voxel = getVoxelSize();
+  m_pool.parallelFor(m_numBricks, [&](int b) {
+    int cell = brickCells[b];
+    glm::vec3 cellMin = m_min + glm::vec3(getCell(cell)) * m_cellSize;
+    glm::vec3 cellMax = cellMin + m_cellSize;
+    // - the samples are at most half a diagonal from the center, so objects
+    //   farther away than that are never the closest
+    float maxD = centers[cell] + halfDiagonal;
+    std::vector<int> candidates;
+    for (int i = 0; i < (int)m_objects.size(); i++) {
+      if (boxDistance(cellMin, cellMax, m_objects[i].min, m_objects[i].max) <
+          maxD) {
+        candidates.push_back(i);
+      }
+    }
+    glm::ivec3 origin =
+        glm::ivec3(b % bricks.x, (b / bricks.x) % bricks.y,
+                   b / (bricks.x * bricks.y)) *
+        SDF_CACHE_BRICK;
+    for (int z = 0; z < SDF_CACHE_BRICK; z++) {
+      for (int y = 0; y < SDF_CACHE_BRICK; y++) {
+        for (int x = 0; x < SDF_CACHE_BRICK; x++) {
+          glm::vec3 p = cellMin + glm::vec3(x, y, z) * voxel;
+          glm::ivec3 t = origin + glm::ivec3(x, y, z);
+          m_atlas[(t.z * m_atlasDims.y + t.y) * m_atlasDims.x + t.x] =
+              sdScene(p, candidates, maxD);
+        }
+      }
+    }
+    m_grid[cell] = glm::vec4(glm::vec3(origin), m_grid[cell].w);
+  });
+  return true;
+}
+
+/**
+ * @brief Gets the coarse grid, one texel per cell
+ */
+const std::vector<glm::vec4> &SDFCache::getGrid() const { return m_grid; }
+
+/**
+ * @brief Gets the number of cells along each axis
+ */
+glm::ivec3 SDFCache::getGridDims() const { return m_gridDims; }
+
+/**
+ * @brief Gets the distance samples of the bricks
+ */
+const std::vector<float> &SDFCache::getAtlas() const { return m_atlas; }
+
+/**
+ * @brief Gets the number of samples of the atlas along each axis
+ */
+glm::ivec3 SDFCache::getAtlasDims() const { return m_atlasDims; }
+
+/**
+ * @brief Gets the min corner of the grid
+ */
+glm::vec3 SDFCache::getMin() const { return m_min; }
+
+/**
+ * @brief Gets the size of a cell
+ */
+float SDFCache::getCellSize() const { return m_cellSize; }
+
+/**
+ * @brief Gets the size of a voxel of a brick
+ */
+float SDFCache::getVoxelSize() const {
+  return m_cellSize / (SDF_CACHE_BRICK - 1);
+}
+
+/**
+ * @brief Gets the max amount by which the interpolated distance exceeds the
+ * distance
+ * - every sample is at most the distance plus its distance to the point, so
+ *   the interpolation is at most a voxel diagonal above it. 1% more covers
+ *   the rounding of the half float samples
+ */
+float SDFCache::getError() const {
+  return std::sqrt(3.f) * getVoxelSize() * 1.01f;
+}
+
+/**
+ * @brief Gets the number of bricks of the last bake
+ */
+int SDFCache::getNumBricks() const { return m_numBricks; }
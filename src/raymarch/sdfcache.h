@@ -0,0 +1,103 @@
+#ifndef SDFCACHE_H
+#define SDFCACHE_H
+
+#include "cpu/threadpool.h"
+#include "raymarch/raymarchobj.h"
+#include <glm/glm.hpp>
+#include <vector>
+
+// Samples per side of a brick
+// - neighbouring bricks share their border samples, so a brick spans
+//   SDF_CACHE_BRICK - 1 voxels
+#define SDF_CACHE_BRICK 8
+// Cells along the longest side of the cached objects
+#define SDF_CACHE_GRID 32
+// Voxels from the cached surfaces within which the shader evaluates the
+// objects instead of the cache
+#define SDF_CACHE_REFINE 2.f
+// Max size of a cached object, relative to the median size of the objects
+// that can be cached
+#define SDF_CACHE_MAX_SIZE 8.f
+
+class SDFCache {
+  // Sparse brick map of the distance to the static objects of a scene.
+  // A coarse grid covers the objects. Cells far from a surface only keep a
+  // lower bound of the distance inside them, cells near one point to a brick
+  // of distance samples in a 3D atlas. The shader steps by the cached
+  // distance away from the surfaces and evaluates the objects near them.
+  // - primitives, the Mandelbulb and the Sierpinski tetrahedron are cached.
+  //   The animated SDFs (Mandelbrot, Menger sponge, sdCUSTOM) are not
+  // - objects much larger than the others (e.g. a ground plane) are not
+  //   cached, they would stretch the grid and coarsen every brick
+  // - the samples are evaluated on the CPU (see CPUSDF) by a thread pool.
+  //   bake may run on another thread, the getters are only valid after it
+  // - the bounds assume that a distance grows at most as fast as the point
+  //   moves. Stretched primitives and the Mandelbulb grow slower, so their
+  //   bound may exceed their estimate but not the distance to the surface
+
+public:
+  // Gets the objects that are cached, by index
+  static std::vector<bool>
+  getCachedObjects(const std::vector<RayMarchObj> &objects);
+
+  // Bakes the cached objects
+  // - returns false if there is nothing to cache
+  bool bake(const std::vector<RayMarchObj> &objects, float power,
+            const glm::vec2 &juliaSeed);
+
+  // Coarse grid, one texel per cell
+  // - (atlas position of the brick, lower bound of the distance in the
+  //   cell). The position is -1 if the cell has no brick
+  const std::vector<glm::vec4> &getGrid() const;
+  glm::ivec3 getGridDims() const;
+  // Distance samples of the bricks
+  const std::vector<float> &getAtlas() const;
+  glm::ivec3 getAtlasDims() const;
+
+  // Min corner of the grid
+  glm::vec3 getMin() const;
+  // Size of a cell
+  float getCellSize() const;
+  // Size of a voxel of a brick
+  float getVoxelSize() const;
+  // Max amount by which the interpolated distance exceeds the distance
+  float getError() const;
+  int getNumBricks() const;
+
+private:
+  // Object that is cached
+  struct Object {
+    PrimitiveType type;
+    glm::mat4 invModelMatrix;
+    float scaleFactor;
+    // World space bounds of the surface
+    glm::vec3 min;
+    glm::vec3 max;
+  };
+
+  // Checks if objects of a type can be cached
+  static bool isCacheable(PrimitiveType type);
+  // Gets the object space bounds of the surface of a cacheable object
+  bool getLocalBounds(PrimitiveType type, glm::vec3 &min,
+                      glm::vec3 &max) const;
+  // Distance to the closest object that may be closer than maxD
+  float sdScene(const glm::vec3 &p, const std::vector<int> &candidates,
+                float maxD) const;
+  // Distance to an object
+  float sdObject(const Object &obj, const glm::vec3 &p) const;
+
+  ThreadPool m_pool;
+  std::vector<Object> m_objects;
+  float m_power = 8.f;
+  glm::vec2 m_juliaSeed = glm::vec2(0.f);
+
+  std::vector<glm::vec4> m_grid;
+  glm::ivec3 m_gridDims = glm::ivec3(0);
+  std::vector<float> m_atlas;
+  glm::ivec3 m_atlasDims = glm::ivec3(0);
+  glm::vec3 m_min = glm::vec3(0.f);
+  float m_cellSize = 1.f;
+  int m_numBricks = 0;
+};
+
+#endif // SDFCACHE_H
@@ -1,7 +1,7 @@
 #include "realtime.h"
 #include "settings.h"
-#include "utils/shaderloader.h"
 #include <QCoreApplication>
+#include <QFontDatabase>
 #include <QKeyEvent>
 #include <QMouseEvent>
 #include <iostream>
@@ -17,6 +17,16 @@ Realtime::Realtime(QWidget *parent) : QOpenGLWidget(parent) {
   m_keyMap[Qt::Key_D] = false;
   m_keyMap[Qt::Key_Control] = false;
   m_keyMap[Qt::Key_Space] = false;
+
+  // Frame timing overlay
+  // - a child widget so that it never touches the GL state of the renderer
+  m_timingOverlay = new QLabel(this);
+  m_timingOverlay->setFont(QFontDatabase::systemFont(QFontDatabase::FixedFont));
+  m_timingOverlay->setStyleSheet("QLabel { color: white; padding: 4px; "
+                                 "background-color: rgba(0, 0, 0, 160); }");
+  m_timingOverlay->setAttribute(Qt::WA_TransparentForMouseEvents);
+  m_timingOverlay->move(8, 8);
+  m_timingOverlay->hide();
 }
 
 /**
@@ -25,40 +35,7 @@ Realtime::Realtime(QWidget *parent) : QOpenGLWidget(parent) {
 void Realtime::finish() {
   killTimer(m_timer);
   this->makeCurrent();
-
-  // Destroy Shapes Textuers
-  destroyShapesTextures();
-
-  // Destroy Image Plane
-  glDeleteVertexArrays(1, &m_imagePlaneVAO);
-  glDeleteBuffers(1, &m_imagePlaneVBO);
-
-  // Destroy Full Screen Quad
-  glDeleteVertexArrays(1, &m_fullscreenVAO);
-  glDeleteBuffers(1, &m_fullscreenVBO);
-
-  // Destroy Area Light Textures
-  glDeleteTextures(1, &m_mTexture);
-  glDeleteTextures(1, &m_ltuTexture);
-
-  // Destroy Defaults
-  glDeleteTextures(1, &m_defaultShapeTexture);
-  glDeleteTextures(1, &m_cubeMapTexture);
-  glDeleteTextures(1, &m_nullCubeMapTexture);
-  glDeleteTextures(1, &m_nullBloomBlurTexture);
-  glDeleteTextures(1, &m_noiseTexture);
-  glDeleteTextures(1, &m_blueNoiseTexture);
-
-  // Destroy FBO
-  destroyCustomFBO();
-
-  // Destroy Shaders
-  glDeleteProgram(m_rayMarchShader);
-  glDeleteProgram(m_fxaaShader);
-  glDeleteProgram(m_lightOptionShader);
-  glDeleteProgram(m_debugShader);
-  glDeleteProgram(m_blurShader);
-
+  m_renderer.finish();
   this->doneCurrent();
 }
 
@@ -72,104 +49,189 @@ void Realtime::initializeGL() {
   m_timer = startTimer(1000 / 30);
   m_elapsedTimer.start();
 
-  glewExperimental = GL_TRUE;
-  GLenum err = glewInit();
-  if (err != GLEW_OK) {
-    std::cerr << "Error while initializing GL: " << glewGetErrorString(err)
-              << std::endl;
-  }
-  std::cout << "Initialized GL: Version " << glewGetString(GLEW_VERSION)
-            << std::endl;
-
-  glEnable(GL_DEPTH_TEST);
-  glEnable(GL_CULL_FACE);
-  // Set dimensions
-  scene.m_width = size().width() * m_devicePixelRatio;
-  scene.m_height = size().height() * m_devicePixelRatio;
-  glViewport(0, 0, scene.m_width, scene.m_height);
-
-  // =========== SETUP =============
-
-  // Load the shaders
-  m_rayMarchShader = ShaderLoader::createShaderProgram(
-      ":/resources/raymarch.vert", ":/resources/raymarch.frag");
-  m_fxaaShader = ShaderLoader::createShaderProgram(
-      ":/resources/fullscreen.vert", ":/resources/fxaa.frag");
-  m_lightOptionShader = ShaderLoader::createShaderProgram(
-      ":/resources/fullscreen.vert", ":/resources/hdr.frag");
-  m_debugShader = ShaderLoader::createShaderProgram(
-      ":/resources/fullscreen.vert", ":/resources/color.frag");
-  m_blurShader = ShaderLoader::createShaderProgram(
-      ":/resources/fullscreen.vert", ":/resources/blur.frag");
-
-  // Initialize the image plane through which we march rays
-  initImagePlane();
-  // Initialize the full screen quad
-  initFullScreenQuad();
-  // Initialize any defaults
-  initDefaults();
-  // Initialize the custom FBO
-  initCustomFBO();
-  // Area Light Textures
-  loadMTexture();
-  loadLTUTexture();
-  // Initialize Custom Textures
-  initCustomTextures();
-  // Initialize the shader
-  initShader();
+  m_renderer.initialize(size().width() * m_devicePixelRatio,
+                        size().height() * m_devicePixelRatio);
 }
 
 /**
  * @brief Draws the scene
  */
 void Realtime::paintGL() {
-  if (!scene.isInitialized()) {
+  // Render into the FBO backing this widget
+  m_renderer.setOutputFBO(defaultFramebufferObject());
+  m_renderer.setTime(m_delta);
+  m_renderer.render();
+  m_dirty = false;
+}
+
+/**
+ * @brief Shows the rolling GPU time of every pass and the time saved by the
+ * ticks that did not render, and the march cost of the heatmap
+ * - the text is refreshed every 10 ticks to keep it readable
+ */
+void Realtime::updateTimingOverlay() {
+  if (!settings.showFrameTimings && settings.costHeatmap == 0) {
+    m_timingOverlay->hide();
+    m_ticks = m_skippedTicks = 0;
+    m_tickTime = 0.f;
     return;
   }
-  // Perform Raymarch and render the scene
-  rayMarch();
+  if (m_timingOverlay->isVisible() && m_ticks < 10) {
+    return;
+  }
+
+  QString text;
+  if (settings.showFrameTimings) {
+    PassTimer &timer = m_renderer.getPassTimer();
+    text = QString("%1 %2 %3 %4 %5")
+               .arg(QStringLiteral("pass"), -14)
+               .arg(QStringLiteral("avg"), 7)
+               .arg(QStringLiteral("p50"), 7)
+               .arg(QStringLiteral("p95"), 7)
+               .arg(QStringLiteral("p99"), 7);
+    double total = 0.;
+    for (int i = 0; i < NUM_RENDER_PASSES; i++) {
+      RenderPass pass = static_cast<RenderPass>(i);
+      PassStats stats = timer.getStats(pass);
+      if (stats.samples == 0) {
+        continue;
+      }
+      total += stats.avg;
+      text += QString("\n%1 %2 %3 %4 %5")
+                  .arg(QString::fromLatin1(PassTimer::getName(pass)), -14)
+                  .arg(stats.avg, 7, 'f', 2)
+                  .arg(stats.p50, 7, 'f', 2)
+                  .arg(stats.p95, 7, 'f', 2)
+                  .arg(stats.p99, 7, 'f', 2);
+    }
+    text += QString("\n%1 %2 ms")
+                .arg(QStringLiteral("total (avg)"), -14)
+                .arg(total, 7, 'f', 2);
+    appendLightingSavings(text);
+    // - a skipped tick saves a whole frame
+    double saved =
+        m_tickTime > 0.f ? m_skippedTicks * total / m_tickTime : 0.;
+    text += QString("\n%1 %2 / %3 ticks")
+                .arg(QStringLiteral("skipped"), -14)
+                .arg(m_skippedTicks, 7)
+                .arg(m_ticks);
+    text += QString("\n%1 %2 ms/s")
+                .arg(QStringLiteral("saved"), -14)
+                .arg(saved, 7, 'f', 2);
+    if (settings.enableDynamicResolution) {
+      text += QString("\n%1 %2")
+                  .arg(QStringLiteral("render scale"), -14)
+                  .arg(m_renderer.getRenderScale(), 7, 'f', 3);
+    }
+    if (settings.enableAccumulation) {
+      text += QString("\n%1 %2 / %3")
+                  .arg(QStringLiteral("samples"), -14)
+                  .arg(m_renderer.getSampleCount(), 7)
+                  .arg(settings.sampleBudget);
+    }
+  }
+  if (settings.costHeatmap > 0) {
+    appendCostStats(text);
+  }
+  m_ticks = m_skippedTicks = 0;
+  m_tickTime = 0.f;
+  m_timingOverlay->setText(text);
+  m_timingOverlay->adjustSize();
+  m_timingOverlay->show();
 }
 
 /**
- * @brief Invoked when scene is resized
+ * @brief Appends the march cost of the latest frame that was read back
+ * - mean and max per pixel, and the total of the frame
+ * @param text Text of the overlay
  */
-void Realtime::resizeGL(int w, int h) {
-  glViewport(0, 0, size().width() * m_devicePixelRatio,
-             size().height() * m_devicePixelRatio);
-  scene.m_width = size().width() * m_devicePixelRatio;
-  scene.m_height = size().height() * m_devicePixelRatio;
-  if (!scene.isInitialized()) {
+void Realtime::appendCostStats(QString &text) {
+  const CostStats &stats = m_renderer.getCostReadback().getStats();
+  if (!text.isEmpty()) {
+    text += "\n";
+  }
+  text += QString("%1 %2 %3 %4")
+              .arg(QStringLiteral("cost"), -14)
+              .arg(QStringLiteral("mean"), 8)
+              .arg(QStringLiteral("max"), 8)
+              .arg(QStringLiteral("total"), 12);
+  for (int i = 0; i < NUM_COST_CHANNELS; i++) {
+    CostChannel channel = static_cast<CostChannel>(i);
+    text += QString("\n%1 %2 %3 %4")
+                .arg(QString::fromLatin1(CostReadback::getName(channel)), -14)
+                .arg(stats.getMean(channel), 8, 'f', 2)
+                .arg(stats.getMax(channel), 8, 'f', 0)
+                .arg(stats.total[i], 12, 'f', 0);
+  }
+}
+
+/**
+ * @brief Appends the time that the shadow and AO passes save below full
+ * resolution
+ * - compared to their average at full resolution, which is kept whenever
+ *   they run at it ("-" until they did)
+ * @param text Text of the overlay
+ */
+void Realtime::appendLightingSavings(QString &text) {
+  PassTimer &timer = m_renderer.getPassTimer();
+  PassStats shadows = timer.getStats(RenderPass::PASS_SHADOWS);
+  PassStats ao = timer.getStats(RenderPass::PASS_AO);
+  if (settings.lightingScale == 1) {
+    if (shadows.samples > 0) {
+      m_fullResShadows = shadows.avg;
+    }
+    if (ao.samples > 0) {
+      m_fullResAO = ao.avg;
+    }
     return;
   }
-  // Resize the scene and update the camera
-  scene.resizeScene(scene.m_width, scene.m_height);
-  // Destroy and re-Init FBO
-  destroyCustomFBO();
-  initCustomFBO();
+  auto append = [&text](const char *name, const PassStats &stats,
+                        double fullRes) {
+    if (stats.samples == 0) {
+      return;
+    }
+    QString saved = fullRes > 0. ? QString::number(fullRes - stats.avg, 'f', 2)
+                                 : QStringLiteral("-");
+    text += QString("\n%1 %2 ms (1/%3 res)")
+                .arg(QString("%1 saved").arg(name), -14)
+                .arg(saved, 7)
+                .arg(settings.lightingScale);
+  };
+  append(PassTimer::getName(RenderPass::PASS_SHADOWS), shadows,
+         m_fullResShadows);
+  append(PassTimer::getName(RenderPass::PASS_AO), ao, m_fullResAO);
+}
+
+/**
+ * @brief Writes the GPU time of every pass to a CSV file
+ * @param filePath Path of the CSV file
+ * @returns True on success
+ */
+bool Realtime::saveFrameTimings(std::string filePath) {
+  return m_renderer.getPassTimer().writeCSV(filePath);
+}
+
+/**
+ * @brief Invoked when scene is resized
+ */
+void Realtime::resizeGL(int w, int h) {
+  m_renderer.resize(size().width() * m_devicePixelRatio,
+                    size().height() * m_devicePixelRatio);
+  // - the full resolution times were for the old size
+  m_fullResShadows = m_fullResAO = 0.;
+  m_dirty = true;
 }
 
 /**
  * @brief Invoked when a new scene file is uploaded
  */
 void Realtime::sceneChanged() {
-  if (scene.isInitialized()) {
-    // Destroy previous shapes textures
-    destroyShapesTextures();
-    m_isAreaLightUsed = false;
-  }
-  if (settings.reset) {
-    scene.resetScene();
-    settings.reset = false;
-    return;
-  }
-  // Initialize the Raymarch scene
-  scene.initScene(settings, m_isAreaLightUsed);
-  // Initialize the textures
-  initShapesTextures();
-  // Clear the seed
-  m_juliaSeed = glm::vec2(0.f);
-  // Update the dim
-  m_twoDSpace = settings.twoDSpace;
+  makeCurrent();
+  m_renderer.sceneChanged();
+  // Timings of the previous configuration no longer apply
+  m_renderer.getPassTimer().reset();
+  m_fullResShadows = m_fullResAO = 0.;
+  m_dirty = true;
   update();
 }
 
@@ -177,13 +239,11 @@ void Realtime::sceneChanged() {
  * @brief Invoked whenever any of the ui settings have been modified
  */
 void Realtime::settingsChanged() {
-  if (!scene.isInitialized()) {
-    return;
-  }
-  // Update the camera
-  scene.updateScene(settings);
-  // Update the options
-  updateUISettings();
+  makeCurrent();
+  m_renderer.settingsChanged();
+  // Timings of the previous configuration no longer apply
+  m_renderer.getPassTimer().reset();
+  m_dirty = true;
   update();
 }
 
@@ -216,7 +276,7 @@ void Realtime::mouseMoveEvent(QMouseEvent *event) {
     int deltaY = posY - m_prev_mouse_pos.y;
     m_prev_mouse_pos = glm::vec2(posX, posY);
 
-    if (!scene.isInitialized()) {
+    if (!m_renderer.getScene().isInitialized()) {
       return;
     }
 
@@ -224,10 +284,11 @@ void Realtime::mouseMoveEvent(QMouseEvent *event) {
       return;
     }
 
-    Camera &cam = scene.getCamera();
+    Camera &cam = m_renderer.getScene().getCamera();
     cam.rotateX(deltaX);
     cam.rotateY(deltaY);
 
+    m_dirty = true;
     update();
   }
 }
@@ -238,6 +299,7 @@ void Realtime::timerEvent(QTimerEvent *event) {
   m_delta += deltaTime;
   m_elapsedTimer.restart();
 
+  RayMarchScene &scene = m_renderer.getScene();
   if (!scene.isInitialized()) {
     return;
   }
@@ -275,9 +337,24 @@ void Realtime::timerEvent(QTimerEvent *event) {
   if (glm::length(disp) != 0.f) {
     disp *= s;
     cam.applyTranslation(disp);
+    m_dirty = true;
   }
 
-  update();
+  // Only render if the frame would change
+  m_ticks++;
+  m_tickTime += deltaTime;
+  if (m_dirty || m_renderer.needsRedraw()) {
+    update();
+  } else {
+    m_skippedTicks++;
+    // - no frame follows the last one to reduce its cost
+    if (settings.costHeatmap > 0) {
+      makeCurrent();
+      m_renderer.getCostReadback().flush();
+      doneCurrent();
+    }
+  }
+  updateTimingOverlay();
 }
 
 // DO NOT EDIT
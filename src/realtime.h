@@ -1,31 +1,13 @@
 #pragma once
 
-// Defined before including GLEW to suppress deprecation messages on macOS
-#ifdef __APPLE__
-#define GL_SILENCE_DEPRECATION
-#endif
-#include <GL/glew.h>
-#include <glm/glm.hpp>
-
-#include "raymarch/raymarchscene.h"
+#include "raymarch/raymarchrenderer.h"
 #include <QElapsedTimer>
+#include <QLabel>
 #include <QOpenGLWidget>
 #include <QTime>
 #include <QTimer>
 #include <unordered_map>
 
-#define MAX_NUM_LIGHTS 10
-#define MAX_NUM_TEXTURES 10
-#define MAX_NUM_CUSTOM_TEXTURES 3
-#define MAX_NUM_SHAPES 30
-#define SKYBOX_TEX_UNIT_OFF 10
-#define LTC1_TEX_UNIT_OFF 11
-#define LTC2_TEX_UNIT_OFF 12
-#define NOISE_TEX_UNIT_OFF 13
-#define BLUE_NOISE_TEX_UNIT_OFF 14
-#define CUSTOM_TEX_UNIT_OFF 15
-#define BLOOM_BLUR_COUNT 10
-
 class Realtime : public QOpenGLWidget {
 public:
   Realtime(QWidget *parent = nullptr);
@@ -33,6 +15,7 @@ public:
   void sceneChanged();
   void settingsChanged();
   void saveViewportImage(std::string filePath);
+  bool saveFrameTimings(std::string filePath);
 
 public slots:
   void tick(QTimerEvent *event); // Called once per tick of m_timer
@@ -69,179 +52,34 @@ private:
 
   // ============ RAY MARCHER ==============
 
-  // PRIVATE DATA
-
-  // RayMarch scene
-  RayMarchScene scene;
-
-  // Shader
-  // - raymarch shader
-  GLuint m_rayMarchShader;
-  // - fxaa shader
-  GLuint m_fxaaShader;
-  // - hdr shader
-  GLuint m_lightOptionShader;
-  // - debug shader
-  GLuint m_debugShader;
-  // - Bloom (blur shader)
-  GLuint m_blurShader;
-
-  // Textures
-  // - default material texture
-  GLuint m_defaultShapeTexture;
-  // - map from file name to texture object
-  std::unordered_map<std::string, GLuint> m_TextureMap;
-  // - hdr texture
-  GLuint m_hdrTexture;
-  // - Bloom
-  GLuint m_bloomBrightnessTexture;
-  GLuint m_nullBloomBlurTexture;
-  // - cube map texture
-  GLuint m_cubeMapTexture;
-  // - null cube map texture
-  GLuint m_nullCubeMapTexture;
-  // - noise texture
-  GLuint m_noiseTexture;
-  // - blue noise texture
-  GLuint m_blueNoiseTexture;
-  // - custom textures
-  GLuint m_customTextures[3];
-
-  // FBO
-  // - application window FBO
-  GLuint m_defaultFBO = 4;
-  // - custom FBO
-  GLuint m_customFBO;
-  GLuint m_customFBOColorTexture;
-  GLuint m_customFBORenderBuffer;
-  // - Bloom
-  GLuint m_pingpongFBO[2];
-  GLuint m_pingpongBuffer[2];
-
-  // Image Plane through which we march rays
-  GLuint m_imagePlaneVAO;
-  GLuint m_imagePlaneVBO;
-
-  // Full Screen Quad for post processing
-  GLuint m_fullscreenVAO;
-  GLuint m_fullscreenVBO;
-
-  // Area Light
-  // source: https://learnopengl.com/Guest-Articles/2022/Area-Lights
-  bool m_isAreaLightUsed = false;
-  GLuint m_mTexture;
-  GLuint m_ltuTexture;
-  void loadMTexture();
-  void loadLTUTexture();
-  const std::vector<glm::vec3> corners = {
-      glm::vec3(-0.5f, 0.5f, 0.f),  // tl
-      glm::vec3(0.5f, 0.5f, 0.f),   // tr
-      glm::vec3(0.5f, -0.5f, 0.f),  // br
-      glm::vec3(-0.5f, -0.5f, 0.f), // bl
-  };
-
-  // Toggelable Options
-
-  // Others
-  bool m_twoDSpace = false;
-
-  // Render Effects
-  // - soft shadow
-  bool m_enableSoftShadow;
-  // - reflection
-  bool m_enableReflection;
-  // - refraction
-  bool m_enableRefraction;
-  // - ambient occulusion
-  bool m_enableAmbientOcclusion;
-  // - sky box
-  int m_idxSkyBox;
-  // Post Processing Effects
-  // - FXAA
-  bool m_enableFXAA;
-
-  // Lighting Effects
-  // - exposure
-  float m_exposure;
-  // - HDR
-  bool m_enableHDR;
-  // - Bloom
-  bool m_enableBloom;
-  // - gamma correction
-  bool m_enableGammaCorrection;
-
-  // Fractals
-  // - power of fractals
-  float m_power = 8.f;
-  // - julia seed (real and imaginary components)
-  glm::vec2 m_juliaSeed = glm::vec2(0.f);
-
-  // Procedural
-  float m_terrainH = 10.;
-  float m_terrainS = 2.75;
-  int m_numOctaves = 8.;
-
-  // PRIVATE METHODS
-
-  // Performs raymarching using our raymarch shader
-  void rayMarch();
-  // Applies FXAA post processing
-  void applyFXAA();
-  // Applies HDR post processing
-  void applyLightEffects();
-  // Applies Bloom Post processing
-  bool applyBloom();
-  // Draws to the fullsreen quad with given tex
-  void drawToQuadWithTex(GLuint tex);
-
-  // Initializes the shaders with constant uniforms
-  void initShader();
-  // Initializes all the default variables used in shader
-  void initDefaults();
-  // Initializes [-1,1] blank canvas to be used for raymarching
-  void initImagePlane();
-  // Initializes full screen quad
-  void initFullScreenQuad();
-  // Initializes each and every material texture used in the scene
-  void initShapesTextures();
-  // Initializes textures for custom scene
-  void initCustomTextures();
-  // Initializes our custom FBO for offline rendering
-  void initCustomFBO();
-  // Initializes our cube map
-  void initCubeMap(CUBEMAP type);
-
-  // Sets the output FBO
-  void setFBO(GLuint fbo);
-
-  // Update settings
-  void updateUISettings();
-
-  // Sets the uniforms for our screen-related stuff
-  void configureScreenUniforms(GLuint shader);
-  // Sets the uniforms for camera-related stuff
-  void configureCameraUniforms(GLuint shader);
-  // Sets the uniforms for each shape in the scene
-  void configureShapesUniforms(GLuint shader);
-  // Sets the uniforms for each light in the scene
-  void configureLightsUniforms(GLuint shader);
-  // Sets the uniforms for all the rendering options
-  void configureSettingsUniforms(GLuint shader);
-  // Sets the uniforms for FXAA
-  void configureFXAAUniforms(GLuint shader);
-  // Sets the uniforms for applying light efects
-  void configureLightEffectsUniforms(GLuint shader, bool side);
-
-  // Destroies shapes textures
-  void destroyShapesTextures();
-  // Destroy custom FBO
-  void destroyCustomFBO();
-
-  // Utility
-  void setIntUniform(GLuint shader, const char *, int val);
-  void setFloatUniform(GLuint shader, const char *, float val);
-  void setMat4Uniform(GLuint shader, const char *, const glm::mat4 &);
-  void setVec2Uniform(GLuint shader, const char *, const glm::vec2 &);
-  void setVec3Uniform(GLuint shader, const char *, const glm::vec3 &);
-  void setVec4Uniform(GLuint shader, const char *, const glm::vec4 &);
+  // Renderer that owns the raymarch pipeline
+  RayMarchRenderer m_renderer;
+
+  // ============ FRAME TIMINGS ============
+
+  // Updates the overlay with the GPU time of the passes
+  void updateTimingOverlay();
+  // Appends the march cost of the heatmap to the overlay text
+  void appendCostStats(QString &text);
+  // Appends the time saved by the shadows and AO below full resolution
+  void appendLightingSavings(QString &text);
+  // Overlay on top of the viewport (settings.showFrameTimings or
+  // settings.costHeatmap)
+  QLabel *m_timingOverlay;
+  // Average time of the shadow and AO passes the last time they ran at full
+  // resolution in this scene and size (0 if they did not)
+  double m_fullResShadows = 0.;
+  double m_fullResAO = 0.;
+
+  // ============ RENDER ON DEMAND =========
+
+  // True if the scene, the camera or the settings changed since the last
+  // frame. A tick only renders if this is set or the renderer needs a redraw
+  bool m_dirty = true;
+  // Ticks since the overlay text was last updated
+  int m_ticks = 0;
+  // - ticks that did not render
+  int m_skippedTicks = 0;
+  // - seconds covered by the ticks
+  float m_tickTime = 0.f;
 };
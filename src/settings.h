@@ -33,12 +33,21 @@ struct Settings {
   bool enableReflection;
   bool enableRefraction;
   bool enableAmbientOcculusion;
+  // - Perlin bump mapping, if the scene uses it
+  bool enableBumpMap = true;
+  // - accumulate jittered samples once the view stops changing
+  bool enableAccumulation = true;
+  // - samples accumulated before the renderer goes idle
+  int sampleBudget = 64;
   // Post Processing Options
   bool enableFXAA;
   bool enableGammaCorrection;
   bool enableHDR;
   bool enableBloom;
   double exposure;
+  // - heatmap of the march cost instead of the image (0 if off, else the
+  //   CostChannel + 1)
+  int costHeatmap = 0;
   // Sky Box
   int idxSkyBox;
   // Fractals
@@ -49,6 +58,24 @@ struct Settings {
   int numOctaves = 8;
   float terrainH = 10.;
   float terrainS = 2.75;
+  // Performance
+  bool showFrameTimings = false;
+  // - scale the render resolution to hold the target GPU time per frame (ms)
+  bool enableDynamicResolution = false;
+  float targetFrameTime = 16.6f;
+  // - cone marched depth prepass that skips the empty space of primary rays
+  bool enableDepthPrepass = true;
+  // - start primary rays from the hit depth of the last frame
+  bool enableReprojection = true;
+  // - over-relaxed sphere tracing with the factor of the scene
+  bool enableRelaxation = true;
+  // - step by the baked distance to the static objects away from them
+  bool enableSDFCache = true;
+  // - deferred shading (G-buffer, shadow, AO and lighting passes)
+  bool enableDeferred = false;
+  // - pixels per side of a texel of the shadows and AO (1 full, 2 half, 4
+  //   quarter resolution), below full resolution implies deferred shading
+  int lightingScale = 1;
 };
 
 // The global Settings object, will be initialized by MainWindow
@@ -58,6 +58,29 @@ struct TextureInfo {
 // Type which can be used to store an RGBA color in floats [0,1]
 using SceneColor = glm::vec4;
 
+// Enum of the backgrounds of the raymarch shader
+enum class BackgroundType {
+  BACKGROUND_WHITE,
+  BACKGROUND_DARK,
+  BACKGROUND_SKY,
+  BACKGROUND_NIGHTSKY,
+};
+
+// Optional features of the raymarch shader. Each one is a #define, so a scene
+// only compiles (and runs) the code paths it uses.
+struct SceneShaderFeatures {
+  BackgroundType background = BackgroundType::BACKGROUND_WHITE;
+  // Perlin noise bump mapping on every object
+  bool perlinBump = true;
+  // Procedural environments
+  bool cloud = false;
+  bool terrain = false;
+  bool sea = false;
+};
+
+// Step factor of the over-relaxed sphere tracing of scenes that do not set it
+#define DEFAULT_RELAXATION 1.2f
+
 // Struct which contains the global color coefficients of a scene.
 // These are multiplied with the object-specific materials in the lighting
 // equation.
@@ -66,6 +89,10 @@ struct SceneGlobalData {
   float kd; // Diffuse term
   float ks; // Specular term
   float kt; // Transparency; used for extra credit (refraction)
+
+  float relaxation; // Step factor of the sphere tracing, in [1, 2)
+
+  SceneShaderFeatures features; // Permutation of the raymarch shader
 };
 
 // Struct which contains raw parsed data fro a single light
@@ -148,7 +148,8 @@ bool ScenefileReader::readJSON() {
 bool ScenefileReader::parseGlobalData(const QJsonObject &globalData) {
   QStringList requiredFields = {"ambientCoeff", "diffuseCoeff",
                                 "specularCoeff"};
-  QStringList optionalFields = {"transparentCoeff"};
+  QStringList optionalFields = {"transparentCoeff", "background", "bumpMap",
+                                "environment", "relaxation"};
   QStringList allFields = requiredFields + optionalFields;
   for (auto field : globalData.keys()) {
     if (!allFields.contains(field)) {
@@ -196,6 +197,68 @@ bool ScenefileReader::parseGlobalData(const QJsonObject &globalData) {
       return false;
     }
   }
+  m_globalData.relaxation = DEFAULT_RELAXATION;
+  if (globalData.contains("relaxation")) {
+    double relaxation = globalData["relaxation"].toDouble();
+    if (globalData["relaxation"].isDouble() && relaxation >= 1. &&
+        relaxation < 2.) {
+      m_globalData.relaxation = relaxation;
+    } else {
+      std::cout << "globalData relaxation must be a floating-point value in "
+                   "[1, 2)"
+                << std::endl;
+      return false;
+    }
+  }
+
+  // Shader features
+  SceneShaderFeatures &features = m_globalData.features;
+  if (globalData.contains("background")) {
+    QString background = globalData["background"].toString();
+    if (background == "white") {
+      features.background = BackgroundType::BACKGROUND_WHITE;
+    } else if (background == "dark") {
+      features.background = BackgroundType::BACKGROUND_DARK;
+    } else if (background == "sky") {
+      features.background = BackgroundType::BACKGROUND_SKY;
+    } else if (background == "nightsky") {
+      features.background = BackgroundType::BACKGROUND_NIGHTSKY;
+    } else {
+      std::cout << "globalData background must be one of white, dark, sky "
+                   "or nightsky"
+                << std::endl;
+      return false;
+    }
+  }
+  if (globalData.contains("bumpMap")) {
+    if (globalData["bumpMap"].isBool()) {
+      features.perlinBump = globalData["bumpMap"].toBool();
+    } else {
+      std::cout << "globalData bumpMap must be a boolean value" << std::endl;
+      return false;
+    }
+  }
+  if (globalData.contains("environment")) {
+    if (!globalData["environment"].isArray()) {
+      std::cout << "globalData environment must be an array" << std::endl;
+      return false;
+    }
+    for (const QJsonValue &value : globalData["environment"].toArray()) {
+      QString environment = value.toString();
+      if (environment == "cloud") {
+        features.cloud = true;
+      } else if (environment == "terrain") {
+        features.terrain = true;
+      } else if (environment == "sea") {
+        features.sea = true;
+      } else {
+        std::cout << "globalData environment must only contain cloud, "
+                     "terrain or sea"
+                  << std::endl;
+        return false;
+      }
+    }
+  }
 
   return true;
 }
@@ -0,0 +1,160 @@
+#include "shadercache.h"
+#include <QCryptographicHash>
+#include <QStandardPaths>
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+/**
+ * @brief Gets the key of a program
+ * @param vertexCode Source of the vertex shader
+ * @param fragmentCode Source of the fragment shader (with its defines)
+ * @returns Hex SHA-256 of the sources and the driver strings
+ */
+std::string ShaderCache::getKey(const std::string &vertexCode,
+                                const std::string &fragmentCode) {
+  QCryptographicHash hash(QCryptographicHash::Sha256);
+  auto add = [&hash](const std::string &s) {
+    hash.addData(QByteArray(s.data(), s.size()));
+    // - separator so that moving text between the parts changes the key
+    hash.addData(QByteArray("\0", 1));
+  };
+  add(std::to_string(SHADER_CACHE_VERSION));
+  for (GLenum name : {GL_VENDOR, GL_RENDERER, GL_VERSION}) {
+    const GLubyte *str = glGetString(name);
+    add(str ? reinterpret_cast<const char *>(str) : "");
+  }
+  add(vertexCode);
+  add(fragmentCode);
+  return hash.result().toHex().toStdString();
+}
+
+/**
+ * @brief Loads a cached binary into the program
+ * @param key Key from getKey
+ * @param programID Program without shaders
+ * @returns True if the program is linked from the binary
+ */
+bool ShaderCache::load(const std::string &key, GLuint programID) {
+  fs::path dir = getDirectory();
+  if (dir.empty()) {
+    return false;
+  }
+  fs::path path = dir / (key + ".bin");
+  std::ifstream file(path, std::ios::binary);
+  if (!file.is_open()) {
+    return false;
+  }
+  // Layout: binary format, then the binary
+  GLenum format;
+  file.read(reinterpret_cast<char *>(&format), sizeof(format));
+  std::vector<char> binary((std::istreambuf_iterator<char>(file)),
+                           std::istreambuf_iterator<char>());
+  file.close();
+
+  GLint status = GL_FALSE;
+  if (!binary.empty()) {
+    glProgramBinary(programID, format, binary.data(), binary.size());
+    glGetProgramiv(programID, GL_LINK_STATUS, &status);
+  }
+  std::error_code err;
+  if (status == GL_FALSE) {
+    // Corrupt or rejected by the driver
+    fs::remove(path, err);
+    return false;
+  }
+  // Mark as recently used
+  fs::last_write_time(path, fs::file_time_type::clock::now(), err);
+  return true;
+}
+
+/**
+ * @brief Writes the binary of a linked program
+ * - the program must have been linked with GL_PROGRAM_BINARY_RETRIEVABLE_HINT
+ * @param key Key from getKey
+ * @param programID Linked program
+ */
+void ShaderCache::store(const std::string &key, GLuint programID) {
+  fs::path dir = getDirectory();
+  if (dir.empty()) {
+    return;
+  }
+  GLint length = 0;
+  glGetProgramiv(programID, GL_PROGRAM_BINARY_LENGTH, &length);
+  if (length <= 0) {
+    return;
+  }
+  std::vector<char> binary(length);
+  GLenum format;
+  glGetProgramBinary(programID, length, nullptr, &format, binary.data());
+
+  // Write to a temporary file first so a reader never sees half a binary
+  fs::path path = dir / (key + ".bin");
+  fs::path tmpPath = dir / (key + ".tmp");
+  std::ofstream file(tmpPath, std::ios::binary | std::ios::trunc);
+  if (!file.is_open()) {
+    std::cerr << "Warning: Could not write shader cache " << tmpPath
+              << std::endl;
+    return;
+  }
+  file.write(reinterpret_cast<const char *>(&format), sizeof(format));
+  file.write(binary.data(), binary.size());
+  file.close();
+  std::error_code err;
+  if (!file) {
+    fs::remove(tmpPath, err);
+    return;
+  }
+  fs::rename(tmpPath, path, err);
+  prune(dir);
+}
+
+/**
+ * @brief Gets the cache directory and creates it if needed
+ * @returns <cache location>/shaders, or empty if the driver has no binary
+ * formats or the directory can not be created
+ */
+fs::path ShaderCache::getDirectory() {
+  GLint numFormats = 0;
+  glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &numFormats);
+  std::string location =
+      QStandardPaths::writableLocation(QStandardPaths::CacheLocation)
+          .toStdString();
+  if (numFormats == 0 || location.empty()) {
+    return {};
+  }
+  fs::path dir = fs::path(location) / "shaders";
+  std::error_code err;
+  fs::create_directories(dir, err);
+  if (err) {
+    return {};
+  }
+  return dir;
+}
+
+/**
+ * @brief Removes the least recently used binaries beyond
+ * SHADER_CACHE_MAX_FILES
+ * @param dir Cache directory
+ */
+void ShaderCache::prune(const fs::path &dir) {
+  std::error_code err;
+  std::vector<std::pair<fs::file_time_type, fs::path>> files;
+  for (const fs::directory_entry &entry : fs::directory_iterator(dir, err)) {
+    if (entry.path().extension() == ".bin") {
+      files.emplace_back(entry.last_write_time(err), entry.path());
+    }
+  }
+  if (files.size() <= SHADER_CACHE_MAX_FILES) {
+    return;
+  }
+  // Newest first
+  std::sort(files.begin(), files.end(),
+            [](const auto &a, const auto &b) { return a.first > b.first; });
+  for (size_t i = SHADER_CACHE_MAX_FILES; i < files.size(); i++) {
+    fs::remove(files[i].second, err);
+  }
+}
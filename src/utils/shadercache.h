@@ -0,0 +1,40 @@
+#pragma once
+
+// Defined before including GLEW to suppress deprecation messages on macOS
+#ifdef __APPLE__
+#define GL_SILENCE_DEPRECATION
+#endif
+#include <GL/glew.h>
+#include <filesystem>
+#include <string>
+
+// Max number of program binaries kept on disk (least recently used go first)
+#define SHADER_CACHE_MAX_FILES 32
+// Bump to drop every binary written by an older layout
+#define SHADER_CACHE_VERSION 1
+
+class ShaderCache {
+  // On-disk cache of linked shader programs (glGetProgramBinary /
+  // glProgramBinary) so that warm starts skip compiling the shaders.
+  // - a binary is keyed by a hash of the sources (after the defines are
+  //   injected) and the GL vendor, renderer and version strings. Editing a
+  //   shader or updating the driver gives a new key, and stale binaries are
+  //   pruned once the cache is full
+  // - a binary that the driver rejects is deleted and the program is compiled
+
+public:
+  // Gets the key of the program built from the sources
+  static std::string getKey(const std::string &vertexCode,
+                            const std::string &fragmentCode);
+  // Loads the binary of the key into the program
+  // - returns false if there is no usable binary
+  static bool load(const std::string &key, GLuint programID);
+  // Stores the binary of the linked program under the key
+  static void store(const std::string &key, GLuint programID);
+
+private:
+  // Gets the cache directory (empty if the cache is disabled)
+  static std::filesystem::path getDirectory();
+  // Removes the least recently used binaries beyond SHADER_CACHE_MAX_FILES
+  static void prune(const std::filesystem::path &dir);
+};
@@ -5,24 +5,89 @@
 #define GL_SILENCE_DEPRECATION
 #endif
 #include <GL/glew.h>
+#include "utils/shadercache.h"
 #include <QFile>
 #include <QTextStream>
 #include <iostream>
+#include <unordered_map>
+#include <vector>
 
 class ShaderLoader {
 public:
   static GLuint createShaderProgram(const char *vertex_file_path,
                                     const char *fragment_file_path) {
-    // Create and compile the shaders.
-    GLuint vertexShaderID = createShader(GL_VERTEX_SHADER, vertex_file_path);
-    GLuint fragmentShaderID =
-        createShader(GL_FRAGMENT_SHADER, fragment_file_path);
+    return createShaderProgramFromSource(readShaderFile(vertex_file_path),
+                                         readShaderFile(fragment_file_path));
+  }
 
-    // Link the shader program.
+  static GLuint createShaderProgramFromSource(const std::string &vertexCode,
+                                              const std::string &fragmentCode) {
+    GLuint programID = beginShaderProgram(vertexCode, fragmentCode);
+    finishShaderProgram(programID);
+    return programID;
+  }
+
+  // Issues the compile and link of the program without waiting for them.
+  // - a binary from the ShaderCache is used instead, if there is one
+  // - the driver may compile in the background (KHR_parallel_shader_compile)
+  // - call finishShaderProgram before using the program
+  static GLuint beginShaderProgram(const std::string &vertexCode,
+                                   const std::string &fragmentCode) {
     GLuint programID = glCreateProgram();
+    std::string key = ShaderCache::getKey(vertexCode, fragmentCode);
+    if (ShaderCache::load(key, programID)) {
+      return programID;
+    }
+
+    GLuint vertexShaderID = compileShader(GL_VERTEX_SHADER, vertexCode);
+    GLuint fragmentShaderID = compileShader(GL_FRAGMENT_SHADER, fragmentCode);
+
+    // Link the shader program.
     glAttachShader(programID, vertexShaderID);
     glAttachShader(programID, fragmentShaderID);
+    glProgramParameteri(programID, GL_PROGRAM_BINARY_RETRIEVABLE_HINT,
+                        GL_TRUE);
     glLinkProgram(programID);
+    // Cached once it is linked
+    getCacheKeys()[programID] = key;
+    return programID;
+  }
+
+  // True once the compile and link of the program are done. Without parallel
+  // shader compile it is always true (finishShaderProgram blocks instead).
+  static bool isShaderProgramReady(GLuint programID) {
+    if (!GLEW_KHR_parallel_shader_compile &&
+        !GLEW_ARB_parallel_shader_compile) {
+      return true;
+    }
+    GLint done;
+    glGetProgramiv(programID, GL_COMPLETION_STATUS_KHR, &done);
+    return done == GL_TRUE;
+  }
+
+  // Waits for the program and releases its shaders. Throws the info log and
+  // deletes the program if it failed to compile or link.
+  static void finishShaderProgram(GLuint programID) {
+    GLuint shaders[2];
+    GLsizei count;
+    glGetAttachedShaders(programID, 2, &count, shaders);
+
+    // Print info log if a shader fails to compile.
+    for (int i = 0; i < count; i++) {
+      GLint status;
+      glGetShaderiv(shaders[i], GL_COMPILE_STATUS, &status);
+
+      if (status == GL_FALSE) {
+        GLint length;
+        glGetShaderiv(shaders[i], GL_INFO_LOG_LENGTH, &length);
+
+        std::string log(length, '\0');
+        glGetShaderInfoLog(shaders[i], length, nullptr, &log[0]);
+
+        deleteShaderProgram(programID);
+        throw std::runtime_error(log);
+      }
+    }
 
     // Print the info log if error
     GLint status;
@@ -35,21 +100,53 @@ public:
       std::string log(length, '\0');
       glGetProgramInfoLog(programID, length, nullptr, &log[0]);
 
-      glDeleteProgram(programID);
+      deleteShaderProgram(programID);
       throw std::runtime_error(log);
     }
 
     // Shaders no longer necessary, stored in program
-    glDeleteShader(vertexShaderID);
-    glDeleteShader(fragmentShaderID);
+    for (int i = 0; i < count; i++) {
+      glDetachShader(programID, shaders[i]);
+      glDeleteShader(shaders[i]);
+    }
 
-    return programID;
+    // Store the binary for the next launch
+    auto it = getCacheKeys().find(programID);
+    if (it != getCacheKeys().end()) {
+      ShaderCache::store(it->second, programID);
+      getCacheKeys().erase(it);
+    }
   }
 
-private:
-  static GLuint createShader(GLenum shaderType, const char *filepath) {
-    GLuint shaderID = glCreateShader(shaderType);
+  // Deletes the program and the shaders that are still attached to it
+  static void deleteShaderProgram(GLuint programID) {
+    GLuint shaders[2];
+    GLsizei count;
+    glGetAttachedShaders(programID, 2, &count, shaders);
+    for (int i = 0; i < count; i++) {
+      glDeleteShader(shaders[i]);
+    }
+    glDeleteProgram(programID);
+    getCacheKeys().erase(programID);
+  }
+
+  // Inserts a #define for each name right after the #version line
+  // - a #line directive keeps the line numbers of the error log
+  static std::string injectDefines(const std::string &code,
+                                   const std::vector<std::string> &defines) {
+    size_t version = code.find('\n');
+    if (defines.empty() || version == std::string::npos) {
+      return code;
+    }
+    std::string block;
+    for (const std::string &define : defines) {
+      block += "#define " + define + "\n";
+    }
+    block += "#line 2\n";
+    return code.substr(0, version + 1) + block + code.substr(version + 1);
+  }
 
+  static std::string readShaderFile(const char *filepath) {
     // Read shader file.
     std::string code;
     QString filepathStr = QString(filepath);
@@ -61,28 +158,25 @@ private:
       throw std::runtime_error(std::string("Failed to open shader: ") +
                                filepath);
     }
+    return code;
+  }
+
+private:
+  // Cache keys of the programs that were compiled but not finished yet
+  static std::unordered_map<GLuint, std::string> &getCacheKeys() {
+    static std::unordered_map<GLuint, std::string> keys;
+    return keys;
+  }
+
+  static GLuint compileShader(GLenum shaderType, const std::string &code) {
+    GLuint shaderID = glCreateShader(shaderType);
 
     // Compile shader code.
+    // - the status is checked by finishShaderProgram
     const char *codePtr = code.c_str();
     glShaderSource(shaderID, 1, &codePtr,
                    nullptr); // Assumes code is null terminated
     glCompileShader(shaderID);
-
-    // Print info log if shader fails to compile.
-    GLint status;
-    glGetShaderiv(shaderID, GL_COMPILE_STATUS, &status);
-
-    if (status == GL_FALSE) {
-      GLint length;
-      glGetShaderiv(shaderID, GL_INFO_LOG_LENGTH, &length);
-
-      std::string log(length, '\0');
-      glGetShaderInfoLog(shaderID, length, nullptr, &log[0]);
-
-      glDeleteShader(shaderID);
-      throw std::runtime_error(log);
-    }
-
     return shaderID;
   }
 };
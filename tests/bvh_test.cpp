@@ -0,0 +1,231 @@
+#include "raymarch/bvh.h"
+#include <algorithm>
+#include <cfloat>
+#include <glm/gtc/matrix_transform.hpp>
+#include <iostream>
+#include <random>
+
+// Checks that the BVH finds the closest object the way sdScene walks it
+// - the distance to an object is that to its world bounds, so the walk must
+//   give the brute force minimum exactly
+// - the walk reads the packed texels and the object indices, like the shader
+
+static const int NUM_SCENES = 20;
+static const int NUM_POINTS = 200;
+// Max depth of the BVH + 1 (BVH_STACK_SIZE in raymarch.frag)
+static const int STACK_SIZE = 25;
+
+/**
+ * @brief Reports a failed check
+ */
+static bool check(bool ok, const char *what) {
+  if (!ok) {
+    std::cerr << "FAILED: " << what << std::endl;
+  }
+  return ok;
+}
+
+/**
+ * @brief Distance from p to an axis aligned box (0 inside)
+ */
+static float boxDistance(const glm::vec3 &p, const glm::vec3 &min,
+                         const glm::vec3 &max) {
+  return glm::length(glm::max(glm::max(min - p, p - max), 0.f));
+}
+
+/**
+ * @brief Checks if a box contains another one
+ */
+static bool contains(const glm::vec3 &min, const glm::vec3 &max,
+                     const glm::vec3 &innerMin, const glm::vec3 &innerMax) {
+  return glm::all(glm::lessThanEqual(min, innerMin)) &&
+         glm::all(glm::lessThanEqual(innerMax, max));
+}
+
+/**
+ * @brief Builds a scene of randomly placed, rotated and scaled objects
+ * - some objects are fractals (unbounded), some share their position
+ */
+static std::vector<RayMarchObj> randomScene(std::mt19937 &rng, int size) {
+  std::uniform_real_distribution<float> pos(-20.f, 20.f);
+  std::uniform_real_distribution<float> scale(0.1f, 3.f);
+  std::uniform_real_distribution<float> angle(0.f, 6.28f);
+  std::uniform_int_distribution<int> type(
+      0, (int)PrimitiveType::MENGERSPONGE);
+  std::vector<RayMarchObj> objects;
+  glm::vec3 last(0.f);
+  for (int i = 0; i < size; i++) {
+    glm::vec3 p = i % 7 == 6 ? last : glm::vec3(pos(rng), pos(rng), pos(rng));
+    last = p;
+    glm::mat4 s = glm::scale(glm::mat4(1.f),
+                             glm::vec3(scale(rng), scale(rng), scale(rng)));
+    glm::mat4 r = glm::rotate(glm::mat4(1.f), angle(rng),
+                              glm::normalize(glm::vec3(pos(rng), pos(rng),
+                                                       pos(rng)) +
+                                             0.01f));
+    glm::mat4 ctm = glm::translate(glm::mat4(1.f), p) * r * s;
+    objects.emplace_back(i, (PrimitiveType)type(rng), ctm, glm::vec4(1.f), 0);
+    objects.back().m_scale = s;
+  }
+  return objects;
+}
+
+/**
+ * @brief Walks the packed tree near child first, skipping every node that
+ * is farther away than the closest object so far (see sdScene)
+ * @returns Distance to the closest bounded object (FLT_MAX if none)
+ */
+static float walk(const std::vector<glm::vec4> &texels,
+                  const std::vector<int> &indices,
+                  const std::vector<RayMarchObj> &objects,
+                  const glm::vec3 &p, bool &overflow) {
+  auto isCulled = [](float d, float minD) { return d > 0.f && d >= minD; };
+  auto nodeDistance = [&](int node) {
+    return boxDistance(p, glm::vec3(texels[2 * node]),
+                       glm::vec3(texels[2 * node + 1]));
+  };
+  float minD = FLT_MAX;
+  if (texels.empty()) {
+    return minD;
+  }
+  int stack[STACK_SIZE];
+  int sp = 0;
+  stack[sp++] = 0;
+  while (sp > 0) {
+    int node = stack[--sp];
+    if (isCulled(nodeDistance(node), minD)) {
+      continue;
+    }
+    int count = (int)texels[2 * node + 1].w;
+    if (count > 0) {
+      int first = (int)texels[2 * node].w;
+      for (int k = first; k < first + count; k++) {
+        glm::vec3 min, max;
+        BVH::getWorldBounds(objects[indices[k]], min, max);
+        minD = std::min(minD, boxDistance(p, min, max));
+      }
+      continue;
+    }
+    int left = (int)texels[2 * node].w;
+    float dl = nodeDistance(left);
+    float dr = nodeDistance(left + 1);
+    if (sp + 2 > STACK_SIZE) {
+      overflow = true;
+      return minD;
+    }
+    if (!isCulled(std::max(dl, dr), minD)) {
+      stack[sp++] = dl <= dr ? left + 1 : left;
+    }
+    if (!isCulled(std::min(dl, dr), minD)) {
+      stack[sp++] = dl <= dr ? left : left + 1;
+    }
+  }
+  return minD;
+}
+
+/**
+ * @brief Checks the structure of the tree
+ * - every object is listed once, the unbounded ones (and those kept out)
+ *   at the end
+ * - the box of a node contains its children, or the bounds of its objects
+ */
+static bool checkTree(const BVH &bvh, const std::vector<RayMarchObj> &objects,
+                      const std::vector<bool> &keepOut) {
+  bool ok = true;
+  const std::vector<int> &indices = bvh.getObjectIndices();
+  std::vector<int> sorted = indices;
+  std::sort(sorted.begin(), sorted.end());
+  bool listedOnce = (int)sorted.size() == (int)objects.size();
+  for (int i = 0; listedOnce && i < (int)sorted.size(); i++) {
+    listedOnce = sorted[i] == i;
+  }
+  ok &= check(listedOnce, "every object is listed once");
+
+  int numBounded = (int)indices.size() - bvh.getNumUnbounded();
+  for (int k = 0; k < (int)indices.size(); k++) {
+    glm::vec3 min, max;
+    int i = indices[k];
+    bool bounded = !keepOut[i] && BVH::getWorldBounds(objects[i], min, max);
+    ok &= check(bounded == (k < numBounded),
+                "the unbounded objects are listed after the bounded ones");
+  }
+  ok &= check(bvh.getDepth() <= BVH_MAX_DEPTH, "the depth is capped");
+
+  const std::vector<BVHNode> &nodes = bvh.getNodes();
+  int leafObjects = 0;
+  for (const BVHNode &node : nodes) {
+    if (node.count > 0) {
+      leafObjects += node.count;
+      for (int k = node.leftOrFirst; k < node.leftOrFirst + node.count; k++) {
+        glm::vec3 min, max;
+        BVH::getWorldBounds(objects[indices[k]], min, max);
+        ok &= check(contains(node.min, node.max, min, max),
+                    "a leaf contains its objects");
+      }
+      continue;
+    }
+    for (int c = node.leftOrFirst; c < node.leftOrFirst + 2; c++) {
+      ok &= check(c < (int)nodes.size(), "the children exist");
+      ok &= check(contains(node.min, node.max, nodes[c].min, nodes[c].max),
+                  "a node contains its children");
+    }
+  }
+  ok &= check(leafObjects == numBounded,
+              "the leaves hold every bounded object");
+  return ok;
+}
+
+int main() {
+  std::mt19937 rng(1);
+  std::uniform_real_distribution<float> pos(-30.f, 30.f);
+  bool ok = true;
+  for (int scene = 0; scene < NUM_SCENES; scene++) {
+    // - from a single object up to a large scene
+    int size = scene < 4 ? scene + 1 : 50 * scene;
+    std::vector<RayMarchObj> objects = randomScene(rng, size);
+    // - every other scene keeps some bounded objects out of the tree
+    std::vector<bool> keepOut(objects.size(), false);
+    for (int i = 0; scene % 2 && i < (int)objects.size(); i += 5) {
+      keepOut[i] = true;
+    }
+    BVH bvh;
+    bvh.build(objects, keepOut);
+    ok &= checkTree(bvh, objects, keepOut);
+
+    std::vector<glm::vec4> texels;
+    bvh.packNodes(texels);
+    ok &= check((int)texels.size() == (int)bvh.getNodes().size() *
+                                          BVH_NODE_TEXELS,
+                "the nodes are packed");
+    const std::vector<int> &indices = bvh.getObjectIndices();
+    for (int i = 0; i < NUM_POINTS; i++) {
+      glm::vec3 p(pos(rng), pos(rng), pos(rng));
+      float expected = FLT_MAX;
+      for (int k = 0; k < (int)objects.size(); k++) {
+        glm::vec3 min, max;
+        if (!keepOut[k] && BVH::getWorldBounds(objects[k], min, max)) {
+          expected = std::min(expected, boxDistance(p, min, max));
+        }
+      }
+      bool overflow = false;
+      float d = walk(texels, indices, objects, p, overflow);
+      ok &= check(!overflow, "the walk fits in the shader stack");
+      ok &= check(d == expected, "the walk finds the closest object");
+    }
+  }
+
+  // Objects on top of each other still split
+  std::vector<RayMarchObj> stacked;
+  for (int i = 0; i < 64; i++) {
+    stacked.emplace_back(i, PrimitiveType::PRIMITIVE_SPHERE, glm::mat4(1.f),
+                         glm::vec4(1.f), 0);
+  }
+  BVH bvh;
+  bvh.build(stacked);
+  ok &= checkTree(bvh, stacked, std::vector<bool>(stacked.size(), false));
+  for (const BVHNode &node : bvh.getNodes()) {
+    ok &= check(node.count <= BVH_MAX_LEAF_SIZE,
+                "stacked objects are split into small leaves");
+  }
+  return ok ? 0 : 1;
+}
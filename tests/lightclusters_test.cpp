@@ -0,0 +1,204 @@
+#include "raymarch/lightclusters.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <glm/gtc/matrix_transform.hpp>
+#include <iostream>
+#include <random>
+
+// Checks that LightClusters never leaves out a light that reaches a point
+// - the range is where the attenuation drops to LIGHT_CUTOFF
+// - the sphere of a light contains every point its range and cone reach
+// - the cluster of a point (found like getCluster in raymarch.frag) lists
+//   every light whose sphere contains the point
+
+static const int NUM_LIGHTS = 40;
+static const int NUM_POINTS = 20000;
+static const float NEAR = 0.1f;
+static const float FAR = 100.f;
+
+/**
+ * @brief Reports a failed check
+ */
+static bool check(bool ok, const char *what) {
+  if (!ok) {
+    std::cerr << "FAILED: " << what << std::endl;
+  }
+  return ok;
+}
+
+/**
+ * @brief Brightest channel of a light at distance d (see attenuationFactor
+ * in raymarch.frag)
+ */
+static float brightness(const SceneLightData &light, float d) {
+  const glm::vec3 &f = light.function;
+  float att = std::min(1.f / (f[0] + d * f[1] + d * d * f[2]), 1.f);
+  return att * std::max({light.color.r, light.color.g, light.color.b});
+}
+
+/**
+ * @brief Makes a random point or spot light
+ */
+static SceneLightData randomLight(std::mt19937 &rng) {
+  std::uniform_real_distribution<float> pos(-60.f, 60.f);
+  std::uniform_real_distribution<float> unit(0.f, 1.f);
+  SceneLightData light{};
+  light.type = unit(rng) < 0.5f ? LightType::LIGHT_POINT
+                                : LightType::LIGHT_SPOT;
+  light.color = glm::vec4(unit(rng), unit(rng), unit(rng), 1.f);
+  light.function = glm::vec3(1.f, 0.5f * unit(rng), 0.1f + unit(rng));
+  light.pos = glm::vec4(pos(rng), pos(rng), pos(rng), 1.f);
+  light.dir = glm::vec4(glm::normalize(glm::vec3(pos(rng), pos(rng), pos(rng)) +
+                                       0.01f),
+                        0.f);
+  // - narrow and wide cones
+  light.angle = 0.05f + 1.6f * unit(rng);
+  light.penumbra = 0.1f * light.angle;
+  return light;
+}
+
+/**
+ * @brief Checks the range of lights with and without falloff
+ */
+static bool checkRange() {
+  bool ok = true;
+  SceneLightData light{};
+  light.type = LightType::LIGHT_POINT;
+  light.color = glm::vec4(1.f, 0.5f, 0.25f, 1.f);
+  for (glm::vec3 f : {glm::vec3(1.f, 0.f, 0.5f), glm::vec3(1.f, 0.3f, 0.f),
+                      glm::vec3(0.5f, 0.2f, 0.01f)}) {
+    light.function = f;
+    float range = LightClusters::getRange(light);
+    ok &= check(std::abs(brightness(light, range) - LIGHT_CUTOFF) <
+                    1e-3f * LIGHT_CUTOFF,
+                "the light drops to the cutoff at its range");
+    ok &= check(brightness(light, 0.99f * range) > LIGHT_CUTOFF,
+                "the light is above the cutoff within its range");
+  }
+  light.function = glm::vec3(1.f, 0.f, 0.f);
+  ok &= check(LightClusters::getRange(light) == FLT_MAX,
+              "a light without falloff has no range");
+  glm::vec3 c;
+  float radius;
+  ok &= check(!LightClusters::getBounds(light, c, radius),
+              "a light without falloff is unbounded");
+  light.function = glm::vec3(1000.f, 0.f, 1.f);
+  ok &= check(LightClusters::getRange(light) == 0.f,
+              "a light below the cutoff has no range");
+  light.function = glm::vec3(1.f, 0.f, 1.f);
+  for (LightType type : {LightType::LIGHT_DIRECTIONAL, LightType::LIGHT_AREA}) {
+    light.type = type;
+    ok &= check(!LightClusters::getBounds(light, c, radius),
+                "directional and area lights are unbounded");
+  }
+  return ok;
+}
+
+/**
+ * @brief Checks that the sphere of a light contains the points it reaches
+ */
+static bool checkBounds(std::mt19937 &rng) {
+  std::uniform_real_distribution<float> unit(0.f, 1.f);
+  bool ok = true;
+  for (int i = 0; i < 200; i++) {
+    SceneLightData light = randomLight(rng);
+    glm::vec3 center;
+    float radius;
+    if (!check(LightClusters::getBounds(light, center, radius),
+               "point and spot lights are bounded")) {
+      return false;
+    }
+    float range = LightClusters::getRange(light);
+    glm::vec3 dir = glm::vec3(light.dir);
+    glm::vec3 side = glm::normalize(glm::cross(dir, glm::vec3(0.3f, 1.f, 0.f)));
+    for (int j = 0; j < 100; j++) {
+      // - random point in the cone of a spot light, anywhere for a point
+      //   light
+      float angle = light.type == LightType::LIGHT_SPOT
+                        ? unit(rng) * light.angle
+                        : unit(rng) * (float)M_PI;
+      glm::mat4 spin = glm::rotate(glm::mat4(1.f), 6.28f * unit(rng), dir);
+      glm::vec3 axis = glm::vec3(spin * glm::vec4(side, 0.f));
+      glm::vec3 v = glm::vec3(glm::rotate(glm::mat4(1.f), angle, axis) *
+                              glm::vec4(dir, 0.f));
+      glm::vec3 p = glm::vec3(light.pos) + v * range * unit(rng);
+      ok &= check(glm::length(p - center) <= radius * 1.0001f + 1e-4f,
+                  "the sphere of a light contains what it reaches");
+    }
+  }
+  return ok;
+}
+
+/**
+ * @brief Checks the clusters of random views against random points
+ */
+static bool checkClusters(std::mt19937 &rng) {
+  std::uniform_real_distribution<float> pos(-50.f, 50.f);
+  std::uniform_real_distribution<float> unit(0.f, 1.f);
+  bool ok = true;
+  for (int scene = 0; scene < 4; scene++) {
+    std::vector<SceneLightData> lights;
+    for (int i = 0; i < NUM_LIGHTS; i++) {
+      lights.push_back(randomLight(rng));
+    }
+    // - unbounded lights are in every cluster
+    lights[3].type = LightType::LIGHT_DIRECTIONAL;
+    lights[7].function = glm::vec3(1.f, 0.f, 0.f);
+
+    glm::vec3 eye(pos(rng), pos(rng), pos(rng));
+    glm::mat4 view = glm::lookAt(eye, glm::vec3(0.f), glm::vec3(0.f, 1.f, 0.f));
+    glm::mat4 proj =
+        glm::perspective(0.5f + unit(rng), 0.5f + 1.5f * unit(rng), NEAR, FAR);
+    LightClusters clusters;
+    clusters.setLights(lights, lights.size());
+    clusters.build(view, proj, NEAR, FAR);
+    ok &= check(clusters.getNumDropped() == 0, "no light is dropped");
+    std::vector<int> data;
+    clusters.packClusters(data);
+
+    glm::mat4 invView = glm::inverse(view);
+    glm::vec2 scale = clusters.getScale();
+    for (int i = 0; i < NUM_POINTS; i++) {
+      // - a point on the screen, from the eye to beyond the far plane
+      glm::vec2 ndc(2.f * unit(rng) - 1.f, 2.f * unit(rng) - 1.f);
+      float depth = 1.2f * FAR * unit(rng) * unit(rng) + 1e-3f;
+      glm::vec3 p = glm::vec3(
+          invView * glm::vec4(ndc * depth / scale, -depth, 1.f));
+
+      // Cluster of the point (see getCluster in raymarch.frag)
+      glm::ivec2 tile = glm::clamp(
+          glm::ivec2(glm::floor((ndc * 0.5f + 0.5f) *
+                                glm::vec2(CLUSTER_TILES_X, CLUSTER_TILES_Y))),
+          glm::ivec2(0), glm::ivec2(CLUSTER_TILES_X - 1, CLUSTER_TILES_Y - 1));
+      int slice =
+          depth <= NEAR
+              ? 0
+              : std::min((int)(std::log(depth / NEAR) * clusters.getLogScale()),
+                         CLUSTER_SLICES - 1);
+      int c = (slice * CLUSTER_TILES_Y + tile.y) * CLUSTER_TILES_X + tile.x;
+      const int *first = &data[data[2 * c]];
+      const int *last = first + data[2 * c + 1];
+
+      for (int l = 0; l < (int)lights.size(); l++) {
+        glm::vec3 center;
+        float radius;
+        bool reaches = !LightClusters::getBounds(lights[l], center, radius) ||
+                       glm::length(p - center) < radius * 0.9999f;
+        if (reaches) {
+          ok &= check(std::find(first, last, l) != last,
+                      "the cluster of a point lists the lights reaching it");
+        }
+      }
+    }
+  }
+  return ok;
+}
+
+int main() {
+  std::mt19937 rng(1);
+  bool ok = checkRange();
+  ok &= checkBounds(rng);
+  ok &= checkClusters(rng);
+  return ok ? 0 : 1;
+}
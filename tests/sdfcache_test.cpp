@@ -0,0 +1,200 @@
+#include "raymarch/sdfcache.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <glm/gtc/matrix_transform.hpp>
+#include <iostream>
+#include <random>
+
+// Checks that the SDF cache never claims more room than there is
+// - the scenes are rotated and uniformly scaled spheres, cubes and tori,
+//   whose distances are exact, so the cached bound (looked up like sdCache
+//   in raymarch.frag) must never exceed the distance to the closest cached
+//   object
+// - in a brick the bound is at most twice the interpolation error below the
+//   distance, so the shader can step by it
+
+static const int NUM_SCENES = 4;
+static const int NUM_POINTS = 20000;
+
+/**
+ * @brief Reports a failed check
+ */
+static bool check(bool ok, const char *what) {
+  if (!ok) {
+    std::cerr << "FAILED: " << what << std::endl;
+  }
+  return ok;
+}
+
+/**
+ * @brief Exact distance to an object of the test scenes
+ * - the scale is uniform, so the object space distance times the scale is
+ *   the world space distance
+ */
+static float distance(const RayMarchObj &obj, const glm::vec3 &p) {
+  glm::vec3 po = glm::vec3(obj.m_ctmInv * glm::vec4(p, 1.f));
+  float d;
+  switch (obj.m_type) {
+  case PrimitiveType::PRIMITIVE_SPHERE:
+    d = glm::length(po) - 0.5f;
+    break;
+  case PrimitiveType::PRIMITIVE_CUBE: {
+    glm::vec3 q = glm::abs(po) - 0.5f;
+    d = glm::length(glm::max(q, 0.f)) +
+        std::min(std::max(q.x, std::max(q.y, q.z)), 0.f);
+    break;
+  }
+  default: {
+    // - torus, radii 0.5 and 0.125
+    glm::vec2 q(glm::length(glm::vec2(po.x, po.z)) - 0.5f, po.y);
+    d = glm::length(q) - 0.125f;
+    break;
+  }
+  }
+  return d * obj.m_scale[0][0];
+}
+
+/**
+ * @brief Lower bound of the distance from the cache (see sdCache in
+ * raymarch.frag)
+ * @param inBrick Set to true if p is in a cell with a brick
+ */
+static float lookup(const SDFCache &cache, const glm::vec3 &p,
+                    bool &inBrick) {
+  glm::ivec3 dims = cache.getGridDims();
+  glm::vec3 gridMin = cache.getMin();
+  glm::vec3 gridMax = gridMin + glm::vec3(dims) * cache.getCellSize();
+  glm::vec3 q = (p - gridMin) / cache.getCellSize();
+  inBrick = false;
+  if (glm::any(glm::lessThan(q, glm::vec3(0.f))) ||
+      glm::any(glm::greaterThanEqual(q, glm::vec3(dims)))) {
+    return glm::length(glm::max(glm::max(gridMin - p, p - gridMax), 0.f));
+  }
+  glm::ivec3 c(q);
+  glm::vec4 cell = cache.getGrid()[(c.z * dims.y + c.y) * dims.x + c.x];
+  if (cell.x < 0.f) {
+    return cell.w;
+  }
+  inBrick = true;
+
+  // Trilinear interpolation of the samples around p
+  glm::ivec3 atlas = cache.getAtlasDims();
+  glm::vec3 s = glm::fract(q) * float(SDF_CACHE_BRICK - 1);
+  glm::ivec3 s0 = glm::min(glm::ivec3(s), SDF_CACHE_BRICK - 2);
+  glm::vec3 f = s - glm::vec3(s0);
+  float d = 0.f;
+  for (int i = 0; i < 8; i++) {
+    glm::ivec3 o((i & 1) ? 1 : 0, (i & 2) ? 1 : 0, (i & 4) ? 1 : 0);
+    glm::ivec3 t = glm::ivec3(cell) + s0 + o;
+    glm::vec3 w = glm::mix(1.f - f, f, glm::vec3(o));
+    d += w.x * w.y * w.z *
+         cache.getAtlas()[(t.z * atlas.y + t.y) * atlas.x + t.x];
+  }
+  return d - cache.getError();
+}
+
+/**
+ * @brief Adds an object to a scene
+ */
+static void addObject(std::vector<RayMarchObj> &objects, PrimitiveType type,
+                      const glm::vec3 &pos, float angle, const glm::vec3 &axis,
+                      float scale) {
+  glm::mat4 s = glm::scale(glm::mat4(1.f), glm::vec3(scale));
+  glm::mat4 ctm = glm::rotate(glm::translate(glm::mat4(1.f), pos), angle,
+                              glm::normalize(axis)) *
+                  s;
+  objects.emplace_back(objects.size(), type, ctm, glm::vec4(1.f), 0);
+  objects.back().m_scale = s;
+}
+
+/**
+ * @brief Checks the cached bound of random scenes at random points
+ */
+static bool checkBounds(std::mt19937 &rng) {
+  std::uniform_real_distribution<float> unit(0.f, 1.f);
+  std::uniform_real_distribution<float> pos(-4.f, 4.f);
+  const PrimitiveType types[3] = {PrimitiveType::PRIMITIVE_SPHERE,
+                                  PrimitiveType::PRIMITIVE_CUBE,
+                                  PrimitiveType::PRIMITIVE_TORUS};
+  bool ok = true;
+  SDFCache cache;
+  for (int scene = 0; scene < NUM_SCENES; scene++) {
+    std::vector<RayMarchObj> objects;
+    for (int i = 0; i < 4 + 3 * scene; i++) {
+      addObject(objects, types[i % 3], glm::vec3(pos(rng), pos(rng), pos(rng)),
+                6.28f * unit(rng),
+                glm::vec3(pos(rng), pos(rng), pos(rng)) + 0.01f,
+                0.5f + 1.5f * unit(rng));
+    }
+    // - a ground plane and an animated fractal are never cached
+    addObject(objects, PrimitiveType::PRIMITIVE_CUBE, glm::vec3(0.f, -5.f, 0.f),
+              0.f, glm::vec3(0.f, 1.f, 0.f), 200.f);
+    addObject(objects, PrimitiveType::MANDELBROT, glm::vec3(0.f), 0.f,
+              glm::vec3(0.f, 1.f, 0.f), 1.f);
+    std::vector<bool> cached = SDFCache::getCachedObjects(objects);
+    for (int i = 0; i < (int)objects.size(); i++) {
+      ok &= check(cached[i] == (i < (int)objects.size() - 2),
+                  "only the small static objects are cached");
+    }
+    if (!check(cache.bake(objects, 8.f, glm::vec2(0.f)), "the scene bakes")) {
+      return false;
+    }
+    ok &= check(cache.getNumBricks() > 0, "the surfaces get bricks");
+
+    glm::vec3 gridMin = cache.getMin();
+    glm::vec3 gridSize =
+        glm::vec3(cache.getGridDims()) * cache.getCellSize();
+    for (int i = 0; i < NUM_POINTS; i++) {
+      // - the grid and a margin around it, and points close to a surface
+      glm::vec3 p = gridMin - 0.1f * gridSize +
+                    1.2f * gridSize *
+                        glm::vec3(unit(rng), unit(rng), unit(rng));
+      float d = FLT_MAX;
+      for (int k = 0; k < (int)objects.size(); k++) {
+        if (cached[k]) {
+          d = std::min(d, distance(objects[k], p));
+        }
+      }
+      if (i % 2 && d > 0.f) {
+        glm::vec3 toward =
+            glm::normalize(glm::vec3(pos(rng), pos(rng), pos(rng)) + 0.01f);
+        p += toward * d * unit(rng);
+        d = FLT_MAX;
+        for (int k = 0; k < (int)objects.size(); k++) {
+          if (cached[k]) {
+            d = std::min(d, distance(objects[k], p));
+          }
+        }
+      }
+      bool inBrick;
+      float bound = lookup(cache, p, inBrick);
+      ok &= check(bound <= d + 1e-4f,
+                  "the bound never exceeds the distance");
+      if (inBrick) {
+        ok &= check(bound >= d - 2.f * cache.getError() - 1e-4f,
+                    "the bound in a brick is close to the distance");
+      }
+    }
+  }
+  return ok;
+}
+
+int main() {
+  std::mt19937 rng(1);
+  bool ok = checkBounds(rng);
+
+  // Nothing to cache, or a Mandelbulb without bounds
+  SDFCache cache;
+  std::vector<RayMarchObj> objects;
+  addObject(objects, PrimitiveType::MENGERSPONGE, glm::vec3(0.f), 0.f,
+            glm::vec3(0.f, 1.f, 0.f), 1.f);
+  ok &= check(!cache.bake(objects, 8.f, glm::vec2(0.f)),
+              "a scene of animated objects is not cached");
+  addObject(objects, PrimitiveType::MANDELBULB, glm::vec3(0.f), 0.f,
+            glm::vec3(0.f, 1.f, 0.f), 1.f);
+  ok &= check(SDFCache::getCachedObjects(objects)[1], "a Mandelbulb is cached");
+  ok &= check(!cache.bake(objects, 1.5f, glm::vec2(0.f)),
+              "a Mandelbulb of power below 2 is not cached");
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,69 @@
+#include "cpu/tilescheduler.h"
+#include <chrono>
+#include <iostream>
+#include <thread>
+
+// Checks that TileScheduler orders the tiles by their cost
+// - a single thread runs the tiles in the order of the scheduler
+
+static const int NUM_TILES = 16;
+
+/**
+ * @brief Runs the tiles and records the order they ran in
+ * @param slowTile Tile whose job takes a few milliseconds
+ * @param probe Probe passed to the scheduler (may be empty)
+ */
+static std::vector<int> runTiles(TileScheduler &scheduler, ThreadPool &pool,
+                                 int slowTile,
+                                 const std::function<void(int)> &probe) {
+  std::vector<int> order;
+  scheduler.run(
+      pool, NUM_TILES,
+      [&](int tile) {
+        order.push_back(tile);
+        if (tile == slowTile) {
+          std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+      },
+      probe);
+  return order;
+}
+
+/**
+ * @brief Reports a failed check
+ */
+static bool check(bool ok, const char *what) {
+  if (!ok) {
+    std::cerr << "FAILED: " << what << std::endl;
+  }
+  return ok;
+}
+
+int main() {
+  ThreadPool pool(1);
+  TileScheduler scheduler;
+  bool ok = true;
+
+  // First frame: no timings, the probe finds the expensive tile
+  auto probe = [](int tile) {
+    if (tile == 5) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+  };
+  std::vector<int> order = runTiles(scheduler, pool, 11, probe);
+  ok &= check((int)order.size() == NUM_TILES, "every tile runs once");
+  ok &= check(order.front() == 5, "the probed tile runs first");
+
+  // Next frame: the timings of the last frame win over the probe
+  order = runTiles(scheduler, pool, -1, probe);
+  ok &= check(order.front() == 11, "the slowest tile of the last frame "
+                                   "runs first");
+
+  // After a reset without a probe: plain order
+  scheduler.reset();
+  order = runTiles(scheduler, pool, -1, nullptr);
+  for (int i = 0; i < NUM_TILES; i++) {
+    ok &= check(order[i] == i, "tiles without costs keep their order");
+  }
+  return ok ? 0 : 1;
+}